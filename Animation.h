@@ -1,61 +1,37 @@
 #pragma once
 #include "Object3D.h"
+#include "AnimationEngine.h"
 
 /**
 * @brief Represents an abstract animation of an object, manipulating one or more of its
 * attributes over a duration.
-* This is an abstract class that cannot be instantiated.
+* This is an abstract class that cannot be instantiated. Animations do not tick themselves;
+* when started they register with an AnimationEngine, which evaluates all animations of the
+* same type together.
 */
 class Animation {
 private:
 	float_t m_duration;
-	float_t m_currentTime;
 	Object3D& m_object;
 
-	/**
-	 * @brief Called when the animation is activated by an Animator.
-	 */
-	virtual void startAnimation() {}
-	/**
-	 * @brief Called when the animation is ticked by an Animator.
-	 * @param dt the change in time since the last tick.
-	 */
-	virtual void applyAnimation(float_t dt) = 0;
-
 public:
-	Animation(Object3D& obj, float_t duration) : m_object(obj), m_duration(duration),
-		m_currentTime(-1) {
+	Animation(Object3D& obj, float_t duration) : m_object(obj), m_duration(duration) {
 	}
 
+	virtual ~Animation() = default;
+
 	/**
 	* @brief The duration over which the animation is active.
 	*/
 	float_t duration() const { return m_duration; }
 
-	/**
-	 * @brief How much time has elapsed during the execution of this animation.
-	 */
-	float_t currentTime() const { return m_currentTime; }
-
 	/**
 	* @brief The object the animation is manipulating.
 	*/
 	Object3D& object() const { return m_object; }
 
 	/**
-	* @brief Advances the animation by the given interval, in seconds.
-	*/
-	void tick(float_t dt) {
-		m_currentTime += dt;
-		applyAnimation(dt);
-	}
-
-	/**
-	 * @brief Starts the animation.
+	 * @brief Registers the animation with the engine, to begin at the given engine time.
 	 */
-	void start() {
-		m_currentTime = 0;
-		startAnimation();
-	}
-
+	virtual void schedule(AnimationEngine& engine, float_t startTime) = 0;
 };
@@ -0,0 +1,125 @@
+#include "AnimationClip.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	const float_t UNORM16_MAX = 65535.0f;
+	const float_t SNORM16_MAX = 32767.0f;
+
+	// Quantizes vector samples to 16 bits per component, relative to their bounding box.
+	// Samples that never change are stored once, with a stride of 0.
+	void quantizeVectors(const std::vector<glm::vec3>& samples, glm::vec3& min, glm::vec3& step,
+		std::vector<uint16_t>& out, uint32_t& stride) {
+		if (samples.empty()) {
+			return;
+		}
+		min = samples[0];
+		glm::vec3 max = samples[0];
+		for (auto& s : samples) {
+			min = glm::min(min, s);
+			max = glm::max(max, s);
+		}
+		step = (max - min) / UNORM16_MAX;
+
+		bool constant = max == min;
+		size_t count = constant ? 1 : samples.size();
+		stride = constant ? 0 : 3;
+		out.resize(count * 3);
+		for (size_t i = 0; i < count; i++) {
+			for (auto c = 0; c < 3; c++) {
+				out[i * 3 + c] = step[c] > 0
+					? static_cast<uint16_t>(std::lround((samples[i][c] - min[c]) / step[c]))
+					: 0;
+			}
+		}
+	}
+
+	void quantizeRotations(const std::vector<glm::quat>& samples, std::vector<int16_t>& out,
+		uint32_t& stride) {
+		if (samples.empty()) {
+			return;
+		}
+		bool constant = std::all_of(samples.begin(), samples.end(), [&](const glm::quat& q) {
+			return q == samples[0];
+		});
+		size_t count = constant ? 1 : samples.size();
+		stride = constant ? 0 : 4;
+		out.resize(count * 4);
+		for (size_t i = 0; i < count; i++) {
+			const glm::quat& q = samples[i];
+			out[i * 4 + 0] = static_cast<int16_t>(std::lround(q.x * SNORM16_MAX));
+			out[i * 4 + 1] = static_cast<int16_t>(std::lround(q.y * SNORM16_MAX));
+			out[i * 4 + 2] = static_cast<int16_t>(std::lround(q.z * SNORM16_MAX));
+			out[i * 4 + 3] = static_cast<int16_t>(std::lround(q.w * SNORM16_MAX));
+		}
+	}
+}
+
+SampledTrack SampledTrack::resample(const KeyframeTrack& track, float_t sampleRate,
+	float_t duration) {
+	SampledTrack result;
+	result.m_duration = duration;
+	uint32_t intervals = std::max(1u, static_cast<uint32_t>(std::ceil(duration * sampleRate)));
+	result.m_sampleCount = intervals + 1;
+	result.m_sampleRate = duration > 0 ? intervals / duration : 0;
+
+	std::vector<glm::vec3> positions;
+	std::vector<glm::quat> rotations;
+	std::vector<glm::vec3> scales;
+	KeyframeCursor cursor;
+	KeyframeSample sample;
+	for (uint32_t i = 0; i <= intervals; i++) {
+		track.sample(duration * i / intervals, cursor, sample);
+		if (track.hasPosition()) {
+			positions.push_back(sample.position);
+		}
+		if (track.hasRotation()) {
+			// Keep neighboring samples in the same hemisphere so interpolation takes the short way.
+			if (!rotations.empty() && glm::dot(rotations.back(), sample.rotation) < 0) {
+				sample.rotation = -sample.rotation;
+			}
+			rotations.push_back(sample.rotation);
+		}
+		if (track.hasScale()) {
+			scales.push_back(sample.scale);
+		}
+	}
+
+	quantizeVectors(positions, result.m_positionMin, result.m_positionStep, result.m_positions,
+		result.m_positionStride);
+	quantizeRotations(rotations, result.m_rotations, result.m_rotationStride);
+	quantizeVectors(scales, result.m_scaleMin, result.m_scaleStep, result.m_scales,
+		result.m_scaleStride);
+	return result;
+}
+
+void SampledTrack::sample(float_t t, KeyframeSample& out) const {
+	// There are always at least two samples, so sample i + 1 exists.
+	float_t f = std::min(std::max(t * m_sampleRate, 0.0f), static_cast<float_t>(m_sampleCount - 1));
+	uint32_t i = std::min(static_cast<uint32_t>(f), m_sampleCount - 2);
+	float_t s = f - i;
+
+	if (hasPosition()) {
+		const uint16_t* a = &m_positions[i * m_positionStride];
+		const uint16_t* b = a + m_positionStride;
+		for (auto c = 0; c < 3; c++) {
+			out.position[c] = m_positionMin[c] + m_positionStep[c] * (a[c] + (b[c] - a[c]) * s);
+		}
+	}
+	if (hasRotation()) {
+		const int16_t* a = &m_rotations[i * m_rotationStride];
+		const int16_t* b = a + m_rotationStride;
+		out.rotation = glm::normalize(glm::quat(
+			a[3] + (b[3] - a[3]) * s,
+			a[0] + (b[0] - a[0]) * s,
+			a[1] + (b[1] - a[1]) * s,
+			a[2] + (b[2] - a[2]) * s));
+	}
+	if (hasScale()) {
+		const uint16_t* a = &m_scales[i * m_scaleStride];
+		const uint16_t* b = a + m_scaleStride;
+		for (auto c = 0; c < 3; c++) {
+			out.scale[c] = m_scaleMin[c] + m_scaleStep[c] * (a[c] + (b[c] - a[c]) * s);
+		}
+	}
+}
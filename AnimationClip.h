@@ -0,0 +1,82 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "KeyframeTrack.h"
+
+/**
+ * @brief A KeyframeTrack resampled at a fixed rate and quantized to 16 bits per component.
+ * Because samples are evenly spaced, the samples surrounding time t are found by index
+ * (t * rate) with no search, no cursor, and no branching on key positions.
+ */
+class SampledTrack {
+private:
+	float_t m_duration;
+	float_t m_sampleRate;
+	uint32_t m_sampleCount;
+
+	// Positions and scales are stored as unsigned offsets from a per-track minimum;
+	// value = min + q * step.
+	glm::vec3 m_positionMin;
+	glm::vec3 m_positionStep;
+	glm::vec3 m_scaleMin;
+	glm::vec3 m_scaleStep;
+	std::vector<uint16_t> m_positions;
+	// Rotations are stored as signed normalized quaternion components.
+	std::vector<int16_t> m_rotations;
+	std::vector<uint16_t> m_scales;
+
+	// How many values to advance per sample in each channel. A channel whose value never
+	// changes stores a single sample and has a stride of 0; an absent channel stores nothing.
+	uint32_t m_positionStride;
+	uint32_t m_rotationStride;
+	uint32_t m_scaleStride;
+
+public:
+	SampledTrack() : m_duration(0), m_sampleRate(0), m_sampleCount(0),
+		m_positionStride(0), m_rotationStride(0), m_scaleStride(0) {}
+
+	/**
+	 * @brief Samples a keyframe track from time 0 to the given duration at (approximately) the
+	 * given rate, in samples per second. The rate is adjusted so both ends are sampled exactly.
+	 */
+	static SampledTrack resample(const KeyframeTrack& track, float_t sampleRate, float_t duration);
+	static SampledTrack resample(const KeyframeTrack& track, float_t sampleRate) {
+		return resample(track, sampleRate, track.duration());
+	}
+
+	bool hasPosition() const { return !m_positions.empty(); }
+	bool hasRotation() const { return !m_rotations.empty(); }
+	bool hasScale() const { return !m_scales.empty(); }
+
+	float_t duration() const { return m_duration; }
+	uint32_t sampleCount() const { return m_sampleCount; }
+
+	/**
+	 * @brief The number of bytes used by the track's samples.
+	 */
+	size_t byteSize() const {
+		return m_positions.size() * sizeof(uint16_t) + m_rotations.size() * sizeof(int16_t)
+			+ m_scales.size() * sizeof(uint16_t);
+	}
+
+	/**
+	 * @brief Samples every animated channel at time t, which is clamped to the track.
+	 */
+	void sample(float_t t, KeyframeSample& out) const;
+};
+
+/**
+ * @brief A named animation of a model hierarchy, such as one imported from an aiAnimation.
+ * Each channel animates the node whose name matches the channel's node name.
+ */
+struct AnimationClip {
+	struct Channel {
+		std::string nodeName;
+		std::shared_ptr<const SampledTrack> track;
+	};
+
+	std::string name;
+	float_t duration;
+	std::vector<Channel> channels;
+};
@@ -0,0 +1,270 @@
+#include "AnimationEngine.h"
+#include <algorithm>
+#include <cmath>
+#include "Profiler.h"
+
+namespace {
+	// Removes element i by overwriting it with the last element; order is not preserved.
+	template <typename T>
+	void swapRemove(std::vector<T>& v, size_t i) {
+		v[i] = v.back();
+		v.pop_back();
+	}
+
+	// The fraction of an animation that has elapsed at time t, clamped to [0, 1].
+	inline float_t progress(float_t t, float_t start, float_t invDuration) {
+		return std::min(std::max((t - start) * invDuration, 0.0f), 1.0f);
+	}
+}
+
+uint32_t TransformBuffer::acquire(Object3D& object) {
+	uint32_t slot;
+	auto existing = m_slots.find(&object);
+	if (existing != m_slots.end()) {
+		slot = existing->second;
+	}
+	else {
+		slot = static_cast<uint32_t>(m_targets.size());
+		m_targets.push_back(&object);
+		m_basePositions.push_back(object.getPosition());
+		m_baseOrientations.push_back(object.getOrientation());
+		m_positionOffsets.emplace_back(0);
+		m_orientationOffsets.emplace_back(0);
+		m_appliedPositions.push_back(object.getPosition());
+		m_appliedOrientations.push_back(object.getOrientation());
+		m_rotations.push_back(object.getRotation());
+		m_scales.push_back(object.getScale());
+		m_activeCounts.push_back(0);
+		m_dirty.push_back(0);
+		m_slots.insert(std::make_pair(&object, slot));
+	}
+
+	// An idle slot may be stale if the object was moved by something other than the engine;
+	// recapture its base so new animations start from where the object actually is.
+	if (m_activeCounts[slot] == 0 && m_dirty[slot] == 0) {
+		m_basePositions[slot] = object.getPosition();
+		m_baseOrientations[slot] = object.getOrientation();
+		m_appliedPositions[slot] = object.getPosition();
+		m_appliedOrientations[slot] = object.getOrientation();
+		m_rotations[slot] = object.getRotation();
+		m_scales[slot] = object.getScale();
+	}
+	++m_activeCounts[slot];
+	return slot;
+}
+
+void TransformBuffer::release(uint32_t slot, Channel channel, const glm::vec3& finalOffset) {
+	if (channel == POSITION) {
+		m_basePositions[slot] += finalOffset;
+	}
+	else {
+		m_baseOrientations[slot] += finalOffset;
+	}
+	m_dirty[slot] |= channel;
+	--m_activeCounts[slot];
+}
+
+void TransformBuffer::apply() {
+	for (size_t i = 0; i < m_targets.size(); i++) {
+		if (!m_dirty[i]) {
+			continue;
+		}
+		// Channels without animations keep whatever value the object currently has. Animated
+		// positions and orientations are added as deltas, keeping whatever else moved the object.
+		Object3D& target = *m_targets[i];
+		glm::vec3 position = target.getPosition();
+		glm::vec3 orientation = target.getOrientation();
+		if (m_dirty[i] & POSITION) {
+			glm::vec3 animated = m_basePositions[i] + m_positionOffsets[i];
+			position += animated - m_appliedPositions[i];
+			m_appliedPositions[i] = animated;
+		}
+		if (m_dirty[i] & ORIENTATION) {
+			glm::vec3 animated = m_baseOrientations[i] + m_orientationOffsets[i];
+			orientation += animated - m_appliedOrientations[i];
+			m_appliedOrientations[i] = animated;
+		}
+		target.setTransform(position, orientation,
+			(m_dirty[i] & ROTATION) ? m_rotations[i] : target.getRotation(),
+			(m_dirty[i] & SCALE) ? m_scales[i] : target.getScale());
+		m_positionOffsets[i] = glm::vec3(0);
+		m_orientationOffsets[i] = glm::vec3(0);
+		m_dirty[i] = 0;
+	}
+}
+
+void LinearAnimationBatch::add(uint32_t slot, float_t startTime, float_t duration,
+	const glm::vec3& total) {
+	slots.push_back(slot);
+	startTimes.push_back(startTime);
+	endTimes.push_back(startTime + duration);
+	invDurations.push_back(1 / duration);
+	totalX.push_back(total.x);
+	totalY.push_back(total.y);
+	totalZ.push_back(total.z);
+}
+
+void LinearAnimationBatch::evaluate(float_t t, size_t begin, size_t end) {
+	const float_t* start = startTimes.data();
+	const float_t* inv = invDurations.data();
+	const float_t* tx = totalX.data();
+	const float_t* ty = totalY.data();
+	const float_t* tz = totalZ.data();
+	float_t* ox = outX.data();
+	float_t* oy = outY.data();
+	float_t* oz = outZ.data();
+
+	// Instances that have not started yet clamp to zero progress, so the loop has no branches.
+	for (size_t i = begin; i < end; i++) {
+		float_t u = progress(t, start[i], inv[i]);
+		ox[i] = tx[i] * u;
+		oy[i] = ty[i] * u;
+		oz[i] = tz[i] * u;
+	}
+}
+
+void LinearAnimationBatch::retire(float_t t, TransformBuffer& transforms,
+	TransformBuffer::Channel channel) {
+	for (size_t i = 0; i < size();) {
+		if (endTimes[i] <= t) {
+			transforms.release(slots[i], channel, glm::vec3(totalX[i], totalY[i], totalZ[i]));
+			swapRemove(slots, i);
+			swapRemove(startTimes, i);
+			swapRemove(endTimes, i);
+			swapRemove(invDurations, i);
+			swapRemove(totalX, i);
+			swapRemove(totalY, i);
+			swapRemove(totalZ, i);
+		}
+		else {
+			++i;
+		}
+	}
+}
+
+void BezierAnimationBatch::add(uint32_t slot, float_t startTime, float_t duration,
+	const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3) {
+	// Convert the Bernstein form of the curve to the power basis.
+	glm::vec3 a0 = p0;
+	glm::vec3 a1 = 3.0f * (p1 - p0);
+	glm::vec3 a2 = 3.0f * (p0 - 2.0f * p1 + p2);
+	glm::vec3 a3 = p3 - 3.0f * p2 + 3.0f * p1 - p0;
+
+	slots.push_back(slot);
+	startTimes.push_back(startTime);
+	endTimes.push_back(startTime + duration);
+	invDurations.push_back(1 / duration);
+	c0x.push_back(a0.x); c0y.push_back(a0.y); c0z.push_back(a0.z);
+	c1x.push_back(a1.x); c1y.push_back(a1.y); c1z.push_back(a1.z);
+	c2x.push_back(a2.x); c2y.push_back(a2.y); c2z.push_back(a2.z);
+	c3x.push_back(a3.x); c3y.push_back(a3.y); c3z.push_back(a3.z);
+}
+
+void BezierAnimationBatch::evaluate(float_t t, size_t begin, size_t end) {
+	for (size_t i = begin; i < end; i++) {
+		float_t u = progress(t, startTimes[i], invDurations[i]);
+		outX[i] = c0x[i] + u * (c1x[i] + u * (c2x[i] + u * c3x[i]));
+		outY[i] = c0y[i] + u * (c1y[i] + u * (c2y[i] + u * c3y[i]));
+		outZ[i] = c0z[i] + u * (c1z[i] + u * (c2z[i] + u * c3z[i]));
+	}
+}
+
+void BezierAnimationBatch::retire(float_t t, TransformBuffer& transforms) {
+	for (size_t i = 0; i < size();) {
+		if (endTimes[i] <= t) {
+			// At u = 1 the curve is the sum of its power-basis coefficients, which is p3.
+			transforms.release(slots[i], TransformBuffer::POSITION,
+				glm::vec3(c0x[i] + c1x[i] + c2x[i] + c3x[i],
+					c0y[i] + c1y[i] + c2y[i] + c3y[i],
+					c0z[i] + c1z[i] + c2z[i] + c3z[i]));
+			swapRemove(slots, i);
+			swapRemove(startTimes, i);
+			swapRemove(endTimes, i);
+			swapRemove(invDurations, i);
+			swapRemove(c0x, i); swapRemove(c0y, i); swapRemove(c0z, i);
+			swapRemove(c1x, i); swapRemove(c1y, i); swapRemove(c1z, i);
+			swapRemove(c2x, i); swapRemove(c2y, i); swapRemove(c2z, i);
+			swapRemove(c3x, i); swapRemove(c3y, i); swapRemove(c3z, i);
+		}
+		else {
+			++i;
+		}
+	}
+}
+
+void AnimationEngine::addRotation(Object3D& object, float_t startTime, float_t duration,
+	const glm::vec3& totalRotation) {
+	m_rotations.add(m_transforms.acquire(object), startTime, duration, totalRotation);
+}
+
+void AnimationEngine::addTranslation(Object3D& object, float_t startTime, float_t duration,
+	const glm::vec3& totalMovement) {
+	m_translations.add(m_transforms.acquire(object), startTime, duration, totalMovement);
+}
+
+void AnimationEngine::addBezierTranslation(Object3D& object, float_t startTime, float_t duration,
+	const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3) {
+	m_beziers.add(m_transforms.acquire(object), startTime, duration, p0, p1, p2, p3);
+}
+
+void AnimationEngine::addKeyframeTrack(Object3D& object, float_t startTime, float_t duration,
+	std::shared_ptr<const KeyframeTrack> track) {
+	m_keyframes.add(m_transforms.acquire(object), startTime, duration, std::move(track));
+}
+
+void AnimationEngine::addSampledTrack(Object3D& object, float_t startTime, float_t duration,
+	std::shared_ptr<const SampledTrack> track) {
+	m_sampledTracks.add(m_transforms.acquire(object), startTime, duration, std::move(track));
+}
+
+template <typename Track>
+void AnimationEngine::evaluateTracks(TrackAnimationBatch<Track>& batch, float_t time) {
+	batch.resize();
+	batch.evaluate(time, 0, batch.size());
+	for (size_t i = 0; i < batch.size(); i++) {
+		// Tracks that have not started yet leave their object alone.
+		if (batch.startTimes[i] <= time) {
+			batch.write(i, m_transforms);
+		}
+	}
+}
+
+void AnimationEngine::seek(float_t time) {
+	PROFILE_SCOPE("AnimationEngine::seek");
+	m_currentTime = time;
+
+	// Animations that have ended fold their final offsets into their objects' bases first, so
+	// they are not also counted by the evaluation below.
+	m_rotations.retire(time, m_transforms, TransformBuffer::ORIENTATION);
+	m_translations.retire(time, m_transforms, TransformBuffer::POSITION);
+	m_beziers.retire(time, m_transforms);
+	m_keyframes.retire(time, m_transforms);
+	m_sampledTracks.retire(time, m_transforms);
+
+	// Tracks set absolute values, so they are written before any offsets are added.
+	evaluateTracks(m_keyframes, time);
+	evaluateTracks(m_sampledTracks, time);
+
+	// Evaluate each type of animation in its own loop, then scatter the results into the
+	// transform buffer.
+	m_rotations.resize();
+	m_rotations.evaluate(time, 0, m_rotations.size());
+	for (size_t i = 0; i < m_rotations.size(); i++) {
+		m_transforms.addOrientation(m_rotations.slots[i],
+			glm::vec3(m_rotations.outX[i], m_rotations.outY[i], m_rotations.outZ[i]));
+	}
+
+	m_translations.resize();
+	m_translations.evaluate(time, 0, m_translations.size());
+	for (size_t i = 0; i < m_translations.size(); i++) {
+		m_transforms.addPosition(m_translations.slots[i],
+			glm::vec3(m_translations.outX[i], m_translations.outY[i], m_translations.outZ[i]));
+	}
+
+	m_beziers.resize();
+	m_beziers.evaluate(time, 0, m_beziers.size());
+	for (size_t i = 0; i < m_beziers.size(); i++) {
+		m_transforms.addPosition(m_beziers.slots[i],
+			glm::vec3(m_beziers.outX[i], m_beziers.outY[i], m_beziers.outZ[i]));
+	}
+}
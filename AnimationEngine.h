@@ -0,0 +1,333 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "Object3D.h"
+#include "KeyframeTrack.h"
+#include "AnimationClip.h"
+
+/**
+ * @brief Collects the transform changes produced by an AnimationEngine during a frame, with one
+ * entry per animated object. Each entry holds the object's transform as captured when its
+ * first active animation was scheduled, plus the offsets of its active animations at the
+ * engine's current time. Applying the buffer rebuilds each changed object's model matrix once,
+ * no matter how many animations touched it.
+ *
+ * Position and orientation are applied as the change since the last apply, so motion from
+ * other sources between frames, such as Object3D::tick or a KinematicsSystem, adds to the
+ * animations instead of being overwritten. Rotation and scale, which only tracks set, are
+ * absolute: a tracked object's rotation and scale belong to the engine while the track plays.
+ */
+class TransformBuffer {
+public:
+	enum Channel : uint8_t {
+		POSITION = 1,
+		ORIENTATION = 2,
+		ROTATION = 4,
+		SCALE = 8
+	};
+
+private:
+	std::vector<Object3D*> m_targets;
+	std::vector<glm::vec3> m_basePositions;
+	std::vector<glm::vec3> m_baseOrientations;
+	std::vector<glm::vec3> m_positionOffsets;
+	std::vector<glm::vec3> m_orientationOffsets;
+	// The position and orientation each entry last wrote into its object.
+	std::vector<glm::vec3> m_appliedPositions;
+	std::vector<glm::vec3> m_appliedOrientations;
+	std::vector<glm::quat> m_rotations;
+	std::vector<glm::vec3> m_scales;
+	std::vector<uint32_t> m_activeCounts;
+	// Which channels of each entry have changed since the last apply().
+	std::vector<uint8_t> m_dirty;
+	std::unordered_map<Object3D*, uint32_t> m_slots;
+
+public:
+	/**
+	 * @brief Gets the slot that holds the given object's transform, creating it if needed.
+	 * If the object has no active animations, its current transform is captured as the base
+	 * that new animations are relative to.
+	 */
+	uint32_t acquire(Object3D& object);
+
+	/**
+	 * @brief Called when one of the slot's animations finishes. Its final offset is folded into
+	 * the slot's base so that it persists without being evaluated again.
+	 */
+	void release(uint32_t slot, Channel channel, const glm::vec3& finalOffset);
+	/**
+	 * @brief Called when an animation that sets absolute values finishes.
+	 */
+	void release(uint32_t slot) { --m_activeCounts[slot]; }
+
+	void addPosition(uint32_t slot, const glm::vec3& offset) {
+		m_positionOffsets[slot] += offset;
+		m_dirty[slot] |= POSITION;
+	}
+
+	void addOrientation(uint32_t slot, const glm::vec3& offset) {
+		m_orientationOffsets[slot] += offset;
+		m_dirty[slot] |= ORIENTATION;
+	}
+
+	/**
+	 * @brief Replaces the slot's base position, which offsets are then added to.
+	 */
+	void setPosition(uint32_t slot, const glm::vec3& position) {
+		m_basePositions[slot] = position;
+		m_dirty[slot] |= POSITION;
+	}
+
+	void setRotation(uint32_t slot, const glm::quat& rotation) {
+		m_rotations[slot] = rotation;
+		m_dirty[slot] |= ROTATION;
+	}
+
+	void setScale(uint32_t slot, const glm::vec3& scale) {
+		m_scales[slot] = scale;
+		m_dirty[slot] |= SCALE;
+	}
+
+	/**
+	 * @brief Writes every changed channel into its object and clears the offsets. Positions and
+	 * orientations move by how much the animated value changed since the last apply.
+	 */
+	void apply();
+
+	size_t size() const { return m_targets.size(); }
+};
+
+/**
+ * @brief Structure-of-arrays storage for animations that change a vector attribute at a
+ * constant rate, such as RotationAnimation and TranslationAnimation. Each instance's offset
+ * at time t is total * clamp((t - start) / duration, 0, 1), so the result depends only on t
+ * and never on the sequence of ticks that led there.
+ */
+struct LinearAnimationBatch {
+	std::vector<uint32_t> slots;
+	std::vector<float_t> startTimes;
+	std::vector<float_t> endTimes;
+	std::vector<float_t> invDurations;
+	std::vector<float_t> totalX;
+	std::vector<float_t> totalY;
+	std::vector<float_t> totalZ;
+
+	// Per-instance results of the last evaluate() call.
+	std::vector<float_t> outX;
+	std::vector<float_t> outY;
+	std::vector<float_t> outZ;
+
+	size_t size() const { return slots.size(); }
+	void add(uint32_t slot, float_t startTime, float_t duration, const glm::vec3& total);
+	/**
+	 * @brief Computes the offsets of instances [begin, end) at time t. Disjoint ranges may be
+	 * evaluated concurrently once the output arrays have been sized with resize().
+	 */
+	void evaluate(float_t t, size_t begin, size_t end);
+	void resize() { outX.resize(size()); outY.resize(size()); outZ.resize(size()); }
+	/**
+	 * @brief Removes every instance that has finished by time t, folding its total into the
+	 * given channel of its transform buffer slot.
+	 */
+	void retire(float_t t, TransformBuffer& transforms, TransformBuffer::Channel channel);
+};
+
+/**
+ * @brief Structure-of-arrays storage for BezierTranslationAnimations. The curve of each instance
+ * is stored in power-basis form so it can be evaluated with Horner's rule.
+ */
+struct BezierAnimationBatch {
+	std::vector<uint32_t> slots;
+	std::vector<float_t> startTimes;
+	std::vector<float_t> endTimes;
+	std::vector<float_t> invDurations;
+	// Coefficients c0 + c1*u + c2*u^2 + c3*u^3, one array per axis and power.
+	std::vector<float_t> c0x, c0y, c0z;
+	std::vector<float_t> c1x, c1y, c1z;
+	std::vector<float_t> c2x, c2y, c2z;
+	std::vector<float_t> c3x, c3y, c3z;
+
+	std::vector<float_t> outX;
+	std::vector<float_t> outY;
+	std::vector<float_t> outZ;
+
+	size_t size() const { return slots.size(); }
+	void add(uint32_t slot, float_t startTime, float_t duration, const glm::vec3& p0,
+		const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3);
+	void evaluate(float_t t, size_t begin, size_t end);
+	void resize() { outX.resize(size()); outY.resize(size()); outZ.resize(size()); }
+	void retire(float_t t, TransformBuffer& transforms);
+};
+
+/**
+ * @brief Samples a track for a playing instance. KeyframeTracks advance the instance's cursor;
+ * SampledTracks are indexed directly and ignore it.
+ */
+inline void sampleTrack(const KeyframeTrack& track, float_t t, KeyframeCursor& cursor,
+	KeyframeSample& out) {
+	track.sample(t, cursor, out);
+}
+
+inline void sampleTrack(const SampledTrack& track, float_t t, KeyframeCursor& cursor,
+	KeyframeSample& out) {
+	track.sample(t, out);
+}
+
+/**
+ * @brief Structure-of-arrays storage for instances of a track type (KeyframeTrack or
+ * SampledTrack). The tracks themselves are shared; each instance only adds its timing and its
+ * own sampling cursor. An instance whose duration exceeds its track's duration loops the track.
+ */
+template <typename Track>
+struct TrackAnimationBatch {
+	std::vector<uint32_t> slots;
+	std::vector<float_t> startTimes;
+	std::vector<float_t> endTimes;
+	std::vector<std::shared_ptr<const Track>> tracks;
+	std::vector<KeyframeCursor> cursors;
+
+	std::vector<KeyframeSample> out;
+
+	size_t size() const { return slots.size(); }
+
+	void add(uint32_t slot, float_t startTime, float_t duration, std::shared_ptr<const Track> track) {
+		slots.push_back(slot);
+		startTimes.push_back(startTime);
+		endTimes.push_back(startTime + duration);
+		tracks.emplace_back(std::move(track));
+		cursors.emplace_back();
+	}
+
+	void evaluate(float_t t, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			const Track& track = *tracks[i];
+			// Map engine time to track time, looping if the instance outlasts the track.
+			float_t local = std::min(std::max(t, startTimes[i]), endTimes[i]) - startTimes[i];
+			if (local > track.duration() && track.duration() > 0) {
+				local = std::fmod(local, track.duration());
+			}
+			sampleTrack(track, local, cursors[i], out[i]);
+		}
+	}
+
+	void resize() { out.resize(size()); }
+
+	/**
+	 * @brief Writes the instance's last result into the transform buffer.
+	 */
+	void write(size_t i, TransformBuffer& transforms) const {
+		const Track& track = *tracks[i];
+		if (track.hasPosition()) {
+			transforms.setPosition(slots[i], out[i].position);
+		}
+		if (track.hasRotation()) {
+			transforms.setRotation(slots[i], out[i].rotation);
+		}
+		if (track.hasScale()) {
+			transforms.setScale(slots[i], out[i].scale);
+		}
+	}
+
+	void retire(float_t t, TransformBuffer& transforms) {
+		resize();
+		for (size_t i = 0; i < size();) {
+			if (endTimes[i] <= t) {
+				// Leave the object in the track's final pose.
+				evaluate(endTimes[i], i, i + 1);
+				write(i, transforms);
+				transforms.release(slots[i]);
+				removeAt(i);
+			}
+			else {
+				++i;
+			}
+		}
+	}
+
+private:
+	void removeAt(size_t i) {
+		size_t last = size() - 1;
+		slots[i] = slots[last];
+		startTimes[i] = startTimes[last];
+		endTimes[i] = endTimes[last];
+		tracks[i] = std::move(tracks[last]);
+		cursors[i] = cursors[last];
+		out[i] = out[last];
+		slots.pop_back();
+		startTimes.pop_back();
+		endTimes.pop_back();
+		tracks.pop_back();
+		cursors.pop_back();
+		out.pop_back();
+	}
+};
+
+/**
+ * @brief Evaluates every active animation in the scene. Animations are stored by type in
+ * contiguous arrays and evaluated one type at a time in tight loops, instead of being ticked
+ * one object at a time through virtual calls. Every animation is a closed-form function of
+ * time relative to the transform its object had when the animation was scheduled, so results
+ * do not depend on the frame rate and do not drift. The results land in a TransformBuffer,
+ * which the scene applies once per frame.
+ */
+class AnimationEngine {
+private:
+	float_t m_currentTime;
+	TransformBuffer m_transforms;
+	LinearAnimationBatch m_rotations;
+	LinearAnimationBatch m_translations;
+	BezierAnimationBatch m_beziers;
+	TrackAnimationBatch<KeyframeTrack> m_keyframes;
+	TrackAnimationBatch<SampledTrack> m_sampledTracks;
+
+	// Evaluates a batch of tracks at the given time and writes the results that have started.
+	template <typename Track>
+	void evaluateTracks(TrackAnimationBatch<Track>& batch, float_t time);
+
+public:
+	AnimationEngine() : m_currentTime(0) {}
+
+	/**
+	 * @brief How much time has elapsed since the engine was created.
+	 */
+	float_t currentTime() const { return m_currentTime; }
+
+	/**
+	 * @brief The number of scheduled animations that have not yet finished.
+	 */
+	size_t activeAnimations() const {
+		return m_rotations.size() + m_translations.size() + m_beziers.size() + m_keyframes.size()
+			+ m_sampledTracks.size();
+	}
+
+	void addRotation(Object3D& object, float_t startTime, float_t duration,
+		const glm::vec3& totalRotation);
+	void addTranslation(Object3D& object, float_t startTime, float_t duration,
+		const glm::vec3& totalMovement);
+	void addBezierTranslation(Object3D& object, float_t startTime, float_t duration,
+		const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3);
+	void addKeyframeTrack(Object3D& object, float_t startTime, float_t duration,
+		std::shared_ptr<const KeyframeTrack> track);
+	void addSampledTrack(Object3D& object, float_t startTime, float_t duration,
+		std::shared_ptr<const SampledTrack> track);
+
+	/**
+	 * @brief Advances every animation by the given interval, in seconds, accumulating the
+	 * results in the transform buffer.
+	 */
+	void tick(float_t dt) { seek(m_currentTime + dt); }
+
+	/**
+	 * @brief Evaluates every animation at the given engine time. Time may skip forward by any
+	 * amount, but must not move back past the end of an animation that has already finished.
+	 */
+	void seek(float_t time);
+
+	/**
+	 * @brief Writes the accumulated results into the animated objects.
+	 */
+	void apply() { m_transforms.apply(); }
+};
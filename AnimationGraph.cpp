@@ -0,0 +1,221 @@
+#include "AnimationGraph.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include "JobSystem.h"
+
+AnimationGraph::AnimationGraph(Object3D& model) {
+	flatten(model, -1);
+	m_restPose.resize(m_bones.size());
+	for (size_t i = 0; i < m_bones.size(); i++) {
+		m_restPose.setPosition(i, m_bones[i]->getPosition());
+		m_restPose.setRotation(i, m_bones[i]->getRotation());
+		m_restPose.setScale(i, m_bones[i]->getScale());
+	}
+	m_result = m_restPose;
+	m_statePose = m_restPose;
+	m_fadePose = m_restPose;
+	m_weights.resize(m_restPose.paddedCount());
+	addLayer(LayerBlendMode::OVERRIDE);
+}
+
+void AnimationGraph::flatten(Object3D& node, int32_t parent) {
+	int32_t index = static_cast<int32_t>(m_bones.size());
+	m_bones.push_back(&node);
+	m_parents.push_back(parent);
+	for (size_t i = 0; i < node.numberOfChildren(); i++) {
+		flatten(node.getChild(i), index);
+	}
+}
+
+int32_t AnimationGraph::findBone(const std::string& name) const {
+	for (size_t i = 0; i < m_bones.size(); i++) {
+		if (m_bones[i]->getName() == name) {
+			return static_cast<int32_t>(i);
+		}
+	}
+	return -1;
+}
+
+std::vector<float_t> AnimationGraph::boneMask(const std::string& boneName) const {
+	std::vector<float_t> mask(m_restPose.paddedCount(), 0);
+	int32_t root = findBone(boneName);
+	if (root < 0) {
+		throw std::runtime_error("No bone named " + boneName);
+	}
+	// Parents come before children, so one pass marks the whole subtree.
+	mask[root] = 1;
+	for (size_t i = root + 1; i < m_bones.size(); i++) {
+		if (m_parents[i] >= 0 && mask[m_parents[i]] == 1) {
+			mask[i] = 1;
+		}
+	}
+	return mask;
+}
+
+size_t AnimationGraph::addState(const std::string& name, std::shared_ptr<const AnimationClip> clip,
+	float_t speed, bool loop) {
+	State state{ name, std::move(clip), speed, loop, {}, {} };
+	for (auto& channel : state.clip->channels) {
+		int32_t bone = findBone(channel.nodeName);
+		if (bone >= 0) {
+			state.channels.emplace_back(static_cast<uint32_t>(bone), channel.track.get());
+			m_animatedBones.push_back(static_cast<uint32_t>(bone));
+		}
+	}
+	std::sort(m_animatedBones.begin(), m_animatedBones.end());
+	m_animatedBones.erase(std::unique(m_animatedBones.begin(), m_animatedBones.end()),
+		m_animatedBones.end());
+
+	state.reference = m_restPose;
+	samplePose(state, 0, false, state.reference);
+	m_states.push_back(std::move(state));
+	return m_states.size() - 1;
+}
+
+size_t AnimationGraph::addLayer(LayerBlendMode mode, std::vector<float_t> mask, float_t weight) {
+	if (!mask.empty()) {
+		if (mask.size() < m_bones.size()) {
+			throw std::runtime_error("Layer mask has fewer weights than the graph has bones");
+		}
+		mask.resize(m_restPose.paddedCount(), 0);
+	}
+	m_layers.push_back({ mode, std::move(mask), weight, -1, 0, -1, 0, 0, 0 });
+	return m_layers.size() - 1;
+}
+
+void AnimationGraph::setLayerWeight(size_t layer, float_t weight) {
+	m_layers.at(layer).weight = weight;
+}
+
+void AnimationGraph::play(size_t layer, const std::string& stateName, float_t fadeDuration) {
+	auto state = std::find_if(m_states.begin(), m_states.end(),
+		[&](const State& s) { return s.name == stateName; });
+	if (state == m_states.end()) {
+		throw std::runtime_error("No animation state named " + stateName);
+	}
+	Layer& l = m_layers.at(layer);
+	l.previous = fadeDuration > 0 ? l.current : -1;
+	l.previousTime = l.currentTime;
+	l.current = static_cast<int32_t>(state - m_states.begin());
+	l.currentTime = 0;
+	l.fadeTime = 0;
+	l.fadeDuration = fadeDuration;
+}
+
+void AnimationGraph::stop(size_t layer, float_t fadeDuration) {
+	Layer& l = m_layers.at(layer);
+	l.previous = fadeDuration > 0 ? l.current : -1;
+	l.previousTime = l.currentTime;
+	l.current = -1;
+	l.fadeTime = 0;
+	l.fadeDuration = fadeDuration;
+}
+
+float_t AnimationGraph::stateTime(const State& state, float_t time) const {
+	float_t duration = state.clip->duration;
+	if (duration <= 0) {
+		return 0;
+	}
+	return state.loop ? std::fmod(time, duration) : std::min(time, duration);
+}
+
+void AnimationGraph::samplePose(const State& state, float_t time, bool additive, Pose& out) const {
+	out = m_restPose;
+	float_t t = stateTime(state, time);
+	for (auto& channel : state.channels) {
+		uint32_t bone = channel.first;
+		// Channels the track does not animate keep the rest pose.
+		KeyframeSample sample{ out.position(bone), out.rotation(bone), out.scale(bone) };
+		channel.second->sample(t, sample);
+		out.setPosition(bone, sample.position);
+		out.setRotation(bone, sample.rotation);
+		out.setScale(bone, sample.scale);
+	}
+	if (additive) {
+		out.makeAdditive(state.reference);
+	}
+}
+
+void AnimationGraph::evaluate(float_t dt) {
+	m_result = m_restPose;
+	for (auto& layer : m_layers) {
+		if (layer.current >= 0) {
+			layer.currentTime += dt * m_states[layer.current].speed;
+		}
+		if (layer.previous >= 0) {
+			layer.previousTime += dt * m_states[layer.previous].speed;
+			layer.fadeTime += dt;
+			if (layer.fadeTime >= layer.fadeDuration) {
+				layer.previous = -1;
+			}
+		}
+		if ((layer.current < 0 && layer.previous < 0) || layer.weight <= 0) {
+			continue;
+		}
+
+		bool additive = layer.mode == LayerBlendMode::ADDITIVE;
+		float_t weight = layer.weight;
+		float_t fade = layer.previous >= 0 ? layer.fadeTime / layer.fadeDuration : 1;
+		if (layer.current >= 0) {
+			samplePose(m_states[layer.current], layer.currentTime, additive, m_statePose);
+			if (layer.previous >= 0) {
+				samplePose(m_states[layer.previous], layer.previousTime, additive, m_fadePose);
+				std::fill(m_weights.begin(), m_weights.end(), fade);
+				Pose::blend(m_fadePose, m_statePose, m_weights.data(), m_statePose);
+			}
+		}
+		else {
+			// The layer is fading out after stop().
+			samplePose(m_states[layer.previous], layer.previousTime, additive, m_statePose);
+			weight *= 1 - fade;
+		}
+
+		if (layer.mask.empty()) {
+			std::fill(m_weights.begin(), m_weights.end(), weight);
+		}
+		else {
+			for (size_t i = 0; i < m_weights.size(); i++) {
+				m_weights[i] = weight * layer.mask[i];
+			}
+		}
+		if (additive) {
+			Pose::add(m_result, m_statePose, m_weights.data(), m_result);
+		}
+		else {
+			Pose::blend(m_result, m_statePose, m_weights.data(), m_result);
+		}
+	}
+}
+
+void AnimationGraph::apply() {
+	for (uint32_t bone : m_animatedBones) {
+		Object3D& node = *m_bones[bone];
+		node.setTransform(m_result.position(bone), node.getOrientation(), m_result.rotation(bone),
+			m_result.scale(bone));
+	}
+}
+
+AnimationGraph& AnimationGraphSystem::create(Object3D& model) {
+	m_graphs.push_back(std::make_unique<AnimationGraph>(model));
+	return *m_graphs.back();
+}
+
+void AnimationGraphSystem::update(float_t dt) {
+	auto start = std::chrono::steady_clock::now();
+	JobSystem::instance().parallelFor(m_graphs.size(), 1, [this, dt](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			m_graphs[i]->evaluate(dt);
+			m_graphs[i]->apply();
+		}
+	});
+	auto elapsed = std::chrono::steady_clock::now() - start;
+
+	size_t bones = 0;
+	for (auto& graph : m_graphs) {
+		bones += graph->numberOfBones();
+	}
+	m_lastFrame = { m_graphs.size(), bones,
+		std::chrono::duration<double, std::milli>(elapsed).count(), m_budgetMilliseconds };
+}
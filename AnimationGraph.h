@@ -0,0 +1,185 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "AnimationClip.h"
+#include "Object3D.h"
+#include "Pose.h"
+
+/**
+ * @brief How a layer of an AnimationGraph combines with the layers beneath it.
+ */
+enum class LayerBlendMode : uint8_t {
+	/** @brief The layer's pose replaces the pose beneath it, in proportion to its weight. */
+	OVERRIDE,
+	/**
+	 * @brief The layer's pose is applied on top of the pose beneath it, as a difference from
+	 * the first frame of the layer's clip.
+	 */
+	ADDITIVE
+};
+
+/**
+ * @brief Drives the bones of one model hierarchy with AnimationClips arranged in layers. Each
+ * layer plays one state (a clip with a speed and looping) at a time and can cross-fade to
+ * another; layers are combined from the bottom up, each restricted to the bones in its mask.
+ *
+ * Where Animators schedule fixed sequences into an AnimationEngine, a graph is controlled at
+ * run time by calling play(). A graph sets its bones' transforms directly, so the objects it
+ * animates should not also be animated through an AnimationEngine.
+ */
+class AnimationGraph {
+private:
+	struct State {
+		std::string name;
+		std::shared_ptr<const AnimationClip> clip;
+		float_t speed;
+		bool loop;
+		// Bone index and track of every clip channel that matches a bone.
+		std::vector<std::pair<uint32_t, const SampledTrack*>> channels;
+		// The clip's first frame, which additive layers subtract from the clip.
+		Pose reference;
+	};
+
+	struct Layer {
+		LayerBlendMode mode;
+		// A weight per bone, padded like a Pose; empty for all bones at full weight.
+		std::vector<float_t> mask;
+		float_t weight;
+		int32_t current;
+		float_t currentTime;
+		// The state being faded out, or -1.
+		int32_t previous;
+		float_t previousTime;
+		float_t fadeTime;
+		float_t fadeDuration;
+	};
+
+	// Every object in the hierarchy, parents before children.
+	std::vector<Object3D*> m_bones;
+	std::vector<int32_t> m_parents;
+	// The bones that at least one state animates; only these are written by apply().
+	std::vector<uint32_t> m_animatedBones;
+	Pose m_restPose;
+	std::vector<State> m_states;
+	std::vector<Layer> m_layers;
+
+	// Scratch space for evaluate(), kept to avoid allocating each frame.
+	Pose m_result;
+	Pose m_statePose;
+	Pose m_fadePose;
+	std::vector<float_t> m_weights;
+
+	void flatten(Object3D& node, int32_t parent);
+	void samplePose(const State& state, float_t time, bool additive, Pose& out) const;
+	float_t stateTime(const State& state, float_t time) const;
+
+public:
+	/**
+	 * @brief Constructs a graph that animates the given model. Every object in the hierarchy is
+	 * a bone, and the current transforms of the objects are the rest pose that bones not
+	 * animated by any layer return to.
+	 */
+	explicit AnimationGraph(Object3D& model);
+
+	AnimationGraph(const AnimationGraph&) = delete;
+	AnimationGraph& operator=(const AnimationGraph&) = delete;
+
+	size_t numberOfBones() const { return m_bones.size(); }
+	size_t numberOfLayers() const { return m_layers.size(); }
+
+	/**
+	 * @brief The index of the bone with the given name, or -1.
+	 */
+	int32_t findBone(const std::string& name) const;
+
+	/**
+	 * @brief A layer mask that selects the named bone and all of its descendants.
+	 */
+	std::vector<float_t> boneMask(const std::string& boneName) const;
+
+	/**
+	 * @brief Adds a state that plays the given clip, returning its index. Clip channels whose
+	 * node names do not match a bone are ignored.
+	 */
+	size_t addState(const std::string& name, std::shared_ptr<const AnimationClip> clip,
+		float_t speed = 1, bool loop = true);
+
+	/**
+	 * @brief Adds a layer on top of the existing ones, returning its index. Layer 0 always
+	 * exists: it overrides the rest pose and affects every bone. An empty mask affects every
+	 * bone; otherwise the mask has a weight in [0, 1] per bone (see boneMask).
+	 */
+	size_t addLayer(LayerBlendMode mode, std::vector<float_t> mask = {}, float_t weight = 1);
+
+	void setLayerWeight(size_t layer, float_t weight);
+
+	/**
+	 * @brief Starts playing the named state from its beginning on the given layer, cross-fading
+	 * from the layer's current state over fadeDuration seconds.
+	 */
+	void play(size_t layer, const std::string& stateName, float_t fadeDuration = 0);
+
+	/**
+	 * @brief Stops the given layer, fading it out over fadeDuration seconds.
+	 */
+	void stop(size_t layer, float_t fadeDuration = 0);
+
+	/**
+	 * @brief Advances every layer by dt seconds and blends the layers into the graph's pose.
+	 * Touches only the graph's own state, so different graphs can be evaluated in parallel.
+	 */
+	void evaluate(float_t dt);
+
+	/**
+	 * @brief Sets the transforms of the animated bones to the most recently evaluated pose.
+	 */
+	void apply();
+};
+
+/**
+ * @brief The cost of one AnimationGraphSystem::update.
+ */
+struct AnimationBudgetStats {
+	size_t graphs;
+	size_t bones;
+	double milliseconds;
+	double budgetMilliseconds;
+
+	bool overBudget() const { return milliseconds > budgetMilliseconds; }
+};
+
+/**
+ * @brief Owns AnimationGraphs and updates all of them in parallel once per frame, measuring the
+ * time taken against a per-frame budget.
+ */
+class AnimationGraphSystem {
+private:
+	std::vector<std::unique_ptr<AnimationGraph>> m_graphs;
+	double m_budgetMilliseconds;
+	AnimationBudgetStats m_lastFrame;
+
+public:
+	AnimationGraphSystem() : m_budgetMilliseconds(2.0), m_lastFrame{ 0, 0, 0, 2.0 } {}
+
+	/**
+	 * @brief Constructs a graph for the given model. Like Animations, graphs keep references to
+	 * their model's objects, so the model must not be moved afterwards.
+	 */
+	AnimationGraph& create(Object3D& model);
+
+	size_t numberOfGraphs() const { return m_graphs.size(); }
+
+	void setBudget(double milliseconds) { m_budgetMilliseconds = milliseconds; }
+
+	/**
+	 * @brief Evaluates and applies every graph; call once per frame, after the AnimationEngine
+	 * is applied. Graphs must not share objects.
+	 */
+	void update(float_t dt);
+
+	/**
+	 * @brief The cost of the most recent update.
+	 */
+	const AnimationBudgetStats& lastFrame() const { return m_lastFrame; }
+};
@@ -1,47 +1,30 @@
 #pragma once
 #include <memory>
 #include "Animation.h"
+#include "AnimationEngine.h"
 #include "RotationAnimation.h"
 #include "TranslationAnimation.h"
 #include "BezierTranslationAnimation.h"
+#include "KeyframeAnimation.h"
+#include "ClipAnimation.h"
 
+/**
+ * @brief Plays a sequence of Animations one after another. The sequence is handed to an
+ * AnimationEngine when the Animator starts; the engine then evaluates it alongside every other
+ * animation in the scene.
+ */
 class Animator {
 private:
-	/**
-	 * @brief How much time has elapsed since the animation started.
-	 */
-	float_t m_currentTime;
-	/**
-	 * @brief The time at which we transition to the next animation.
-	 */
-	float_t m_nextTransition;
 	/**
 	 * @brief The sequence of animations to play.
 	 */
 	std::vector<std::unique_ptr<Animation>> m_animations;
-	/**
-	 * @brief The current (active) animation.
-	 */
-	Animation* m_currentAnimation;
-	/**
-	 * @brief The index of the current animation.
-	 */
-	int32_t m_currentIndex;
-	
-	/**
-	 * @brief Activate the next animation.
-	 */
-	void nextAnimation();
 
 public:
 	/**
-	 * @brief Constructs an Animator that acts on the given object.
+	 * @brief Constructs an Animator with an empty animation sequence.
 	 */
-	Animator() :
-		m_currentTime(0),
-		m_nextTransition(0),
-		m_currentIndex(-1), 
-		m_currentAnimation(nullptr) {
+	Animator() {
 	}
 
 	/**
@@ -52,13 +35,14 @@ public:
 	}
 
 	/**
-	 * @brief Activate the Animator, causing its active animation to receive future tick() calls.
+	 * @brief The total duration of the animation sequence.
 	 */
-	void start();
+	float_t duration() const;
 
 	/**
-	 * @brief Advance the animation sequence by the given time interval, in seconds.
+	 * @brief Activate the Animator, scheduling its sequence on the given engine beginning at
+	 * the engine's current time.
 	 */
-	void tick(float_t dt);
+	void start(AnimationEngine& engine);
 
-};
\ No newline at end of file
+};
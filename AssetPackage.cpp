@@ -0,0 +1,413 @@
+#include "AssetPackage.h"
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include "Profiler.h"
+
+namespace {
+	const char PACKAGE_MAGIC[4] = { 'F', 'P', 'P', 'K' };
+	const uint32_t PACKAGE_VERSION = 2;
+	// The table of contents and every blob start on a boundary of this many bytes, a whole
+	// number of pages on every platform the engine targets.
+	const uint64_t PACKAGE_ALIGNMENT = 4096;
+	// The magic, the version, the sizes of a BVH node and packet, and the offset of the data after
+	// the table of contents.
+	const uint64_t PACKAGE_HEADER_SIZE = sizeof(PACKAGE_MAGIC) + 3 * sizeof(uint32_t) + sizeof(uint64_t);
+
+	std::mutex mountedMutex;
+	std::vector<std::unique_ptr<AssetPackage>> mountedPackages;
+
+	uint64_t alignUp(uint64_t offset) {
+		return (offset + PACKAGE_ALIGNMENT - 1) / PACKAGE_ALIGNMENT * PACKAGE_ALIGNMENT;
+	}
+
+	/**
+	 * @brief Serializes the table of contents, and lays out the blobs it refers to.
+	 */
+	class TocWriter {
+	private:
+		std::vector<uint8_t> m_toc;
+		std::vector<std::pair<const void*, uint64_t>> m_blobs;
+		uint64_t m_dataSize = 0;
+
+	public:
+		template <typename T>
+		void value(const T& value) {
+			size_t at = m_toc.size();
+			m_toc.resize(at + sizeof(T));
+			std::memcpy(&m_toc[at], &value, sizeof(T));
+		}
+
+		void string(const std::string& text) {
+			value(static_cast<uint32_t>(text.size()));
+			m_toc.insert(m_toc.end(), text.begin(), text.end());
+		}
+
+		// Records a blob's offset and size in the table, and places it on the next boundary.
+		void blob(const void* data, uint64_t size) {
+			m_dataSize = alignUp(m_dataSize);
+			value(m_dataSize);
+			value(size);
+			m_blobs.emplace_back(data, size);
+			m_dataSize += size;
+		}
+
+		void write(std::ostream& out) const {
+			uint64_t dataOffset = alignUp(PACKAGE_HEADER_SIZE + m_toc.size());
+			out.write(PACKAGE_MAGIC, sizeof(PACKAGE_MAGIC));
+			out.write(reinterpret_cast<const char*>(&PACKAGE_VERSION), sizeof(PACKAGE_VERSION));
+			// The BVH blobs are the tree's memory as is, whose layout depends on the compiler.
+			uint32_t nodeSize = static_cast<uint32_t>(TriangleBVH::nodeSize());
+			uint32_t packetSize = static_cast<uint32_t>(TriangleBVH::packetSize());
+			out.write(reinterpret_cast<const char*>(&nodeSize), sizeof(nodeSize));
+			out.write(reinterpret_cast<const char*>(&packetSize), sizeof(packetSize));
+			out.write(reinterpret_cast<const char*>(&dataOffset), sizeof(dataOffset));
+			out.write(reinterpret_cast<const char*>(m_toc.data()), m_toc.size());
+
+			std::vector<char> padding(PACKAGE_ALIGNMENT, 0);
+			uint64_t written = 0;
+			out.write(padding.data(), dataOffset - (PACKAGE_HEADER_SIZE + m_toc.size()));
+			for (auto& [data, size] : m_blobs) {
+				out.write(padding.data(), alignUp(written) - written);
+				written = alignUp(written);
+				out.write(static_cast<const char*>(data), size);
+				written += size;
+			}
+		}
+	};
+
+	/**
+	 * @brief Reads the table of contents from the mapped file, checking every read against its end.
+	 */
+	class TocReader {
+	private:
+		const uint8_t* m_at;
+		const uint8_t* m_end;
+
+	public:
+		TocReader(const uint8_t* begin, const uint8_t* end) : m_at(begin), m_end(end) {}
+
+		template <typename T>
+		T value() {
+			if (static_cast<size_t>(m_end - m_at) < sizeof(T)) {
+				throw std::runtime_error("table of contents is truncated");
+			}
+			T result;
+			std::memcpy(&result, m_at, sizeof(T));
+			m_at += sizeof(T);
+			return result;
+		}
+
+		std::string string() {
+			uint32_t size = value<uint32_t>();
+			if (static_cast<size_t>(m_end - m_at) < size) {
+				throw std::runtime_error("table of contents is truncated");
+			}
+			std::string text(reinterpret_cast<const char*>(m_at), size);
+			m_at += size;
+			return text;
+		}
+
+		std::vector<uint32_t> indices() {
+			uint32_t count = value<uint32_t>();
+			if (static_cast<size_t>(m_end - m_at) / sizeof(uint32_t) < count) {
+				throw std::runtime_error("table of contents is truncated");
+			}
+			std::vector<uint32_t> result(count);
+			std::memcpy(result.data(), m_at, count * sizeof(uint32_t));
+			m_at += count * sizeof(uint32_t);
+			return result;
+		}
+	};
+
+	void writeIndices(TocWriter& toc, const std::vector<uint32_t>& indices) {
+		toc.value(static_cast<uint32_t>(indices.size()));
+		for (uint32_t index : indices) {
+			toc.value(index);
+		}
+	}
+}
+
+std::string AssetPackage::modelKey(const std::string& path, bool flipTextureCoords) {
+	return std::filesystem::path(path).lexically_normal().generic_string() + (flipTextureCoords ? "|flip" : "");
+}
+
+AssetPackage::AssetPackage(const std::filesystem::path& path) : m_path(path), m_file(path), m_dataOffset(0) {
+	try {
+		const uint8_t* begin = m_file.data();
+		TocReader header(begin, begin + m_file.size());
+		char magic[sizeof(PACKAGE_MAGIC)];
+		for (char& c : magic) {
+			c = header.value<char>();
+		}
+		if (std::memcmp(magic, PACKAGE_MAGIC, sizeof(magic)) != 0) {
+			throw std::runtime_error("not an asset package");
+		}
+		uint32_t version = header.value<uint32_t>();
+		if (version != PACKAGE_VERSION) {
+			throw std::runtime_error("unsupported package version " + std::to_string(version));
+		}
+		uint32_t nodeSize = header.value<uint32_t>();
+		uint32_t packetSize = header.value<uint32_t>();
+		if (nodeSize != TriangleBVH::nodeSize() || packetSize != TriangleBVH::packetSize()) {
+			throw std::runtime_error("package was written with a different BVH layout");
+		}
+		m_dataOffset = header.value<uint64_t>();
+		if (m_dataOffset < PACKAGE_HEADER_SIZE || m_dataOffset > m_file.size()) {
+			throw std::runtime_error("table of contents is truncated");
+		}
+		if (m_dataOffset % PACKAGE_ALIGNMENT != 0) {
+			throw std::runtime_error("data is misaligned");
+		}
+		TocReader toc(begin + PACKAGE_HEADER_SIZE, begin + m_dataOffset);
+		auto readBlob = [&toc] {
+			Blob blob;
+			blob.offset = toc.value<uint64_t>();
+			blob.size = toc.value<uint64_t>();
+			return blob;
+		};
+		uint32_t modelCount = toc.value<uint32_t>();
+		for (uint32_t m = 0; m < modelCount; m++) {
+			std::string key = toc.string();
+			PackedModel model;
+
+			uint32_t textureCount = toc.value<uint32_t>();
+			for (uint32_t t = 0; t < textureCount; t++) {
+				PackedTexture texture;
+				texture.name = toc.string();
+				texture.samplerName = toc.string();
+				texture.width = toc.value<uint32_t>();
+				texture.height = toc.value<uint32_t>();
+				texture.pixels = readBlob();
+				model.textures.push_back(std::move(texture));
+			}
+
+			uint32_t meshCount = toc.value<uint32_t>();
+			for (uint32_t i = 0; i < meshCount; i++) {
+				PackedMesh mesh;
+				mesh.name = toc.string();
+				mesh.vertexCount = toc.value<uint32_t>();
+				mesh.faceCount = toc.value<uint32_t>();
+				mesh.bounds.min = toc.value<glm::vec3>();
+				mesh.bounds.max = toc.value<glm::vec3>();
+				mesh.vertices = readBlob();
+				mesh.faces = readBlob();
+				mesh.bvhNodes = readBlob();
+				mesh.bvhPackets = readBlob();
+				mesh.textures = toc.indices();
+				uint32_t jointCount = toc.value<uint32_t>();
+				if (jointCount > 0) {
+					auto skin = std::make_shared<Skin>();
+					for (uint32_t j = 0; j < jointCount; j++) {
+						skin->jointNames.push_back(toc.string());
+						skin->inverseBindMatrices.push_back(toc.value<glm::mat4>());
+					}
+					mesh.skin = std::move(skin);
+				}
+				model.meshes.push_back(std::move(mesh));
+			}
+
+			uint32_t nodeCount = toc.value<uint32_t>();
+			for (uint32_t i = 0; i < nodeCount; i++) {
+				ImportedNode node;
+				node.name = toc.string();
+				node.transform = toc.value<glm::mat4>();
+				node.animated = toc.value<uint8_t>() != 0;
+				node.meshes = toc.indices();
+				node.children = toc.indices();
+				model.nodes.push_back(std::move(node));
+			}
+
+			validate(model);
+			m_models.emplace(std::move(key), std::move(model));
+		}
+	}
+	catch (std::runtime_error& e) {
+		throw std::runtime_error("Could not open asset package " + path.string() + ": " + e.what());
+	}
+}
+
+void AssetPackage::validate(const PackedModel& model) const {
+	uint64_t dataSize = m_file.size() - m_dataOffset;
+	auto checkBlob = [dataSize](const Blob& blob, uint64_t expectedSize) {
+		// An empty blob's offset may lie past the end of the file, since nothing follows the last blob.
+		bool inRange = blob.size == 0 || (blob.offset <= dataSize && blob.size <= dataSize - blob.offset);
+		if (blob.size != expectedSize || !inRange) {
+			throw std::runtime_error("blob is out of range or the wrong size");
+		}
+		// Blobs are read in place as floats and indices.
+		if (blob.offset % sizeof(uint32_t) != 0) {
+			throw std::runtime_error("blob is misaligned");
+		}
+	};
+	for (auto& texture : model.textures) {
+		checkBlob(texture.pixels, static_cast<uint64_t>(texture.width) * texture.height * 4);
+	}
+	for (auto& mesh : model.meshes) {
+		size_t stride = mesh.skin != nullptr ? sizeof(SkinnedVertex3D) : sizeof(Vertex3D);
+		checkBlob(mesh.vertices, static_cast<uint64_t>(mesh.vertexCount) * stride);
+		checkBlob(mesh.faces, static_cast<uint64_t>(mesh.faceCount) * sizeof(uint32_t));
+		checkBlob(mesh.bvhNodes, mesh.bvhNodes.size);
+		checkBlob(mesh.bvhPackets, mesh.bvhPackets.size);
+		for (uint32_t t : mesh.textures) {
+			if (t >= model.textures.size()) {
+				throw std::runtime_error("mesh " + mesh.name + " refers to a missing texture");
+			}
+		}
+	}
+	if (model.nodes.empty()) {
+		throw std::runtime_error("model has no root node");
+	}
+	for (uint32_t i = 0; i < model.nodes.size(); i++) {
+		for (uint32_t m : model.nodes[i].meshes) {
+			if (m >= model.meshes.size()) {
+				throw std::runtime_error("node " + model.nodes[i].name + " refers to a missing mesh");
+			}
+		}
+		// Children follow their parents, so the hierarchy cannot contain a cycle.
+		for (uint32_t child : model.nodes[i].children) {
+			if (child <= i || child >= model.nodes.size()) {
+				throw std::runtime_error("node " + model.nodes[i].name + " has an invalid child");
+			}
+		}
+	}
+}
+
+bool AssetPackage::contains(const std::string& path, bool flipTextureCoords) const {
+	return m_models.count(modelKey(path, flipTextureCoords)) > 0;
+}
+
+Object3D AssetPackage::load(const std::string& path, bool flipTextureCoords, MeshRetention retention) const {
+	PROFILE_SCOPE("AssetPackage::load");
+	auto found = m_models.find(modelKey(path, flipTextureCoords));
+	if (found == m_models.end()) {
+		throw std::runtime_error("Asset package " + m_path.string() + " does not contain " + path);
+	}
+	const PackedModel& model = found->second;
+
+	std::vector<Texture> textures;
+	textures.reserve(model.textures.size());
+	for (auto& texture : model.textures) {
+		textures.push_back(Texture::loadPixels(blob(texture.pixels), texture.width, texture.height,
+			texture.samplerName, texture.name));
+		// Packed textures are named by the path they were imported from.
+		textures.back().source = texture.name;
+	}
+
+	std::vector<Mesh3D> meshes;
+	meshes.reserve(model.meshes.size());
+	for (auto& mesh : model.meshes) {
+		// Skinned meshes cannot be picked, so their trees are not loaded.
+		std::shared_ptr<const TriangleBVH> bvh;
+		if (mesh.skin == nullptr) {
+			bvh = std::make_shared<const TriangleBVH>(TriangleBVH::fromBytes(
+				blob(mesh.bvhNodes), mesh.bvhNodes.size, blob(mesh.bvhPackets), mesh.bvhPackets.size, mesh.faceCount / 3));
+		}
+		std::vector<Texture> meshTextures;
+		for (uint32_t t : mesh.textures) {
+			meshTextures.push_back(textures[t]);
+		}
+		meshes.emplace_back(blob(mesh.vertices), mesh.vertexCount, reinterpret_cast<const uint32_t*>(blob(mesh.faces)),
+			mesh.faceCount, mesh.bounds, std::move(bvh), std::move(meshTextures), mesh.skin, retention);
+		meshes.back().setName(mesh.name);
+		meshes.back().setSource({ path, flipTextureCoords, static_cast<uint32_t>(meshes.size() - 1) });
+	}
+	return buildImportedNode(model.nodes, 0, meshes);
+}
+
+void AssetPackage::write(const std::vector<ImportedModel>& models, const std::filesystem::path& path) {
+	PROFILE_SCOPE("AssetPackage::write");
+	TocWriter toc;
+	// The BVHs are built here, and must live until the blobs are written.
+	std::vector<TriangleBVH> bvhs;
+	size_t meshCount = 0;
+	for (auto& model : models) {
+		meshCount += model.meshes.size();
+	}
+	bvhs.reserve(meshCount);
+
+	toc.value(static_cast<uint32_t>(models.size()));
+	for (auto& model : models) {
+		if (!model.animations.empty()) {
+			throw std::runtime_error("Model " + model.path + " has animations, which asset packages do not store");
+		}
+		toc.string(modelKey(model.path, model.flipTextureCoords));
+
+		toc.value(static_cast<uint32_t>(model.textures.size()));
+		for (auto& texture : model.textures) {
+			toc.string(texture.path.string());
+			toc.string(texture.samplerName);
+			toc.value(static_cast<uint32_t>(texture.image.getSize().x));
+			toc.value(static_cast<uint32_t>(texture.image.getSize().y));
+			toc.blob(texture.image.getPixelsPtr(),
+				static_cast<uint64_t>(texture.image.getSize().x) * texture.image.getSize().y * 4);
+		}
+
+		toc.value(static_cast<uint32_t>(model.meshes.size()));
+		for (auto& mesh : model.meshes) {
+			bool skinned = mesh.skin != nullptr;
+			size_t vertexCount = skinned ? mesh.skinnedVertices.size() : mesh.vertices.size();
+			std::vector<glm::vec3> positions(vertexCount);
+			AABB bounds;
+			for (size_t i = 0; i < vertexCount; i++) {
+				const Vertex3D& v = skinned ? mesh.skinnedVertices[i].vertex : mesh.vertices[i];
+				positions[i] = glm::vec3(v.x, v.y, v.z);
+				bounds.expand(positions[i]);
+			}
+			bvhs.emplace_back(positions, mesh.faces);
+
+			toc.string(mesh.name);
+			toc.value(static_cast<uint32_t>(vertexCount));
+			toc.value(static_cast<uint32_t>(mesh.faces.size()));
+			toc.value(bounds.min);
+			toc.value(bounds.max);
+			if (skinned) {
+				toc.blob(mesh.skinnedVertices.data(), vertexCount * sizeof(SkinnedVertex3D));
+			}
+			else {
+				toc.blob(mesh.vertices.data(), vertexCount * sizeof(Vertex3D));
+			}
+			toc.blob(mesh.faces.data(), mesh.faces.size() * sizeof(uint32_t));
+			toc.blob(bvhs.back().nodeBytes(), bvhs.back().nodeByteCount());
+			toc.blob(bvhs.back().packetBytes(), bvhs.back().packetByteCount());
+			writeIndices(toc, mesh.textures);
+			toc.value(static_cast<uint32_t>(skinned ? mesh.skin->jointNames.size() : 0));
+			for (size_t j = 0; skinned && j < mesh.skin->jointNames.size(); j++) {
+				toc.string(mesh.skin->jointNames[j]);
+				toc.value(mesh.skin->inverseBindMatrices[j]);
+			}
+		}
+
+		toc.value(static_cast<uint32_t>(model.nodes.size()));
+		for (auto& node : model.nodes) {
+			toc.string(node.name);
+			toc.value(node.transform);
+			toc.value(static_cast<uint8_t>(node.animated));
+			writeIndices(toc, node.meshes);
+			writeIndices(toc, node.children);
+		}
+	}
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	toc.write(out);
+	if (!out) {
+		throw std::runtime_error("Could not write asset package " + path.string());
+	}
+}
+
+void mountAssetPackage(const std::filesystem::path& path) {
+	auto package = std::make_unique<AssetPackage>(path);
+	std::lock_guard<std::mutex> lock(mountedMutex);
+	mountedPackages.push_back(std::move(package));
+}
+
+const AssetPackage* findPackagedModel(const std::string& path, bool flipTextureCoords) {
+	std::lock_guard<std::mutex> lock(mountedMutex);
+	for (auto& package : mountedPackages) {
+		if (package->contains(path, flipTextureCoords)) {
+			return package.get();
+		}
+	}
+	return nullptr;
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "AssimpImport.h"
+#include "MappedFile.h"
+#include "Object3D.h"
+
+/**
+ * @brief A file of models laid out ahead of time for the GPU and mapped into memory, so loading
+ * a model is bounded by disk bandwidth instead of by parsing.
+ *
+ * The file begins with a table of contents: each model's hierarchy, and the size and offset of
+ * each of its meshes' and textures' data. The table is padded to a page boundary, and each blob
+ * of data after it starts on a page of its own: vertex records exactly as Mesh3D uploads them,
+ * face indices, a prebuilt TriangleBVH, and rows of RGBA8 texture pixels. Loading hands the
+ * mapped blobs straight to OpenGL, so nothing is copied before the driver copies it, and the
+ * operating system reads each page from disk as it is uploaded.
+ *
+ * Packages do not store animations; models with animations must be imported with Assimp.
+ */
+class AssetPackage {
+private:
+	// A range of the data that follows the table of contents.
+	struct Blob {
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	struct PackedTexture {
+		std::string name;
+		std::string samplerName;
+		uint32_t width;
+		uint32_t height;
+		Blob pixels;
+	};
+
+	struct PackedMesh {
+		std::string name;
+		uint32_t vertexCount;
+		uint32_t faceCount;
+		AABB bounds;
+		Blob vertices;
+		Blob faces;
+		Blob bvhNodes;
+		Blob bvhPackets;
+		std::vector<uint32_t> textures;
+		std::shared_ptr<const Skin> skin;
+	};
+
+	struct PackedModel {
+		std::vector<ImportedNode> nodes;
+		std::vector<PackedMesh> meshes;
+		std::vector<PackedTexture> textures;
+	};
+
+	std::filesystem::path m_path;
+	MappedFile m_file;
+	uint64_t m_dataOffset;
+	std::unordered_map<std::string, PackedModel> m_models;
+
+	const uint8_t* blob(const Blob& blob) const { return m_file.data() + m_dataOffset + blob.offset; }
+	void validate(const PackedModel& model) const;
+
+public:
+	/**
+	 * @brief Maps a package and reads its table of contents; throws std::runtime_error if the
+	 * file is not a package or is damaged.
+	 */
+	explicit AssetPackage(const std::filesystem::path& path);
+
+	AssetPackage(const AssetPackage&) = delete;
+	AssetPackage& operator=(const AssetPackage&) = delete;
+
+	const std::filesystem::path& path() const { return m_path; }
+	size_t modelCount() const { return m_models.size(); }
+
+	bool contains(const std::string& path, bool flipTextureCoords) const;
+
+	/**
+	 * @brief Uploads a model from the package and builds its objects, keeping each mesh's CPU
+	 * data per the given policy. Throws std::runtime_error if the package does not contain it,
+	 * or if one of its BVHs is damaged, which is checked only when the BVH is loaded.
+	 */
+	Object3D load(const std::string& path, bool flipTextureCoords,
+		MeshRetention retention = MeshRetention::DISCARD) const;
+
+	/**
+	 * @brief Writes the models to a package, computing each mesh's bounds and BVH. Throws
+	 * std::runtime_error if a model has animations or the file cannot be written.
+	 */
+	static void write(const std::vector<ImportedModel>& models, const std::filesystem::path& path);
+
+	/**
+	 * @brief The name a model is stored under: its normalized path, and whether its texture
+	 * coordinates were flipped.
+	 */
+	static std::string modelKey(const std::string& path, bool flipTextureCoords);
+};
+
+/**
+ * @brief Maps a package and makes its models available to assimpLoad, which then loads them
+ * from the package instead of importing them. Packages mounted first take precedence.
+ */
+void mountAssetPackage(const std::filesystem::path& path);
+
+/**
+ * @brief The first mounted package containing the model, or nullptr if there is none.
+ */
+const AssetPackage* findPackagedModel(const std::string& path, bool flipTextureCoords);
@@ -0,0 +1,222 @@
+#include "AssetReloader.h"
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <unordered_set>
+#include "AssimpImport.h"
+#include "Profiler.h"
+
+namespace {
+	void forEachMeshOf(Object3D& object, const std::function<void(Mesh3D&)>& function) {
+		for (size_t i = 0; i < object.numberOfMeshes(); i++) {
+			function(object.getMesh(i));
+		}
+		for (size_t i = 0; i < object.numberOfChildren(); i++) {
+			forEachMeshOf(object.getChild(i), function);
+		}
+	}
+
+	void collectFiles(const Object3D& object, std::vector<std::string>& files) {
+		for (size_t i = 0; i < object.numberOfMeshes(); i++) {
+			const Mesh3D& mesh = object.getMesh(i);
+			if (!mesh.source().path.empty()) {
+				files.push_back(mesh.source().path);
+			}
+			for (auto& texture : mesh.textures()) {
+				if (!texture.source.empty()) {
+					files.push_back(texture.source);
+				}
+			}
+		}
+		for (size_t i = 0; i < object.numberOfChildren(); i++) {
+			collectFiles(object.getChild(i), files);
+		}
+	}
+}
+
+std::string AssetReloader::canonical(const std::string& path) {
+	auto found = m_canonicalPaths.find(path);
+	if (found != m_canonicalPaths.end()) {
+		return found->second;
+	}
+	// A file missing now, perhaps while an editor replaces it, may be found next time.
+	std::string result = FileWatcher::canonical(path);
+	if (!result.empty()) {
+		m_canonicalPaths.emplace(path, result);
+	}
+	return result;
+}
+
+void AssetReloader::forEachMesh(const std::function<void(Mesh3D&)>& function) {
+	for (auto* objects : m_objects) {
+		for (auto& object : *objects) {
+			forEachMeshOf(object, function);
+		}
+	}
+}
+
+void AssetReloader::addShader(ShaderProgram& program, std::function<void(ShaderProgram&)> onReloaded) {
+	m_shaders.push_back({ &program, std::move(onReloaded) });
+	m_watcher.watch(program.vertexPath());
+	m_watcher.watch(program.fragmentPath());
+}
+
+void AssetReloader::addShaders(ShaderVariants& variants) {
+	m_variants.push_back(&variants);
+	m_watcher.watch(variants.vertexPath());
+	m_watcher.watch(variants.fragmentPath());
+}
+
+void AssetReloader::addObjects(std::vector<Object3D>& objects) {
+	m_objects.push_back(&objects);
+	for (auto& object : objects) {
+		watch(object);
+	}
+}
+
+void AssetReloader::watch(const Object3D& model) {
+	std::vector<std::string> files;
+	collectFiles(model, files);
+	for (auto& file : files) {
+		m_watcher.watch(file);
+	}
+}
+
+bool AssetReloader::reloadShaders(const std::string& file) {
+	bool reloaded = false;
+	for (auto& shader : m_shaders) {
+		if (FileWatcher::canonical(shader.program->vertexPath()) != file
+			&& FileWatcher::canonical(shader.program->fragmentPath()) != file) {
+			continue;
+		}
+		reloaded = true;
+		try {
+			shader.program->reload();
+			shader.onReloaded(*shader.program);
+		}
+		catch (std::runtime_error& e) {
+			std::cerr << "Could not reload " << file << ": " << e.what() << std::endl;
+		}
+	}
+	for (auto* variants : m_variants) {
+		if (FileWatcher::canonical(variants->vertexPath()) != file
+			&& FileWatcher::canonical(variants->fragmentPath()) != file) {
+			continue;
+		}
+		reloaded = true;
+		try {
+			variants->reload();
+		}
+		catch (std::runtime_error& e) {
+			std::cerr << "Could not reload " << file << ": " << e.what() << std::endl;
+		}
+	}
+	return reloaded;
+}
+
+bool AssetReloader::reloadTextures(const std::string& file) {
+	// Copies of a texture share its ID, so each texture is reloaded once.
+	std::vector<Texture> textures;
+	std::unordered_set<uint32_t> seen;
+	forEachMesh([&](Mesh3D& mesh) {
+		for (auto& texture : mesh.textures()) {
+			if (!texture.source.empty() && canonical(texture.source) == file && seen.insert(texture.textureId).second) {
+				textures.push_back(texture);
+			}
+		}
+	});
+	if (textures.empty()) {
+		return false;
+	}
+	sf::Image image;
+	if (!image.loadFromFile(file)) {
+		std::cerr << "Could not reload " << file << std::endl;
+		return true;
+	}
+	for (auto& texture : textures) {
+		Texture::reloadImage(texture, image);
+	}
+	return true;
+}
+
+bool AssetReloader::reloadModel(const std::string& file) {
+	// The meshes loaded from the file, by whether their texture coordinates were flipped, since
+	// that changes the imported vertices.
+	std::map<bool, std::vector<Mesh3D*>> meshes;
+	forEachMesh([&](Mesh3D& mesh) {
+		if (!mesh.source().path.empty() && canonical(mesh.source().path) == file) {
+			meshes[mesh.source().flipTextureCoords].push_back(&mesh);
+		}
+	});
+	for (auto& group : meshes) {
+		ImportedModel imported;
+		try {
+			imported = importModel(group.second[0]->source().path, group.first);
+		}
+		catch (std::runtime_error& e) {
+			std::cerr << "Could not reload " << file << ": " << e.what() << std::endl;
+			continue;
+		}
+		// Only the geometry is replaced, so the textures need not be uploaded.
+		imported.textures.clear();
+		for (auto& mesh : imported.meshes) {
+			mesh.textures.clear();
+		}
+
+		// Each distinct geometry takes its replacement from an upload of its own, since the
+		// replacement is left holding the old geometry. Copies of one model share geometry, so
+		// usually a single upload is needed.
+		std::vector<std::unique_ptr<ModelUpload>> uploads;
+		std::vector<std::vector<bool>> taken;
+		std::vector<const Mesh3D*> replaced;
+		for (Mesh3D* mesh : group.second) {
+			bool shared = false;
+			for (const Mesh3D* other : replaced) {
+				shared = shared || mesh->sharesGeometry(*other);
+			}
+			uint32_t index = mesh->source().index;
+			if (shared || index >= imported.meshes.size()) {
+				continue;
+			}
+			size_t u = 0;
+			while (u < uploads.size() && taken[u][index]) {
+				u++;
+			}
+			if (u == uploads.size()) {
+				ImportedModel copy = imported;
+				uploads.push_back(std::make_unique<ModelUpload>(std::move(copy), mesh->retention()));
+				while (!uploads.back()->done()) {
+					uploads.back()->uploadNext();
+				}
+				taken.emplace_back(imported.meshes.size(), false);
+			}
+			taken[u][index] = true;
+			Mesh3D replacement = uploads[u]->meshes()[index];
+			try {
+				mesh->replaceGeometry(replacement);
+				replaced.push_back(mesh);
+			}
+			catch (std::runtime_error& e) {
+				std::cerr << "Could not reload a mesh of " << file << ": " << e.what() << std::endl;
+			}
+		}
+	}
+	return !meshes.empty();
+}
+
+void AssetReloader::update() {
+	PROFILE_SCOPE("AssetReloader::update");
+	for (auto& file : m_watcher.poll()) {
+		auto start = std::chrono::steady_clock::now();
+		bool reloaded = reloadShaders(file);
+		reloaded = reloadTextures(file) || reloaded;
+		reloaded = reloadModel(file) || reloaded;
+		if (reloaded) {
+			m_reloads++;
+			auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+			std::cout << "Reloaded " << file << " in " << elapsed.count() << " ms" << std::endl;
+		}
+	}
+}
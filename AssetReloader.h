@@ -0,0 +1,82 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "FileWatcher.h"
+#include "Object3D.h"
+#include "ShaderProgram.h"
+#include "ShaderVariants.h"
+
+/**
+ * @brief Reloads shaders, textures, and models in place when their files change, so edits show
+ * up in a running scene without restarting it and importing every other model again.
+ *
+ * Nothing that refers to a reloaded asset has to change. Shader programs are recompiled from
+ * their files, and a program that fails to compile keeps running the old one. Textures are
+ * re-uploaded into their existing OpenGL textures. Meshes keep their Mesh3D objects, and only
+ * their geometry is replaced, which their copies share; a model's hierarchy, transforms, and
+ * texture assignments stay as they were loaded.
+ *
+ * Must be used on the thread that owns the OpenGL context.
+ */
+class AssetReloader {
+private:
+	struct WatchedShader {
+		ShaderProgram* program;
+		std::function<void(ShaderProgram&)> onReloaded;
+	};
+
+	FileWatcher m_watcher;
+	std::vector<WatchedShader> m_shaders;
+	std::vector<ShaderVariants*> m_variants;
+	std::vector<std::vector<Object3D>*> m_objects;
+	// Canonical paths of the files meshes were loaded from, by the path they were loaded by. Files
+	// that could not be found are left out, so they are looked up again.
+	std::unordered_map<std::string, std::string> m_canonicalPaths;
+	size_t m_reloads;
+
+	std::string canonical(const std::string& path);
+	// Calls the function for every mesh of every object in the lists.
+	void forEachMesh(const std::function<void(Mesh3D&)>& function);
+	bool reloadShaders(const std::string& file);
+	bool reloadTextures(const std::string& file);
+	bool reloadModel(const std::string& file);
+
+public:
+	AssetReloader() : m_reloads(0) {}
+
+	/**
+	 * @brief Recompiles the program when either of its shader files changes, then calls
+	 * onReloaded, which must activate it again and restore its uniforms and blocks.
+	 */
+	void addShader(ShaderProgram& program, std::function<void(ShaderProgram&)> onReloaded);
+
+	/**
+	 * @brief Recompiles every variant when either of the shader files changes.
+	 */
+	void addShaders(ShaderVariants& variants);
+
+	/**
+	 * @brief Watches the files of the objects' meshes and textures, which are reloaded in every
+	 * object of the list when they change. The list must outlive the reloader.
+	 */
+	void addObjects(std::vector<Object3D>& objects);
+
+	/**
+	 * @brief Watches the files of a model's meshes and textures; for models loaded into a list
+	 * after it was added.
+	 */
+	void watch(const Object3D& model);
+
+	/**
+	 * @brief Reloads everything whose file has been written since the last update. Failures are
+	 * reported on standard error, leaving the asset as it was. Call once per frame.
+	 */
+	void update();
+
+	/**
+	 * @brief The number of files reloaded so far.
+	 */
+	size_t reloads() const { return m_reloads; }
+};
@@ -1,4 +1,6 @@
+#define GLM_ENABLE_EXPERIMENTAL
 #include "AssimpImport.h"
+#include <glm/gtx/matrix_decompose.hpp>
 #include <iostream>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -6,85 +8,213 @@
 #include <filesystem>
 #include <unordered_map>
 #include <algorithm>
+#include <array>
+#include "AssetPackage.h"
+#include "Profiler.h"
+#include "SkinningSystem.h"
 
 const size_t FLOATS_PER_VERTEX = 3;
 const size_t VERTICES_PER_FACE = 3;
+// Imported animations are resampled to this many samples per second.
+const float_t ANIMATION_SAMPLE_RATE = 30;
+// Assimp reports 0 ticks per second when the file does not specify a rate.
+const double DEFAULT_TICKS_PER_SECOND = 25;
 
-std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, const std::string& typeName, const std::filesystem::path& modelPath,
-	std::unordered_map<std::filesystem::path, Texture>& loadedTextures) {
-	std::vector<Texture> textures;
-	for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
-	{
-		aiString name;
-		mat->GetTexture(type, i, &name);
-		std::filesystem::path texPath = modelPath.parent_path() / name.C_Str();
+glm::mat4 fromAssimpMatrix(const aiMatrix4x4& matrix) {
+	// Assimp matrices are row-major; glm matrices are column-major.
+	glm::mat4 result;
+	for (auto i = 0; i < 4; i++) {
+		for (auto j = 0; j < 4; j++) {
+			result[i][j] = matrix[j][i];
+		}
+	}
+	return result;
+}
 
-		auto existing = loadedTextures.find(texPath);
-		if (existing != loadedTextures.end()) {
-			textures.push_back(existing->second);
+namespace {
+	/**
+	 * @brief Imports a material's textures of one type, adding each file to the model once, and
+	 * appends their indices to the mesh's.
+	 */
+	void importMaterialTextures(const aiMaterial* material, aiTextureType type, const std::string& samplerName,
+		const std::filesystem::path& modelPath, ImportedModel& model,
+		std::unordered_map<std::filesystem::path, uint32_t>& texturesByPath, ImportedMesh& mesh) {
+		for (unsigned int i = 0; i < material->GetTextureCount(type); i++) {
+			aiString name;
+			material->GetTexture(type, i, &name);
+			std::filesystem::path texPath = modelPath.parent_path() / name.C_Str();
+
+			auto existing = texturesByPath.find(texPath);
+			if (existing == texturesByPath.end()) {
+				ImportedTexture texture{ texPath, samplerName, sf::Image() };
+				texture.image.loadFromFile(texPath.string());
+				existing = texturesByPath.emplace(texPath, static_cast<uint32_t>(model.textures.size())).first;
+				model.textures.push_back(std::move(texture));
+			}
+			mesh.textures.push_back(existing->second);
 		}
-		else {
-			sf::Image image;
-			image.loadFromFile(texPath.string());
-			Texture tex = Texture::loadImage(image, typeName);
-			textures.push_back(tex);
-			loadedTextures.insert(std::make_pair(texPath, tex));
+	}
+
+	/**
+	 * @brief Replaces the mesh's vertices with skinned vertices weighted by the aiMesh's bones.
+	 */
+	void importSkin(const aiMesh* mesh, ImportedMesh& imported) {
+		if (mesh->mNumBones > SkinningSystem::MAX_JOINTS) {
+			throw std::runtime_error("Mesh has more bones than skinning supports");
+		}
+
+		auto skin = std::make_shared<Skin>();
+		// The strongest four influences on each vertex, as (weight, joint) pairs.
+		std::vector<std::array<std::pair<float_t, uint8_t>, 4>> influences(imported.vertices.size());
+		for (unsigned int b = 0; b < mesh->mNumBones; b++) {
+			const aiBone* bone = mesh->mBones[b];
+			skin->jointNames.push_back(bone->mName.C_Str());
+			skin->inverseBindMatrices.push_back(fromAssimpMatrix(bone->mOffsetMatrix));
+			for (unsigned int w = 0; w < bone->mNumWeights; w++) {
+				auto& slots = influences[bone->mWeights[w].mVertexId];
+				auto weakest = std::min_element(slots.begin(), slots.end());
+				if (bone->mWeights[w].mWeight > weakest->first) {
+					*weakest = std::make_pair(bone->mWeights[w].mWeight, static_cast<uint8_t>(b));
+				}
+			}
+		}
+
+		std::vector<SkinnedVertex3D> skinnedVertices(imported.vertices.begin(), imported.vertices.end());
+		for (size_t i = 0; i < skinnedVertices.size(); i++) {
+			auto& slots = influences[i];
+			float_t total = slots[0].first + slots[1].first + slots[2].first + slots[3].first;
+			if (total <= 0) {
+				// A vertex no bone moves stays with the first joint's default weight of 255.
+				continue;
+			}
+			// Quantize to bytes, then give any rounding error to the strongest influence so the
+			// weights sum to exactly 255.
+			int32_t sum = 0;
+			size_t strongest = 0;
+			for (size_t k = 0; k < 4; k++) {
+				skinnedVertices[i].joints[k] = slots[k].second;
+				skinnedVertices[i].weights[k] = static_cast<uint8_t>(std::lround(slots[k].first / total * 255));
+				sum += skinnedVertices[i].weights[k];
+				if (slots[k].first > slots[strongest].first) {
+					strongest = k;
+				}
+			}
+			skinnedVertices[i].weights[strongest] += 255 - sum;
 		}
+
+		imported.skinnedVertices = std::move(skinnedVertices);
+		imported.vertices.clear();
+		imported.vertices.shrink_to_fit();
+		imported.skin = std::move(skin);
 	}
-	return textures;
-}
 
-Mesh3D fromAssimpMesh(const aiMesh* mesh, const aiScene* scene, const std::filesystem::path& modelPath,
-	std::unordered_map<std::filesystem::path, Texture>& loadedTextures) {
-	std::vector<Vertex3D> vertices;
+	ImportedMesh importMesh(const aiMesh* mesh, const aiScene* scene, const std::filesystem::path& modelPath,
+		ImportedModel& model, std::unordered_map<std::filesystem::path, uint32_t>& texturesByPath) {
+		ImportedMesh imported;
+		imported.name = modelPath.filename().string() + ":" + mesh->mName.C_Str();
 
-	for (size_t i = 0; i < mesh->mNumVertices; i++) {
-		auto* tex = mesh->mTextureCoords[0];
-		if (tex != nullptr) {
-			vertices.emplace_back( mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z,
-				mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z,
-				//mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z,
-				mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y );
+		auto& vertices = imported.vertices;
+		vertices.reserve(mesh->mNumVertices);
+		const aiVector3D* tex = mesh->mTextureCoords[0];
+		for (size_t i = 0; i < mesh->mNumVertices; i++) {
+			if (tex != nullptr) {
+				vertices.emplace_back(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z,
+					mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z,
+					tex[i].x, tex[i].y);
+			}
+			else {
+				vertices.emplace_back(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z,
+					0, 0, 1, 0, 0);
+			}
 		}
-		else {
-			vertices.push_back({ mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z,
-				0, 0, 1, 0, 0 });
-		}
-	}
-
-	std::vector<uint32_t> faces;
-	faces.reserve(mesh->mNumFaces * VERTICES_PER_FACE);
-	for (size_t i = 0; i < mesh->mNumFaces; i++) {
-		faces.push_back(mesh->mFaces[i].mIndices[0]);
-		faces.push_back(mesh->mFaces[i].mIndices[1]);
-		faces.push_back(mesh->mFaces[i].mIndices[2]);
-	}
-
-	std::vector<Texture> textures = {};
-	if (mesh->mMaterialIndex >= 0)
-	{
-		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-		std::vector<Texture> diffuseMaps = loadMaterialTextures(material,
-			aiTextureType_DIFFUSE, "baseTexture", modelPath, loadedTextures);
-		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-		std::vector<Texture> specularMaps = loadMaterialTextures(material,
-			aiTextureType_SPECULAR, "specMap", modelPath, loadedTextures);
-		textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-		std::vector<Texture> normalMaps = loadMaterialTextures(material,
-			aiTextureType_HEIGHT, "normalMap", modelPath, loadedTextures);
-		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-		normalMaps = loadMaterialTextures(material,
-			aiTextureType_NORMALS, "normalMap", modelPath, loadedTextures);
-		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-	}
-
-	auto m = Mesh3D(std::move(vertices), std::move(faces), std::move(textures));
-	return m;
+
+		auto& faces = imported.faces;
+		faces.reserve(mesh->mNumFaces * VERTICES_PER_FACE);
+		for (size_t i = 0; i < mesh->mNumFaces; i++) {
+			faces.push_back(mesh->mFaces[i].mIndices[0]);
+			faces.push_back(mesh->mFaces[i].mIndices[1]);
+			faces.push_back(mesh->mFaces[i].mIndices[2]);
+		}
+
+		const aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+		importMaterialTextures(material, aiTextureType_DIFFUSE, "baseTexture", modelPath, model, texturesByPath, imported);
+		importMaterialTextures(material, aiTextureType_SPECULAR, "specMap", modelPath, model, texturesByPath, imported);
+		importMaterialTextures(material, aiTextureType_HEIGHT, "normalMap", modelPath, model, texturesByPath, imported);
+		importMaterialTextures(material, aiTextureType_NORMALS, "normalMap", modelPath, model, texturesByPath, imported);
+
+		if (mesh->HasBones()) {
+			importSkin(mesh, imported);
+		}
+		return imported;
+	}
+
+	uint32_t importNode(const aiNode* node, ImportedModel& model, const std::unordered_set<std::string>& animatedNodes) {
+		uint32_t index = static_cast<uint32_t>(model.nodes.size());
+		model.nodes.push_back({ node->mName.C_Str(), fromAssimpMatrix(node->mTransformation),
+			animatedNodes.count(node->mName.C_Str()) > 0, {}, {} });
+		model.nodes[index].meshes.assign(node->mMeshes, node->mMeshes + node->mNumMeshes);
+		for (unsigned int i = 0; i < node->mNumChildren; i++) {
+			uint32_t child = importNode(node->mChildren[i], model, animatedNodes);
+			model.nodes[index].children.push_back(child);
+		}
+		return index;
+	}
 }
 
+std::shared_ptr<AnimationClip> fromAssimpAnimation(const aiAnimation* animation) {
+	double ticksPerSecond = animation->mTicksPerSecond != 0
+		? animation->mTicksPerSecond : DEFAULT_TICKS_PER_SECOND;
 
+	auto clip = std::make_shared<AnimationClip>();
+	clip->name = animation->mName.C_Str();
+	clip->duration = static_cast<float_t>(animation->mDuration / ticksPerSecond);
 
-Object3D assimpLoad(const std::string& path, bool flipTextureCoords) {
+	for (unsigned int i = 0; i < animation->mNumChannels; i++) {
+		const aiNodeAnim* channel = animation->mChannels[i];
+		KeyframeTrack track;
+		for (unsigned int k = 0; k < channel->mNumPositionKeys; k++) {
+			auto& key = channel->mPositionKeys[k];
+			track.addPositionKey(static_cast<float_t>(key.mTime / ticksPerSecond),
+				glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+		}
+		for (unsigned int k = 0; k < channel->mNumRotationKeys; k++) {
+			auto& key = channel->mRotationKeys[k];
+			track.addRotationKey(static_cast<float_t>(key.mTime / ticksPerSecond),
+				glm::quat(key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z));
+		}
+		for (unsigned int k = 0; k < channel->mNumScalingKeys; k++) {
+			auto& key = channel->mScalingKeys[k];
+			track.addScaleKey(static_cast<float_t>(key.mTime / ticksPerSecond),
+				glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+		}
+
+		// Every channel is resampled over the whole clip, so channels whose keys end early
+		// hold their last value and all channels loop together.
+		clip->channels.push_back({
+			channel->mNodeName.C_Str(),
+			std::make_shared<const SampledTrack>(
+				SampledTrack::resample(track, ANIMATION_SAMPLE_RATE, clip->duration))
+		});
+	}
+	return clip;
+}
+
+size_t ImportedModel::gpuBytes() const {
+	size_t bytes = 0;
+	for (auto& mesh : meshes) {
+		bytes += mesh.vertices.size() * sizeof(Vertex3D) + mesh.skinnedVertices.size() * sizeof(SkinnedVertex3D)
+			+ mesh.faces.size() * sizeof(uint32_t);
+	}
+	for (auto& texture : textures) {
+		// RGBA8, plus a third for the mipmap chain.
+		size_t level0 = static_cast<size_t>(texture.image.getSize().x) * texture.image.getSize().y * 4;
+		bytes += level0 + level0 / 3;
+	}
+	return bytes;
+}
+
+ImportedModel importModel(const std::string& path, bool flipTextureCoords) {
+	PROFILE_SCOPE("importModel");
 	Assimp::Importer importer;
 
 	auto options = aiProcessPreset_TargetRealtime_MaxQuality;
@@ -95,79 +225,125 @@ Object3D assimpLoad(const std::string& path, bool flipTextureCoords) {
 
 	// If the import failed, report it
 	if (nullptr == scene) {
-		throw std::runtime_error("Error loading assimp file ");
-
+		throw std::runtime_error("Error loading assimp file " + path + ": " + importer.GetErrorString());
 	}
-	else {
 
+	ImportedModel model;
+	model.path = path;
+	model.flipTextureCoords = flipTextureCoords;
+	std::unordered_set<std::string> animatedNodes;
+	for (unsigned int i = 0; i < scene->mNumAnimations; i++) {
+		auto clip = fromAssimpAnimation(scene->mAnimations[i]);
+		for (auto& channel : clip->channels) {
+			animatedNodes.insert(channel.nodeName);
+		}
+		model.animations.push_back(std::move(clip));
 	}
-	/*auto* mesh = scene->mMeshes[0];
-	std::vector<std::pair<std::string, sf::Image>> textures;
-
-	if (scene->HasMaterials()) {
 
-		auto* material = scene->mMaterials[mesh->mMaterialIndex];
-		aiString name;
-		material->Get(AI_MATKEY_NAME, name);
-
-		material->GetTexture(aiTextureType_DIFFUSE, 0, &name);
+	std::unordered_map<std::filesystem::path, uint32_t> texturesByPath;
+	for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+		model.meshes.push_back(importMesh(scene->mMeshes[i], scene, path, model, texturesByPath));
+	}
+	// aiNode -> Object3D. the aiNode's mTransformation -> Object3D.m_baseTransform.
+	// The list of meshes in aiNode -> Model3D.
+	importNode(scene->mRootNode, model, animatedNodes);
+	return model;
+}
 
-		std::filesystem::path modelPath = path;
-		std::filesystem::path texPath = modelPath.parent_path() / name.C_Str();
-		sf::Image diffuse;
-		diffuse.loadFromFile(texPath.string());
-		textures.emplace_back(std::make_pair(std::string("diffuse"), std::move(diffuse)));
+ModelUpload::ModelUpload(ImportedModel&& model, MeshRetention retention)
+	: m_model(std::move(model)), m_retention(retention) {
+	m_textures.reserve(m_model.textures.size());
+	m_meshes.reserve(m_model.meshes.size());
+}
 
-		if (!material->GetTexture(aiTextureType_HEIGHT, 0, &name)) {
-			std::filesystem::path texPath = modelPath.parent_path() / name.C_Str();
-			sf::Image normal;
-			normal.loadFromFile(texPath.string());
-			textures.emplace_back(std::make_pair(std::string("normalMap"), std::move(normal)));
+size_t ModelUpload::uploadNext() {
+	if (m_textures.size() < m_model.textures.size()) {
+		auto& texture = m_model.textures[m_textures.size()];
+		size_t bytes = static_cast<size_t>(texture.image.getSize().x) * texture.image.getSize().y * 4;
+		m_textures.push_back(Texture::loadImage(texture.image, texture.samplerName, texture.path.string()));
+		m_textures.back().source = texture.path.string();
+		texture.image = sf::Image();
+		return bytes + bytes / 3;
+	}
+	if (m_meshes.size() < m_model.meshes.size()) {
+		auto& mesh = m_model.meshes[m_meshes.size()];
+		std::vector<Texture> textures;
+		for (uint32_t t : mesh.textures) {
+			textures.push_back(m_textures[t]);
 		}
-		if (!material->GetTexture(aiTextureType_SPECULAR, 0, &name)) {
-			std::filesystem::path texPath = modelPath.parent_path() / name.C_Str();
-			sf::Image specular;
-			specular.loadFromFile(texPath.string());
-			textures.emplace_back(std::make_pair(std::string("specMap"), std::move(specular)));
+		size_t bytes = mesh.vertices.size() * sizeof(Vertex3D) + mesh.skinnedVertices.size() * sizeof(SkinnedVertex3D)
+			+ mesh.faces.size() * sizeof(uint32_t);
+		if (mesh.skin != nullptr) {
+			m_meshes.emplace_back(std::move(mesh.skinnedVertices), std::move(mesh.faces), std::move(textures),
+				mesh.skin, m_retention);
 		}
-	}*/
-	//auto ret = Object3D(std::make_shared<Mesh3D>(fromAssimpMesh(scene->mMeshes[0], scene, textures)));
-	std::vector<Mesh3D> meshes;
-	std::unordered_map<std::filesystem::path, Texture> loadedTextures;
-	auto ret = processAssimpNode(scene->mRootNode, scene, std::filesystem::path(path), loadedTextures);
-
-	// aiNode -> Object3D. the aiNode's mTransformation -> Object3D.m_baseTransform.
-	// The list of meshes in aiNode -> Model3D.
-	return ret;
+		else {
+			m_meshes.emplace_back(std::move(mesh.vertices), std::move(mesh.faces), std::move(textures), m_retention);
+		}
+		m_meshes.back().setName(mesh.name);
+		m_meshes.back().setSource({ m_model.path, m_model.flipTextureCoords, static_cast<uint32_t>(m_meshes.size() - 1) });
+		// The Mesh3D constructors take the vectors by reference and leave them intact.
+		mesh.vertices = {};
+		mesh.skinnedVertices = {};
+		mesh.faces = {};
+		return bytes;
+	}
+	return 0;
 }
 
-Object3D processAssimpNode(aiNode* node, const aiScene* scene,
-	const std::filesystem::path& modelPath,
-	std::unordered_map<std::filesystem::path, Texture>& loadedTextures) {
-
-	// Load the aiNode's meshes.
-	std::vector<Mesh3D> meshes;
-	for (auto i = 0; i < node->mNumMeshes; i++) {
-		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		meshes.emplace_back(fromAssimpMesh(mesh, scene, modelPath, loadedTextures));
+Object3D buildImportedNode(const std::vector<ImportedNode>& nodes, uint32_t index, const std::vector<Mesh3D>& meshes) {
+	const ImportedNode& node = nodes[index];
+	std::vector<Mesh3D> nodeMeshes;
+	for (uint32_t m : node.meshes) {
+		nodeMeshes.push_back(meshes[m]);
 	}
 
-	std::vector<Texture> textures;
-	for (auto& p : loadedTextures) {
-		textures.push_back(p.second);
+	// An animation channel replaces its node's whole transform. For animated nodes, the
+	// aiNode's transform is split into the object's position, rotation, and scale, which the
+	// animation then overwrites, instead of becoming the object's base transform.
+	auto parent = Object3D(std::move(nodeMeshes), node.animated ? glm::mat4(1) : node.transform);
+	parent.setName(node.name);
+	if (node.animated) {
+		glm::vec3 scale, translation, skew;
+		glm::quat rotation;
+		glm::vec4 perspective;
+		glm::decompose(node.transform, scale, rotation, translation, skew, perspective);
+		parent.setTransform(translation, glm::vec3(0), rotation, scale);
 	}
-	glm::mat4 baseTransform;
-	for (auto i = 0; i < 4; i++) {
-		for (auto j = 0; j < 4; j++) {
-			baseTransform[i][j] = node->mTransformation[j][i];
-		}
+
+	for (uint32_t child : node.children) {
+		parent.addChild(buildImportedNode(nodes, child, meshes));
 	}
-	auto parent = Object3D(std::move(meshes), baseTransform);
+	return parent;
+}
 
-	for (auto i = 0; i < node->mNumChildren; i++) {
-		Object3D child = processAssimpNode(node->mChildren[i], scene, modelPath, loadedTextures);
-		parent.addChild(std::move(child));
+Object3D ModelUpload::finish() const {
+	if (!done()) {
+		throw std::runtime_error("Model " + m_model.path + " has not finished uploading");
 	}
+	return buildImportedNode(m_model.nodes, 0, m_meshes);
+}
 
-	return parent;
+Object3D assimpLoad(const std::string& path, bool flipTextureCoords) {
+	std::vector<std::shared_ptr<AnimationClip>> animations;
+	return assimpLoad(path, flipTextureCoords, animations);
+}
+
+Object3D assimpLoad(const std::string& path, bool flipTextureCoords,
+	std::vector<std::shared_ptr<AnimationClip>>& animations) {
+	return assimpLoad(path, flipTextureCoords, animations, MeshRetention::DISCARD);
+}
+
+Object3D assimpLoad(const std::string& path, bool flipTextureCoords,
+	std::vector<std::shared_ptr<AnimationClip>>& animations, MeshRetention retention) {
+	PROFILE_SCOPE("assimpLoad");
+	if (const AssetPackage* package = findPackagedModel(path, flipTextureCoords)) {
+		return package->load(path, flipTextureCoords, retention);
+	}
+	ModelUpload upload(importModel(path, flipTextureCoords), retention);
+	while (!upload.done()) {
+		upload.uploadNext();
+	}
+	animations.insert(animations.end(), upload.model().animations.begin(), upload.model().animations.end());
+	return upload.finish();
 }
@@ -1,15 +1,130 @@
 #pragma once
 #include "Mesh3D.h"
 #include "Object3D.h"
+#include <memory>
 #include <unordered_map>
+#include <unordered_set>
 #include <assimp/scene.h>
+#include "AnimationClip.h"
 
-Mesh3D fromAssimpMesh(const aiMesh* mesh, const aiScene* scene, const std::filesystem::path& modelPath,
-	std::unordered_map<std::filesystem::path, Texture>& loadedTextures);
+glm::mat4 fromAssimpMatrix(const aiMatrix4x4& matrix);
+
+/**
+ * @brief A texture of an imported model, decoded but not yet uploaded.
+ */
+struct ImportedTexture {
+	std::filesystem::path path;
+	std::string samplerName;
+	sf::Image image;
+};
+
+/**
+ * @brief A mesh of an imported model, not yet uploaded. Skinned meshes fill skinnedVertices
+ * and skin instead of vertices.
+ */
+struct ImportedMesh {
+	std::string name;
+	std::vector<Vertex3D> vertices;
+	std::vector<SkinnedVertex3D> skinnedVertices;
+	std::shared_ptr<const Skin> skin;
+	std::vector<uint32_t> faces;
+	// Indices into the model's textures.
+	std::vector<uint32_t> textures;
+};
+
+/**
+ * @brief A node of an imported model's hierarchy, with indices into the model's meshes and nodes.
+ */
+struct ImportedNode {
+	std::string name;
+	glm::mat4 transform;
+	// Whether an animation channel drives the node, which replaces its transform.
+	bool animated;
+	std::vector<uint32_t> meshes;
+	std::vector<uint32_t> children;
+};
+
+/**
+ * @brief A model read from a file into memory, with its textures decoded: everything assimpLoad
+ * does before it touches OpenGL. Meshes used by several nodes are imported once.
+ */
+struct ImportedModel {
+	std::string path;
+	bool flipTextureCoords = false;
+	// The hierarchy; nodes[0] is the root.
+	std::vector<ImportedNode> nodes;
+	std::vector<ImportedMesh> meshes;
+	std::vector<ImportedTexture> textures;
+	std::vector<std::shared_ptr<AnimationClip>> animations;
+
+	/**
+	 * @brief How many bytes uploading the model will take on the GPU, including mipmaps.
+	 */
+	size_t gpuBytes() const;
+};
+
+/**
+ * @brief Reads a model and its textures into memory. It needs no OpenGL context, so it can run
+ * on any thread; throws std::runtime_error if the file cannot be imported.
+ */
+ImportedModel importModel(const std::string& path, bool flipTextureCoords);
+
+/**
+ * @brief Uploads an imported model to the GPU one texture or mesh at a time, so the upload can be
+ * spread over several frames, and then builds its objects. Each part's CPU copy is released
+ * once it is uploaded. Must be used on the thread that owns the OpenGL context.
+ */
+class ModelUpload {
+private:
+	ImportedModel m_model;
+	MeshRetention m_retention;
+	std::vector<Texture> m_textures;
+	std::vector<Mesh3D> m_meshes;
+
+public:
+	ModelUpload(ImportedModel&& model, MeshRetention retention = MeshRetention::DISCARD);
+
+	bool done() const {
+		return m_textures.size() == m_model.textures.size() && m_meshes.size() == m_model.meshes.size();
+	}
+
+	/**
+	 * @brief Uploads the next texture, or once they are all uploaded, the next mesh. Returns how
+	 * many bytes it uploaded.
+	 */
+	size_t uploadNext();
+
+	/**
+	 * @brief Builds the model's objects once every part is uploaded. The objects share the
+	 * uploaded meshes, so finish can be called again for another copy of the model.
+	 */
+	Object3D finish() const;
+
+	const ImportedModel& model() const { return m_model; }
+	const std::vector<Texture>& textures() const { return m_textures; }
+	const std::vector<Mesh3D>& meshes() const { return m_meshes; }
+};
+
+/**
+ * @brief Builds the objects of an imported model's node, and its descendants, from the model's
+ * uploaded meshes.
+ */
+Object3D buildImportedNode(const std::vector<ImportedNode>& nodes, uint32_t index, const std::vector<Mesh3D>& meshes);
+
+/**
+ * @brief Loads a model from the first mounted AssetPackage that contains it, or else imports
+ * it with Assimp.
+ */
 Object3D assimpLoad(const std::string& path, bool flipTextureCoords);
-Object3D processAssimpNode(aiNode* node, const aiScene* scene,
-	const std::filesystem::path& modelPath,
-	std::unordered_map<std::filesystem::path, Texture>& textures);
-std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, const std::string& typeName,
-	const std::filesystem::path& modelPath,
-	std::unordered_map<std::filesystem::path, Texture>& loadedTextures);
\ No newline at end of file
+/**
+ * @brief Loads a model, also converting each of its aiAnimations into an AnimationClip whose
+ * channels are bound to the model's objects by node name.
+ */
+Object3D assimpLoad(const std::string& path, bool flipTextureCoords,
+	std::vector<std::shared_ptr<AnimationClip>>& animations);
+/**
+ * @brief Loads a model and its animations, keeping each mesh's CPU data per the given policy.
+ */
+Object3D assimpLoad(const std::string& path, bool flipTextureCoords,
+	std::vector<std::shared_ptr<AnimationClip>>& animations, MeshRetention retention);
+std::shared_ptr<AnimationClip> fromAssimpAnimation(const aiAnimation* animation);
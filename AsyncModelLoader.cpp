@@ -0,0 +1,124 @@
+#include "AsyncModelLoader.h"
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include "Profiler.h"
+
+namespace {
+	size_t fileSize(const std::filesystem::path& path) {
+		std::error_code error;
+		auto size = std::filesystem::file_size(path, error);
+		return error ? 0 : static_cast<size_t>(size);
+	}
+}
+
+AsyncModelLoader::AsyncModelLoader(size_t threadCount, double bytesPerSecond)
+	: m_nextId(1), m_running(0), m_stopping(false), m_bytesPerSecond(bytesPerSecond),
+	m_ioAvailableAt(std::chrono::steady_clock::now()) {
+	for (size_t i = 0; i < std::max<size_t>(threadCount, 1); i++) {
+		m_threads.emplace_back(&AsyncModelLoader::workerLoop, this);
+	}
+}
+
+AsyncModelLoader::~AsyncModelLoader() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+	for (auto& thread : m_threads) {
+		thread.join();
+	}
+}
+
+void AsyncModelLoader::workerLoop() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true) {
+		// Wait for a request and for the disk budget to allow another read.
+		m_wake.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+		if (m_stopping) {
+			return;
+		}
+		if (std::chrono::steady_clock::now() < m_ioAvailableAt) {
+			m_wake.wait_until(lock, m_ioAvailableAt);
+			continue;
+		}
+
+		auto next = std::min_element(m_queue.begin(), m_queue.end(),
+			[](const Request& a, const Request& b) { return a.priority < b.priority; });
+		Request request = std::move(*next);
+		m_queue.erase(next);
+		m_running++;
+		lock.unlock();
+
+		Result result{ request.id, nullptr, "", fileSize(request.path) };
+		try {
+			PROFILE_SCOPE("AsyncModelLoader::import");
+			result.model = std::make_unique<ImportedModel>(importModel(request.path, request.flipTextureCoords));
+			for (auto& texture : result.model->textures) {
+				result.bytesRead += fileSize(texture.path);
+			}
+		}
+		catch (std::exception& e) {
+			result.error = e.what();
+		}
+
+		lock.lock();
+		auto now = std::chrono::steady_clock::now();
+		if (m_bytesPerSecond > 0) {
+			auto readTime = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				std::chrono::duration<double>(result.bytesRead / m_bytesPerSecond));
+			m_ioAvailableAt = std::max(m_ioAvailableAt, now) + readTime;
+		}
+		m_results.push_back(std::move(result));
+		m_running--;
+	}
+}
+
+uint64_t AsyncModelLoader::request(const std::string& path, bool flipTextureCoords, float_t priority) {
+	uint64_t id;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		id = m_nextId++;
+		m_queue.push_back({ id, path, flipTextureCoords, priority });
+	}
+	m_wake.notify_one();
+	return id;
+}
+
+void AsyncModelLoader::setPriority(uint64_t id, float_t priority) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (auto& request : m_queue) {
+		if (request.id == id) {
+			request.priority = priority;
+			return;
+		}
+	}
+}
+
+bool AsyncModelLoader::cancel(uint64_t id) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto request = std::find_if(m_queue.begin(), m_queue.end(), [id](const Request& r) { return r.id == id; });
+	if (request == m_queue.end()) {
+		return false;
+	}
+	m_queue.erase(request);
+	return true;
+}
+
+std::vector<AsyncModelLoader::Result> AsyncModelLoader::collect() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::vector<Result> results;
+	results.swap(m_results);
+	return results;
+}
+
+size_t AsyncModelLoader::pending() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_queue.size() + m_running;
+}
+
+void AsyncModelLoader::setBytesPerSecond(double bytesPerSecond) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_bytesPerSecond = bytesPerSecond;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "AssimpImport.h"
+
+/**
+ * @brief Imports models with importModel on background threads, so reading and decoding files
+ * never stalls rendering. Queued requests are started in order of priority, lowest first, and
+ * the threads together read no more than a budget of bytes per second from disk. The rendering
+ * thread collects finished imports and uploads them, e.g. with ModelUpload.
+ */
+class AsyncModelLoader {
+public:
+	struct Result {
+		uint64_t id;
+		// The imported model, or nullptr if the import failed.
+		std::unique_ptr<ImportedModel> model;
+		std::string error;
+		// How many bytes the import read from disk: the model file and its textures.
+		size_t bytesRead;
+	};
+
+private:
+	struct Request {
+		uint64_t id;
+		std::string path;
+		bool flipTextureCoords;
+		float_t priority;
+	};
+
+	std::vector<std::thread> m_threads;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::vector<Request> m_queue;
+	std::vector<Result> m_results;
+	uint64_t m_nextId;
+	size_t m_running;
+	bool m_stopping;
+
+	// The disk budget: once an import has read its bytes, no import starts until the time the
+	// budget would take to read them has passed.
+	double m_bytesPerSecond;
+	std::chrono::steady_clock::time_point m_ioAvailableAt;
+
+	void workerLoop();
+
+public:
+	/**
+	 * @brief Starts the given number of import threads, reading at most bytesPerSecond.
+	 */
+	AsyncModelLoader(size_t threadCount, double bytesPerSecond);
+	~AsyncModelLoader();
+
+	AsyncModelLoader(const AsyncModelLoader&) = delete;
+	AsyncModelLoader& operator=(const AsyncModelLoader&) = delete;
+
+	/**
+	 * @brief Queues a model for import, returning the id its Result will carry.
+	 */
+	uint64_t request(const std::string& path, bool flipTextureCoords, float_t priority);
+
+	/**
+	 * @brief Changes the priority of a request that has not started yet.
+	 */
+	void setPriority(uint64_t id, float_t priority);
+
+	/**
+	 * @brief Removes a request that has not started yet. Returns false if it has started, in
+	 * which case its result will still arrive.
+	 */
+	bool cancel(uint64_t id);
+
+	/**
+	 * @brief Takes the results of every import finished since the last call.
+	 */
+	std::vector<Result> collect();
+
+	/**
+	 * @brief How many requests are queued or being imported.
+	 */
+	size_t pending() const;
+
+	void setBytesPerSecond(double bytesPerSecond);
+};
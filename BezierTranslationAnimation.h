@@ -2,6 +2,11 @@
 #include "glm/glm.hpp"
 #include "Animation.h"
 
+/**
+ * @brief Moves an object along a cubic Bezier curve over an interval. The control points are
+ * offsets from the position the object has when the animation is scheduled, so a curve whose
+ * first point is the origin starts exactly where the object is.
+ */
 class BezierTranslationAnimation : public Animation {
 private:
 	glm::vec3 cp0;
@@ -9,18 +14,11 @@ private:
 	glm::vec3 cp2;
 	glm::vec3 cp3;
 
-	void applyAnimation(float_t dt) override {
-		auto t = currentTime() / duration();
-		glm::vec3 interpolatedPoint;
-
-		interpolatedPoint.x = pow((1 - t), 3) * cp0.x + 3 * pow((1 - t), 2) * t * cp1.x + 3 * (1 - t) * pow(t, 2) * cp2.x + pow(t, 3) * cp3.x;
-		interpolatedPoint.y = pow((1 - t), 3) * cp0.y + 3 * pow((1 - t), 2) * t * cp1.y + 3 * (1 - t) * pow(t, 2) * cp2.y + pow(t, 3) * cp3.y;
-		interpolatedPoint.z = pow((1 - t), 3) * cp0.z + 3 * pow((1 - t), 2) * t * cp1.z + 3 * (1 - t) * pow(t, 2) * cp2.z + pow(t, 3) * cp3.z;
-
-		object().move(interpolatedPoint * dt);
-	}
-
 public:
 	BezierTranslationAnimation(Object3D& object, float_t duration, const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3) :
-		Animation(object, duration), cp0(p0/duration), cp1(p1/duration), cp2(p2/duration), cp3(p3/duration){}
-};
\ No newline at end of file
+		Animation(object, duration), cp0(p0), cp1(p1), cp2(p2), cp3(p3) {}
+
+	void schedule(AnimationEngine& engine, float_t startTime) override {
+		engine.addBezierTranslation(object(), startTime, duration(), cp0, cp1, cp2, cp3);
+	}
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include <algorithm>
+#include <limits>
+#include <glm/glm.hpp>
+
+/**
+ * @brief An axis-aligned bounding box. A default-constructed box is empty, and expanding it by
+ * a point or another box grows it to contain them.
+ */
+struct AABB {
+	glm::vec3 min;
+	glm::vec3 max;
+
+	AABB() : min(std::numeric_limits<float_t>::max()), max(-std::numeric_limits<float_t>::max()) {}
+	AABB(const glm::vec3& minCorner, const glm::vec3& maxCorner) : min(minCorner), max(maxCorner) {}
+
+	bool isEmpty() const { return min.x > max.x; }
+
+	glm::vec3 center() const { return (min + max) * 0.5f; }
+	/**
+	 * @brief Half the size of the box along each axis.
+	 */
+	glm::vec3 extents() const { return (max - min) * 0.5f; }
+
+	void expand(const glm::vec3& point) {
+		min = glm::min(min, point);
+		max = glm::max(max, point);
+	}
+
+	void expand(const AABB& other) {
+		min = glm::min(min, other.min);
+		max = glm::max(max, other.max);
+	}
+
+	bool overlaps(const AABB& other) const {
+		return min.x <= other.max.x && max.x >= other.min.x
+			&& min.y <= other.max.y && max.y >= other.min.y
+			&& min.z <= other.max.z && max.z >= other.min.z;
+	}
+
+	/**
+	 * @brief The smallest box containing this box after transforming it by the given matrix.
+	 */
+	AABB transformed(const glm::mat4& m) const {
+		if (isEmpty()) {
+			return *this;
+		}
+		// Transform the center, then add up how far each axis of the box reaches along each
+		// world axis (Arvo's method), instead of transforming all eight corners.
+		glm::vec3 c = glm::vec3(m * glm::vec4(center(), 1));
+		glm::vec3 e = extents();
+		glm::vec3 reach = glm::abs(glm::vec3(m[0])) * e.x + glm::abs(glm::vec3(m[1])) * e.y
+			+ glm::abs(glm::vec3(m[2])) * e.z;
+		return AABB(c - reach, c + reach);
+	}
+};
+
+/**
+ * @brief The distance along a ray at which it enters the box from min to max, or infinity if
+ * the ray misses the box or enters it beyond maxDistance. inverseDirection is 1 / the ray's
+ * direction, which callers testing many boxes against one ray compute once.
+ */
+inline float_t rayEnterDistance(const glm::vec3& min, const glm::vec3& max, const glm::vec3& origin,
+	const glm::vec3& inverseDirection, float_t maxDistance) {
+	glm::vec3 t0 = (min - origin) * inverseDirection;
+	glm::vec3 t1 = (max - origin) * inverseDirection;
+	glm::vec3 nearT = glm::min(t0, t1);
+	glm::vec3 farT = glm::max(t0, t1);
+	float_t enter = std::max(std::max(nearT.x, nearT.y), std::max(nearT.z, float_t(0)));
+	float_t exit = std::min(std::min(farT.x, farT.y), std::min(farT.z, maxDistance));
+	return enter <= exit ? enter : std::numeric_limits<float_t>::infinity();
+}
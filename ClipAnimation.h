@@ -0,0 +1,34 @@
+#pragma once
+#include <memory>
+#include "Object3D.h"
+#include "Animation.h"
+#include "AnimationClip.h"
+
+/**
+ * @brief Plays an AnimationClip on a model hierarchy. Each channel of the clip animates the
+ * object in the hierarchy with the channel's node name; channels with no matching object are
+ * ignored. If the animation's duration is longer than the clip, the clip loops.
+ */
+class ClipAnimation : public Animation {
+private:
+	std::shared_ptr<const AnimationClip> m_clip;
+
+public:
+	/**
+	 * @brief Constructs an animation that plays the clip once on the given model.
+	 */
+	ClipAnimation(Object3D& model, std::shared_ptr<const AnimationClip> clip) :
+		Animation(model, clip->duration), m_clip(std::move(clip)) {}
+
+	ClipAnimation(Object3D& model, float_t duration, std::shared_ptr<const AnimationClip> clip) :
+		Animation(model, duration), m_clip(std::move(clip)) {}
+
+	void schedule(AnimationEngine& engine, float_t startTime) override {
+		for (auto& channel : m_clip->channels) {
+			Object3D* node = object().findByName(channel.nodeName);
+			if (node != nullptr) {
+				engine.addSampledTrack(*node, startTime, duration(), channel.track);
+			}
+		}
+	}
+};
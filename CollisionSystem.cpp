@@ -0,0 +1,215 @@
+#include "CollisionSystem.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	// The radius of the largest sphere that fits in the box.
+	float_t sphereRadius(const AABB& box) {
+		glm::vec3 e = box.extents();
+		return std::min({ e.x, e.y, e.z });
+	}
+
+	// The bounds of the model's meshes and descendants in the model's own space.
+	AABB localBounds(const Object3D& model) {
+		AABB bounds;
+		for (size_t i = 0; i < model.numberOfMeshes(); i++) {
+			bounds.expand(model.getMesh(i).bounds());
+		}
+		for (size_t i = 0; i < model.numberOfChildren(); i++) {
+			bounds.expand(model.getChild(i).getBounds());
+		}
+		return bounds;
+	}
+}
+
+size_t CollisionSystem::add(Object3D& model, ColliderShape shape, int32_t body) {
+	m_colliders.push_back({ &model, shape, body, AABB(), glm::mat4(1) });
+	m_bounds.emplace_back();
+	m_order.push_back(static_cast<uint32_t>(m_colliders.size() - 1));
+	refresh(m_colliders.size() - 1);
+	return m_colliders.size() - 1;
+}
+
+void CollisionSystem::refresh(size_t collider) {
+	Collider& c = m_colliders[collider];
+	c.localBounds = localBounds(*c.object);
+	c.matrix = c.object->getModelMatrix();
+	m_bounds[collider] = c.localBounds.transformed(c.matrix);
+}
+
+void CollisionSystem::sortOrder(bool axisChanged) {
+	int32_t axis = m_axis;
+	auto key = [&](uint32_t collider) { return m_bounds[collider].min[axis]; };
+	if (axisChanged) {
+		std::sort(m_order.begin(), m_order.end(),
+			[&](uint32_t a, uint32_t b) { return key(a) < key(b); });
+		return;
+	}
+	// Insertion sort: nearly linear when the order barely changed since the last step.
+	for (size_t i = 1; i < m_order.size(); i++) {
+		uint32_t collider = m_order[i];
+		float_t k = key(collider);
+		size_t j = i;
+		while (j > 0 && key(m_order[j - 1]) > k) {
+			m_order[j] = m_order[j - 1];
+			j--;
+		}
+		m_order[j] = collider;
+	}
+}
+
+void CollisionSystem::update() {
+	m_pairs.clear();
+	if (m_colliders.empty()) {
+		return;
+	}
+
+	// Sweep along the axis where the colliders' centers vary the most, so the fewest of them
+	// overlap along it.
+	glm::vec3 sum(0), sumOfSquares(0);
+	for (size_t i = 0; i < m_colliders.size(); i++) {
+		// Models that have not moved since the last step keep their bounds.
+		Collider& collider = m_colliders[i];
+		const glm::mat4& matrix = collider.object->getModelMatrix();
+		if (matrix != collider.matrix) {
+			collider.matrix = matrix;
+			m_bounds[i] = collider.localBounds.transformed(matrix);
+		}
+		glm::vec3 c = m_bounds[i].center();
+		sum += c;
+		sumOfSquares += c * c;
+	}
+	glm::vec3 variance = sumOfSquares - sum * sum / static_cast<float_t>(m_colliders.size());
+	int32_t axis = variance.x >= variance.y && variance.x >= variance.z ? 0
+		: variance.y >= variance.z ? 1 : 2;
+	bool axisChanged = axis != m_axis;
+	m_axis = axis;
+	sortOrder(axisChanged);
+
+	// Colliders whose intervals along the axis contain the current sweep position.
+	m_active.clear();
+	for (uint32_t collider : m_order) {
+		const AABB& bounds = m_bounds[collider];
+		for (size_t i = 0; i < m_active.size();) {
+			const AABB& other = m_bounds[m_active[i]];
+			if (other.max[axis] < bounds.min[axis]) {
+				m_active[i] = m_active.back();
+				m_active.pop_back();
+				continue;
+			}
+			if (other.overlaps(bounds)) {
+				m_pairs.push_back({ std::min(collider, m_active[i]), std::max(collider, m_active[i]) });
+			}
+			i++;
+		}
+		m_active.push_back(collider);
+	}
+}
+
+bool CollisionSystem::intersect(uint32_t a, uint32_t b, Contact& contact) const {
+	const AABB& boxA = m_bounds[a];
+	const AABB& boxB = m_bounds[b];
+	ColliderShape shapeA = m_colliders[a].shape;
+	ColliderShape shapeB = m_colliders[b].shape;
+	glm::vec3 centerA = boxA.center();
+	glm::vec3 centerB = boxB.center();
+	contact.a = a;
+	contact.b = b;
+
+	if (shapeA == ColliderShape::SPHERE && shapeB == ColliderShape::SPHERE) {
+		float_t radii = sphereRadius(boxA) + sphereRadius(boxB);
+		glm::vec3 offset = centerB - centerA;
+		float_t distanceSquared = glm::dot(offset, offset);
+		if (distanceSquared >= radii * radii) {
+			return false;
+		}
+		float_t distance = std::sqrt(distanceSquared);
+		contact.normal = distance > 0 ? offset / distance : glm::vec3(0, 1, 0);
+		contact.depth = radii - distance;
+		return true;
+	}
+
+	if (shapeA != shapeB) {
+		// Test the sphere against the point of the box closest to its center.
+		bool sphereIsA = shapeA == ColliderShape::SPHERE;
+		const AABB& sphereBox = sphereIsA ? boxA : boxB;
+		const AABB& box = sphereIsA ? boxB : boxA;
+		glm::vec3 center = sphereBox.center();
+		float_t radius = sphereRadius(sphereBox);
+		glm::vec3 closest = glm::clamp(center, box.min, box.max);
+		glm::vec3 offset = center - closest;
+		float_t distanceSquared = glm::dot(offset, offset);
+		if (distanceSquared >= radius * radius) {
+			return false;
+		}
+		if (distanceSquared > 0) {
+			float_t distance = std::sqrt(distanceSquared);
+			// offset points from the box to the sphere.
+			glm::vec3 normal = offset / distance;
+			contact.normal = sphereIsA ? -normal : normal;
+			contact.depth = radius - distance;
+			return true;
+		}
+		// The sphere's center is inside the box; separate them like two boxes.
+	}
+
+	glm::vec3 overlap = glm::min(boxA.max, boxB.max) - glm::max(boxA.min, boxB.min);
+	if (overlap.x <= 0 || overlap.y <= 0 || overlap.z <= 0) {
+		return false;
+	}
+	int32_t axis = overlap.x <= overlap.y && overlap.x <= overlap.z ? 0
+		: overlap.y <= overlap.z ? 1 : 2;
+	contact.normal = glm::vec3(0);
+	contact.normal[axis] = centerB[axis] >= centerA[axis] ? 1.0f : -1.0f;
+	contact.depth = overlap[axis];
+	return true;
+}
+
+const std::vector<Contact>& CollisionSystem::findContacts() {
+	m_contacts.clear();
+	Contact contact;
+	for (auto& pair : m_pairs) {
+		if (intersect(pair.a, pair.b, contact)) {
+			m_contacts.push_back(contact);
+		}
+	}
+	return m_contacts;
+}
+
+void CollisionSystem::bounce(KinematicsSystem& kinematics, float_t restitution) {
+	for (auto& contact : m_contacts) {
+		int32_t bodyA = m_colliders[contact.a].body;
+		int32_t bodyB = m_colliders[contact.b].body;
+		float_t inverseMassA = bodyA >= 0 ? 1.0f : 0.0f;
+		float_t inverseMassB = bodyB >= 0 ? 1.0f : 0.0f;
+		float_t inverseMasses = inverseMassA + inverseMassB;
+		if (inverseMasses == 0) {
+			continue;
+		}
+
+		// Push the bodies apart, each in proportion to its inverse mass.
+		glm::vec3 separation = contact.normal * (contact.depth / inverseMasses);
+		glm::vec3 velocityA = bodyA >= 0 ? kinematics.velocity(bodyA) : glm::vec3(0);
+		glm::vec3 velocityB = bodyB >= 0 ? kinematics.velocity(bodyB) : glm::vec3(0);
+		if (bodyA >= 0) {
+			kinematics.setPosition(bodyA, kinematics.position(bodyA) - separation * inverseMassA);
+		}
+		if (bodyB >= 0) {
+			kinematics.setPosition(bodyB, kinematics.position(bodyB) + separation * inverseMassB);
+		}
+
+		// Reflect the velocities only if the bodies are approaching each other, so a pair that
+		// is already separating is not pulled back together.
+		float_t approach = glm::dot(velocityB - velocityA, contact.normal);
+		if (approach >= 0) {
+			continue;
+		}
+		float_t impulse = -(1 + restitution) * approach / inverseMasses;
+		if (bodyA >= 0) {
+			kinematics.setVelocity(bodyA, velocityA - contact.normal * (impulse * inverseMassA));
+		}
+		if (bodyB >= 0) {
+			kinematics.setVelocity(bodyB, velocityB + contact.normal * (impulse * inverseMassB));
+		}
+	}
+}
@@ -0,0 +1,121 @@
+#pragma once
+#include <vector>
+#include "Bounds.h"
+#include "KinematicsSystem.h"
+#include "Object3D.h"
+
+/**
+ * @brief The shape used for a collider's narrowphase tests. Both are derived from the world
+ * bounds of the collider's model.
+ */
+enum class ColliderShape : uint8_t {
+	/** @brief The model's world bounding box. */
+	BOX,
+	/** @brief The largest sphere that fits in the model's world bounding box. */
+	SPHERE
+};
+
+/**
+ * @brief Two colliders whose bounding boxes overlap; a < b.
+ */
+struct CollisionPair {
+	uint32_t a;
+	uint32_t b;
+};
+
+/**
+ * @brief Two colliders whose shapes intersect. The normal points from a towards b, and the
+ * depth is how far b must move along it to separate them.
+ */
+struct Contact {
+	uint32_t a;
+	uint32_t b;
+	glm::vec3 normal;
+	float_t depth;
+};
+
+/**
+ * @brief Finds which of many moving models collide. The broadphase sweeps the colliders' world
+ * bounds along the axis on which they are most spread out, keeping them sorted between updates
+ * with an insertion sort; since models move little from one step to the next, that sort is
+ * close to linear, as is the sweep unless many colliders overlap along the axis.
+ *
+ * Each model is treated as rigid: the bounds of its hierarchy in its own space are computed
+ * when it is added, and each update only transforms them by the root's model matrix, for the
+ * colliders whose root has moved. Call refresh() after moving a model's children.
+ *
+ * Overlapping pairs can then be tested exactly against each collider's shape, and colliders
+ * driven by a KinematicsSystem can be separated and bounced off each other.
+ *
+ * Colliders are the root objects of models. Like Animations, the system keeps pointers to the
+ * objects, so they must not be moved after they are added.
+ */
+class CollisionSystem {
+private:
+	struct Collider {
+		Object3D* object;
+		ColliderShape shape;
+		// The collider's body in a KinematicsSystem, or -1 if it does not move in response to
+		// collisions.
+		int32_t body;
+		// The bounds of the model's hierarchy in the root's space, and the root's model matrix
+		// when the world bounds were last computed from them.
+		AABB localBounds;
+		glm::mat4 matrix;
+	};
+
+	std::vector<Collider> m_colliders;
+	std::vector<AABB> m_bounds;
+	// Collider indices sorted by the minimum of their bounds along the sweep axis.
+	std::vector<uint32_t> m_order;
+	int32_t m_axis;
+	std::vector<uint32_t> m_active;
+	std::vector<CollisionPair> m_pairs;
+	std::vector<Contact> m_contacts;
+
+	void sortOrder(bool axisChanged);
+	bool intersect(uint32_t a, uint32_t b, Contact& contact) const;
+
+public:
+	CollisionSystem() : m_axis(-1) {}
+
+	/**
+	 * @brief Adds a collider for the given model, returning its index. If the model is a body
+	 * of a KinematicsSystem, pass its body index so bounce() can move it.
+	 */
+	size_t add(Object3D& model, ColliderShape shape = ColliderShape::BOX, int32_t body = -1);
+
+	size_t numberOfColliders() const { return m_colliders.size(); }
+	const AABB& bounds(size_t collider) const { return m_bounds[collider]; }
+
+	/**
+	 * @brief Recomputes the bounds of the collider's hierarchy, after its children have moved
+	 * relative to its root.
+	 */
+	void refresh(size_t collider);
+
+	/**
+	 * @brief Updates the world bounds of the colliders whose models moved, and finds the pairs
+	 * whose bounds overlap. Call once per simulation step, after the models have moved.
+	 */
+	void update();
+
+	/**
+	 * @brief The pairs found by the most recent update.
+	 */
+	const std::vector<CollisionPair>& pairs() const { return m_pairs; }
+
+	/**
+	 * @brief Tests the shapes of every overlapping pair, returning those that intersect.
+	 */
+	const std::vector<Contact>& findContacts();
+
+	/**
+	 * @brief Resolves the contacts of the most recent findContacts: intersecting bodies are
+	 * pushed apart, and bodies moving towards each other have their velocities reflected along
+	 * the contact normal, keeping the given fraction of their speed. Bodies are treated as
+	 * having equal mass, and colliders without bodies as immovable. Call
+	 * KinematicsSystem::apply afterwards to move the objects.
+	 */
+	void bounce(KinematicsSystem& kinematics, float_t restitution = 1);
+};
@@ -0,0 +1,105 @@
+#include "FileWatcher.h"
+#include <stdexcept>
+
+#ifdef FILE_WATCHER_INOTIFY
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+std::string FileWatcher::canonical(const std::filesystem::path& path) {
+	std::error_code error;
+	auto result = std::filesystem::canonical(path, error);
+	return error ? std::string() : result.string();
+}
+
+#ifdef FILE_WATCHER_INOTIFY
+
+FileWatcher::FileWatcher() : m_inotify(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {
+	if (m_inotify < 0) {
+		throw std::runtime_error("Could not initialize inotify");
+	}
+}
+
+FileWatcher::~FileWatcher() {
+	close(m_inotify);
+}
+
+void FileWatcher::watch(const std::filesystem::path& path) {
+	std::string file = canonical(path);
+	if (file.empty() || !m_files.insert(file).second) {
+		return;
+	}
+	std::string directory = std::filesystem::path(file).parent_path().string();
+	if (m_watchedDirectories.count(directory) > 0) {
+		return;
+	}
+	// A write ends with the file being closed, and a replacement with one being moved in.
+	int descriptor = inotify_add_watch(m_inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (descriptor < 0) {
+		m_files.erase(file);
+		return;
+	}
+	m_directories[descriptor] = directory;
+	m_watchedDirectories.insert(directory);
+}
+
+std::vector<std::string> FileWatcher::poll() {
+	std::vector<std::string> changed;
+	std::unordered_set<std::string> seen;
+	alignas(inotify_event) char buffer[4096];
+	while (true) {
+		ssize_t length = read(m_inotify, buffer, sizeof(buffer));
+		if (length <= 0) {
+			break;
+		}
+		for (ssize_t offset = 0; offset < length; ) {
+			auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+			offset += sizeof(inotify_event) + event->len;
+			auto directory = m_directories.find(event->wd);
+			if (event->len == 0 || directory == m_directories.end()) {
+				continue;
+			}
+			std::string file = (std::filesystem::path(directory->second) / event->name).string();
+			if (m_files.count(file) > 0 && seen.insert(file).second) {
+				changed.push_back(file);
+			}
+		}
+	}
+	return changed;
+}
+
+#else
+
+FileWatcher::FileWatcher() : m_lastPoll(std::chrono::steady_clock::now()) {}
+
+FileWatcher::~FileWatcher() {}
+
+void FileWatcher::watch(const std::filesystem::path& path) {
+	std::string file = canonical(path);
+	if (file.empty() || !m_files.insert(file).second) {
+		return;
+	}
+	std::error_code error;
+	m_modified[file] = std::filesystem::last_write_time(file, error);
+}
+
+std::vector<std::string> FileWatcher::poll() {
+	std::vector<std::string> changed;
+	auto now = std::chrono::steady_clock::now();
+	if (now - m_lastPoll < POLL_INTERVAL) {
+		return changed;
+	}
+	m_lastPoll = now;
+	for (auto& entry : m_modified) {
+		std::error_code error;
+		auto modified = std::filesystem::last_write_time(entry.first, error);
+		// A file being replaced may briefly not exist; it is picked up once it does.
+		if (!error && modified != entry.second) {
+			entry.second = modified;
+			changed.push_back(entry.first);
+		}
+	}
+	return changed;
+}
+
+#endif
@@ -0,0 +1,67 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// On Linux, changes are reported by inotify; elsewhere the watched files' modification times
+// are polled.
+#if defined(__linux__)
+#define FILE_WATCHER_INOTIFY
+#endif
+
+/**
+ * @brief Reports when watched files are written. With inotify, the files' directories are
+ * watched rather than the files, so a file replaced by an editor saving through a temporary
+ * file and a rename is still reported. Without it, every watched file's modification time is
+ * checked, at most every POLL_INTERVAL.
+ */
+class FileWatcher {
+public:
+	/**
+	 * @brief How often modification times are checked when inotify is unavailable.
+	 */
+	static constexpr std::chrono::milliseconds POLL_INTERVAL{ 250 };
+
+private:
+	// Watched files, by canonical path.
+	std::unordered_set<std::string> m_files;
+#ifdef FILE_WATCHER_INOTIFY
+	int m_inotify;
+	// Watched directories, by watch descriptor and by path.
+	std::unordered_map<int, std::string> m_directories;
+	std::unordered_set<std::string> m_watchedDirectories;
+#else
+	std::unordered_map<std::string, std::filesystem::file_time_type> m_modified;
+	std::chrono::steady_clock::time_point m_lastPoll;
+#endif
+
+public:
+	/**
+	 * @brief Throws std::runtime_error if the operating system cannot watch files.
+	 */
+	FileWatcher();
+	~FileWatcher();
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	/**
+	 * @brief Starts watching the file, if it exists and is not already watched.
+	 */
+	void watch(const std::filesystem::path& path);
+
+	/**
+	 * @brief The canonical paths of the watched files written since the last poll, each once.
+	 * Never blocks.
+	 */
+	std::vector<std::string> poll();
+
+	/**
+	 * @brief The path by which the watcher knows the file, for comparing with what poll returns;
+	 * empty if the file does not exist.
+	 */
+	static std::string canonical(const std::filesystem::path& path);
+};
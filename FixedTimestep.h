@@ -0,0 +1,63 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+/**
+ * @brief Turns variable frame times into a whole number of fixed simulation steps. Frame time
+ * accumulates until it covers a step; the remainder carries over, and alpha() says how far the
+ * simulation's latest state is from the next one, for interpolating rendered transforms.
+ *
+ * A frame runs at most maxStepsPerFrame steps. If the simulation cannot keep up (or the
+ * program stalled), the excess time is dropped instead of carried over, so one slow frame
+ * cannot snowball into ever more steps per frame. The simulation then runs slower than real
+ * time, but each step stays exactly step() seconds long.
+ */
+class FixedTimestep {
+private:
+	float_t m_step;
+	uint32_t m_maxStepsPerFrame;
+	float_t m_accumulator;
+	// Simulation time dropped by the catch-up cap, in seconds.
+	double m_droppedTime;
+
+public:
+	/**
+	 * @brief Constructs a timestep that simulates stepsPerSecond steps per second of real time.
+	 */
+	explicit FixedTimestep(float_t stepsPerSecond, uint32_t maxStepsPerFrame = 5) :
+		m_step(1 / stepsPerSecond), m_maxStepsPerFrame(maxStepsPerFrame), m_accumulator(0),
+		m_droppedTime(0) {}
+
+	/**
+	 * @brief The duration of one step, in seconds.
+	 */
+	float_t step() const { return m_step; }
+
+	/**
+	 * @brief Adds a frame's elapsed time and returns the number of steps to simulate for it.
+	 */
+	uint32_t advance(float_t frameSeconds) {
+		m_accumulator += std::max(frameSeconds, float_t(0));
+		uint32_t steps = static_cast<uint32_t>(std::floor(m_accumulator / m_step));
+		if (steps > m_maxStepsPerFrame) {
+			float_t kept = m_maxStepsPerFrame * m_step;
+			m_droppedTime += m_accumulator - kept - std::fmod(m_accumulator, m_step);
+			m_accumulator = kept + std::fmod(m_accumulator, m_step);
+			steps = m_maxStepsPerFrame;
+		}
+		m_accumulator = std::max(m_accumulator - steps * m_step, float_t(0));
+		return steps;
+	}
+
+	/**
+	 * @brief How far between the previous and the current simulation state the present moment
+	 * is, in [0, 1).
+	 */
+	float_t alpha() const { return std::min(m_accumulator / m_step, float_t(1)); }
+
+	/**
+	 * @brief The total simulation time skipped because frames took too long.
+	 */
+	double droppedTime() const { return m_droppedTime; }
+};
@@ -0,0 +1,81 @@
+#include "FrameBuffer.h"
+#include <cstring>
+#include <stdexcept>
+#include <SFML/Graphics.hpp>
+#include "glad.h"
+
+FrameBuffer::FrameBuffer(uint32_t width, uint32_t height)
+	: m_framebuffer(0), m_color(0), m_depth(0), m_width(width), m_height(height) {
+	glGenTextures(1, &m_color);
+	glBindTexture(GL_TEXTURE_2D, m_color);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenRenderbuffers(1, &m_depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_color, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depth);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		glDeleteFramebuffers(1, &m_framebuffer);
+		glDeleteRenderbuffers(1, &m_depth);
+		glDeleteTextures(1, &m_color);
+		throw std::runtime_error("Framebuffer is incomplete");
+	}
+}
+
+FrameBuffer::~FrameBuffer() {
+	glDeleteFramebuffers(1, &m_framebuffer);
+	glDeleteRenderbuffers(1, &m_depth);
+	glDeleteTextures(1, &m_color);
+}
+
+void FrameBuffer::bind() const {
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, m_width, m_height);
+}
+
+void FrameBuffer::unbind() {
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void FrameBuffer::readPixels(std::vector<uint8_t>& pixels) const {
+	size_t rowBytes = static_cast<size_t>(m_width) * 4;
+	pixels.resize(rowBytes * m_height);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+	// OpenGL returns the bottom row first.
+	std::vector<uint8_t> row(rowBytes);
+	for (uint32_t y = 0; y < m_height / 2; y++) {
+		uint8_t* top = &pixels[y * rowBytes];
+		uint8_t* bottom = &pixels[(m_height - 1 - y) * rowBytes];
+		std::memcpy(row.data(), top, rowBytes);
+		std::memcpy(top, bottom, rowBytes);
+		std::memcpy(bottom, row.data(), rowBytes);
+	}
+}
+
+void FrameBuffer::save(const std::string& path) const {
+	std::vector<uint8_t> pixels;
+	readPixels(pixels);
+	// Like a window, the image is opaque, whatever alpha the scene left behind.
+	for (size_t i = 3; i < pixels.size(); i += 4) {
+		pixels[i] = 255;
+	}
+	sf::Image image;
+	image.create(m_width, m_height, pixels.data());
+	if (!image.saveToFile(path)) {
+		throw std::runtime_error("Could not save frame to " + path);
+	}
+}
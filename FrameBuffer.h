@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief An offscreen render target: a framebuffer object with an RGBA8 color texture and a
+ * 24-bit depth buffer. Rendering goes to it while it is bound, and its pixels can be read back
+ * or saved as an image.
+ */
+class FrameBuffer {
+private:
+	uint32_t m_framebuffer;
+	uint32_t m_color;
+	uint32_t m_depth;
+	uint32_t m_width;
+	uint32_t m_height;
+
+public:
+	/**
+	 * @brief Creates the framebuffer. Throws std::runtime_error if the driver cannot render to it.
+	 */
+	FrameBuffer(uint32_t width, uint32_t height);
+	~FrameBuffer();
+
+	FrameBuffer(const FrameBuffer&) = delete;
+	FrameBuffer& operator=(const FrameBuffer&) = delete;
+
+	uint32_t width() const { return m_width; }
+	uint32_t height() const { return m_height; }
+	uint32_t colorTexture() const { return m_color; }
+
+	/**
+	 * @brief Directs rendering to this framebuffer and sets the viewport to cover it.
+	 */
+	void bind() const;
+	/**
+	 * @brief Directs rendering back to the default framebuffer.
+	 */
+	static void unbind();
+
+	/**
+	 * @brief Reads the color buffer as RGBA8 rows, top row first.
+	 */
+	void readPixels(std::vector<uint8_t>& pixels) const;
+
+	/**
+	 * @brief Saves the color buffer in a format chosen by the path's extension (png, bmp, tga,
+	 * or jpg). Throws std::runtime_error if the file cannot be written.
+	 */
+	void save(const std::string& path) const;
+};
@@ -0,0 +1,122 @@
+#include "HeadlessContext.h"
+#include <stdexcept>
+#include "glad.h"
+
+#ifdef HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+namespace {
+	// Every context uses the same display, which is terminated with the last of them.
+	int liveContexts = 0;
+
+	// Prefers Mesa's surfaceless platform, which needs neither a display server nor a GPU.
+	EGLDisplay openDisplay() {
+		auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+			eglGetProcAddress("eglGetPlatformDisplayEXT"));
+		if (getPlatformDisplay != nullptr) {
+			EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+			if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr)) {
+				return display;
+			}
+		}
+		EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+			throw std::runtime_error("Could not initialize an EGL display");
+		}
+		return display;
+	}
+
+	// Terminates the display unless other contexts still use it.
+	void closeDisplay(EGLDisplay display) {
+		if (liveContexts == 0) {
+			eglTerminate(display);
+		}
+	}
+}
+
+HeadlessContext::HeadlessContext() : m_display(nullptr), m_context(nullptr) {
+	EGLDisplay display = openDisplay();
+	m_display = display;
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		closeDisplay(display);
+		throw std::runtime_error("EGL does not support desktop OpenGL");
+	}
+
+	const EGLint configAttributes[] = {
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_SURFACE_TYPE, 0,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint configCount = 0;
+	if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+		closeDisplay(display);
+		throw std::runtime_error("No EGL config supports OpenGL");
+	}
+
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+	if (context == EGL_NO_CONTEXT) {
+		closeDisplay(display);
+		throw std::runtime_error("Could not create an OpenGL 3.3 context with EGL");
+	}
+	m_context = context;
+	// Without a surface, rendering must go to framebuffer objects.
+	if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+		eglDestroyContext(display, context);
+		closeDisplay(display);
+		throw std::runtime_error("Could not make the EGL context current");
+	}
+	if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress))) {
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(display, context);
+		closeDisplay(display);
+		throw std::runtime_error("Could not load OpenGL functions through EGL");
+	}
+	++liveContexts;
+}
+
+HeadlessContext::~HeadlessContext() {
+	if (eglGetCurrentContext() == m_context) {
+		eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	}
+	eglDestroyContext(m_display, m_context);
+	--liveContexts;
+	closeDisplay(m_display);
+}
+
+void HeadlessContext::makeCurrent() {
+	if (!eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, m_context)) {
+		throw std::runtime_error("Could not make the EGL context current");
+	}
+}
+
+#else
+
+HeadlessContext::HeadlessContext() {
+	sf::ContextSettings settings;
+	settings.depthBits = 24;
+	settings.majorVersion = 3;
+	settings.minorVersion = 3;
+	m_context = std::make_unique<sf::Context>(settings, 1, 1);
+	if (!m_context->setActive(true) || !gladLoadGL()) {
+		throw std::runtime_error("Could not create an OpenGL context");
+	}
+}
+
+HeadlessContext::~HeadlessContext() {
+}
+
+void HeadlessContext::makeCurrent() {
+	if (!m_context->setActive(true)) {
+		throw std::runtime_error("Could not make the OpenGL context current");
+	}
+}
+
+#endif
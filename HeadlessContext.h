@@ -0,0 +1,39 @@
+#pragma once
+#include <memory>
+#include <SFML/Window.hpp>
+
+// On Linux the context comes from EGL, which needs no display server; elsewhere it is SFML's
+// hidden context.
+#if defined(__linux__)
+#define HEADLESS_EGL
+#endif
+
+/**
+ * @brief An OpenGL 3.3 context with no window, for rendering offscreen into a FrameBuffer on
+ * machines without a display. On Linux it is a surfaceless EGL context, which Mesa's software
+ * rasterizer (llvmpipe) provides without any GPU; elsewhere it is an SFML context whose window
+ * is never shown. The constructor makes the context current and loads the OpenGL functions,
+ * and throws std::runtime_error if no context can be created. Several contexts may exist at
+ * once; they share no objects.
+ */
+class HeadlessContext {
+private:
+#ifdef HEADLESS_EGL
+	void* m_display;
+	void* m_context;
+#else
+	std::unique_ptr<sf::Context> m_context;
+#endif
+
+public:
+	HeadlessContext();
+	~HeadlessContext();
+
+	HeadlessContext(const HeadlessContext&) = delete;
+	HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+	/**
+	 * @brief Makes the context current on the calling thread again, after another was.
+	 */
+	void makeCurrent();
+};
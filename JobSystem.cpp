@@ -0,0 +1,91 @@
+#include "JobSystem.h"
+#include <algorithm>
+
+JobSystem::JobSystem(size_t workerCount) : m_generation(0), m_stopping(false) {
+	for (size_t i = 0; i < workerCount; i++) {
+		m_workers.emplace_back(&JobSystem::workerLoop, this);
+	}
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+	for (auto& worker : m_workers) {
+		worker.join();
+	}
+}
+
+JobSystem& JobSystem::instance() {
+	static JobSystem pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+	return pool;
+}
+
+void JobSystem::workerLoop() {
+	uint64_t seenGeneration = 0;
+	while (true) {
+		std::shared_ptr<Batch> batch;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [&] { return m_stopping || m_generation != seenGeneration; });
+			if (m_stopping) {
+				return;
+			}
+			seenGeneration = m_generation;
+			batch = m_batch;
+		}
+		runRanges(*batch);
+	}
+}
+
+void JobSystem::runRanges(Batch& batch) {
+	size_t range;
+	while ((range = batch.nextRange.fetch_add(1)) < batch.rangeCount) {
+		size_t begin = range * batch.rangeSize;
+		size_t end = std::min(begin + batch.rangeSize, batch.count);
+		(*batch.job)(begin, end);
+		if (batch.remainingRanges.fetch_sub(1) == 1) {
+			// Take the lock so the notification cannot slip in between the caller's check
+			// and its wait.
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_done.notify_all();
+		}
+	}
+}
+
+void JobSystem::parallelFor(size_t count, size_t minRangeSize,
+	const std::function<void(size_t, size_t)>& job) {
+	if (count == 0) {
+		return;
+	}
+	// Aim for a few ranges per thread so uneven ranges balance out.
+	size_t threads = m_workers.size() + 1;
+	size_t rangeSize = std::max(std::max<size_t>(minRangeSize, 1), (count + threads * 4 - 1) / (threads * 4));
+	size_t rangeCount = (count + rangeSize - 1) / rangeSize;
+	if (rangeCount == 1 || m_workers.empty()) {
+		job(0, count);
+		return;
+	}
+
+	std::lock_guard<std::mutex> submit(m_submitMutex);
+	auto batch = std::make_shared<Batch>();
+	batch->job = &job;
+	batch->count = count;
+	batch->rangeSize = rangeSize;
+	batch->rangeCount = rangeCount;
+	batch->nextRange = 0;
+	batch->remainingRanges = rangeCount;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_batch = batch;
+		++m_generation;
+	}
+	m_wake.notify_all();
+
+	runRanges(*batch);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, [&] { return batch->remainingRanges == 0; });
+}
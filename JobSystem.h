@@ -0,0 +1,63 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief A fixed pool of worker threads that splits loops across the machine's cores.
+ */
+class JobSystem {
+private:
+	// One call to parallelFor. Workers hold a reference to the batch they are working on, so a
+	// late worker can never pick up ranges of a newer batch with an older job.
+	struct Batch {
+		const std::function<void(size_t, size_t)>* job;
+		size_t count;
+		size_t rangeSize;
+		size_t rangeCount;
+		std::atomic<size_t> nextRange;
+		std::atomic<size_t> remainingRanges;
+	};
+
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	std::shared_ptr<Batch> m_batch;
+	uint64_t m_generation;
+	bool m_stopping;
+	// Serializes calls to parallelFor from different threads.
+	std::mutex m_submitMutex;
+
+	void workerLoop();
+	// Runs ranges of the batch until none are left.
+	void runRanges(Batch& batch);
+
+public:
+	/**
+	 * @brief Constructs a pool with the given number of worker threads. The thread calling
+	 * parallelFor also does work, so 0 workers runs everything on the caller.
+	 */
+	explicit JobSystem(size_t workerCount);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	/**
+	 * @brief A shared pool with one worker per hardware thread, minus one for the caller.
+	 */
+	static JobSystem& instance();
+
+	size_t workerCount() const { return m_workers.size(); }
+
+	/**
+	 * @brief Calls job(begin, end) for contiguous ranges covering [0, count), each at least
+	 * minRangeSize long except the last, and returns when every range has finished.
+	 */
+	void parallelFor(size_t count, size_t minRangeSize, const std::function<void(size_t, size_t)>& job);
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include <memory>
+#include "Object3D.h"
+#include "Animation.h"
+#include "KeyframeTrack.h"
+
+/**
+ * @brief Plays a KeyframeTrack on an object. If the animation's duration is longer than the
+ * track, the track loops until the duration ends.
+ */
+class KeyframeAnimation : public Animation {
+private:
+	std::shared_ptr<const KeyframeTrack> m_track;
+
+public:
+	/**
+	 * @brief Constructs an animation that plays the track once.
+	 */
+	KeyframeAnimation(Object3D& object, std::shared_ptr<const KeyframeTrack> track) :
+		Animation(object, track->duration()), m_track(std::move(track)) {}
+
+	KeyframeAnimation(Object3D& object, float_t duration, std::shared_ptr<const KeyframeTrack> track) :
+		Animation(object, duration), m_track(std::move(track)) {}
+
+	void schedule(AnimationEngine& engine, float_t startTime) override {
+		engine.addKeyframeTrack(object(), startTime, duration(), m_track);
+	}
+};
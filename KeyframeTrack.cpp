@@ -0,0 +1,109 @@
+#include "KeyframeTrack.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+void KeyframeChannel::addKey(float_t time, const float_t* value) {
+	if (!times.empty() && time < times.back()) {
+		throw std::invalid_argument("Keyframes must be added in increasing time order");
+	}
+	times.push_back(time);
+	values.insert(values.end(), value, value + components);
+}
+
+uint32_t KeyframeChannel::seek(float_t t, uint32_t cursor) const {
+	uint32_t last = static_cast<uint32_t>(times.size()) - 1;
+	// Playback moved backwards (for example, a looping track wrapped around); start over.
+	if (cursor > last || t < times[cursor]) {
+		cursor = 0;
+	}
+	while (cursor < last && t >= times[cursor + 1]) {
+		++cursor;
+	}
+	return cursor;
+}
+
+void KeyframeChannel::sample(float_t t, uint32_t& cursor, float_t* out) const {
+	uint32_t last = static_cast<uint32_t>(times.size()) - 1;
+	uint32_t i = cursor = seek(t, cursor);
+	const float_t* a = &values[i * components];
+
+	// Before the first key, after the last key, and in step mode, the value is a key's value.
+	if (interpolation == KeyframeInterpolation::STEP || i == last || t <= times[i]) {
+		std::copy(a, a + components, out);
+		return;
+	}
+
+	const float_t* b = &values[(i + 1) * components];
+	float_t s = (t - times[i]) / (times[i + 1] - times[i]);
+	if (interpolation == KeyframeInterpolation::LINEAR) {
+		for (uint8_t c = 0; c < components; c++) {
+			out[c] = a[c] + (b[c] - a[c]) * s;
+		}
+	}
+	else {
+		// Catmull-Rom, using the end keys as their own neighbors.
+		const float_t* p0 = &values[(i > 0 ? i - 1 : i) * components];
+		const float_t* p3 = &values[std::min(i + 2, last) * components];
+		float_t s2 = s * s;
+		float_t s3 = s2 * s;
+		for (uint8_t c = 0; c < components; c++) {
+			out[c] = 0.5f * (2 * a[c] + (b[c] - p0[c]) * s
+				+ (2 * p0[c] - 5 * a[c] + 4 * b[c] - p3[c]) * s2
+				+ (3 * a[c] - p0[c] - 3 * b[c] + p3[c]) * s3);
+		}
+	}
+
+	// Interpolated quaternions are renormalized. addRotationKey keeps consecutive keys in the
+	// same hemisphere, so this takes the short way around.
+	if (components == 4) {
+		float_t length = std::sqrt(out[0] * out[0] + out[1] * out[1] + out[2] * out[2] + out[3] * out[3]);
+		for (uint8_t c = 0; c < 4; c++) {
+			out[c] /= length;
+		}
+	}
+}
+
+void KeyframeTrack::addPositionKey(float_t time, const glm::vec3& position) {
+	float_t value[3] = { position.x, position.y, position.z };
+	m_position.addKey(time, value);
+	m_duration = std::max(m_duration, time);
+}
+
+void KeyframeTrack::addRotationKey(float_t time, const glm::quat& rotation) {
+	float_t value[4] = { rotation.x, rotation.y, rotation.z, rotation.w };
+	if (!m_rotation.empty()) {
+		const float_t* previous = &m_rotation.values[m_rotation.values.size() - 4];
+		float_t dot = previous[0] * value[0] + previous[1] * value[1]
+			+ previous[2] * value[2] + previous[3] * value[3];
+		if (dot < 0) {
+			for (auto& v : value) {
+				v = -v;
+			}
+		}
+	}
+	m_rotation.addKey(time, value);
+	m_duration = std::max(m_duration, time);
+}
+
+void KeyframeTrack::addScaleKey(float_t time, const glm::vec3& scale) {
+	float_t value[3] = { scale.x, scale.y, scale.z };
+	m_scale.addKey(time, value);
+	m_duration = std::max(m_duration, time);
+}
+
+void KeyframeTrack::sample(float_t t, KeyframeCursor& cursor, KeyframeSample& out) const {
+	float_t value[4];
+	if (!m_position.empty()) {
+		m_position.sample(t, cursor.position, value);
+		out.position = glm::vec3(value[0], value[1], value[2]);
+	}
+	if (!m_rotation.empty()) {
+		m_rotation.sample(t, cursor.rotation, value);
+		out.rotation = glm::quat(value[3], value[0], value[1], value[2]);
+	}
+	if (!m_scale.empty()) {
+		m_scale.sample(t, cursor.scale, value);
+		out.scale = glm::vec3(value[0], value[1], value[2]);
+	}
+}
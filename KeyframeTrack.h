@@ -0,0 +1,113 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+/**
+ * @brief How a keyframe channel computes values between two keys.
+ */
+enum class KeyframeInterpolation : uint8_t {
+	// Holds the value of the earlier key until the next key is reached.
+	STEP,
+	LINEAR,
+	// Catmull-Rom spline through the neighboring keys.
+	CUBIC
+};
+
+/**
+ * @brief The keys of one animated attribute. Key times and values are kept in two tightly
+ * packed arrays, with `components` floats per value (3 for vectors, 4 for quaternions).
+ */
+struct KeyframeChannel {
+	std::vector<float_t> times;
+	std::vector<float_t> values;
+	uint8_t components;
+	KeyframeInterpolation interpolation;
+
+	KeyframeChannel(uint8_t components) : components(components),
+		interpolation(KeyframeInterpolation::LINEAR) {}
+
+	size_t keyCount() const { return times.size(); }
+	bool empty() const { return times.empty(); }
+
+	void addKey(float_t time, const float_t* value);
+
+	/**
+	 * @brief Finds the key at or before time t. The search starts from the given cursor, the
+	 * result of the previous call, so sampling a channel forward in time costs amortized O(1)
+	 * per sample instead of a binary search.
+	 */
+	uint32_t seek(float_t t, uint32_t cursor) const;
+
+	/**
+	 * @brief Writes the channel's value at time t to out, updating the cursor.
+	 */
+	void sample(float_t t, uint32_t& cursor, float_t* out) const;
+};
+
+/**
+ * @brief The positions of a track's channels from the previous sample. Each playing instance
+ * of a track owns its own cursor, so one track can be shared by many instances.
+ */
+struct KeyframeCursor {
+	uint32_t position = 0;
+	uint32_t rotation = 0;
+	uint32_t scale = 0;
+};
+
+/**
+ * @brief The transform produced by sampling a KeyframeTrack. Only the channels the track
+ * animates are written.
+ */
+struct KeyframeSample {
+	glm::vec3 position;
+	glm::quat rotation;
+	glm::vec3 scale;
+};
+
+/**
+ * @brief An authored animation of one object's position, rotation, and scale, each given by
+ * its own channel of keys. Tracks are immutable once built and are shared between every
+ * instance that plays them.
+ */
+class KeyframeTrack {
+private:
+	KeyframeChannel m_position;
+	KeyframeChannel m_rotation;
+	KeyframeChannel m_scale;
+	float_t m_duration;
+
+public:
+	KeyframeTrack() : m_position(3), m_rotation(4), m_scale(3), m_duration(0) {}
+
+	/**
+	 * @brief Adds keys to the end of a channel. Keys must be added in increasing time order.
+	 */
+	void addPositionKey(float_t time, const glm::vec3& position);
+	void addRotationKey(float_t time, const glm::quat& rotation);
+	void addScaleKey(float_t time, const glm::vec3& scale);
+
+	void setPositionInterpolation(KeyframeInterpolation interpolation) {
+		m_position.interpolation = interpolation;
+	}
+	void setRotationInterpolation(KeyframeInterpolation interpolation) {
+		m_rotation.interpolation = interpolation;
+	}
+	void setScaleInterpolation(KeyframeInterpolation interpolation) {
+		m_scale.interpolation = interpolation;
+	}
+
+	bool hasPosition() const { return !m_position.empty(); }
+	bool hasRotation() const { return !m_rotation.empty(); }
+	bool hasScale() const { return !m_scale.empty(); }
+
+	/**
+	 * @brief The time of the track's last key.
+	 */
+	float_t duration() const { return m_duration; }
+
+	/**
+	 * @brief Samples every animated channel at time t, which is clamped to the track's keys.
+	 */
+	void sample(float_t t, KeyframeCursor& cursor, KeyframeSample& out) const;
+};
@@ -0,0 +1,132 @@
+#include "KinematicsSystem.h"
+
+#if defined(__AVX2__)
+#define KINEMATICS_AVX2 1
+#include <immintrin.h>
+static_assert(sizeof(float_t) == sizeof(float), "AVX2 integration requires float_t to be float");
+#endif
+
+namespace {
+	// Bodies are processed in groups of this many, so the arrays are padded to a multiple of it.
+	const size_t LANES = 8;
+
+#ifdef KINEMATICS_AVX2
+	// Integrates one axis of eight bodies; returns a bit mask of the bodies whose position changed.
+	inline int integrate8(float_t* p, float_t* v, const float_t* a, __m256 dt) {
+		__m256 velocity = _mm256_add_ps(_mm256_loadu_ps(v), _mm256_mul_ps(_mm256_loadu_ps(a), dt));
+		__m256 position = _mm256_loadu_ps(p);
+		__m256 next = _mm256_add_ps(position, _mm256_mul_ps(velocity, dt));
+		_mm256_storeu_ps(v, velocity);
+		_mm256_storeu_ps(p, next);
+		return _mm256_movemask_ps(_mm256_cmp_ps(next, position, _CMP_NEQ_UQ));
+	}
+#else
+	// Integrates one axis of one body; returns whether its position changed.
+	inline bool integrate1(float_t& p, float_t& v, float_t a, float_t dt) {
+		v += a * dt;
+		float_t next = p + v * dt;
+		bool moved = next != p;
+		p = next;
+		return moved;
+	}
+#endif
+}
+
+void KinematicsSystem::resize(size_t paddedCount) {
+	for (auto* component : { &m_px, &m_py, &m_pz, &m_vx, &m_vy, &m_vz, &m_ax, &m_ay, &m_az,
+		&m_ox, &m_oy, &m_oz, &m_wx, &m_wy, &m_wz, &m_alphaX, &m_alphaY, &m_alphaZ }) {
+		component->resize(paddedCount, 0);
+	}
+	m_dirty.resize(paddedCount, 0);
+}
+
+size_t KinematicsSystem::add(Object3D& object) {
+	size_t body = m_bodyCount++;
+	m_objects.push_back(&object);
+	if (body >= m_px.size()) {
+		resize(m_px.size() + LANES);
+	}
+	setPosition(body, object.getPosition());
+	setVelocity(body, object.getVelocity());
+	setAcceleration(body, object.getAcceleration());
+	const glm::vec3& orientation = object.getOrientation();
+	m_ox[body] = orientation.x;
+	m_oy[body] = orientation.y;
+	m_oz[body] = orientation.z;
+	setRotVelocity(body, object.getRotVelocity());
+	setRotAcceleration(body, object.getRotAcceleration());
+	m_dirty[body] = 0;
+	return body;
+}
+
+void KinematicsSystem::setPosition(size_t body, const glm::vec3& position) {
+	m_px[body] = position.x;
+	m_py[body] = position.y;
+	m_pz[body] = position.z;
+	m_dirty[body] = 1;
+}
+
+void KinematicsSystem::setVelocity(size_t body, const glm::vec3& velocity) {
+	m_vx[body] = velocity.x;
+	m_vy[body] = velocity.y;
+	m_vz[body] = velocity.z;
+}
+
+void KinematicsSystem::setAcceleration(size_t body, const glm::vec3& acceleration) {
+	m_ax[body] = acceleration.x;
+	m_ay[body] = acceleration.y;
+	m_az[body] = acceleration.z;
+}
+
+void KinematicsSystem::setRotVelocity(size_t body, const glm::vec3& rotVelocity) {
+	m_wx[body] = rotVelocity.x;
+	m_wy[body] = rotVelocity.y;
+	m_wz[body] = rotVelocity.z;
+}
+
+void KinematicsSystem::setRotAcceleration(size_t body, const glm::vec3& rotAcceleration) {
+	m_alphaX[body] = rotAcceleration.x;
+	m_alphaY[body] = rotAcceleration.y;
+	m_alphaZ[body] = rotAcceleration.z;
+}
+
+void KinematicsSystem::integrate(float_t dt) {
+	size_t count = m_px.size();
+#ifdef KINEMATICS_AVX2
+	__m256 step = _mm256_set1_ps(dt);
+	for (size_t i = 0; i < count; i += LANES) {
+		int moved = integrate8(&m_px[i], &m_vx[i], &m_ax[i], step)
+			| integrate8(&m_py[i], &m_vy[i], &m_ay[i], step)
+			| integrate8(&m_pz[i], &m_vz[i], &m_az[i], step)
+			| integrate8(&m_ox[i], &m_wx[i], &m_alphaX[i], step)
+			| integrate8(&m_oy[i], &m_wy[i], &m_alphaY[i], step)
+			| integrate8(&m_oz[i], &m_wz[i], &m_alphaZ[i], step);
+		for (size_t lane = 0; moved != 0; lane++, moved >>= 1) {
+			m_dirty[i + lane] |= moved & 1;
+		}
+	}
+#else
+	for (size_t i = 0; i < count; i++) {
+		// Non-short-circuiting | so every axis is integrated.
+		bool moved = integrate1(m_px[i], m_vx[i], m_ax[i], dt)
+			| integrate1(m_py[i], m_vy[i], m_ay[i], dt)
+			| integrate1(m_pz[i], m_vz[i], m_az[i], dt)
+			| integrate1(m_ox[i], m_wx[i], m_alphaX[i], dt)
+			| integrate1(m_oy[i], m_wy[i], m_alphaY[i], dt)
+			| integrate1(m_oz[i], m_wz[i], m_alphaZ[i], dt);
+		m_dirty[i] |= moved;
+	}
+#endif
+}
+
+void KinematicsSystem::apply() {
+	for (size_t i = 0; i < m_bodyCount; i++) {
+		if (!m_dirty[i]) {
+			continue;
+		}
+		m_dirty[i] = 0;
+		// One setter, so the model matrix is rebuilt once per body.
+		m_objects[i]->setKinematicState(position(i), orientation(i), velocity(i),
+			glm::vec3(m_wx[i], m_wy[i], m_wz[i]));
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <vector>
+#include "Object3D.h"
+
+/**
+ * @brief Integrates the velocities and accelerations of many objects at once. Each body's
+ * position, orientation, and their first and second derivatives are stored in one array per
+ * component, so the integrator processes eight bodies per instruction when built with AVX2
+ * (one at a time otherwise), and only the objects that actually moved have their transforms
+ * written back.
+ *
+ * The system takes over the kinematic state of the objects added to it: change velocities and
+ * positions through the system, and do not also call Object3D::tick on those objects. Like
+ * Animations, the system keeps pointers to the objects, so they must not be moved after they
+ * are added.
+ */
+class KinematicsSystem {
+private:
+	std::vector<Object3D*> m_objects;
+	size_t m_bodyCount;
+
+	// Positions, velocities, and accelerations.
+	std::vector<float_t> m_px, m_py, m_pz;
+	std::vector<float_t> m_vx, m_vy, m_vz;
+	std::vector<float_t> m_ax, m_ay, m_az;
+	// Euler orientations, and their angular velocities and accelerations.
+	std::vector<float_t> m_ox, m_oy, m_oz;
+	std::vector<float_t> m_wx, m_wy, m_wz;
+	std::vector<float_t> m_alphaX, m_alphaY, m_alphaZ;
+
+	// Whether each body moved since its object was last written.
+	std::vector<uint8_t> m_dirty;
+
+	void resize(size_t paddedCount);
+
+public:
+	KinematicsSystem() : m_bodyCount(0) {}
+
+	/**
+	 * @brief Adds a body that moves the given object, starting from the object's current
+	 * position, orientation, velocity, and acceleration. Returns the body's index.
+	 */
+	size_t add(Object3D& object);
+
+	size_t numberOfBodies() const { return m_bodyCount; }
+
+	glm::vec3 position(size_t body) const { return glm::vec3(m_px[body], m_py[body], m_pz[body]); }
+	glm::vec3 velocity(size_t body) const { return glm::vec3(m_vx[body], m_vy[body], m_vz[body]); }
+	glm::vec3 acceleration(size_t body) const { return glm::vec3(m_ax[body], m_ay[body], m_az[body]); }
+	glm::vec3 orientation(size_t body) const { return glm::vec3(m_ox[body], m_oy[body], m_oz[body]); }
+
+	void setPosition(size_t body, const glm::vec3& position);
+	void setVelocity(size_t body, const glm::vec3& velocity);
+	void setAcceleration(size_t body, const glm::vec3& acceleration);
+	void setRotVelocity(size_t body, const glm::vec3& rotVelocity);
+	void setRotAcceleration(size_t body, const glm::vec3& rotAcceleration);
+
+	/**
+	 * @brief Advances every body by dt seconds with semi-implicit Euler integration: velocities
+	 * are updated from accelerations first, then positions from the new velocities.
+	 */
+	void integrate(float_t dt);
+
+	/**
+	 * @brief Writes the position and orientation of every body that moved since the last call
+	 * to its object.
+	 */
+	void apply();
+};
@@ -0,0 +1,379 @@
+#include "LazyScene.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include "AssetPackage.h"
+#include "AssimpImport.h"
+#include "MemoryAccounting.h"
+#include "PauseAnimation.h"
+#include "Profiler.h"
+
+LazyScene::LazyScene(SceneDescription description, MeshRetention retention)
+	: m_description(std::move(description)), m_loader(1, 0), m_retention(retention),
+	m_loadDistance(std::numeric_limits<float_t>::infinity()), m_pending(0), m_engine(nullptr) {
+	auto& nodes = m_description.nodes;
+	m_nodes.resize(nodes.size(), Node{ nullptr, nullptr, NodeState::EMPTY, {}, {} });
+	std::vector<size_t> roots;
+	for (size_t i = 0; i < nodes.size(); i++) {
+		if (nodes[i].parent < 0) {
+			roots.push_back(i);
+		}
+		else {
+			m_nodes[nodes[i].parent].children.push_back(i);
+		}
+		if (!nodes[i].model.empty()) {
+			m_nodes[i].state = NodeState::PENDING;
+			m_pending++;
+			m_modelUses[modelKey(nodes[i])]++;
+		}
+	}
+
+	// Build the whole hierarchy before taking any addresses, since building moves objects.
+	for (size_t root : roots) {
+		m_objects.push_back(buildNode(root));
+	}
+	for (size_t i = 0; i < roots.size(); i++) {
+		bindNode(roots[i], m_objects[i]);
+		m_objects[i].savePreviousTransform();
+	}
+
+	for (size_t i = 0; i < nodes.size(); i++) {
+		Animator animator;
+		bool animated = false;
+		for (auto& animation : nodes[i].animations) {
+			Object3D& object = *m_nodes[i].object;
+			switch (animation.type) {
+			case SceneAnimationDescription::ROTATE:
+				animator.addAnimation(std::make_unique<RotationAnimation>(object, animation.duration, animation.amount));
+				break;
+			case SceneAnimationDescription::TRANSLATE:
+				animator.addAnimation(std::make_unique<TranslationAnimation>(object, animation.duration, animation.amount));
+				break;
+			case SceneAnimationDescription::PAUSE:
+				animator.addAnimation(std::make_unique<PauseAnimation>(object, animation.duration));
+				break;
+			case SceneAnimationDescription::CLIP:
+				// Played by startClips once the model has loaded.
+				continue;
+			}
+			animated = true;
+		}
+		if (animated) {
+			m_animators.push_back(std::move(animator));
+		}
+	}
+}
+
+Object3D LazyScene::buildNode(size_t index) {
+	auto& description = m_description.nodes[index];
+	Object3D object(std::vector<Mesh3D>{});
+	object.setName(description.name);
+	object.setTransform(description.position, description.orientation, glm::quat(1, 0, 0, 0), description.scale);
+	if (!description.model.empty()) {
+		object.addChild(Object3D(std::vector<Mesh3D>{}));
+	}
+	for (size_t child : m_nodes[index].children) {
+		object.addChild(buildNode(child));
+	}
+	return object;
+}
+
+void LazyScene::bindNode(size_t index, Object3D& object) {
+	Node& node = m_nodes[index];
+	node.object = &object;
+	size_t next = 0;
+	if (!m_description.nodes[index].model.empty()) {
+		node.content = &object.getChild(next++);
+	}
+	for (size_t child : node.children) {
+		bindNode(child, object.getChild(next++));
+	}
+}
+
+std::string LazyScene::modelKey(const SceneNodeDescription& node) {
+	return node.model + (node.flipTextureCoords ? "|flip" : "");
+}
+
+Object3D* LazyScene::find(const std::string& name) {
+	int32_t index = m_description.find(name);
+	return index < 0 ? nullptr : m_nodes[index].object;
+}
+
+LazyScene::CachedModel& LazyScene::cachedModel(size_t index) {
+	auto& description = m_description.nodes[index];
+	std::string key = modelKey(description);
+	auto cached = m_models.find(key);
+	if (cached == m_models.end()) {
+		CachedModel model{ 0, nullptr, nullptr, {}, m_modelUses[key], description.name,
+			std::numeric_limits<float_t>::infinity() };
+		cached = m_models.emplace(key, std::move(model)).first;
+	}
+	return cached->second;
+}
+
+size_t LazyScene::receiveImports() {
+	size_t failed = 0;
+	for (auto& result : m_loader.collect()) {
+		auto request = m_requests.find(result.id);
+		if (request == m_requests.end()) {
+			continue;
+		}
+		std::string key = request->second;
+		m_requests.erase(request);
+		auto cached = m_models.find(key);
+		if (cached == m_models.end() || cached->second.request != result.id) {
+			// loadAll loaded the model while it was importing.
+			continue;
+		}
+		CachedModel& model = cached->second;
+		model.request = 0;
+		if (result.model == nullptr) {
+			failed += failModel(key, result.error);
+			continue;
+		}
+		model.upload = std::make_unique<ModelUpload>(std::move(*result.model), m_retention);
+	}
+	return failed;
+}
+
+void LazyScene::finishUpload(CachedModel& model) {
+	model.clips = model.upload->model().animations;
+	model.prototype = std::make_unique<Object3D>(model.upload->finish());
+	model.upload.reset();
+}
+
+void LazyScene::loadModelNow(size_t index) {
+	PROFILE_SCOPE("LazyScene::loadModelNow");
+	CachedModel& model = cachedModel(index);
+	if (model.prototype != nullptr) {
+		return;
+	}
+	MemoryTag tag(model.name);
+	if (model.upload != nullptr) {
+		while (!model.upload->done()) {
+			model.upload->uploadNext();
+		}
+		finishUpload(model);
+		return;
+	}
+	if (model.request != 0) {
+		// Superseded; if the import has started, its result is ignored when it arrives.
+		if (m_loader.cancel(model.request)) {
+			m_requests.erase(model.request);
+		}
+		model.request = 0;
+	}
+	auto& description = m_description.nodes[index];
+	model.prototype = std::make_unique<Object3D>(
+		assimpLoad(description.model, description.flipTextureCoords, model.clips, m_retention));
+}
+
+void LazyScene::placeNode(size_t index) {
+	Node& node = m_nodes[index];
+	auto& description = m_description.nodes[index];
+	auto cached = m_models.find(modelKey(description));
+	CachedModel& model = cached->second;
+	bool playsClips = std::any_of(description.animations.begin(), description.animations.end(),
+		[](auto& a) { return a.type == SceneAnimationDescription::CLIP; });
+	if (playsClips) {
+		node.clips = model.clips;
+	}
+	if (--model.remainingUses == 0) {
+		// The last node to use the model takes it instead of copying it.
+		*node.content = std::move(*model.prototype);
+		m_models.erase(cached);
+	}
+	else {
+		*node.content = *model.prototype;
+	}
+	node.content->savePreviousTransform();
+	node.state = NodeState::LOADED;
+	m_pending--;
+
+	startClips(index);
+	if (m_onLoaded) {
+		m_onLoaded(*node.content);
+	}
+}
+
+size_t LazyScene::failModel(const std::string& key, const std::string& error) {
+	size_t failed = 0;
+	for (size_t i = 0; i < m_nodes.size(); i++) {
+		auto& description = m_description.nodes[i];
+		if (m_nodes[i].state == NodeState::PENDING && modelKey(description) == key) {
+			std::cerr << "Could not load " << description.model << " for " << description.name << ": " << error << std::endl;
+			m_nodes[i].state = NodeState::FAILED;
+			m_pending--;
+			failed++;
+		}
+	}
+	auto cached = m_models.find(key);
+	if (cached != m_models.end()) {
+		if (cached->second.request != 0 && m_loader.cancel(cached->second.request)) {
+			m_requests.erase(cached->second.request);
+		}
+		m_models.erase(cached);
+	}
+	return failed;
+}
+
+void LazyScene::startClips(size_t index) {
+	Node& node = m_nodes[index];
+	if (m_engine == nullptr || node.state != NodeState::LOADED) {
+		return;
+	}
+	Animator animator;
+	for (auto& animation : m_description.nodes[index].animations) {
+		if (animation.type != SceneAnimationDescription::CLIP) {
+			continue;
+		}
+		auto clip = std::find_if(node.clips.begin(), node.clips.end(),
+			[&](auto& c) { return animation.clip.empty() || c->name == animation.clip; });
+		if (clip == node.clips.end()) {
+			std::cerr << "No clip " << (animation.clip.empty() ? "at all" : animation.clip) << " in "
+				<< m_description.nodes[index].model << std::endl;
+			continue;
+		}
+		animator.addAnimation(std::make_unique<ClipAnimation>(*node.content, animation.duration, *clip));
+	}
+	animator.start(*m_engine);
+	node.clips.clear();
+}
+
+void LazyScene::start(AnimationEngine& engine) {
+	m_engine = &engine;
+	for (auto& animator : m_animators) {
+		animator.start(engine);
+	}
+	for (size_t i = 0; i < m_nodes.size(); i++) {
+		startClips(i);
+	}
+}
+
+size_t LazyScene::update(const glm::vec3& cameraPosition, float_t budgetSeconds) {
+	if (m_pending == 0) {
+		return 0;
+	}
+	PROFILE_SCOPE("LazyScene::update");
+	auto begin = std::chrono::steady_clock::now();
+	auto spent = [&] {
+		return std::chrono::duration<float_t>(std::chrono::steady_clock::now() - begin).count() >= budgetSeconds;
+	};
+	size_t loaded = receiveImports();
+
+	// Nodes follow their parents, so each world matrix can build on its parent's.
+	auto& nodes = m_description.nodes;
+	std::vector<glm::mat4> world(nodes.size());
+	std::vector<std::pair<float_t, size_t>> candidates;
+	for (size_t i = 0; i < nodes.size(); i++) {
+		const glm::mat4& local = m_nodes[i].object->getModelMatrix();
+		world[i] = nodes[i].parent < 0 ? local : world[nodes[i].parent] * local;
+		if (m_nodes[i].state == NodeState::PENDING) {
+			float_t distance = glm::length(glm::vec3(world[i][3]) - cameraPosition) - nodes[i].radius;
+			if (distance <= m_loadDistance) {
+				candidates.emplace_back(distance, i);
+			}
+		}
+	}
+	std::sort(candidates.begin(), candidates.end());
+
+	// Fill in the nodes whose models are ready, and request the rest, nearest first.
+	for (auto& [key, model] : m_models) {
+		model.distance = std::numeric_limits<float_t>::infinity();
+	}
+	bool worked = false;
+	for (auto& [distance, index] : candidates) {
+		if (m_nodes[index].state != NodeState::PENDING) {
+			continue;
+		}
+		auto& description = nodes[index];
+		std::string key = modelKey(description);
+		CachedModel& model = cachedModel(index);
+		model.distance = std::min(model.distance, distance);
+		if (model.prototype != nullptr) {
+			placeNode(index);
+			loaded++;
+		}
+		else if (model.request == 0 && model.upload == nullptr) {
+			if (findPackagedModel(description.model, description.flipTextureCoords) == nullptr) {
+				model.request = m_loader.request(description.model, description.flipTextureCoords, distance);
+				m_requests[model.request] = key;
+			}
+			else if (!worked || !spent()) {
+				// Packaged models are ready to upload, so they load here, within the budget.
+				worked = true;
+				try {
+					loadModelNow(index);
+				}
+				catch (std::runtime_error& e) {
+					loaded += failModel(key, e.what());
+					continue;
+				}
+				placeNode(index);
+				loaded++;
+			}
+		}
+	}
+	for (auto& [key, model] : m_models) {
+		if (model.request != 0) {
+			m_loader.setPriority(model.request, model.distance);
+		}
+	}
+
+	// Upload the imported models, nearest first, a part at a time.
+	std::vector<std::pair<float_t, std::string>> uploading;
+	for (auto& [key, model] : m_models) {
+		if (model.upload != nullptr) {
+			uploading.emplace_back(model.distance, key);
+		}
+	}
+	std::sort(uploading.begin(), uploading.end());
+	for (auto& [distance, key] : uploading) {
+		if (worked && spent()) {
+			break;
+		}
+		CachedModel& model = m_models.at(key);
+		try {
+			PROFILE_SCOPE("LazyScene::upload");
+			MemoryTag tag(model.name);
+			while (!model.upload->done() && (!worked || !spent())) {
+				model.upload->uploadNext();
+				worked = true;
+			}
+			if (!model.upload->done()) {
+				break;
+			}
+			finishUpload(model);
+		}
+		catch (std::runtime_error& e) {
+			loaded += failModel(key, e.what());
+			continue;
+		}
+		// Fill in the nodes in range that were waiting for it; nodes out of range wait for the
+		// camera, with the model kept for them.
+		for (auto& [nodeDistance, index] : candidates) {
+			if (m_nodes[index].state == NodeState::PENDING && modelKey(nodes[index]) == key) {
+				placeNode(index);
+				loaded++;
+			}
+		}
+	}
+	return loaded;
+}
+
+void LazyScene::loadAll() {
+	for (size_t i = 0; i < m_nodes.size(); i++) {
+		if (m_nodes[i].state != NodeState::PENDING) {
+			continue;
+		}
+		try {
+			loadModelNow(i);
+		}
+		catch (std::runtime_error& e) {
+			failModel(modelKey(m_description.nodes[i]), e.what());
+			continue;
+		}
+		placeNode(i);
+	}
+}
@@ -0,0 +1,162 @@
+#pragma once
+#include <functional>
+#include <limits>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "AnimationClip.h"
+#include "AnimationEngine.h"
+#include "Animator.h"
+#include "AssimpImport.h"
+#include "AsyncModelLoader.h"
+#include "MeshData.h"
+#include "Object3D.h"
+#include "SceneFile.h"
+
+/**
+ * @brief A scene built from a SceneDescription whose models load on demand, nearest to the
+ * camera first, so the scene can render before all of its assets have loaded.
+ *
+ * Every node of the description becomes an object as soon as the scene is constructed, with its
+ * transform, children, and animators, so the hierarchy can be animated and rendered at once.
+ * A node with a model gets an empty first child that the model replaces when it loads; objects
+ * never move in memory, so references to them stay valid as models arrive. A model file used by
+ * several nodes is imported once, and its meshes are shared.
+ *
+ * Models are imported on a background thread, nearest first, and update uploads them a texture or
+ * mesh at a time on the thread that owns the OpenGL context, within a time budget per call.
+ * Models mounted from an AssetPackage need no import and are loaded whole by update. Clip
+ * animations start when their node's model loads.
+ */
+class LazyScene {
+public:
+	enum class NodeState {
+		// The node has no model.
+		EMPTY,
+		PENDING,
+		LOADED,
+		FAILED
+	};
+
+private:
+	struct Node {
+		Object3D* object;
+		// The child holding the model, or nullptr if the node has none.
+		Object3D* content;
+		NodeState state;
+		std::vector<size_t> children;
+		// The clips imported with the model, kept until the node's clip animations start.
+		std::vector<std::shared_ptr<AnimationClip>> clips;
+	};
+
+	// A model for one or more nodes; dropped once every node using it has loaded.
+	struct CachedModel {
+		// The import request while the model is being imported, else 0.
+		uint64_t request;
+		// The upload once the import has arrived, until the model is built.
+		std::unique_ptr<ModelUpload> upload;
+		// The model's objects once it is loaded.
+		std::unique_ptr<Object3D> prototype;
+		std::vector<std::shared_ptr<AnimationClip>> clips;
+		size_t remainingUses;
+		// Which node's name tags the model's memory.
+		std::string name;
+		// The distance of the nearest node waiting for the model, as of the last update.
+		float_t distance;
+	};
+
+	SceneDescription m_description;
+	std::vector<Object3D> m_objects;
+	std::vector<Node> m_nodes;
+	std::vector<Animator> m_animators;
+	std::unordered_map<std::string, CachedModel> m_models;
+	AsyncModelLoader m_loader;
+	// The model each import request is for.
+	std::unordered_map<uint64_t, std::string> m_requests;
+	// How many nodes use each model file.
+	std::unordered_map<std::string, size_t> m_modelUses;
+	MeshRetention m_retention;
+	float_t m_loadDistance;
+	size_t m_pending;
+	AnimationEngine* m_engine;
+	std::function<void(Object3D&)> m_onLoaded;
+
+	// Builds the object for a node and, recursively, its children.
+	Object3D buildNode(size_t index);
+	// Records the address of each node's object once the hierarchy is in place.
+	void bindNode(size_t index, Object3D& object);
+	static std::string modelKey(const SceneNodeDescription& node);
+	// The cached model of a node, added if the node is the first to need it.
+	CachedModel& cachedModel(size_t index);
+	// Moves finished imports on to uploading, failing the nodes whose import failed. Returns how
+	// many nodes failed.
+	size_t receiveImports();
+	// Builds a model whose upload is done.
+	void finishUpload(CachedModel& model);
+	// Imports and uploads a node's model at once, unless it is already loaded.
+	void loadModelNow(size_t index);
+	// Copies a node's loaded model from the cache into the node's content child.
+	void placeNode(size_t index);
+	// Marks the pending nodes using a model that could not be loaded, and drops the model.
+	// Returns how many nodes failed.
+	size_t failModel(const std::string& key, const std::string& error);
+	// Plays the node's clip animations, once both its model and the engine are available.
+	void startClips(size_t index);
+
+public:
+	/**
+	 * @brief Builds the scene's objects and animators, without loading any models. Meshes are
+	 * loaded with the given retention policy.
+	 */
+	explicit LazyScene(SceneDescription description, MeshRetention retention = MeshRetention::DISCARD);
+
+	LazyScene(const LazyScene&) = delete;
+	LazyScene& operator=(const LazyScene&) = delete;
+
+	const SceneDescription& description() const { return m_description; }
+
+	/**
+	 * @brief The scene's root objects. The vector never changes size.
+	 */
+	std::vector<Object3D>& objects() { return m_objects; }
+
+	/**
+	 * @brief The object of the node with the given name, or nullptr if there is none.
+	 */
+	Object3D* find(const std::string& name);
+
+	NodeState state(size_t node) const { return m_nodes[node].state; }
+	size_t pendingCount() const { return m_pending; }
+
+	/**
+	 * @brief Models farther than this from the camera, less their nodes' radii, are not loaded.
+	 * Unlimited by default.
+	 */
+	void setLoadDistance(float_t distance) { m_loadDistance = distance; }
+
+	/**
+	 * @brief Called with each model's object when it loads, to register it with the systems that
+	 * need to know about it, such as skinning and collisions.
+	 */
+	void setOnLoaded(std::function<void(Object3D&)> onLoaded) { m_onLoaded = std::move(onLoaded); }
+
+	/**
+	 * @brief Starts the scene's animators on the engine, which also plays clip animations as
+	 * their models load.
+	 */
+	void start(AnimationEngine& engine);
+
+	/**
+	 * @brief Requests imports of the pending models in range, nearest first, and uploads imported
+	 * ones until the budget, in seconds, is spent; at least one part is uploaded if any is waiting.
+	 * Nodes whose models have loaded are filled in. Returns how many nodes loaded or failed.
+	 */
+	size_t update(const glm::vec3& cameraPosition, float_t budgetSeconds);
+
+	/**
+	 * @brief Loads every pending model at once, regardless of distance, importing on the calling
+	 * thread any that have not arrived from the background thread yet.
+	 */
+	void loadAll();
+};
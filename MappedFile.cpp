@@ -0,0 +1,87 @@
+#include "MappedFile.h"
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+MappedFile::MappedFile(const std::filesystem::path& path) : m_data(nullptr), m_size(0),
+	m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr) {
+	m_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Could not open file for mapping: " + path.string());
+	}
+	LARGE_INTEGER size;
+	GetFileSizeEx(m_file, &size);
+	m_size = static_cast<size_t>(size.QuadPart);
+	if (m_size == 0) {
+		return;
+	}
+	m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mapping != nullptr) {
+		m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	}
+	if (m_data == nullptr) {
+		close();
+		throw std::runtime_error("Could not map file: " + path.string());
+	}
+}
+
+void MappedFile::close() {
+	if (m_data != nullptr) {
+		UnmapViewOfFile(m_data);
+	}
+	if (m_mapping != nullptr) {
+		CloseHandle(m_mapping);
+	}
+	if (m_file != INVALID_HANDLE_VALUE) {
+		CloseHandle(m_file);
+	}
+	m_data = nullptr;
+	m_mapping = nullptr;
+	m_file = INVALID_HANDLE_VALUE;
+}
+
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::filesystem::path& path) : m_data(nullptr), m_size(0) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error("Could not open file for mapping: " + path.string());
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		::close(fd);
+		throw std::runtime_error("Could not read size of file: " + path.string());
+	}
+	m_size = static_cast<size_t>(info.st_size);
+	if (m_size > 0) {
+		void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED) {
+			::close(fd);
+			throw std::runtime_error("Could not map file: " + path.string());
+		}
+		m_data = static_cast<const uint8_t*>(data);
+	}
+	// The mapping keeps the file's pages available after the descriptor is closed.
+	::close(fd);
+}
+
+void MappedFile::close() {
+	if (m_data != nullptr) {
+		munmap(const_cast<uint8_t*>(m_data), m_size);
+	}
+	m_data = nullptr;
+}
+
+#endif
+
+MappedFile::~MappedFile() {
+	close();
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+/**
+ * @brief A file mapped read-only into the address space. Its pages are loaded by the operating
+ * system when first touched, and can be dropped and reloaded from the file under memory
+ * pressure, so mapped data does not count against the process's private memory.
+ */
+class MappedFile {
+private:
+	const uint8_t* m_data;
+	size_t m_size;
+#ifdef _WIN32
+	void* m_file;
+	void* m_mapping;
+#endif
+
+	void close();
+
+public:
+	/**
+	 * @brief Maps the whole file at the given path; throws std::runtime_error if it cannot.
+	 */
+	explicit MappedFile(const std::filesystem::path& path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const uint8_t* data() const { return m_data; }
+	size_t size() const { return m_size; }
+};
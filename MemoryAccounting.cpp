@@ -0,0 +1,106 @@
+#include "MemoryAccounting.h"
+#include <iomanip>
+
+namespace {
+	thread_local std::string currentTag = "untagged";
+
+	double megabytes(size_t bytes) {
+		return bytes / (1024.0 * 1024.0);
+	}
+
+	void printUsage(std::ostream& out, const std::string& label, const MemoryUsage& usage) {
+		out << "  " << std::left << std::setw(24) << label << std::right << std::fixed << std::setprecision(2)
+			<< " cpu " << std::setw(9) << megabytes(usage.cpuBytes) << " MB"
+			<< "  gpu " << std::setw(9) << megabytes(usage.gpuBytes) << " MB"
+			<< "  mapped " << std::setw(9) << megabytes(usage.mappedBytes) << " MB\n";
+	}
+}
+
+MemoryAccounting& MemoryAccounting::instance() {
+	static MemoryAccounting accounting;
+	return accounting;
+}
+
+uint64_t MemoryAccounting::add(const std::string& kind, const std::string& name, const MemoryUsage& usage) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	uint64_t id = m_nextId++;
+	m_records.emplace(id, Record{ kind, name, MemoryTag::current(), usage });
+	return id;
+}
+
+void MemoryAccounting::update(uint64_t id, const MemoryUsage& usage) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto record = m_records.find(id);
+	if (record != m_records.end()) {
+		record->second.usage = usage;
+	}
+}
+
+void MemoryAccounting::rename(uint64_t id, const std::string& name) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto record = m_records.find(id);
+	if (record != m_records.end()) {
+		record->second.name = name;
+	}
+}
+
+void MemoryAccounting::remove(uint64_t id) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_records.erase(id);
+}
+
+std::unordered_map<uint64_t, MemoryAccounting::Record> MemoryAccounting::records() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_records;
+}
+
+MemoryUsage MemoryAccounting::total() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	MemoryUsage total;
+	for (auto& record : m_records) {
+		total += record.second.usage;
+	}
+	return total;
+}
+
+std::map<std::string, MemoryUsage> MemoryAccounting::byTag() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::map<std::string, MemoryUsage> totals;
+	for (auto& record : m_records) {
+		totals[record.second.tag] += record.second.usage;
+	}
+	return totals;
+}
+
+std::map<std::string, MemoryUsage> MemoryAccounting::byKind() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::map<std::string, MemoryUsage> totals;
+	for (auto& record : m_records) {
+		totals[record.second.kind] += record.second.usage;
+	}
+	return totals;
+}
+
+void MemoryAccounting::report(std::ostream& out) const {
+	out << "Memory by tag:\n";
+	for (auto& tag : byTag()) {
+		printUsage(out, tag.first, tag.second);
+	}
+	out << "Memory by kind:\n";
+	for (auto& kind : byKind()) {
+		printUsage(out, kind.first, kind.second);
+	}
+	printUsage(out, "total", total());
+}
+
+MemoryTag::MemoryTag(const std::string& tag) : m_previous(currentTag) {
+	currentTag = tag;
+}
+
+MemoryTag::~MemoryTag() {
+	currentTag = m_previous;
+}
+
+const std::string& MemoryTag::current() {
+	return currentTag;
+}
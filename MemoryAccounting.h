@@ -0,0 +1,95 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @brief Bytes used by a resource or a group of resources. Mapped bytes are file-backed pages
+ * that the operating system can reclaim, so they are kept apart from CPU (heap) bytes.
+ */
+struct MemoryUsage {
+	size_t cpuBytes;
+	size_t gpuBytes;
+	size_t mappedBytes;
+
+	MemoryUsage() : cpuBytes(0), gpuBytes(0), mappedBytes(0) {}
+	MemoryUsage(size_t cpu, size_t gpu, size_t mapped = 0) : cpuBytes(cpu), gpuBytes(gpu), mappedBytes(mapped) {}
+
+	MemoryUsage& operator+=(const MemoryUsage& other) {
+		cpuBytes += other.cpuBytes;
+		gpuBytes += other.gpuBytes;
+		mappedBytes += other.mappedBytes;
+		return *this;
+	}
+};
+
+/**
+ * @brief Keeps track of the memory used by every mesh and texture. Each resource is recorded
+ * with a kind ("mesh", "texture"), a name, and the MemoryTag active on the thread that created
+ * it, so usage can be reported per resource, per kind, and per tag (for example, per scene).
+ */
+class MemoryAccounting {
+public:
+	struct Record {
+		std::string kind;
+		std::string name;
+		std::string tag;
+		MemoryUsage usage;
+	};
+
+private:
+	mutable std::mutex m_mutex;
+	std::unordered_map<uint64_t, Record> m_records;
+	uint64_t m_nextId;
+
+	MemoryAccounting() : m_nextId(1) {}
+
+public:
+	static MemoryAccounting& instance();
+
+	/**
+	 * @brief Records a resource under the current MemoryTag, returning its id.
+	 */
+	uint64_t add(const std::string& kind, const std::string& name, const MemoryUsage& usage);
+	void update(uint64_t id, const MemoryUsage& usage);
+	void rename(uint64_t id, const std::string& name);
+	void remove(uint64_t id);
+
+	/**
+	 * @brief A copy of every record, keyed by id.
+	 */
+	std::unordered_map<uint64_t, Record> records() const;
+
+	MemoryUsage total() const;
+	std::map<std::string, MemoryUsage> byTag() const;
+	std::map<std::string, MemoryUsage> byKind() const;
+
+	/**
+	 * @brief Prints the totals per tag and kind.
+	 */
+	void report(std::ostream& out) const;
+};
+
+/**
+ * @brief While in scope, attributes the resources created on this thread to the given tag.
+ * Tags nest; the innermost one applies.
+ */
+class MemoryTag {
+private:
+	std::string m_previous;
+
+public:
+	explicit MemoryTag(const std::string& tag);
+	~MemoryTag();
+
+	MemoryTag(const MemoryTag&) = delete;
+	MemoryTag& operator=(const MemoryTag&) = delete;
+
+	/**
+	 * @brief The innermost tag on this thread, or "untagged".
+	 */
+	static const std::string& current();
+};
@@ -2,7 +2,10 @@
 #include <iostream>
 #include "Mesh3D.h"
 #include "glad.h"
-#include <GL/GL.h>
+#include "MemoryAccounting.h"
+#include "Profiler.h"
+#include "RenderStats.h"
+#include "ShaderVariants.h"
 
 using std::vector;
 using sf::Color;
@@ -11,67 +14,289 @@ using glm::mat4;
 using glm::vec4;
 
 Mesh3D::Mesh3D(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces,
-	Texture texture) 
-	: Mesh3D(std::move(vertices), std::move(faces), std::vector<Texture>{texture}) {
+	Texture texture, MeshRetention retention) 
+	: Mesh3D(std::move(vertices), std::move(faces), std::vector<Texture>{texture}, retention) {
 }
 
-Mesh3D::Mesh3D(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces, std::vector<Texture>&& textures)
- : m_vertexCount(vertices.size()), m_faceCount(faces.size()), m_textures(textures) {
+Mesh3D::Mesh3D(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces, std::vector<Texture>&& textures,
+	MeshRetention retention)
+ : m_textures(textures), m_paletteBuffer(0), m_paletteOffset(0), m_paletteSize(0) {
+	upload(vertices.data(), vertices.size(), sizeof(Vertex3D), faces, nullptr, retention);
+}
+
+Mesh3D::Mesh3D(std::vector<SkinnedVertex3D>&& vertices, std::vector<uint32_t>&& faces,
+	std::vector<Texture>&& textures, std::shared_ptr<const Skin> skin, MeshRetention retention)
+	: m_textures(textures), m_paletteBuffer(0), m_paletteOffset(0), m_paletteSize(0) {
+	upload(vertices.data(), vertices.size(), sizeof(SkinnedVertex3D), faces, std::move(skin), retention);
+}
+
+Mesh3D::Mesh3D(const void* vertices, size_t vertexCount, const uint32_t* faces, size_t faceCount,
+	const AABB& bounds, std::shared_ptr<const TriangleBVH> bvh, std::vector<Texture>&& textures,
+	std::shared_ptr<const Skin> skin, MeshRetention retention)
+	: m_textures(std::move(textures)), m_paletteBuffer(0), m_paletteOffset(0), m_paletteSize(0) {
+	m_geometry = std::make_shared<Geometry>();
+	Geometry& geometry = *m_geometry;
+	geometry.skin = std::move(skin);
+	geometry.vertexCount = vertexCount;
+	geometry.vertexStride = geometry.skin != nullptr ? sizeof(SkinnedVertex3D) : sizeof(Vertex3D);
+	geometry.faceCount = faceCount;
+	geometry.bounds = bounds;
+	geometry.bvh = std::move(bvh);
+	if (retention != MeshRetention::DISCARD) {
+		geometry.cpuData = std::make_unique<MeshData>(retention, vertices, vertexCount, geometry.vertexStride,
+			std::vector<uint32_t>(faces, faces + faceCount), bounds);
+	}
+	createBuffers(vertices, faces);
+	recordMemory();
+}
+
+namespace {
+	// Advanced by Mesh3D::contextLost.
+	uint32_t currentContextGeneration = 0;
+}
+
+Mesh3D::Geometry::Geometry() : vao(0), vbo(0), ebo(0), vertexCount(0), vertexStride(0), faceCount(0),
+	memoryRecord(0), contextGeneration(currentContextGeneration) {}
+
+Mesh3D::Geometry::~Geometry() {
+	// Names from a lost context may now belong to other objects.
+	if (contextGeneration == currentContextGeneration) {
+		glDeleteBuffers(1, &vbo);
+		glDeleteBuffers(1, &ebo);
+		glDeleteVertexArrays(1, &vao);
+	}
+	MemoryAccounting::instance().remove(memoryRecord);
+}
+
+void Mesh3D::upload(const void* vertices, size_t vertexCount, size_t vertexStride,
+	const std::vector<uint32_t>& faces, std::shared_ptr<const Skin> skin, MeshRetention retention) {
+	m_geometry = std::make_shared<Geometry>();
+	Geometry& geometry = *m_geometry;
+	geometry.skin = std::move(skin);
+	geometry.vertexCount = vertexCount;
+	geometry.vertexStride = vertexStride;
+	geometry.faceCount = faces.size();
+
+	// Every vertex type begins with a Vertex3D, whose first three floats are the position.
+	auto* bytes = static_cast<const uint8_t*>(vertices);
+	for (size_t i = 0; i < vertexCount; i++) {
+		auto* v = reinterpret_cast<const Vertex3D*>(bytes + i * vertexStride);
+		geometry.bounds.expand(glm::vec3(v->x, v->y, v->z));
+	}
+	if (retention != MeshRetention::DISCARD) {
+		geometry.cpuData = std::make_unique<MeshData>(retention, vertices, vertexCount, vertexStride,
+			faces, geometry.bounds);
+	}
+
+	createBuffers(vertices, faces.data());
+	recordMemory();
+}
+
+MemoryUsage Mesh3D::memoryUsage() const {
+	const Geometry& geometry = *m_geometry;
+	MemoryUsage usage(geometry.bvh != nullptr ? geometry.bvh->byteSize() : 0,
+		geometry.vertexCount * geometry.vertexStride + geometry.faceCount * sizeof(uint32_t));
+	if (geometry.cpuData != nullptr) {
+		usage.cpuBytes += geometry.cpuData->residentBytes();
+		usage.mappedBytes = geometry.cpuData->mappedBytes();
+	}
+	return usage;
+}
+
+void Mesh3D::recordMemory() {
+	m_geometry->memoryRecord = MemoryAccounting::instance().add("mesh", "", memoryUsage());
+}
+
+void Mesh3D::createBuffers(const void* vertices, const uint32_t* faces) {
+	Geometry& geometry = *m_geometry;
+	size_t vertexStride = geometry.vertexStride;
 
 	// Generate a vertex array object on the GPU.
-	glGenVertexArrays(1, &m_vao);
+	glGenVertexArrays(1, &geometry.vao);
 	// "Bind" the newly-generated vao, which makes future functions operate on that specific object.
-	glBindVertexArray(m_vao);
+	glBindVertexArray(geometry.vao);
 
 	// Generate a vertex buffer object on the GPU.
-	uint32_t vbo;
-	glGenBuffers(1, &vbo);
+	glGenBuffers(1, &geometry.vbo);
 
 	// "Bind" the newly-generated vbo, which makes future functions operate on that specific object.
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	// This vbo is now associated with m_vao.
+	glBindBuffer(GL_ARRAY_BUFFER, geometry.vbo);
+	// This vbo is now associated with the vao.
 	// Copy the contents of the vertices list to the buffer that lives on the GPU.
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex3D), &vertices[0], GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, geometry.vertexCount * vertexStride, vertices, GL_STATIC_DRAW);
+	RENDER_STATS_ADD(bufferBytesUploaded, geometry.vertexCount * vertexStride);
 
 	// Inform OpenGL how to interpret the buffer. Each vertex now has TWO attributes; a position and a color.
 	// Atrribute 0 is position: 3 contiguous floats (x/y/z)...
-	glVertexAttribPointer(0, 3, GL_FLOAT, false, sizeof(Vertex3D), 0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, false, vertexStride, 0);
 	glEnableVertexAttribArray(0);
 
 	// Attribute 1 is normal (nx, ny, nz): 3 contiguous floats, starting 12 bytes after the beginning of the vertex.
-	glVertexAttribPointer(1, 3, GL_FLOAT, false, sizeof(Vertex3D), (void*)12);
+	glVertexAttribPointer(1, 3, GL_FLOAT, false, vertexStride, (void*)12);
 	glEnableVertexAttribArray(1);
 
 	// Attribute 2 is texture coordinates (u, v): 2 contiguous floats, starting 24 bytes after the beginning of the vertex.
-	glVertexAttribPointer(2, 2, GL_FLOAT, false, sizeof(Vertex3D), (void*)24);
+	glVertexAttribPointer(2, 2, GL_FLOAT, false, vertexStride, (void*)24);
 	glEnableVertexAttribArray(2);
 
+	if (m_geometry->skin != nullptr) {
+		// Attribute 3 is the joint indices: 4 unsigned bytes, read as integers, starting 32 bytes
+		// after the beginning of the vertex.
+		glVertexAttribIPointer(3, 4, GL_UNSIGNED_BYTE, vertexStride, (void*)32);
+		glEnableVertexAttribArray(3);
+
+		// Attribute 4 is the joint weights: 4 unsigned bytes, normalized to [0, 1], starting 36 bytes
+		// after the beginning of the vertex.
+		glVertexAttribPointer(4, 4, GL_UNSIGNED_BYTE, true, vertexStride, (void*)36);
+		glEnableVertexAttribArray(4);
+	}
+
 	// Generate a second buffer, to store the indices of each triangle in the mesh.
-	uint32_t ebo;
-	glGenBuffers(1, &ebo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, faces.size() * sizeof(uint32_t), &faces[0], GL_STATIC_DRAW);
+	glGenBuffers(1, &geometry.ebo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry.ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, geometry.faceCount * sizeof(uint32_t), faces, GL_STATIC_DRAW);
+	RENDER_STATS_ADD(bufferBytesUploaded, geometry.faceCount * sizeof(uint32_t));
 
 	// Unbind the vertex array, so no one else can accidentally mess with it.
 	glBindVertexArray(0);
 }
 
+void Mesh3D::readCpuData(std::vector<uint8_t>& vertices, std::vector<uint32_t>& faces) const {
+	if (m_geometry->cpuData == nullptr) {
+		throw std::runtime_error("Mesh data was discarded after upload");
+	}
+	m_geometry->cpuData->read(vertices, faces);
+}
+
+void Mesh3D::readBuffers(std::vector<uint8_t>& vertices, std::vector<uint32_t>& faces) const {
+	const Geometry& geometry = *m_geometry;
+	vertices.resize(geometry.vertexCount * geometry.vertexStride);
+	faces.resize(geometry.faceCount);
+	// The copy-read target reads either buffer without disturbing any vertex array's bindings.
+	glBindBuffer(GL_COPY_READ_BUFFER, geometry.vbo);
+	glGetBufferSubData(GL_COPY_READ_BUFFER, 0, vertices.size(), vertices.data());
+	glBindBuffer(GL_COPY_READ_BUFFER, geometry.ebo);
+	glGetBufferSubData(GL_COPY_READ_BUFFER, 0, faces.size() * sizeof(uint32_t), faces.data());
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+const TriangleBVH* Mesh3D::bvh() const {
+	if (m_geometry->skin != nullptr) {
+		return nullptr;
+	}
+	Geometry& geometry = *m_geometry;
+	if (geometry.bvh == nullptr) {
+		PROFILE_SCOPE("Mesh3D::bvh");
+		std::vector<uint8_t> vertices;
+		std::vector<uint32_t> faces;
+		if (geometry.cpuData != nullptr) {
+			geometry.cpuData->read(vertices, faces);
+		}
+		else {
+			readBuffers(vertices, faces);
+		}
+		std::vector<glm::vec3> positions(geometry.vertexCount);
+		for (size_t i = 0; i < geometry.vertexCount; i++) {
+			auto* v = reinterpret_cast<const Vertex3D*>(vertices.data() + i * geometry.vertexStride);
+			positions[i] = glm::vec3(v->x, v->y, v->z);
+		}
+		geometry.bvh = std::make_shared<const TriangleBVH>(positions, faces);
+		MemoryAccounting::instance().update(geometry.memoryRecord, memoryUsage());
+	}
+	return geometry.bvh.get();
+}
+
+void Mesh3D::contextLost() {
+	++currentContextGeneration;
+}
+
+void Mesh3D::reupload() {
+	Geometry& geometry = *m_geometry;
+	if (geometry.contextGeneration == currentContextGeneration) {
+		// Not lost, or already reuploaded through a copy.
+		return;
+	}
+	std::vector<uint8_t> vertices;
+	std::vector<uint32_t> faces;
+	readCpuData(vertices, faces);
+	// The old names are forgotten rather than deleted, since the new context may use them.
+	geometry.vao = 0;
+	geometry.vbo = 0;
+	geometry.ebo = 0;
+	createBuffers(vertices.data(), faces.data());
+	geometry.contextGeneration = currentContextGeneration;
+}
+
+void Mesh3D::setName(const std::string& name) {
+	MemoryAccounting::instance().rename(m_geometry->memoryRecord, name);
+}
+
+void Mesh3D::replaceGeometry(Mesh3D& replacement) {
+	Geometry& mine = *m_geometry;
+	Geometry& theirs = *replacement.m_geometry;
+	if ((mine.skin == nullptr) != (theirs.skin == nullptr)
+		|| (mine.skin != nullptr && mine.skin->jointNames != theirs.skin->jointNames)) {
+		throw std::runtime_error("A mesh cannot be replaced by one with different joints");
+	}
+	// Swap the contents rather than the pointers, so copies of this mesh see the new geometry.
+	std::swap(mine.vao, theirs.vao);
+	std::swap(mine.vbo, theirs.vbo);
+	std::swap(mine.ebo, theirs.ebo);
+	std::swap(mine.vertexCount, theirs.vertexCount);
+	std::swap(mine.vertexStride, theirs.vertexStride);
+	std::swap(mine.faceCount, theirs.faceCount);
+	// The inverse bind matrices belong to the vertices they were imported with.
+	std::swap(mine.skin, theirs.skin);
+	std::swap(mine.bounds, theirs.bounds);
+	std::swap(mine.bvh, theirs.bvh);
+	std::swap(mine.cpuData, theirs.cpuData);
+	std::swap(mine.memoryRecord, theirs.memoryRecord);
+	std::swap(mine.contextGeneration, theirs.contextGeneration);
+}
+
 void Mesh3D::addTexture(Texture texture)
 {
 	m_textures.push_back(texture);
 }
 
-void Mesh3D::render(sf::RenderWindow& window, ShaderProgram& program) const {
+uint32_t Mesh3D::shaderFeatures() const {
+	// Like render(), a skinned mesh without a palette yet is drawn in its bind pose.
+	uint32_t features = m_geometry->skin != nullptr && m_paletteBuffer != 0 ? ShaderVariants::SKINNED : 0;
+	for (auto& texture : m_textures) {
+		if (texture.samplerName == "normalMap") {
+			features |= ShaderVariants::NORMAL_MAP;
+		}
+		else if (texture.samplerName == "specMap") {
+			features |= ShaderVariants::SPEC_MAP;
+		}
+	}
+	return features;
+}
+
+void Mesh3D::render(ShaderProgram& program) const {
+	PROFILE_DRAW_SCOPE("Mesh3D::render");
 	// Activate the mesh's vertex array.
-	glBindVertexArray(m_vao);
+	glBindVertexArray(m_geometry->vao);
+	RENDER_STATS_ADD(vertexArrayBinds, 1);
+	// A skinned mesh reads its joint matrices from its range of the palette buffer.
+	bool skinned = m_geometry->skin != nullptr && m_paletteBuffer != 0;
+	program.setSkinned(skinned);
+	if (skinned) {
+		glBindBufferRange(GL_UNIFORM_BUFFER, JOINT_PALETTE_BINDING, m_paletteBuffer,
+			m_paletteOffset, m_paletteSize);
+	}
 	for (auto i = 0; i < m_textures.size(); i++) {
 		program.setUniform(m_textures[i].samplerName, i);
 		glActiveTexture(GL_TEXTURE0 + i);
 		glBindTexture(GL_TEXTURE_2D, m_textures[i].textureId);
 	}
+	RENDER_STATS_ADD(textureBinds, m_textures.size());
 
 	// Draw the vertex array, using its "element buffer" to identify the faces.
-	glDrawElements(GL_TRIANGLES, m_faceCount, GL_UNSIGNED_INT, nullptr);
+	glDrawElements(GL_TRIANGLES, m_geometry->faceCount, GL_UNSIGNED_INT, nullptr);
+	RENDER_STATS_ADD(drawCalls, 1);
+	RENDER_STATS_ADD(triangles, m_geometry->faceCount / 3);
+	RENDER_STATS_ADD(vertices, m_geometry->vertexCount);
 	// Deactivate the mesh's vertex array and texture.
 	glBindVertexArray(0);
 	glBindTexture(GL_TEXTURE_2D, 0);
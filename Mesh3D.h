@@ -1,9 +1,14 @@
 #pragma once
+#include <memory>
 #include <SFML/Graphics.hpp>
 #include <glm/glm.hpp>
 #include "glad.h"
+#include "Bounds.h"
+#include "MemoryAccounting.h"
+#include "MeshData.h"
 #include "ShaderProgram.h"
 #include "Texture.h"
+#include "TriangleBVH.h"
 
 struct Vertex3D {
 	float_t x;
@@ -22,16 +27,93 @@ struct Vertex3D {
 		x(px), y(py), z(pz), nx(normX), ny(normY), nz(normZ), u(texU), v(texV) {}
 };
 
+/**
+ * @brief A vertex of a skinned mesh: a Vertex3D plus the indices of up to four joints that move
+ * it, and how much each joint contributes as unsigned normalized bytes that sum to 255.
+ */
+struct SkinnedVertex3D {
+	Vertex3D vertex;
+	uint8_t joints[4];
+	uint8_t weights[4];
+
+	SkinnedVertex3D(const Vertex3D& v) : vertex(v), joints{ 0, 0, 0, 0 }, weights{ 255, 0, 0, 0 } {}
+};
+
+/**
+ * @brief The joints that deform a skinned mesh. Joints are identified by the names of the
+ * objects in the model hierarchy that drive them; each joint's inverse bind matrix moves a
+ * vertex from the mesh's bind pose into the joint's local space.
+ */
+struct Skin {
+	std::vector<std::string> jointNames;
+	std::vector<glm::mat4> inverseBindMatrices;
+};
+
+/**
+ * @brief Where a mesh was loaded from: a model file, and the mesh's index among the model's
+ * imported meshes.
+ */
+struct MeshSource {
+	std::string path;
+	bool flipTextureCoords = false;
+	uint32_t index = 0;
+};
+
 /**
  * @brief Represents a mesh whose vertices have positions, normal vectors, and texture coordinates;
  * as well as a list of Textures to bind when rendering the mesh.
  */
 class Mesh3D {
 private:
-	uint32_t m_vao;
+	// The mesh's buffers and everything derived from its vertices, shared by copies of the mesh.
+	// The buffers are deleted, and the mesh's memory record removed, with the last copy.
+	struct Geometry {
+		uint32_t vao;
+		uint32_t vbo;
+		uint32_t ebo;
+		size_t vertexCount;
+		size_t vertexStride;
+		size_t faceCount;
+		// Skinned meshes only: the joints the vertices are bound to.
+		std::shared_ptr<const Skin> skin;
+		// The bounds of the vertex positions, in the mesh's local space.
+		AABB bounds;
+		// A BVH over the mesh's triangles, for ray casts; built by the first pick, unless the mesh
+		// came with one.
+		std::shared_ptr<const TriangleBVH> bvh;
+		// What is kept of the vertices and faces after uploading them, per the retention policy.
+		std::unique_ptr<MeshData> cpuData;
+		uint64_t memoryRecord;
+		MeshSource source;
+		// The value of the context generation when the buffers were created; buffers from an
+		// earlier generation belong to a lost context.
+		uint32_t contextGeneration;
+
+		Geometry();
+		~Geometry();
+	};
+
+	std::shared_ptr<Geometry> m_geometry;
 	std::vector<Texture> m_textures;
-	size_t m_vertexCount;
-	size_t m_faceCount;
+
+	// Skinned meshes only: the range of the uniform buffer that holds this instance's joint
+	// matrices, assigned by a SkinningSystem.
+	uint32_t m_paletteBuffer;
+	size_t m_paletteOffset;
+	size_t m_paletteSize;
+
+	// Derives the geometry from the vertex and face data, keeps what the retention policy asks
+	// for, uploads it, and records its memory.
+	void upload(const void* vertices, size_t vertexCount, size_t vertexStride,
+		const std::vector<uint32_t>& faces, std::shared_ptr<const Skin> skin, MeshRetention retention);
+	// Creates the vertex array and buffers and describes the vertex attributes to them.
+	void createBuffers(const void* vertices, const uint32_t* faces);
+	// Records the uploaded geometry in memory reports.
+	void recordMemory();
+	// The memory the geometry uses, on the CPU and the GPU.
+	MemoryUsage memoryUsage() const;
+	// Reads the vertex records and faces back from the mesh's buffers.
+	void readBuffers(std::vector<uint8_t>& vertices, std::vector<uint32_t>& faces) const;
 
 public:
 	Mesh3D() = delete;
@@ -41,13 +123,123 @@ public:
 	 * @brief Construcst a Mesh3D using existing vectors of vertices and faces.
 	*/
 	Mesh3D(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces, 
-		Texture texture);
+		Texture texture, MeshRetention retention = MeshRetention::DISCARD);
 
 	Mesh3D(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces,
-		std::vector<Texture>&& textures);
+		std::vector<Texture>&& textures, MeshRetention retention = MeshRetention::DISCARD);
+
+	/**
+	 * @brief Constructs a skinned mesh, whose vertices are moved by the joints of the given skin.
+	 */
+	Mesh3D(std::vector<SkinnedVertex3D>&& vertices, std::vector<uint32_t>&& faces,
+		std::vector<Texture>&& textures, std::shared_ptr<const Skin> skin,
+		MeshRetention retention = MeshRetention::DISCARD);
+
+	/**
+	 * @brief Constructs a mesh from vertex records and faces already laid out for the GPU, such
+	 * as those mapped from an AssetPackage, whose bounds and BVH were computed ahead of time; a
+	 * null BVH is built when first needed. The data is uploaded straight from the given memory,
+	 * which need not outlive the constructor. Vertices are Vertex3Ds, or SkinnedVertex3Ds if a
+	 * skin is given.
+	 */
+	Mesh3D(const void* vertices, size_t vertexCount, const uint32_t* faces, size_t faceCount,
+		const AABB& bounds, std::shared_ptr<const TriangleBVH> bvh, std::vector<Texture>&& textures,
+		std::shared_ptr<const Skin> skin = nullptr, MeshRetention retention = MeshRetention::DISCARD);
 
 	void addTexture(Texture texture);
 
+	/**
+	 * @brief The uniform block binding point that skinned meshes bind their joint matrices to.
+	 */
+	static const uint32_t JOINT_PALETTE_BINDING = 1;
+
+	/**
+	 * @brief The bounds of the mesh's vertices in its local space. The bounds of a skinned mesh
+	 * are those of its bind pose.
+	 */
+	const AABB& bounds() const { return m_geometry->bounds; }
+
+	/**
+	 * @brief The BVH over the mesh's triangles, in its local space, built the first time it is
+	 * asked for from the mesh's CPU data, or else from its buffers on the GPU, which requires the
+	 * OpenGL context; copies of the mesh share it. Null for skinned meshes, whose triangles move
+	 * with their joints, so they cannot be picked.
+	 */
+	const TriangleBVH* bvh() const;
+
+	size_t vertexCount() const { return m_geometry->vertexCount; }
+	size_t faceCount() const { return m_geometry->faceCount; }
+	MeshRetention retention() const {
+		return m_geometry->cpuData != nullptr ? m_geometry->cpuData->retention() : MeshRetention::DISCARD;
+	}
+	bool hasCpuData() const { return retention() != MeshRetention::DISCARD; }
+
+	/**
+	 * @brief Reads back the vertex records, as bytes, and the face indices that the mesh was
+	 * constructed with; a compressed mesh returns its quantized approximation. Throws
+	 * std::runtime_error if the mesh discarded its data.
+	 */
+	void readCpuData(std::vector<uint8_t>& vertices, std::vector<uint32_t>& faces) const;
+
+	/**
+	 * @brief Uploads the mesh's data to new buffers in the current context, after contextLost().
+	 * Copies of a mesh share their buffers, so only the first copy reuploaded uploads anything.
+	 * Throws std::runtime_error if the mesh discarded its data.
+	 *
+	 * Only geometry is restored. Everything else created in the lost context must be recreated
+	 * by its owner as well: textures, shader programs, and stream buffers, including the ones
+	 * behind Object3D's per-draw data and a SkinningSystem's joint palettes, whose ranges the
+	 * system must then assign to its meshes again.
+	 */
+	void reupload();
+
+	/**
+	 * @brief Declares that the OpenGL context every existing mesh's buffers were created in has
+	 * been lost, and that a new one is current. The old buffer names are never deleted, since
+	 * the new context may already use the same names for other objects.
+	 */
+	static void contextLost();
+
+	/**
+	 * @brief Names the mesh in memory reports.
+	 */
+	void setName(const std::string& name);
+
+	/**
+	 * @brief Records the model file the mesh was loaded from; empty for meshes built in code.
+	 */
+	void setSource(const MeshSource& source) { m_geometry->source = source; }
+	const MeshSource& source() const { return m_geometry->source; }
+
+	/**
+	 * @brief Replaces the mesh's geometry and skin, and those of every copy sharing them, with the
+	 * replacement's, which is left with the old ones; textures and the joint palette are kept. Throws std::runtime_error if the replacement's skin has different joints, since a
+	 * SkinningSystem binds the mesh's joints when the mesh is added.
+	 */
+	void replaceGeometry(Mesh3D& replacement);
+	bool sharesGeometry(const Mesh3D& other) const { return m_geometry == other.m_geometry; }
+
+	const std::vector<Texture>& textures() const { return m_textures; }
+
+	bool isSkinned() const { return m_geometry->skin != nullptr; }
+	const std::shared_ptr<const Skin>& skin() const { return m_geometry->skin; }
+
+	/**
+	 * @brief The ShaderVariants::Feature flags of the program that draws this mesh: whether it is
+	 * skinned by a joint palette, and which of the normal and specular maps its textures include.
+	 */
+	uint32_t shaderFeatures() const;
+
+	/**
+	 * @brief Sets the range of a uniform buffer, in bytes, that holds this mesh's joint
+	 * palette; it is bound to JOINT_PALETTE_BINDING when the mesh is rendered.
+	 */
+	void setJointPalette(uint32_t buffer, size_t offset, size_t size) {
+		m_paletteBuffer = buffer;
+		m_paletteOffset = offset;
+		m_paletteSize = size;
+	}
+
 	/**
 	 * @brief Constructs a 1x1 square centered at the origin in world space.
 	*/
@@ -64,6 +256,6 @@ public:
 	/**
 	 * @brief Renders the mesh to the given context.
 	 */
-	void render(sf::RenderWindow& window, ShaderProgram& program) const;
+	void render(ShaderProgram& program) const;
 	
 };
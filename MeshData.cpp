@@ -0,0 +1,212 @@
+#include "MeshData.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include "Mesh3D.h"
+
+namespace {
+	std::mutex cacheDirectoryMutex;
+	std::filesystem::path cacheDirectoryPath;
+	std::atomic<uint64_t> nextCacheFile(0);
+
+	uint16_t quantize(float_t value, float_t min, float_t max) {
+		if (max <= min) {
+			return 0;
+		}
+		float_t fraction = (value - min) / (max - min);
+		return static_cast<uint16_t>(std::lround(std::min(std::max(fraction, float_t(0)), float_t(1)) * 65535));
+	}
+
+	float_t dequantize(uint16_t value, float_t min, float_t max) {
+		return min + (max - min) * (value / float_t(65535));
+	}
+
+	int16_t toSnorm(float_t value) {
+		return static_cast<int16_t>(std::lround(std::min(std::max(value, float_t(-1)), float_t(1)) * 32767));
+	}
+
+	template <typename T>
+	void append(std::vector<uint8_t>& out, T value) {
+		size_t at = out.size();
+		out.resize(at + sizeof(T));
+		std::memcpy(&out[at], &value, sizeof(T));
+	}
+
+	template <typename T>
+	T take(const uint8_t*& in) {
+		T value;
+		std::memcpy(&value, in, sizeof(T));
+		in += sizeof(T);
+		return value;
+	}
+}
+
+MeshData::MeshData(MeshRetention retention, const void* vertices, size_t vertexCount, size_t vertexStride,
+	const std::vector<uint32_t>& faces, const AABB& bounds)
+	: m_retention(retention), m_vertexCount(vertexCount), m_vertexStride(vertexStride),
+	m_faceCount(faces.size()), m_texCoordMin(0), m_texCoordMax(0) {
+	auto* bytes = static_cast<const uint8_t*>(vertices);
+	switch (retention) {
+	case MeshRetention::DISCARD:
+		break;
+	case MeshRetention::KEEP:
+		m_vertices.assign(bytes, bytes + vertexCount * vertexStride);
+		m_faces = faces;
+		break;
+	case MeshRetention::KEEP_COMPRESSED:
+		compress(bytes, faces, bounds);
+		break;
+	case MeshRetention::MAPPED_CACHE:
+		writeCache(bytes, faces);
+		break;
+	}
+}
+
+MeshData::~MeshData() {
+	if (m_file != nullptr) {
+		m_file.reset();
+		std::error_code ignored;
+		std::filesystem::remove(m_path, ignored);
+	}
+}
+
+void MeshData::compress(const uint8_t* vertices, const std::vector<uint32_t>& faces, const AABB& bounds) {
+	m_positionRange = bounds;
+	m_texCoordMin = glm::vec2(std::numeric_limits<float_t>::max());
+	m_texCoordMax = glm::vec2(-std::numeric_limits<float_t>::max());
+	for (size_t i = 0; i < m_vertexCount; i++) {
+		auto* v = reinterpret_cast<const Vertex3D*>(vertices + i * m_vertexStride);
+		m_texCoordMin = glm::min(m_texCoordMin, glm::vec2(v->u, v->v));
+		m_texCoordMax = glm::max(m_texCoordMax, glm::vec2(v->u, v->v));
+	}
+
+	size_t extra = m_vertexStride - sizeof(Vertex3D);
+	m_encoded.reserve(m_vertexCount * (8 * sizeof(uint16_t) + extra) + faces.size() * 2);
+	for (size_t i = 0; i < m_vertexCount; i++) {
+		const uint8_t* record = vertices + i * m_vertexStride;
+		auto* v = reinterpret_cast<const Vertex3D*>(record);
+		append(m_encoded, quantize(v->x, m_positionRange.min.x, m_positionRange.max.x));
+		append(m_encoded, quantize(v->y, m_positionRange.min.y, m_positionRange.max.y));
+		append(m_encoded, quantize(v->z, m_positionRange.min.z, m_positionRange.max.z));
+		append(m_encoded, toSnorm(v->nx));
+		append(m_encoded, toSnorm(v->ny));
+		append(m_encoded, toSnorm(v->nz));
+		append(m_encoded, quantize(v->u, m_texCoordMin.x, m_texCoordMax.x));
+		append(m_encoded, quantize(v->v, m_texCoordMin.y, m_texCoordMax.y));
+		m_encoded.insert(m_encoded.end(), record + sizeof(Vertex3D), record + m_vertexStride);
+	}
+
+	// Neighboring faces mostly share nearby vertices, so each index is stored as the zigzag
+	// encoded difference from the previous one, 7 bits per byte.
+	int64_t previous = 0;
+	for (uint32_t index : faces) {
+		int64_t delta = static_cast<int64_t>(index) - previous;
+		previous = index;
+		uint64_t zigzag = (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63);
+		while (zigzag >= 0x80) {
+			m_encoded.push_back(static_cast<uint8_t>(zigzag | 0x80));
+			zigzag >>= 7;
+		}
+		m_encoded.push_back(static_cast<uint8_t>(zigzag));
+	}
+	m_encoded.shrink_to_fit();
+}
+
+void MeshData::decompress(std::vector<uint8_t>& vertices, std::vector<uint32_t>& faces) const {
+	vertices.resize(m_vertexCount * m_vertexStride);
+	faces.resize(m_faceCount);
+	size_t extra = m_vertexStride - sizeof(Vertex3D);
+	const uint8_t* in = m_encoded.data();
+	for (size_t i = 0; i < m_vertexCount; i++) {
+		uint8_t* record = &vertices[i * m_vertexStride];
+		float_t x = dequantize(take<uint16_t>(in), m_positionRange.min.x, m_positionRange.max.x);
+		float_t y = dequantize(take<uint16_t>(in), m_positionRange.min.y, m_positionRange.max.y);
+		float_t z = dequantize(take<uint16_t>(in), m_positionRange.min.z, m_positionRange.max.z);
+		float_t nx = take<int16_t>(in) / float_t(32767);
+		float_t ny = take<int16_t>(in) / float_t(32767);
+		float_t nz = take<int16_t>(in) / float_t(32767);
+		float_t u = dequantize(take<uint16_t>(in), m_texCoordMin.x, m_texCoordMax.x);
+		float_t v = dequantize(take<uint16_t>(in), m_texCoordMin.y, m_texCoordMax.y);
+		Vertex3D vertex(x, y, z, nx, ny, nz, u, v);
+		std::memcpy(record, &vertex, sizeof(Vertex3D));
+		std::memcpy(record + sizeof(Vertex3D), in, extra);
+		in += extra;
+	}
+
+	int64_t previous = 0;
+	for (size_t i = 0; i < m_faceCount; i++) {
+		uint64_t zigzag = 0;
+		for (int shift = 0;; shift += 7) {
+			uint8_t byte = *in++;
+			zigzag |= static_cast<uint64_t>(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0) {
+				break;
+			}
+		}
+		int64_t delta = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+		previous += delta;
+		faces[i] = static_cast<uint32_t>(previous);
+	}
+}
+
+void MeshData::writeCache(const uint8_t* vertices, const std::vector<uint32_t>& faces) {
+	// Names include the process's start time, so concurrent runs do not share files.
+	static const auto processStamp = std::chrono::system_clock::now().time_since_epoch().count();
+	std::filesystem::path directory = cacheDirectory();
+	std::filesystem::create_directories(directory);
+	m_path = directory / ("mesh-" + std::to_string(processStamp) + "-"
+		+ std::to_string(nextCacheFile++) + ".bin");
+	{
+		std::ofstream out(m_path, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(vertices), m_vertexCount * m_vertexStride);
+		out.write(reinterpret_cast<const char*>(faces.data()), faces.size() * sizeof(uint32_t));
+		if (!out) {
+			throw std::runtime_error("Could not write mesh cache file " + m_path.string());
+		}
+	}
+	m_file = std::make_unique<MappedFile>(m_path);
+}
+
+void MeshData::read(std::vector<uint8_t>& vertices, std::vector<uint32_t>& faces) const {
+	switch (m_retention) {
+	case MeshRetention::DISCARD:
+		throw std::runtime_error("Mesh data was discarded after upload");
+	case MeshRetention::KEEP:
+		vertices = m_vertices;
+		faces = m_faces;
+		break;
+	case MeshRetention::KEEP_COMPRESSED:
+		decompress(vertices, faces);
+		break;
+	case MeshRetention::MAPPED_CACHE: {
+		size_t vertexBytes = m_vertexCount * m_vertexStride;
+		const uint8_t* data = m_file->data();
+		vertices.assign(data, data + vertexBytes);
+		faces.resize(m_faceCount);
+		std::memcpy(faces.data(), data + vertexBytes, m_faceCount * sizeof(uint32_t));
+		break;
+	}
+	}
+}
+
+size_t MeshData::residentBytes() const {
+	return m_vertices.capacity() + m_faces.capacity() * sizeof(uint32_t) + m_encoded.capacity();
+}
+
+void MeshData::setCacheDirectory(const std::filesystem::path& directory) {
+	std::lock_guard<std::mutex> lock(cacheDirectoryMutex);
+	cacheDirectoryPath = directory;
+}
+
+std::filesystem::path MeshData::cacheDirectory() {
+	std::lock_guard<std::mutex> lock(cacheDirectoryMutex);
+	if (cacheDirectoryPath.empty()) {
+		cacheDirectoryPath = std::filesystem::temp_directory_path() / "FinalProject449-mesh-cache";
+	}
+	return cacheDirectoryPath;
+}
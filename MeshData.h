@@ -0,0 +1,98 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+#include "Bounds.h"
+#include "MappedFile.h"
+
+/**
+ * @brief What a mesh keeps of its vertex and face data after uploading it to the GPU.
+ */
+enum class MeshRetention : uint8_t {
+	/** @brief Nothing; the data lives only on the GPU. */
+	DISCARD,
+	/** @brief An exact copy in memory. */
+	KEEP,
+	/**
+	 * @brief A quantized copy in memory, about half the size: positions and texture
+	 * coordinates are stored as 16-bit fractions of their ranges, normals as 16-bit signed
+	 * normalized values, and faces as variable-length deltas. Positions are accurate to
+	 * 1/65535 of the mesh's size.
+	 */
+	KEEP_COMPRESSED,
+	/**
+	 * @brief An exact copy written to a file in the cache directory and mapped into memory, so
+	 * the operating system pages it in only when it is read.
+	 */
+	MAPPED_CACHE
+};
+
+/**
+ * @brief The CPU-side copy of a mesh's vertex and face data, stored according to a
+ * MeshRetention policy. Vertices are opaque records of a fixed stride that begin with a
+ * Vertex3D; any bytes after the Vertex3D are kept exactly.
+ */
+class MeshData {
+private:
+	MeshRetention m_retention;
+	size_t m_vertexCount;
+	size_t m_vertexStride;
+	size_t m_faceCount;
+
+	// KEEP: the data as given. KEEP_COMPRESSED: the encoded data.
+	std::vector<uint8_t> m_vertices;
+	std::vector<uint32_t> m_faces;
+	std::vector<uint8_t> m_encoded;
+	// The ranges that KEEP_COMPRESSED quantizes positions and texture coordinates to.
+	AABB m_positionRange;
+	glm::vec2 m_texCoordMin;
+	glm::vec2 m_texCoordMax;
+
+	// MAPPED_CACHE: the cache file, which is deleted with the MeshData.
+	std::unique_ptr<MappedFile> m_file;
+	std::filesystem::path m_path;
+
+	void compress(const uint8_t* vertices, const std::vector<uint32_t>& faces, const AABB& bounds);
+	void decompress(std::vector<uint8_t>& vertices, std::vector<uint32_t>& faces) const;
+	void writeCache(const uint8_t* vertices, const std::vector<uint32_t>& faces);
+
+public:
+	/**
+	 * @brief Stores the given vertices and faces. bounds are the bounds of the vertex positions.
+	 * Throws std::runtime_error if a cache file cannot be written.
+	 */
+	MeshData(MeshRetention retention, const void* vertices, size_t vertexCount, size_t vertexStride,
+		const std::vector<uint32_t>& faces, const AABB& bounds);
+	~MeshData();
+
+	MeshData(const MeshData&) = delete;
+	MeshData& operator=(const MeshData&) = delete;
+
+	MeshRetention retention() const { return m_retention; }
+	size_t vertexCount() const { return m_vertexCount; }
+	size_t vertexStride() const { return m_vertexStride; }
+	size_t faceCount() const { return m_faceCount; }
+
+	/**
+	 * @brief Reconstructs the vertex bytes and face indices.
+	 */
+	void read(std::vector<uint8_t>& vertices, std::vector<uint32_t>& faces) const;
+
+	/**
+	 * @brief The bytes of heap memory used by the stored data.
+	 */
+	size_t residentBytes() const;
+
+	/**
+	 * @brief The bytes of the mapped cache file, if any.
+	 */
+	size_t mappedBytes() const { return m_file != nullptr ? m_file->size() : 0; }
+
+	/**
+	 * @brief Sets the directory that MAPPED_CACHE files are written to; by default, a
+	 * subdirectory of the system's temporary directory.
+	 */
+	static void setCacheDirectory(const std::filesystem::path& directory);
+	static std::filesystem::path cacheDirectory();
+};
@@ -2,18 +2,26 @@
 #include <glm/gtx/string_cast.hpp>
 #include <glm/ext.hpp>
 #include "Object3D.h"
+#include "Profiler.h"
+#include "StreamBuffer.h"
+#include <cstring>
 #include <iostream>
 
-void Object3D::rebuildModelMatrix() {
-	auto m = glm::translate(glm::mat4(1), m_position);
-	m = glm::translate(m, m_center * m_scale);
-	m = glm::rotate(m, m_orientation[2], glm::vec3(0, 0, 1));
-	m = glm::rotate(m, m_orientation[0], glm::vec3(1, 0, 0));
-	m = glm::rotate(m, m_orientation[1], glm::vec3(0, 1, 0));
-	m = glm::scale(m, m_scale);
+glm::mat4 Object3D::buildModelMatrix(const glm::vec3& position, const glm::vec3& orientation,
+	const glm::quat& rotation, const glm::vec3& scale) const {
+	auto m = glm::translate(glm::mat4(1), position);
+	m = glm::translate(m, m_center * scale);
+	m = glm::rotate(m, orientation[2], glm::vec3(0, 0, 1));
+	m = glm::rotate(m, orientation[0], glm::vec3(1, 0, 0));
+	m = glm::rotate(m, orientation[1], glm::vec3(0, 1, 0));
+	m = m * glm::mat4_cast(rotation);
+	m = glm::scale(m, scale);
 	m = glm::translate(m, -m_center);
-	m = m * m_baseTransform;
-	m_modelMatrix = m;
+	return m * m_baseTransform;
+}
+
+void Object3D::rebuildModelMatrix() {
+	m_modelMatrix = buildModelMatrix(m_position, m_orientation, m_rotation, m_scale);
 }
 
 Object3D::Object3D(std::vector<Mesh3D>&& meshes)
@@ -22,8 +30,9 @@ Object3D::Object3D(std::vector<Mesh3D>&& meshes)
 }
 
 Object3D::Object3D(std::vector<Mesh3D>&& meshes, const glm::mat4& baseTransform)
-	: m_meshes(meshes), m_position(), m_orientation(), m_scale(1.0),
-	m_center(), m_baseTransform(baseTransform)
+	: m_meshes(meshes), m_position(), m_orientation(), m_rotation(1, 0, 0, 0), m_scale(1.0),
+	m_center(), m_previousPosition(), m_previousOrientation(), m_previousRotation(1, 0, 0, 0),
+	m_previousScale(1.0), m_baseTransform(baseTransform)
 {
 	rebuildModelMatrix();
 }
@@ -52,6 +61,10 @@ const glm::vec3& Object3D::getOrientation() const {
 	return m_orientation;
 }
 
+const glm::quat& Object3D::getRotation() const {
+	return m_rotation;
+}
+
 const glm::vec3& Object3D::getScale() const {
 	return m_scale;
 }
@@ -67,6 +80,22 @@ const std::string& Object3D::getName() const {
 	return m_name;
 }
 
+const glm::mat4& Object3D::getModelMatrix() const {
+	return m_modelMatrix;
+}
+
+size_t Object3D::numberOfMeshes() const {
+	return m_meshes.size();
+}
+
+const Mesh3D& Object3D::getMesh(size_t index) const {
+	return m_meshes[index];
+}
+
+Mesh3D& Object3D::getMesh(size_t index) {
+	return m_meshes[index];
+}
+
 size_t Object3D::numberOfChildren() const {
 	return m_children.size();
 }
@@ -79,6 +108,19 @@ Object3D& Object3D::getChild(size_t index) {
 	return m_children[index];
 }
 
+Object3D* Object3D::findByName(const std::string& name) {
+	if (m_name == name) {
+		return this;
+	}
+	for (auto& child : m_children) {
+		Object3D* found = child.findByName(name);
+		if (found != nullptr) {
+			return found;
+		}
+	}
+	return nullptr;
+}
+
 void Object3D::setPosition(const glm::vec3& position) {
 	m_position = position;
 	rebuildModelMatrix();
@@ -89,6 +131,11 @@ void Object3D::setOrientation(const glm::vec3& orientation) {
 	rebuildModelMatrix();
 }
 
+void Object3D::setRotation(const glm::quat& rotation) {
+	m_rotation = rotation;
+	rebuildModelMatrix();
+}
+
 void Object3D::setScale(const glm::vec3& scale) {
 	m_scale = scale;
 	rebuildModelMatrix();
@@ -126,6 +173,24 @@ void Object3D::setRotAcceleration(const glm::vec3& rotAcceleration) {
 	rot_acceleration = rotAcceleration;
 }
 
+void Object3D::setTransform(const glm::vec3& position, const glm::vec3& orientation,
+	const glm::quat& rotation, const glm::vec3& scale) {
+	m_position = position;
+	m_orientation = orientation;
+	m_rotation = rotation;
+	m_scale = scale;
+	rebuildModelMatrix();
+}
+
+void Object3D::setKinematicState(const glm::vec3& position, const glm::vec3& orientation,
+	const glm::vec3& velocity, const glm::vec3& rotVelocity) {
+	m_position = position;
+	m_orientation = orientation;
+	curr_velocity = velocity;
+	rot_velocity = rotVelocity;
+	rebuildModelMatrix();
+}
+
 void Object3D::move(const glm::vec3& offset) {
 	m_position = m_position + offset;
 	rebuildModelMatrix();
@@ -154,24 +219,198 @@ void Object3D::tick(float_t dt) {
 	rebuildModelMatrix();
 }
 
+AABB Object3D::getBounds(const glm::mat4& parentMatrix) const {
+	glm::mat4 trueModel = parentMatrix * m_modelMatrix;
+	AABB bounds;
+	for (auto& mesh : m_meshes) {
+		bounds.expand(mesh.bounds().transformed(trueModel));
+	}
+	for (auto& child : m_children) {
+		bounds.expand(child.getBounds(trueModel));
+	}
+	return bounds;
+}
+
+void Object3D::savePreviousTransform() {
+	m_previousPosition = m_position;
+	m_previousOrientation = m_orientation;
+	m_previousRotation = m_rotation;
+	m_previousScale = m_scale;
+	for (auto& child : m_children) {
+		child.savePreviousTransform();
+	}
+}
+
 void Object3D::render(sf::RenderWindow& window, ShaderProgram& shaderProgram) const {
-	renderRecursive(window, shaderProgram, glm::mat4(1));
+	render(shaderProgram, 1);
+}
+
+void Object3D::render(sf::RenderWindow& window, ShaderProgram& shaderProgram, float_t alpha) const {
+	render(shaderProgram, alpha);
+}
+
+namespace {
+	// The size of a PerDraw block: a batch of model matrices, 4 KB, a multiple of any uniform
+	// buffer alignment, so every batch in a mapping starts aligned.
+	const size_t PER_DRAW_BATCH_SIZE = Object3D::PER_DRAW_CAPACITY * sizeof(glm::mat4);
+
+	// Created with the first draw, when there is a context to create it in, and never destroyed,
+	// so it is not deleted after the context is gone.
+	StreamBuffer& perDrawStream() {
+		static StreamBuffer* stream = new StreamBuffer(GL_UNIFORM_BUFFER, 64 * 1024,
+			StreamBuffer::uniformAlignment());
+		return *stream;
+	}
+
+	// The meshes of the draws being rendered, kept between calls so its storage is reused.
+	std::vector<const Mesh3D*>& drawList() {
+		static std::vector<const Mesh3D*> meshes;
+		return meshes;
+	}
+}
+
+void Object3D::beginFrame() {
+	perDrawStream().beginFrame();
+}
+
+void Object3D::render(ShaderProgram& shaderProgram, float_t alpha) const {
+	// Timed here rather than inside the recursion, so nested calls are not counted twice.
+	PROFILE_SCOPE("Object3D::renderRecursive");
+	renderDraws(this, 1, shaderProgram, alpha);
+}
+
+void Object3D::render(ShaderVariants& variants, float_t alpha) const {
+	PROFILE_SCOPE("Object3D::renderRecursive");
+	renderDraws(this, 1, variants, alpha);
+}
+
+void Object3D::renderAll(const std::vector<Object3D>& objects, ShaderProgram& shaderProgram, float_t alpha) {
+	PROFILE_SCOPE("Object3D::renderAll");
+	renderDraws(objects.data(), objects.size(), shaderProgram, alpha);
+}
+
+void Object3D::renderAll(const std::vector<Object3D>& objects, ShaderVariants& variants, float_t alpha) {
+	PROFILE_SCOPE("Object3D::renderAll");
+	renderDraws(objects.data(), objects.size(), variants, alpha);
+}
+
+void Object3D::renderDraws(const Object3D* objects, size_t count, ShaderProgram& shaderProgram, float_t alpha) {
+	if (!shaderProgram.bindPerDrawBlock(PER_DRAW_BINDING)) {
+		for (size_t i = 0; i < count; i++) {
+			objects[i].renderRecursive(shaderProgram, glm::mat4(1), alpha);
+		}
+		return;
+	}
+
+	auto& meshes = drawList();
+	size_t offset = streamDraws(objects, count, alpha, meshes);
+	uint32_t buffer = perDrawStream().buffer();
+	for (size_t i = 0; i < meshes.size(); i++) {
+		size_t slot = i % PER_DRAW_CAPACITY;
+		if (slot == 0) {
+			glBindBufferRange(GL_UNIFORM_BUFFER, PER_DRAW_BINDING, buffer, offset + i * sizeof(glm::mat4),
+				PER_DRAW_BATCH_SIZE);
+		}
+		shaderProgram.setDrawIndex(static_cast<int32_t>(slot));
+		meshes[i]->render(shaderProgram);
+	}
+}
+
+void Object3D::renderDraws(const Object3D* objects, size_t count, ShaderVariants& variants, float_t alpha) {
+	auto& meshes = drawList();
+	size_t offset = streamDraws(objects, count, alpha, meshes);
+	uint32_t buffer = perDrawStream().buffer();
+	// Consecutive meshes with the same features share a program, so switch only between them.
+	ShaderProgram* program = nullptr;
+	uint32_t programFeatures = 0;
+	for (size_t i = 0; i < meshes.size(); i++) {
+		uint32_t features = meshes[i]->shaderFeatures();
+		if (program == nullptr || features != programFeatures) {
+			program = &variants.activate(features);
+			programFeatures = features;
+		}
+		size_t slot = i % PER_DRAW_CAPACITY;
+		if (slot == 0) {
+			glBindBufferRange(GL_UNIFORM_BUFFER, PER_DRAW_BINDING, buffer, offset + i * sizeof(glm::mat4),
+				PER_DRAW_BATCH_SIZE);
+		}
+		program->setDrawIndex(static_cast<int32_t>(slot));
+		meshes[i]->render(*program);
+	}
+}
+
+size_t Object3D::streamDraws(const Object3D* objects, size_t count, float_t alpha,
+	std::vector<const Mesh3D*>& meshes) {
+	meshes.clear();
+	size_t meshCount = 0;
+	for (size_t i = 0; i < count; i++) {
+		meshCount += objects[i].countMeshes();
+	}
+	if (meshCount == 0) {
+		return 0;
+	}
+	// Every matrix is written in one mapping, then each batch of draws binds one block of it.
+	// The mapping is rounded up to whole blocks, so the last batch's range is in the buffer too.
+	StreamBuffer& stream = perDrawStream();
+	size_t batches = (meshCount + PER_DRAW_CAPACITY - 1) / PER_DRAW_CAPACITY;
+	size_t offset;
+	uint8_t* out = stream.map(batches * PER_DRAW_BATCH_SIZE, offset);
+	meshes.reserve(meshCount);
+	for (size_t i = 0; i < count; i++) {
+		objects[i].writeDraws(glm::mat4(1), alpha, out, meshes);
+	}
+	stream.unmap();
+	return offset;
+}
+
+glm::mat4 Object3D::interpolatedModelMatrix(float_t alpha) const {
+	// Between simulation steps, the object is drawn partway from its previous transform to its
+	// current one; objects that did not move use the cached matrix.
+	if (alpha < 1 && (m_previousPosition != m_position || m_previousOrientation != m_orientation
+		|| m_previousRotation != m_rotation || m_previousScale != m_scale)) {
+		return buildModelMatrix(glm::mix(m_previousPosition, m_position, alpha),
+			glm::mix(m_previousOrientation, m_orientation, alpha),
+			glm::slerp(m_previousRotation, m_rotation, alpha),
+			glm::mix(m_previousScale, m_scale, alpha));
+	}
+	return m_modelMatrix;
+}
+
+size_t Object3D::countMeshes() const {
+	size_t count = m_meshes.size();
+	for (auto& child : m_children) {
+		count += child.countMeshes();
+	}
+	return count;
+}
+
+void Object3D::writeDraws(const glm::mat4& parentMatrix, float_t alpha, uint8_t*& out,
+	std::vector<const Mesh3D*>& meshes) const {
+	glm::mat4 trueModel = parentMatrix * interpolatedModelMatrix(alpha);
+	for (auto& mesh : m_meshes) {
+		std::memcpy(out, &trueModel, sizeof(trueModel));
+		out += sizeof(trueModel);
+		meshes.push_back(&mesh);
+	}
+	for (auto& child : m_children) {
+		child.writeDraws(trueModel, alpha, out, meshes);
+	}
 }
 
 /**
  * @brief Renders the object and its children, recursively.
  * @param parentMatrix the model matrix of this object's parent in the model hierarchy.
  */
-void Object3D::renderRecursive(sf::RenderWindow& window, ShaderProgram& shaderProgram, const glm::mat4& parentMatrix) const {
+void Object3D::renderRecursive(ShaderProgram& shaderProgram, const glm::mat4& parentMatrix, float_t alpha) const {
 	// This object's true model matrix is the combination of its parent's matrix and the object's matrix.
-	glm::mat4 trueModel = parentMatrix * m_modelMatrix;
+	glm::mat4 trueModel = parentMatrix * interpolatedModelMatrix(alpha);
 	shaderProgram.setUniform("model", trueModel);
 	// Render each mesh in the object.
 	for (auto& mesh : m_meshes) {
-		mesh.render(window, shaderProgram);
+		mesh.render(shaderProgram);
 	}
 	// Render the children of the object.
 	for (auto& child : m_children) {
-		child.renderRecursive(window, shaderProgram, trueModel);
+		child.renderRecursive(shaderProgram, trueModel, alpha);
 	}
 }
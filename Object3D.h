@@ -1,8 +1,10 @@
 #pragma once
 #include <memory>
 #include <vector>
+#include <glm/gtc/quaternion.hpp>
 #include "Mesh3D.h"
 #include "ShaderProgram.h"
+#include "ShaderVariants.h"
 /**
  * @brief Represents an object placed in a 3D scene. The object is a node in an hierarchy of
  * objects representing a single 3D model. Each object in the hierarchy has its own position,
@@ -17,6 +19,9 @@ private:
 	// The object's position, orientation, and scale in world space.
 	glm::vec3 m_position;
 	glm::vec3 m_orientation;
+	// An additional rotation applied after the Euler orientation, for animation sources such
+	// as keyframe tracks that describe rotations as quaternions.
+	glm::quat m_rotation;
 	glm::vec3 m_scale;
 	glm::vec3 m_center;
 	glm::vec3 curr_velocity;
@@ -24,6 +29,12 @@ private:
 	glm::vec3 rot_velocity;
 	glm::vec3 rot_acceleration;
 
+	// The transform as of the previous simulation step, for rendering between steps.
+	glm::vec3 m_previousPosition;
+	glm::vec3 m_previousOrientation;
+	glm::quat m_previousRotation;
+	glm::vec3 m_previousScale;
+
 	// The object's cached local->world transformation matrix.
 	glm::mat4 m_modelMatrix;
 	glm::mat4 m_baseTransform;
@@ -33,8 +44,37 @@ private:
 
 	// Recomputes the local->world transformation matrix.
 	void rebuildModelMatrix();
+	// Computes the local->world transformation matrix for the given transform.
+	glm::mat4 buildModelMatrix(const glm::vec3& position, const glm::vec3& orientation,
+		const glm::quat& rotation, const glm::vec3& scale) const;
+	// The number of meshes in this object and its descendants.
+	size_t countMeshes() const;
+	// Writes the true model matrix of each mesh in the hierarchy, one after another, and
+	// appends the mesh in the same order.
+	void writeDraws(const glm::mat4& parentMatrix, float_t alpha, uint8_t*& out,
+		std::vector<const Mesh3D*>& meshes) const;
+	// Writes the model matrices of the objects' hierarchies into the per-draw stream buffer in one
+	// mapping, listing the meshes in the same order, and returns the offset of the first matrix.
+	static size_t streamDraws(const Object3D* objects, size_t count, float_t alpha,
+		std::vector<const Mesh3D*>& meshes);
+	// Renders the objects' meshes, binding one range of the per-draw stream buffer for each batch
+	// of PER_DRAW_CAPACITY draws and setting each draw's index into it.
+	static void renderDraws(const Object3D* objects, size_t count, ShaderProgram& shaderProgram, float_t alpha);
+	static void renderDraws(const Object3D* objects, size_t count, ShaderVariants& variants, float_t alpha);
 
 public:
+	/**
+	 * @brief The uniform block binding of the PerDraw block, which holds the model matrices of a
+	 * batch of draws. Programs with the block read each draw's matrix at the "drawIndex" uniform
+	 * from a stream buffer; programs without it fall back to a "model" uniform.
+	 */
+	static const uint32_t PER_DRAW_BINDING = 2;
+	/**
+	 * @brief The number of model matrices in the PerDraw block, which shaders must declare as
+	 * mat4 models[PER_DRAW_CAPACITY].
+	 */
+	static const uint32_t PER_DRAW_CAPACITY = 64;
+
 	// No default constructor; you must have a mesh to initialize an object.
 	Object3D() = delete;
 
@@ -44,6 +84,7 @@ public:
 	// Simple accessors.
 	const glm::vec3& getPosition() const;
 	const glm::vec3& getOrientation() const;
+	const glm::quat& getRotation() const;
 	const glm::vec3& getScale() const;
 	const glm::vec3& getCenter() const;
 	const std::string& getName() const;
@@ -51,15 +92,32 @@ public:
 	const glm::vec3& getAcceleration() const;
 	const glm::vec3& getRotVelocity() const;
 	const glm::vec3& getRotAcceleration() const;
+	// The object's local->parent transformation.
+	const glm::mat4& getModelMatrix() const;
+	// The local->parent transformation the given fraction of the way from the previous transform
+	// to the current one, as the object is rendered between simulation steps.
+	glm::mat4 interpolatedModelMatrix(float_t alpha) const;
+	// The bounds of the meshes of this object and its descendants, in the space that
+	// parentMatrix transforms to; for a model's root object, world space.
+	AABB getBounds(const glm::mat4& parentMatrix = glm::mat4(1)) const;
+
+	// Mesh access.
+	size_t numberOfMeshes() const;
+	const Mesh3D& getMesh(size_t index) const;
+	Mesh3D& getMesh(size_t index);
 
 	// Child management.
 	size_t numberOfChildren() const;
 	const Object3D& getChild(size_t index) const;
 	Object3D& getChild(size_t index);
+	// Finds the first object named `name` in this object's hierarchy, including itself;
+	// nullptr if there is none.
+	Object3D* findByName(const std::string& name);
 
 	// Simple mutators.
 	void setPosition(const glm::vec3& position);
 	void setOrientation(const glm::vec3& orientation);
+	void setRotation(const glm::quat& rotation);
 	void setScale(const glm::vec3& scale);
 	void setCenter(const glm::vec3& center);
 	void setName(const std::string& name);
@@ -67,8 +125,19 @@ public:
 	void setAcceleration(const glm::vec3& acceleration);
 	void setRotVelocity(const glm::vec3& rotVelocity);
 	void setRotAcceleration(const glm::vec3& rotAcceleration);
+	// Replaces the position, orientation, rotation, and scale together, rebuilding the model
+	// matrix once.
+	void setTransform(const glm::vec3& position, const glm::vec3& orientation,
+		const glm::quat& rotation, const glm::vec3& scale);
+	// Replaces the position, orientation, and their velocities together, rebuilding the model
+	// matrix once; for systems that integrate many objects' motion.
+	void setKinematicState(const glm::vec3& position, const glm::vec3& orientation,
+		const glm::vec3& velocity, const glm::vec3& rotVelocity);
 
 	void tick(float_t dt);
+	// Records the current transforms of this object and its descendants as their previous
+	// transforms; call before each simulation step so rendering can interpolate between them.
+	void savePreviousTransform();
 
 	// Transformations.
 	void move(const glm::vec3& offset);
@@ -76,8 +145,23 @@ public:
 	void grow(const glm::vec3& growth);
 	void addChild(Object3D&& child);
 
-	// Rendering.
+	// Rendering. Objects draw to whatever framebuffer is bound, which need not belong to a
+	// window.
 	void render(sf::RenderWindow& window, ShaderProgram& shaderProgram) const;
-	void renderRecursive(sf::RenderWindow& window, ShaderProgram& shaderProgram, const glm::mat4& parentMatrix) const;
+	// Renders the object at the given fraction of the way from its previous transform to its
+	// current one.
+	void render(sf::RenderWindow& window, ShaderProgram& shaderProgram, float_t alpha) const;
+	void render(ShaderProgram& shaderProgram, float_t alpha = 1) const;
+	// Renders each mesh with the variant for its material's features. The variants' shaders
+	// must have the PerDraw block.
+	void render(ShaderVariants& variants, float_t alpha = 1) const;
+	void renderRecursive(ShaderProgram& shaderProgram, const glm::mat4& parentMatrix, float_t alpha = 1) const;
+	// Renders each of the objects, writing the model matrices of all of them in one mapping of
+	// the per-draw stream buffer rather than one per object.
+	static void renderAll(const std::vector<Object3D>& objects, ShaderProgram& shaderProgram, float_t alpha = 1);
+	static void renderAll(const std::vector<Object3D>& objects, ShaderVariants& variants, float_t alpha = 1);
+	// Lets the per-draw stream buffer move on to its next region; call once per frame, before
+	// rendering any object.
+	static void beginFrame();
 
 };
\ No newline at end of file
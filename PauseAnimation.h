@@ -2,15 +2,14 @@
 #include "Object3D.h"
 #include "Animation.h"
 
+/**
+ * @brief Leaves an object unchanged for a duration, delaying the next animation in an Animator.
+ */
 class PauseAnimation : public Animation {
-private:
-	float_t duration;
-
-	void applyAnimation(float_t dt) override {
-		object().move(glm::vec3(0) * duration * dt);
-	}
-
 public:
 	PauseAnimation(Object3D& object, float_t duration) :
-		Animation(object, duration), duration(duration) {}
+		Animation(object, duration) {}
+
+	// A pause has nothing to evaluate; it only occupies time in the sequence.
+	void schedule(AnimationEngine& engine, float_t startTime) override {}
 };
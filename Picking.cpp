@@ -0,0 +1,133 @@
+#include "Picking.h"
+#include <algorithm>
+#include <limits>
+
+namespace {
+	const size_t OBJECTS_PER_LEAF = 2;
+	const size_t STACK_SIZE = 64;
+}
+
+Ray rayFromScreen(const glm::vec2& pixel, const glm::vec2& viewportSize, const glm::mat4& view,
+	const glm::mat4& projection) {
+	float_t x = 2 * pixel.x / viewportSize.x - 1;
+	float_t y = 1 - 2 * pixel.y / viewportSize.y;
+	glm::mat4 inverse = glm::inverse(projection * view);
+	glm::vec4 nearPoint = inverse * glm::vec4(x, y, -1, 1);
+	glm::vec4 farPoint = inverse * glm::vec4(x, y, 1, 1);
+	glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+	glm::vec3 target = glm::vec3(farPoint) / farPoint.w;
+	return Ray{ origin, glm::normalize(target - origin) };
+}
+
+void SceneBVH::collect(Object3D& object, const glm::mat4& parentMatrix) {
+	glm::mat4 world = parentMatrix * object.getModelMatrix();
+	if (object.numberOfMeshes() > 0) {
+		AABB bounds;
+		for (size_t i = 0; i < object.numberOfMeshes(); i++) {
+			bounds.expand(object.getMesh(i).bounds().transformed(world));
+		}
+		m_entries.push_back({ &object, world, bounds });
+	}
+	for (size_t i = 0; i < object.numberOfChildren(); i++) {
+		collect(object.getChild(i), world);
+	}
+}
+
+void SceneBVH::build(std::vector<Object3D>& models) {
+	m_entries.clear();
+	m_nodes.clear();
+	for (auto& model : models) {
+		collect(model, glm::mat4(1));
+	}
+	if (m_entries.empty()) {
+		return;
+	}
+
+	// Scenes have few objects compared to meshes' triangles, so a median split is good enough.
+	struct Task {
+		uint32_t node;
+		size_t begin;
+		size_t end;
+	};
+	m_nodes.push_back({});
+	std::vector<Task> tasks{ { 0, 0, m_entries.size() } };
+	while (!tasks.empty()) {
+		Task task = tasks.back();
+		tasks.pop_back();
+		AABB bounds, centers;
+		for (size_t i = task.begin; i < task.end; i++) {
+			bounds.expand(m_entries[i].bounds);
+			centers.expand(m_entries[i].bounds.center());
+		}
+		Node& node = m_nodes[task.node];
+		node.min = bounds.min;
+		node.max = bounds.max;
+		if (task.end - task.begin <= OBJECTS_PER_LEAF) {
+			node.first = static_cast<uint32_t>(task.begin);
+			node.count = static_cast<uint32_t>(task.end - task.begin);
+			continue;
+		}
+
+		glm::vec3 extent = centers.max - centers.min;
+		int32_t axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+		size_t mid = (task.begin + task.end) / 2;
+		std::nth_element(m_entries.begin() + task.begin, m_entries.begin() + mid,
+			m_entries.begin() + task.end, [axis](const Entry& a, const Entry& b) {
+				return a.bounds.center()[axis] < b.bounds.center()[axis];
+			});
+		uint32_t left = static_cast<uint32_t>(m_nodes.size());
+		node.first = left;
+		node.count = 0;
+		m_nodes.push_back({});
+		m_nodes.push_back({});
+		tasks.push_back({ left, task.begin, mid });
+		tasks.push_back({ left + 1, mid, task.end });
+	}
+}
+
+bool SceneBVH::pickEntry(const Entry& entry, const Ray& ray, PickResult& result) const {
+	// Cast in the object's local space. The direction is not renormalized, so distances along
+	// the local ray equal distances along the world ray.
+	glm::mat4 inverse = glm::inverse(entry.world);
+	Ray local{ glm::vec3(inverse * glm::vec4(ray.origin, 1)), glm::vec3(inverse * glm::vec4(ray.direction, 0)) };
+	bool found = false;
+	for (size_t i = 0; i < entry.object->numberOfMeshes(); i++) {
+		// Skinned meshes have no BVH, since their triangles move with their joints.
+		const TriangleBVH* bvh = entry.object->getMesh(i).bvh();
+		RayHit hit{ result.distance, 0, 0, 0 };
+		if (bvh != nullptr && bvh->intersect(local, hit)) {
+			result = { entry.object, i, hit.triangle, hit.distance, ray.origin + ray.direction * hit.distance };
+			found = true;
+		}
+	}
+	return found;
+}
+
+bool SceneBVH::pick(const Ray& ray, PickResult& result) const {
+	if (m_nodes.empty()) {
+		return false;
+	}
+	glm::vec3 inverseDirection = 1.0f / ray.direction;
+	const float_t infinity = std::numeric_limits<float_t>::infinity();
+	result.distance = infinity;
+
+	bool found = false;
+	uint32_t stack[STACK_SIZE];
+	size_t stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0) {
+		const Node& node = m_nodes[stack[--stackSize]];
+		if (rayEnterDistance(node.min, node.max, ray.origin, inverseDirection, result.distance) == infinity) {
+			continue;
+		}
+		if (node.count > 0) {
+			for (uint32_t i = node.first; i < node.first + node.count; i++) {
+				found |= pickEntry(m_entries[i], ray, result);
+			}
+			continue;
+		}
+		stack[stackSize++] = node.first + 1;
+		stack[stackSize++] = node.first;
+	}
+	return found;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <vector>
+#include "Object3D.h"
+#include "TriangleBVH.h"
+
+/**
+ * @brief The nearest triangle under a ray: the object and mesh it belongs to, its index in the
+ * mesh's face list, and where the ray hit it in world space.
+ */
+struct PickResult {
+	Object3D* object;
+	size_t mesh;
+	uint32_t triangle;
+	float_t distance;
+	glm::vec3 point;
+};
+
+/**
+ * @brief The world-space ray through a pixel of a viewport, from the near plane of the given
+ * camera towards its far plane. Pixels are measured from the top left, as in sf::Mouse.
+ */
+Ray rayFromScreen(const glm::vec2& pixel, const glm::vec2& viewportSize, const glm::mat4& view,
+	const glm::mat4& projection);
+
+/**
+ * @brief A BVH over the world bounds of every object in a scene, for finding the triangle
+ * under a ray. Objects whose bounds the ray reaches are tested with their meshes' own
+ * TriangleBVHs, so a pick costs a few box tests plus a few triangle packets per mesh hit. Each
+ * mesh's BVH is built the first time the ray reaches it; skinned meshes are never hit.
+ *
+ * The tree is a snapshot of the objects' transforms; rebuild it after objects move.
+ */
+class SceneBVH {
+private:
+	struct Entry {
+		Object3D* object;
+		glm::mat4 world;
+		AABB bounds;
+	};
+
+	// Leaves hold the entries [first, first + count); interior nodes have count 0 and their
+	// children are adjacent, starting at first.
+	struct Node {
+		glm::vec3 min;
+		uint32_t first;
+		glm::vec3 max;
+		uint32_t count;
+	};
+
+	std::vector<Entry> m_entries;
+	std::vector<Node> m_nodes;
+
+	void collect(Object3D& object, const glm::mat4& parentMatrix);
+	bool pickEntry(const Entry& entry, const Ray& ray, PickResult& result) const;
+
+public:
+	/**
+	 * @brief Rebuilds the tree over every object (with meshes) of the given models, using their
+	 * current transforms.
+	 */
+	void build(std::vector<Object3D>& models);
+
+	size_t numberOfObjects() const { return m_entries.size(); }
+
+	/**
+	 * @brief Finds the nearest triangle hit by a world-space ray. Returns false if the ray hits
+	 * nothing.
+	 */
+	bool pick(const Ray& ray, PickResult& result) const;
+};
@@ -0,0 +1,157 @@
+#include "Pose.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define POSE_SSE 1
+#include <emmintrin.h>
+static_assert(sizeof(float_t) == sizeof(float), "SSE pose blending requires float_t to be float");
+#endif
+
+void Pose::resize(size_t boneCount) {
+	m_boneCount = boneCount;
+	size_t padded = (boneCount + 3) / 4 * 4;
+	for (auto* component : { &tx, &ty, &tz, &rx, &ry, &rz }) {
+		component->assign(padded, 0);
+	}
+	for (auto* component : { &rw, &sx, &sy, &sz }) {
+		component->assign(padded, 1);
+	}
+}
+
+void Pose::makeAdditive(const Pose& reference) {
+	for (size_t i = 0; i < m_boneCount; i++) {
+		setPosition(i, position(i) - reference.position(i));
+		setRotation(i, glm::normalize(rotation(i) * glm::inverse(reference.rotation(i))));
+		setScale(i, scale(i) / reference.scale(i));
+	}
+}
+
+#ifdef POSE_SSE
+namespace {
+	inline void lerp4(const float_t* a, const float_t* b, __m128 w, float_t* out) {
+		__m128 va = _mm_loadu_ps(a);
+		_mm_storeu_ps(out, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b), va), w)));
+	}
+
+	inline __m128 inverseLength(__m128 x, __m128 y, __m128 z, __m128 w) {
+		__m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+			_mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w)));
+		return _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(lengthSquared));
+	}
+}
+
+void Pose::blend(const Pose& a, const Pose& b, const float_t* weights, Pose& out) {
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+	for (size_t i = 0; i < out.paddedCount(); i += 4) {
+		__m128 w = _mm_loadu_ps(weights + i);
+		lerp4(&a.tx[i], &b.tx[i], w, &out.tx[i]);
+		lerp4(&a.ty[i], &b.ty[i], w, &out.ty[i]);
+		lerp4(&a.tz[i], &b.tz[i], w, &out.tz[i]);
+		lerp4(&a.sx[i], &b.sx[i], w, &out.sx[i]);
+		lerp4(&a.sy[i], &b.sy[i], w, &out.sy[i]);
+		lerp4(&a.sz[i], &b.sz[i], w, &out.sz[i]);
+
+		__m128 ax = _mm_loadu_ps(&a.rx[i]), ay = _mm_loadu_ps(&a.ry[i]);
+		__m128 az = _mm_loadu_ps(&a.rz[i]), aw = _mm_loadu_ps(&a.rw[i]);
+		__m128 bx = _mm_loadu_ps(&b.rx[i]), by = _mm_loadu_ps(&b.ry[i]);
+		__m128 bz = _mm_loadu_ps(&b.rz[i]), bw = _mm_loadu_ps(&b.rw[i]);
+		// Negate b wherever it is in the opposite hemisphere from a.
+		__m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)),
+			_mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+		__m128 flip = _mm_and_ps(_mm_cmplt_ps(dot, _mm_setzero_ps()), signBit);
+		bx = _mm_xor_ps(bx, flip);
+		by = _mm_xor_ps(by, flip);
+		bz = _mm_xor_ps(bz, flip);
+		bw = _mm_xor_ps(bw, flip);
+
+		__m128 x = _mm_add_ps(ax, _mm_mul_ps(_mm_sub_ps(bx, ax), w));
+		__m128 y = _mm_add_ps(ay, _mm_mul_ps(_mm_sub_ps(by, ay), w));
+		__m128 z = _mm_add_ps(az, _mm_mul_ps(_mm_sub_ps(bz, az), w));
+		__m128 rw = _mm_add_ps(aw, _mm_mul_ps(_mm_sub_ps(bw, aw), w));
+		__m128 scale = inverseLength(x, y, z, rw);
+		_mm_storeu_ps(&out.rx[i], _mm_mul_ps(x, scale));
+		_mm_storeu_ps(&out.ry[i], _mm_mul_ps(y, scale));
+		_mm_storeu_ps(&out.rz[i], _mm_mul_ps(z, scale));
+		_mm_storeu_ps(&out.rw[i], _mm_mul_ps(rw, scale));
+	}
+}
+
+void Pose::add(const Pose& base, const Pose& additive, const float_t* weights, Pose& out) {
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+	for (size_t i = 0; i < out.paddedCount(); i += 4) {
+		__m128 w = _mm_loadu_ps(weights + i);
+		_mm_storeu_ps(&out.tx[i], _mm_add_ps(_mm_loadu_ps(&base.tx[i]), _mm_mul_ps(_mm_loadu_ps(&additive.tx[i]), w)));
+		_mm_storeu_ps(&out.ty[i], _mm_add_ps(_mm_loadu_ps(&base.ty[i]), _mm_mul_ps(_mm_loadu_ps(&additive.ty[i]), w)));
+		_mm_storeu_ps(&out.tz[i], _mm_add_ps(_mm_loadu_ps(&base.tz[i]), _mm_mul_ps(_mm_loadu_ps(&additive.tz[i]), w)));
+		// Scale by a ratio lerped from 1.
+		_mm_storeu_ps(&out.sx[i], _mm_mul_ps(_mm_loadu_ps(&base.sx[i]),
+			_mm_add_ps(one, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&additive.sx[i]), one), w))));
+		_mm_storeu_ps(&out.sy[i], _mm_mul_ps(_mm_loadu_ps(&base.sy[i]),
+			_mm_add_ps(one, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&additive.sy[i]), one), w))));
+		_mm_storeu_ps(&out.sz[i], _mm_mul_ps(_mm_loadu_ps(&base.sz[i]),
+			_mm_add_ps(one, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&additive.sz[i]), one), w))));
+
+		// Lerp the additive rotation from identity along the shorter arc, then normalize.
+		__m128 dx = _mm_loadu_ps(&additive.rx[i]), dy = _mm_loadu_ps(&additive.ry[i]);
+		__m128 dz = _mm_loadu_ps(&additive.rz[i]), dw = _mm_loadu_ps(&additive.rw[i]);
+		__m128 flip = _mm_and_ps(_mm_cmplt_ps(dw, _mm_setzero_ps()), signBit);
+		dx = _mm_mul_ps(_mm_xor_ps(dx, flip), w);
+		dy = _mm_mul_ps(_mm_xor_ps(dy, flip), w);
+		dz = _mm_mul_ps(_mm_xor_ps(dz, flip), w);
+		dw = _mm_add_ps(one, _mm_mul_ps(_mm_sub_ps(_mm_xor_ps(dw, flip), one), w));
+		__m128 scale = inverseLength(dx, dy, dz, dw);
+		dx = _mm_mul_ps(dx, scale);
+		dy = _mm_mul_ps(dy, scale);
+		dz = _mm_mul_ps(dz, scale);
+		dw = _mm_mul_ps(dw, scale);
+
+		// out = d * base
+		__m128 bx = _mm_loadu_ps(&base.rx[i]), by = _mm_loadu_ps(&base.ry[i]);
+		__m128 bz = _mm_loadu_ps(&base.rz[i]), bw = _mm_loadu_ps(&base.rw[i]);
+		__m128 x = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dw, bx), _mm_mul_ps(dx, bw)),
+			_mm_sub_ps(_mm_mul_ps(dy, bz), _mm_mul_ps(dz, by)));
+		__m128 y = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(dw, by), _mm_mul_ps(dx, bz)),
+			_mm_add_ps(_mm_mul_ps(dy, bw), _mm_mul_ps(dz, bx)));
+		__m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dw, bz), _mm_mul_ps(dx, by)),
+			_mm_sub_ps(_mm_mul_ps(dz, bw), _mm_mul_ps(dy, bx)));
+		__m128 rw = _mm_sub_ps(_mm_sub_ps(_mm_mul_ps(dw, bw), _mm_mul_ps(dx, bx)),
+			_mm_add_ps(_mm_mul_ps(dy, by), _mm_mul_ps(dz, bz)));
+		_mm_storeu_ps(&out.rx[i], x);
+		_mm_storeu_ps(&out.ry[i], y);
+		_mm_storeu_ps(&out.rz[i], z);
+		_mm_storeu_ps(&out.rw[i], rw);
+	}
+}
+
+#else
+
+void Pose::blend(const Pose& a, const Pose& b, const float_t* weights, Pose& out) {
+	for (size_t i = 0; i < out.paddedCount(); i++) {
+		float_t w = weights[i];
+		out.setPosition(i, glm::mix(a.position(i), b.position(i), w));
+		out.setScale(i, glm::mix(a.scale(i), b.scale(i), w));
+		glm::quat ra = a.rotation(i);
+		glm::quat rb = b.rotation(i);
+		if (glm::dot(ra, rb) < 0) {
+			rb = -rb;
+		}
+		out.setRotation(i, glm::normalize(ra + (rb - ra) * w));
+	}
+}
+
+void Pose::add(const Pose& base, const Pose& additive, const float_t* weights, Pose& out) {
+	for (size_t i = 0; i < out.paddedCount(); i++) {
+		float_t w = weights[i];
+		out.setPosition(i, base.position(i) + additive.position(i) * w);
+		out.setScale(i, base.scale(i) * glm::mix(glm::vec3(1), additive.scale(i), w));
+		glm::quat d = additive.rotation(i);
+		if (d.w < 0) {
+			d = -d;
+		}
+		glm::quat identity(1, 0, 0, 0);
+		d = glm::normalize(identity + (d - identity) * w);
+		out.setRotation(i, d * base.rotation(i));
+	}
+}
+
+#endif
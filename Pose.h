@@ -0,0 +1,62 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+/**
+ * @brief The local position, rotation, and scale of every bone of a skeleton, stored as one
+ * array per component so that poses can be blended four bones at a time with SSE.
+ *
+ * The arrays are padded to a multiple of four with identity transforms, so the blending loops
+ * never need a scalar tail.
+ */
+class Pose {
+private:
+	size_t m_boneCount;
+
+public:
+	std::vector<float_t> tx, ty, tz;
+	std::vector<float_t> rx, ry, rz, rw;
+	std::vector<float_t> sx, sy, sz;
+
+	Pose() : m_boneCount(0) {}
+	explicit Pose(size_t boneCount) : m_boneCount(0) { resize(boneCount); }
+
+	/**
+	 * @brief Resizes the pose; every bone is reset to the identity transform.
+	 */
+	void resize(size_t boneCount);
+
+	size_t boneCount() const { return m_boneCount; }
+	/**
+	 * @brief The length of each component array: the bone count rounded up to a multiple of 4.
+	 */
+	size_t paddedCount() const { return tx.size(); }
+
+	glm::vec3 position(size_t bone) const { return glm::vec3(tx[bone], ty[bone], tz[bone]); }
+	glm::quat rotation(size_t bone) const { return glm::quat(rw[bone], rx[bone], ry[bone], rz[bone]); }
+	glm::vec3 scale(size_t bone) const { return glm::vec3(sx[bone], sy[bone], sz[bone]); }
+
+	void setPosition(size_t bone, const glm::vec3& p) { tx[bone] = p.x; ty[bone] = p.y; tz[bone] = p.z; }
+	void setRotation(size_t bone, const glm::quat& r) { rx[bone] = r.x; ry[bone] = r.y; rz[bone] = r.z; rw[bone] = r.w; }
+	void setScale(size_t bone, const glm::vec3& s) { sx[bone] = s.x; sy[bone] = s.y; sz[bone] = s.z; }
+
+	/**
+	 * @brief Converts this pose into the difference from a reference pose, for use as an
+	 * additive layer: translations become offsets, rotations become r * inverse(reference),
+	 * and scales become ratios.
+	 */
+	void makeAdditive(const Pose& reference);
+
+	/**
+	 * @brief Blends from pose a towards pose b by a per-bone weight in [0, 1], writing the
+	 * result to out. Rotations are normalized-lerped along the shorter arc. out may be a or b.
+	 */
+	static void blend(const Pose& a, const Pose& b, const float_t* weights, Pose& out);
+
+	/**
+	 * @brief Applies an additive pose (see makeAdditive) on top of a base pose, scaled by a
+	 * per-bone weight in [0, 1], writing the result to out. out may be base.
+	 */
+	static void add(const Pose& base, const Pose& additive, const float_t* weights, Pose& out);
+};
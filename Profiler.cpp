@@ -0,0 +1,241 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <iomanip>
+#include "glad.h"
+
+namespace {
+	void writeJsonString(std::ostream& out, const char* text) {
+		out << '"';
+		for (const char* c = text; *c != '\0'; c++) {
+			if (*c == '"' || *c == '\\') {
+				out << '\\';
+			}
+			out << *c;
+		}
+		out << '"';
+	}
+}
+
+Profiler::Profiler() : m_frameCount(0), m_frameStart(profilerTicks()), m_gpuDepth(0), m_capturing(false),
+	m_calibrationTicks(profilerTicks()), m_calibrationTime(std::chrono::steady_clock::now()) {
+}
+
+Profiler& Profiler::instance() {
+	static Profiler profiler;
+	return profiler;
+}
+
+Profiler::ThreadBuffer& Profiler::threadBuffer() {
+	// Releases the thread's buffer when the thread exits.
+	struct Owner {
+		ThreadBuffer* buffer = nullptr;
+		~Owner() {
+			if (buffer != nullptr) {
+				buffer->inUse.store(false, std::memory_order_release);
+			}
+		}
+	};
+	thread_local Owner owner;
+	if (owner.buffer == nullptr) {
+		std::lock_guard<std::mutex> lock(m_threadsMutex);
+		for (auto& buffer : m_threads) {
+			if (!buffer->inUse.load(std::memory_order_acquire)) {
+				buffer->inUse.store(true, std::memory_order_relaxed);
+				owner.buffer = buffer.get();
+				return *owner.buffer;
+			}
+		}
+		// Thread ids start at 1; 0 is the GPU.
+		m_threads.push_back(std::make_unique<ThreadBuffer>(static_cast<uint32_t>(m_threads.size() + 1)));
+		owner.buffer = m_threads.back().get();
+	}
+	return *owner.buffer;
+}
+
+void Profiler::record(const char* name, uint64_t start, uint64_t end) {
+	ThreadBuffer& buffer = threadBuffer();
+	uint64_t written = buffer.written.load(std::memory_order_relaxed);
+	buffer.events[written % EVENTS_PER_THREAD] = { name, start, end };
+	buffer.written.store(written + 1, std::memory_order_release);
+}
+
+double Profiler::ticksPerSecond() const {
+#ifdef PROFILER_HAS_TSC
+	// The counter runs at a constant rate on every processor of the last decade; measure it
+	// over the whole time the profiler has existed.
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_calibrationTime).count();
+	uint64_t ticks = profilerTicks() - m_calibrationTicks;
+	return seconds > 0 && ticks > 0 ? ticks / seconds : 1e9;
+#else
+	return 1e9;
+#endif
+}
+
+Profiler::ScopeHistory& Profiler::scope(std::vector<ScopeHistory>& scopes,
+	std::unordered_map<std::string, size_t>& index, const char* name) {
+	auto existing = index.find(name);
+	if (existing != index.end()) {
+		return scopes[existing->second];
+	}
+	index.emplace(name, scopes.size());
+	scopes.push_back({ name, std::vector<double>(FRAME_HISTORY, 0), std::vector<uint32_t>(FRAME_HISTORY, 0), 0, 0 });
+	return scopes.back();
+}
+
+void Profiler::drainThreads() {
+	double secondsPerTick = 1 / ticksPerSecond();
+	std::lock_guard<std::mutex> lock(m_threadsMutex);
+	for (auto& buffer : m_threads) {
+		uint64_t written = buffer->written.load(std::memory_order_acquire);
+		uint64_t first = std::max(buffer->read, written > EVENTS_PER_THREAD ? written - EVENTS_PER_THREAD : 0);
+		for (uint64_t i = first; i < written; i++) {
+			const Event& event = buffer->events[i % EVENTS_PER_THREAD];
+			ScopeHistory& history = scope(m_cpuScopes, m_cpuIndex, event.name);
+			history.frameSeconds += (event.end - event.start) * secondsPerTick;
+			history.frameCalls++;
+			if (m_capturing && m_captured.size() < MAX_CAPTURED_EVENTS) {
+				m_captured.push_back({ event.name, buffer->threadId, event.start, event.end });
+			}
+		}
+		buffer->read = written;
+	}
+}
+
+void Profiler::beginGpuPass(const char* name) {
+	if (m_gpuDepth++ > 0) {
+		return;
+	}
+	size_t slot = m_frameCount % GPU_FRAMES_IN_FLIGHT;
+	auto& queries = m_gpuFrames[slot];
+	auto& pool = m_gpuQueryPools[slot];
+	if (queries.size() == pool.size()) {
+		uint32_t query;
+		glGenQueries(1, &query);
+		pool.push_back(query);
+	}
+	uint32_t query = pool[queries.size()];
+	queries.push_back({ name, query, profilerTicks() });
+	glBeginQuery(GL_TIME_ELAPSED, query);
+}
+
+void Profiler::endGpuPass() {
+	if (m_gpuDepth == 0 || --m_gpuDepth > 0) {
+		return;
+	}
+	glEndQuery(GL_TIME_ELAPSED);
+}
+
+void Profiler::collectGpuFrame(size_t slot) {
+	for (auto& pass : m_gpuFrames[slot]) {
+		int32_t available = 0;
+		glGetQueryObjectiv(pass.query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			// The GPU is more than GPU_FRAMES_IN_FLIGHT frames behind. Waiting would stall
+			// the CPU, so the pass is dropped instead.
+			continue;
+		}
+		uint64_t nanoseconds = 0;
+		glGetQueryObjectui64v(pass.query, GL_QUERY_RESULT, &nanoseconds);
+		ScopeHistory& history = scope(m_gpuScopes, m_gpuIndex, pass.name);
+		history.frameSeconds += nanoseconds * 1e-9;
+		history.frameCalls++;
+		if (m_capturing && m_captured.size() < MAX_CAPTURED_EVENTS) {
+			uint64_t ticks = static_cast<uint64_t>(nanoseconds * 1e-9 * ticksPerSecond());
+			m_captured.push_back({ pass.name, GPU_THREAD, pass.cpuStart, pass.cpuStart + ticks });
+		}
+	}
+	m_gpuFrames[slot].clear();
+}
+
+void Profiler::pushHistories(std::vector<ScopeHistory>& scopes) {
+	size_t at = m_frameCount % FRAME_HISTORY;
+	for (auto& history : scopes) {
+		history.seconds[at] = history.frameSeconds;
+		history.calls[at] = history.frameCalls;
+		history.frameSeconds = 0;
+		history.frameCalls = 0;
+	}
+}
+
+void Profiler::endFrame() {
+	if (m_gpuDepth > 0) {
+		m_gpuDepth = 1;
+		endGpuPass();
+	}
+	uint64_t now = profilerTicks();
+	record("frame", m_frameStart, now);
+	m_frameStart = now;
+
+	drainThreads();
+	// Read back the oldest frame's passes, whose slot the next frame reuses.
+	collectGpuFrame((m_frameCount + 1) % GPU_FRAMES_IN_FLIGHT);
+	pushHistories(m_cpuScopes);
+	pushHistories(m_gpuScopes);
+	m_frameCount++;
+}
+
+std::vector<Profiler::ScopeStats> Profiler::stats(const std::vector<ScopeHistory>& scopes) const {
+	std::vector<ScopeStats> result;
+	size_t frames = static_cast<size_t>(std::min<uint64_t>(m_frameCount, FRAME_HISTORY));
+	if (frames == 0) {
+		return result;
+	}
+	std::vector<double> sorted;
+	for (auto& history : scopes) {
+		sorted.assign(history.seconds.begin(), history.seconds.begin() + frames);
+		std::sort(sorted.begin(), sorted.end());
+		double total = 0;
+		uint64_t calls = 0;
+		for (size_t i = 0; i < frames; i++) {
+			total += sorted[i];
+			calls += history.calls[i];
+		}
+		size_t p99 = std::min(frames - 1, static_cast<size_t>(frames * 0.99));
+		result.push_back({ history.name, static_cast<double>(calls) / frames, sorted.front() * 1000,
+			total / frames * 1000, sorted[p99] * 1000 });
+	}
+	std::sort(result.begin(), result.end(),
+		[](const ScopeStats& a, const ScopeStats& b) { return a.averageMs > b.averageMs; });
+	return result;
+}
+
+void Profiler::report(std::ostream& out) const {
+	auto print = [&](const char* title, const std::vector<ScopeStats>& scopes) {
+		out << title << " (ms per frame over " << std::min<uint64_t>(m_frameCount, FRAME_HISTORY) << " frames):\n";
+		out << "  " << std::left << std::setw(32) << "scope" << std::right << std::setw(10) << "calls"
+			<< std::setw(10) << "min" << std::setw(10) << "avg" << std::setw(10) << "p99" << "\n";
+		for (auto& s : scopes) {
+			out << "  " << std::left << std::setw(32) << s.name << std::right << std::fixed << std::setprecision(3)
+				<< std::setw(10) << s.callsPerFrame << std::setw(10) << s.minMs << std::setw(10) << s.averageMs
+				<< std::setw(10) << s.p99Ms << "\n";
+		}
+	};
+	print("CPU", cpuStats());
+	print("GPU", gpuStats());
+}
+
+void Profiler::startCapture() {
+	m_captured.clear();
+	m_capturing = true;
+}
+
+void Profiler::writeChromeTrace(std::ostream& out) const {
+	double microsecondsPerTick = 1e6 / ticksPerSecond();
+	uint64_t origin = m_captured.empty() ? 0 : m_captured.front().start;
+	for (auto& event : m_captured) {
+		origin = std::min(origin, event.start);
+	}
+
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << GPU_THREAD
+		<< ",\"args\":{\"name\":\"GPU\"}}";
+	out << std::fixed << std::setprecision(3);
+	for (auto& event : m_captured) {
+		out << ",\n{\"name\":";
+		writeJsonString(out, event.name);
+		out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.threadId
+			<< ",\"ts\":" << (event.start - origin) * microsecondsPerTick
+			<< ",\"dur\":" << (event.end - event.start) * microsecondsPerTick << "}";
+	}
+	out << "\n]}\n";
+}
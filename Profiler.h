@@ -0,0 +1,243 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define PROFILER_HAS_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILER_HAS_TSC
+#endif
+
+/**
+ * @brief The profiler's clock: the CPU's time stamp counter where there is one, which costs a
+ * few nanoseconds to read, or a steady clock in nanoseconds otherwise. Ticks are converted to
+ * seconds by Profiler::ticksPerSecond.
+ */
+inline uint64_t profilerTicks() {
+#ifdef PROFILER_HAS_TSC
+	return __rdtsc();
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/**
+ * @brief Where the frame time goes, on the CPU and on the GPU.
+ *
+ * CPU scopes (ProfileScope, PROFILE_SCOPE) are recorded into a ring buffer owned by the thread
+ * that runs them, so recording takes no locks; the rendering thread drains every ring once per
+ * frame in endFrame. GPU passes (GpuProfileScope) are timed with GL_TIME_ELAPSED queries kept
+ * in a ring several frames deep, and each frame's queries are only read once the GPU has
+ * finished them, so timing never stalls the pipeline. GPU passes must not nest.
+ *
+ * Every scope's total time per frame is kept for the last FRAME_HISTORY frames, for reports of
+ * its minimum, average, and 99th percentile. While a capture is running, every event is also
+ * kept for export in the Chrome trace format (chrome://tracing, or ui.perfetto.dev).
+ *
+ * Call endFrame, the GPU functions, and the reporting functions from the rendering thread.
+ */
+class Profiler {
+public:
+	struct ScopeStats {
+		std::string name;
+		double callsPerFrame;
+		double minMs;
+		double averageMs;
+		double p99Ms;
+	};
+
+	static const size_t EVENTS_PER_THREAD = 1 << 16;
+	static const size_t FRAME_HISTORY = 256;
+	static const size_t GPU_FRAMES_IN_FLIGHT = 4;
+	// Captures stop growing past this many events.
+	static const size_t MAX_CAPTURED_EVENTS = 1 << 22;
+
+private:
+	struct Event {
+		const char* name;
+		uint64_t start;
+		uint64_t end;
+	};
+
+	// A single-producer ring: only its thread writes events, and only the rendering thread
+	// reads them. Events the reader has not drained before the ring wraps are lost. When its
+	// thread exits, the buffer is handed to the next new thread.
+	struct ThreadBuffer {
+		uint32_t threadId;
+		std::vector<Event> events;
+		std::atomic<uint64_t> written;
+		uint64_t read;
+		std::atomic<bool> inUse;
+
+		explicit ThreadBuffer(uint32_t id) : threadId(id), events(EVENTS_PER_THREAD), written(0), read(0),
+			inUse(true) {}
+	};
+
+	struct ScopeHistory {
+		std::string name;
+		// Totals in seconds and call counts of the last FRAME_HISTORY frames, as rings.
+		std::vector<double> seconds;
+		std::vector<uint32_t> calls;
+		double frameSeconds;
+		uint32_t frameCalls;
+	};
+
+	struct CapturedEvent {
+		const char* name;
+		uint32_t threadId;
+		uint64_t start;
+		uint64_t end;
+	};
+
+	struct GpuQuery {
+		const char* name;
+		uint32_t query;
+		uint64_t cpuStart;
+	};
+
+	std::mutex m_threadsMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> m_threads;
+
+	std::vector<ScopeHistory> m_cpuScopes;
+	std::vector<ScopeHistory> m_gpuScopes;
+	std::unordered_map<std::string, size_t> m_cpuIndex;
+	std::unordered_map<std::string, size_t> m_gpuIndex;
+	uint64_t m_frameCount;
+	uint64_t m_frameStart;
+
+	// The queries issued in each of the last GPU_FRAMES_IN_FLIGHT frames, and the ids of every
+	// query created for that frame's slot, which are reused.
+	std::vector<GpuQuery> m_gpuFrames[GPU_FRAMES_IN_FLIGHT];
+	std::vector<uint32_t> m_gpuQueryPools[GPU_FRAMES_IN_FLIGHT];
+	int32_t m_gpuDepth;
+
+	bool m_capturing;
+	std::vector<CapturedEvent> m_captured;
+
+	uint64_t m_calibrationTicks;
+	std::chrono::steady_clock::time_point m_calibrationTime;
+
+	Profiler();
+
+	ThreadBuffer& threadBuffer();
+	ScopeHistory& scope(std::vector<ScopeHistory>& scopes, std::unordered_map<std::string, size_t>& index,
+		const char* name);
+	void drainThreads();
+	void collectGpuFrame(size_t slot);
+	void pushHistories(std::vector<ScopeHistory>& scopes);
+	std::vector<ScopeStats> stats(const std::vector<ScopeHistory>& scopes) const;
+
+public:
+	// The thread id given to GPU passes in traces.
+	static const uint32_t GPU_THREAD = 0;
+
+	static Profiler& instance();
+
+	Profiler(const Profiler&) = delete;
+	Profiler& operator=(const Profiler&) = delete;
+
+	/**
+	 * @brief Records a finished CPU scope on the calling thread. name must outlive the profiler,
+	 * as string literals do.
+	 */
+	void record(const char* name, uint64_t start, uint64_t end);
+
+	/**
+	 * @brief Starts and ends timing a GPU pass. Nested passes are ignored.
+	 */
+	void beginGpuPass(const char* name);
+	void endGpuPass();
+
+	/**
+	 * @brief Ends the current frame: records it as the "frame" scope, gathers the CPU events of
+	 * every thread and the GPU passes that have finished, and starts the next frame.
+	 */
+	void endFrame();
+
+	uint64_t frameCount() const { return m_frameCount; }
+
+	/**
+	 * @brief The rate of profilerTicks, measured against the system's steady clock.
+	 */
+	double ticksPerSecond() const;
+
+	std::vector<ScopeStats> cpuStats() const { return stats(m_cpuScopes); }
+	std::vector<ScopeStats> gpuStats() const { return stats(m_gpuScopes); }
+
+	/**
+	 * @brief Prints every CPU scope and GPU pass, per frame, over the recent frames.
+	 */
+	void report(std::ostream& out) const;
+
+	void startCapture();
+	void stopCapture() { m_capturing = false; }
+	bool isCapturing() const { return m_capturing; }
+
+	/**
+	 * @brief Writes the events of the last capture as a Chrome trace. GPU passes appear on their
+	 * own thread, starting when the CPU issued them.
+	 */
+	void writeChromeTrace(std::ostream& out) const;
+};
+
+/**
+ * @brief Times the enclosing scope on the CPU.
+ */
+class ProfileScope {
+private:
+	const char* m_name;
+	uint64_t m_start;
+
+public:
+	explicit ProfileScope(const char* name) : m_name(name), m_start(profilerTicks()) {}
+	~ProfileScope() { Profiler::instance().record(m_name, m_start, profilerTicks()); }
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+/**
+ * @brief Times the enclosing scope's OpenGL commands on the GPU.
+ */
+class GpuProfileScope {
+public:
+	explicit GpuProfileScope(const char* name) { Profiler::instance().beginGpuPass(name); }
+	~GpuProfileScope() { Profiler::instance().endGpuPass(); }
+
+	GpuProfileScope(const GpuProfileScope&) = delete;
+	GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+/**
+ * @brief Times the rest of the enclosing block under the given string literal.
+ */
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(name)
+
+// Define PROFILE_DRAWS_ENABLED as 1 to also time each mesh drawn, which costs two clock reads
+// and a record per draw.
+#ifndef PROFILE_DRAWS_ENABLED
+#define PROFILE_DRAWS_ENABLED 0
+#endif
+
+/**
+ * @brief Times the rest of the enclosing block, like PROFILE_SCOPE, when per-draw profiling is
+ * enabled; otherwise does nothing.
+ */
+#if PROFILE_DRAWS_ENABLED
+#define PROFILE_DRAW_SCOPE(name) PROFILE_SCOPE(name)
+#else
+#define PROFILE_DRAW_SCOPE(name) ((void)0)
+#endif
@@ -0,0 +1,28 @@
+#include "RenderStats.h"
+#include <sstream>
+
+namespace {
+	RenderStats currentStats;
+	RenderStats lastFrameStats;
+}
+
+RenderStats& RenderStats::current() {
+	return currentStats;
+}
+
+const RenderStats& RenderStats::lastFrame() {
+	return lastFrameStats;
+}
+
+void RenderStats::endFrame() {
+	lastFrameStats = currentStats;
+	currentStats.reset();
+}
+
+std::string RenderStats::summary() const {
+	std::ostringstream out;
+	out << drawCalls << " draws, " << triangles << " tris, " << vertices << " verts, "
+		<< programBinds << " programs, " << vertexArrayBinds << " VAOs, " << textureBinds << " textures, "
+		<< uniformUploads << " uniforms, " << bufferBytesUploaded / 1024 << " KB uploaded";
+	return out.str();
+}
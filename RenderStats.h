@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Define RENDER_STATS_ENABLED as 0 to compile the counters out entirely.
+#ifndef RENDER_STATS_ENABLED
+#define RENDER_STATS_ENABLED 1
+#endif
+
+/**
+ * @brief Counts the rendering work submitted to OpenGL in a frame: draws, the geometry they
+ * submit, state changes, uniform uploads, and bytes uploaded to buffers and textures. The
+ * counters are incremented by Mesh3D, ShaderProgram, Texture, and SkinningSystem on the
+ * rendering thread; call endFrame once per frame to publish them as lastFrame().
+ */
+struct RenderStats {
+	uint64_t drawCalls;
+	uint64_t triangles;
+	uint64_t vertices;
+	uint64_t programBinds;
+	uint64_t vertexArrayBinds;
+	uint64_t textureBinds;
+	uint64_t uniformUploads;
+	uint64_t bufferBytesUploaded;
+
+	RenderStats() { reset(); }
+
+	void reset() {
+		drawCalls = 0;
+		triangles = 0;
+		vertices = 0;
+		programBinds = 0;
+		vertexArrayBinds = 0;
+		textureBinds = 0;
+		uniformUploads = 0;
+		bufferBytesUploaded = 0;
+	}
+
+	/**
+	 * @brief One line listing every counter, for logs and the window title.
+	 */
+	std::string summary() const;
+
+	/**
+	 * @brief The counters of the frame in progress.
+	 */
+	static RenderStats& current();
+	/**
+	 * @brief The counters of the last finished frame.
+	 */
+	static const RenderStats& lastFrame();
+	/**
+	 * @brief Publishes the current counters as lastFrame() and starts counting a new frame.
+	 */
+	static void endFrame();
+};
+
+#if RENDER_STATS_ENABLED
+#define RENDER_STATS_ADD(counter, amount) (RenderStats::current().counter += (amount))
+#else
+#define RENDER_STATS_ADD(counter, amount) ((void)0)
+#endif
@@ -7,16 +7,9 @@
 class RotationAnimation : public Animation {
 private:
 	/**
-	 * @brief How much to increment the orientation by each second.
+	 * @brief The total rotation to apply over the animation's duration.
 	 */
-	glm::vec3 m_perSecond;
-
-	/**
-	 * @brief Advance the animation by the given time interval.
-	 */
-	void applyAnimation(float_t dt) override {
-		object().rotate(m_perSecond * dt);
-	}
+	glm::vec3 m_totalRotation;
 
 public:
 	/**
@@ -24,6 +17,10 @@ public:
 	 * angle, linearly interpolated across the given duration.
 	 */
 	RotationAnimation(Object3D& object, float_t duration, const glm::vec3& totalRotation) : 
-		Animation(object, duration), m_perSecond(totalRotation / duration) {}
+		Animation(object, duration), m_totalRotation(totalRotation) {}
+
+	void schedule(AnimationEngine& engine, float_t startTime) override {
+		engine.addRotation(object(), startTime, duration(), m_totalRotation);
+	}
 };
 
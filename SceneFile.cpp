@@ -0,0 +1,379 @@
+#include "SceneFile.h"
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+	/**
+	 * @brief Splits a line into whitespace-separated tokens, stopping at a #. Double quotes group
+	 * text containing spaces into one token and are removed.
+	 */
+	std::vector<std::string> tokenize(const std::string& line) {
+		std::vector<std::string> tokens;
+		std::string token;
+		bool inToken = false;
+		bool quoted = false;
+		for (char c : line) {
+			if (c == '"') {
+				quoted = !quoted;
+				inToken = true;
+			}
+			else if (!quoted && c == '#') {
+				break;
+			}
+			else if (!quoted && std::isspace(static_cast<unsigned char>(c))) {
+				if (inToken) {
+					tokens.push_back(std::move(token));
+					token.clear();
+					inToken = false;
+				}
+			}
+			else {
+				token += c;
+				inToken = true;
+			}
+		}
+		if (quoted) {
+			throw std::runtime_error("unterminated quote");
+		}
+		if (inToken) {
+			tokens.push_back(std::move(token));
+		}
+		return tokens;
+	}
+
+	float_t parseFloat(const std::string& text) {
+		size_t end = 0;
+		float_t value = 0;
+		try {
+			value = std::stof(text, &end);
+		}
+		catch (std::logic_error&) {
+			end = 0;
+		}
+		if (end != text.size() || text.empty()) {
+			throw std::runtime_error("expected a number, not \"" + text + "\"");
+		}
+		return value;
+	}
+
+	// Parses X,Y,Z, or a single number for all three if allowUniform.
+	glm::vec3 parseVec3(const std::string& text, bool allowUniform = false) {
+		size_t first = text.find(',');
+		if (first == std::string::npos && allowUniform) {
+			return glm::vec3(parseFloat(text));
+		}
+		size_t second = first == std::string::npos ? first : text.find(',', first + 1);
+		if (second == std::string::npos || text.find(',', second + 1) != std::string::npos) {
+			throw std::runtime_error("expected X,Y,Z, not \"" + text + "\"");
+		}
+		return glm::vec3(parseFloat(text.substr(0, first)), parseFloat(text.substr(first + 1, second - first - 1)),
+			parseFloat(text.substr(second + 1)));
+	}
+
+	std::string formatVec3(const glm::vec3& v) {
+		std::ostringstream out;
+		out << v.x << "," << v.y << "," << v.z;
+		return out.str();
+	}
+
+	std::string quote(const std::string& text) {
+		bool plain = !text.empty() && text.find_first_of(" \t\"#=") == std::string::npos;
+		return plain ? text : "\"" + text + "\"";
+	}
+
+	void parseObject(const std::vector<std::string>& tokens, SceneDescription& scene) {
+		if (tokens.size() < 2) {
+			throw std::runtime_error("object needs a name");
+		}
+		if (scene.find(tokens[1]) >= 0) {
+			throw std::runtime_error("there is already an object named " + tokens[1]);
+		}
+		SceneNodeDescription node;
+		node.name = tokens[1];
+		for (size_t i = 2; i < tokens.size(); i++) {
+			if (tokens[i] == "flip") {
+				node.flipTextureCoords = true;
+				continue;
+			}
+			size_t equals = tokens[i].find('=');
+			if (equals == std::string::npos) {
+				throw std::runtime_error("unknown object attribute " + tokens[i]);
+			}
+			std::string key = tokens[i].substr(0, equals);
+			std::string value = tokens[i].substr(equals + 1);
+			if (key == "parent") {
+				node.parent = scene.find(value);
+				if (node.parent < 0) {
+					throw std::runtime_error("parent " + value + " must be declared before its children");
+				}
+			}
+			else if (key == "model") {
+				node.model = value;
+			}
+			else if (key == "position") {
+				node.position = parseVec3(value);
+			}
+			else if (key == "orientation") {
+				node.orientation = parseVec3(value);
+			}
+			else if (key == "scale") {
+				node.scale = parseVec3(value, true);
+			}
+			else if (key == "radius") {
+				node.radius = parseFloat(value);
+			}
+			else {
+				throw std::runtime_error("unknown object attribute " + key);
+			}
+		}
+		scene.nodes.push_back(std::move(node));
+	}
+
+	void parseAnimation(const std::vector<std::string>& tokens, SceneDescription& scene) {
+		static const std::unordered_map<std::string, SceneAnimationDescription::Type> TYPES = {
+			{ "rotate", SceneAnimationDescription::ROTATE },
+			{ "translate", SceneAnimationDescription::TRANSLATE },
+			{ "pause", SceneAnimationDescription::PAUSE },
+			{ "clip", SceneAnimationDescription::CLIP },
+		};
+		SceneAnimationDescription animation{ TYPES.at(tokens[0]), 0, glm::vec3(0), "" };
+		size_t expected = animation.type == SceneAnimationDescription::PAUSE ? 3 : 4;
+		bool optionalLast = animation.type == SceneAnimationDescription::CLIP;
+		if (tokens.size() != expected && !(optionalLast && tokens.size() == expected - 1)) {
+			throw std::runtime_error("wrong number of values for " + tokens[0]);
+		}
+		int32_t node = scene.find(tokens[1]);
+		if (node < 0) {
+			throw std::runtime_error("no object named " + tokens[1]);
+		}
+		animation.duration = parseFloat(tokens[2]);
+		if (animation.type == SceneAnimationDescription::ROTATE || animation.type == SceneAnimationDescription::TRANSLATE) {
+			animation.amount = parseVec3(tokens[3]);
+		}
+		else if (animation.type == SceneAnimationDescription::CLIP && tokens.size() == 4) {
+			animation.clip = tokens[3];
+		}
+		scene.nodes[node].animations.push_back(std::move(animation));
+	}
+
+	template <typename T>
+	void writeValue(std::ostream& out, const T& value) {
+		out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	void writeString(std::ostream& out, const std::string& text) {
+		writeValue(out, static_cast<uint32_t>(text.size()));
+		out.write(text.data(), text.size());
+	}
+
+	template <typename T>
+	T readValue(std::istream& in) {
+		T value;
+		if (!in.read(reinterpret_cast<char*>(&value), sizeof(T))) {
+			throw std::runtime_error("Scene file is truncated");
+		}
+		return value;
+	}
+
+	// The bytes left in the stream, or the largest size if the stream cannot tell.
+	uint64_t bytesLeft(std::istream& in) {
+		std::istream::pos_type at = in.tellg();
+		if (at == std::istream::pos_type(-1)) {
+			return std::numeric_limits<uint64_t>::max();
+		}
+		in.seekg(0, std::ios::end);
+		std::istream::pos_type end = in.tellg();
+		in.seekg(at);
+		return end > at ? static_cast<uint64_t>(end - at) : 0;
+	}
+
+	std::string readString(std::istream& in) {
+		uint32_t size = readValue<uint32_t>(in);
+		// A damaged length would otherwise allocate up to 4 GiB before the read fails.
+		if (size > bytesLeft(in)) {
+			throw std::runtime_error("Scene file is truncated");
+		}
+		std::string text(size, '\0');
+		if (!in.read(&text[0], size)) {
+			throw std::runtime_error("Scene file is truncated");
+		}
+		return text;
+	}
+}
+
+int32_t SceneDescription::find(const std::string& name) const {
+	for (size_t i = 0; i < nodes.size(); i++) {
+		if (nodes[i].name == name) {
+			return static_cast<int32_t>(i);
+		}
+	}
+	return -1;
+}
+
+SceneDescription parseSceneText(std::istream& in) {
+	SceneDescription scene;
+	std::string line;
+	size_t lineNumber = 0;
+	while (std::getline(in, line)) {
+		lineNumber++;
+		try {
+			auto tokens = tokenize(line);
+			if (tokens.empty()) {
+				continue;
+			}
+			const std::string& statement = tokens[0];
+			if (statement == "shader") {
+				if (tokens.size() != 3) {
+					throw std::runtime_error("shader needs a vertex and a fragment shader path");
+				}
+				scene.vertexShader = tokens[1];
+				scene.fragmentShader = tokens[2];
+			}
+			else if (statement == "object") {
+				parseObject(tokens, scene);
+			}
+			else if (statement == "rotate" || statement == "translate" || statement == "pause" || statement == "clip") {
+				parseAnimation(tokens, scene);
+			}
+			else {
+				throw std::runtime_error("unknown statement " + statement);
+			}
+		}
+		catch (std::runtime_error& e) {
+			throw std::runtime_error("Scene line " + std::to_string(lineNumber) + ": " + e.what());
+		}
+	}
+	return scene;
+}
+
+void writeSceneText(const SceneDescription& scene, std::ostream& out) {
+	static const char* ANIMATION_STATEMENTS[] = { "rotate", "translate", "pause", "clip" };
+	if (!scene.vertexShader.empty()) {
+		out << "shader " << quote(scene.vertexShader) << " " << quote(scene.fragmentShader) << "\n";
+	}
+	for (auto& node : scene.nodes) {
+		out << "object " << quote(node.name);
+		if (node.parent >= 0) {
+			out << " parent=" << quote(scene.nodes[node.parent].name);
+		}
+		if (!node.model.empty()) {
+			out << " model=" << quote(node.model);
+		}
+		if (node.flipTextureCoords) {
+			out << " flip";
+		}
+		out << " position=" << formatVec3(node.position) << " orientation=" << formatVec3(node.orientation)
+			<< " scale=" << formatVec3(node.scale);
+		if (node.radius != 0) {
+			out << " radius=" << node.radius;
+		}
+		out << "\n";
+	}
+	for (auto& node : scene.nodes) {
+		for (auto& animation : node.animations) {
+			out << ANIMATION_STATEMENTS[animation.type] << " " << quote(node.name) << " " << animation.duration;
+			if (animation.type == SceneAnimationDescription::ROTATE || animation.type == SceneAnimationDescription::TRANSLATE) {
+				out << " " << formatVec3(animation.amount);
+			}
+			else if (animation.type == SceneAnimationDescription::CLIP && !animation.clip.empty()) {
+				out << " " << quote(animation.clip);
+			}
+			out << "\n";
+		}
+	}
+}
+
+// The binary form is the magic and version, the two shader paths, then each node's name,
+// parent, model, flags, transform, radius, and animations. Strings are a 32-bit length
+// followed by their bytes; numbers are in the machine's byte order.
+SceneDescription readSceneBinary(std::istream& in) {
+	char magic[sizeof(SCENE_BINARY_MAGIC)];
+	if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, SCENE_BINARY_MAGIC, sizeof(magic)) != 0) {
+		throw std::runtime_error("Not a binary scene file");
+	}
+	uint32_t version = readValue<uint32_t>(in);
+	if (version != SCENE_BINARY_VERSION) {
+		throw std::runtime_error("Unsupported scene file version " + std::to_string(version));
+	}
+
+	SceneDescription scene;
+	scene.vertexShader = readString(in);
+	scene.fragmentShader = readString(in);
+	uint32_t nodeCount = readValue<uint32_t>(in);
+	for (uint32_t i = 0; i < nodeCount; i++) {
+		SceneNodeDescription node;
+		node.name = readString(in);
+		node.parent = readValue<int32_t>(in);
+		if (node.parent < -1 || node.parent >= static_cast<int32_t>(i)) {
+			throw std::runtime_error("Scene node " + node.name + " comes before its parent");
+		}
+		node.model = readString(in);
+		node.flipTextureCoords = readValue<uint8_t>(in) != 0;
+		node.position = readValue<glm::vec3>(in);
+		node.orientation = readValue<glm::vec3>(in);
+		node.scale = readValue<glm::vec3>(in);
+		node.radius = readValue<float_t>(in);
+		uint32_t animationCount = readValue<uint32_t>(in);
+		for (uint32_t a = 0; a < animationCount; a++) {
+			SceneAnimationDescription animation;
+			animation.type = static_cast<SceneAnimationDescription::Type>(readValue<uint8_t>(in));
+			if (animation.type > SceneAnimationDescription::CLIP) {
+				throw std::runtime_error("Unknown animation type in scene node " + node.name);
+			}
+			animation.duration = readValue<float_t>(in);
+			animation.amount = readValue<glm::vec3>(in);
+			animation.clip = readString(in);
+			node.animations.push_back(std::move(animation));
+		}
+		scene.nodes.push_back(std::move(node));
+	}
+	return scene;
+}
+
+void writeSceneBinary(const SceneDescription& scene, std::ostream& out) {
+	out.write(SCENE_BINARY_MAGIC, sizeof(SCENE_BINARY_MAGIC));
+	writeValue(out, SCENE_BINARY_VERSION);
+	writeString(out, scene.vertexShader);
+	writeString(out, scene.fragmentShader);
+	writeValue(out, static_cast<uint32_t>(scene.nodes.size()));
+	for (auto& node : scene.nodes) {
+		writeString(out, node.name);
+		writeValue(out, node.parent);
+		writeString(out, node.model);
+		writeValue(out, static_cast<uint8_t>(node.flipTextureCoords));
+		writeValue(out, node.position);
+		writeValue(out, node.orientation);
+		writeValue(out, node.scale);
+		writeValue(out, node.radius);
+		writeValue(out, static_cast<uint32_t>(node.animations.size()));
+		for (auto& animation : node.animations) {
+			writeValue(out, static_cast<uint8_t>(animation.type));
+			writeValue(out, animation.duration);
+			writeValue(out, animation.amount);
+			writeString(out, animation.clip);
+		}
+	}
+}
+
+SceneDescription loadSceneDescription(const std::filesystem::path& path) {
+	std::ifstream in(path, std::ios::binary);
+	if (!in) {
+		throw std::runtime_error("Could not open scene " + path.string());
+	}
+	char magic[sizeof(SCENE_BINARY_MAGIC)] = {};
+	in.read(magic, sizeof(magic));
+	bool binary = in.gcount() == sizeof(magic) && std::memcmp(magic, SCENE_BINARY_MAGIC, sizeof(magic)) == 0;
+	in.clear();
+	in.seekg(0);
+	try {
+		return binary ? readSceneBinary(in) : parseSceneText(in);
+	}
+	catch (std::runtime_error& e) {
+		throw std::runtime_error(path.string() + ": " + e.what());
+	}
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+/**
+ * @brief One animation in a node's sequence, as described in a scene file.
+ */
+struct SceneAnimationDescription {
+	enum Type : uint8_t {
+		ROTATE,
+		TRANSLATE,
+		PAUSE,
+		// Plays a clip imported with the node's model.
+		CLIP
+	};
+
+	Type type;
+	float_t duration;
+	// The total rotation or translation.
+	glm::vec3 amount;
+	// The name of the clip to play; empty for the model's first clip.
+	std::string clip;
+};
+
+/**
+ * @brief One object of a scene: its place in the hierarchy, its transform relative to its
+ * parent, the model file it shows, if any, and the animations it plays one after another.
+ */
+struct SceneNodeDescription {
+	std::string name;
+	// The index of the parent node, which precedes this one, or -1 for a root object.
+	int32_t parent = -1;
+	// The model to load with assimpLoad; empty for a node that only groups its children.
+	std::string model;
+	bool flipTextureCoords = false;
+	glm::vec3 position = glm::vec3(0);
+	glm::vec3 orientation = glm::vec3(0);
+	glm::vec3 scale = glm::vec3(1);
+	// How far the model extends around the node, for prioritizing loads by distance.
+	float_t radius = 0;
+	std::vector<SceneAnimationDescription> animations;
+};
+
+/**
+ * @brief A scene as data: the shaders to render it with and its objects, parents before
+ * children.
+ *
+ * Scenes are authored as text and can be compiled to a binary form that loads without
+ * parsing. The text form has one statement per line; # starts a comment, and values containing
+ * spaces are written in double quotes:
+ *
+ *     shader VERTEX_PATH FRAGMENT_PATH
+ *     object NAME [parent=NAME] [model=PATH] [flip] [position=X,Y,Z] [orientation=X,Y,Z]
+ *            [scale=X,Y,Z | scale=S] [radius=R]
+ *     rotate NAME DURATION X,Y,Z
+ *     translate NAME DURATION X,Y,Z
+ *     pause NAME DURATION
+ *     clip NAME DURATION [CLIP_NAME]
+ *
+ * Animation statements append to the named object's sequence. Model and shader paths are
+ * relative to the working directory, as with assimpLoad.
+ */
+struct SceneDescription {
+	std::string vertexShader;
+	std::string fragmentShader;
+	std::vector<SceneNodeDescription> nodes;
+
+	/**
+	 * @brief The index of the node with the given name, or -1 if there is none.
+	 */
+	int32_t find(const std::string& name) const;
+};
+
+/**
+ * @brief Parses the text form of a scene; throws std::runtime_error naming the line of the
+ * first error.
+ */
+SceneDescription parseSceneText(std::istream& in);
+void writeSceneText(const SceneDescription& scene, std::ostream& out);
+
+/**
+ * @brief Reads and writes the binary form of a scene, which starts with SCENE_BINARY_MAGIC.
+ */
+SceneDescription readSceneBinary(std::istream& in);
+void writeSceneBinary(const SceneDescription& scene, std::ostream& out);
+
+/**
+ * @brief Loads a scene file in either form, telling them apart by the binary form's magic.
+ */
+SceneDescription loadSceneDescription(const std::filesystem::path& path);
+
+const char SCENE_BINARY_MAGIC[4] = { 'F', 'P', 'S', 'C' };
+const uint32_t SCENE_BINARY_VERSION = 1;
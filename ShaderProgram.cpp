@@ -1,141 +1,352 @@
 #include "ShaderProgram.h"
 #include "glad.h"
+#include "RenderStats.h"
+#include <algorithm>
+#include <cstdio>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+    // The cache stays disabled until a directory is set.
+    std::filesystem::path binaryCacheDirectory;
+
+    const char BINARY_MAGIC[4] = { 'F', 'P', 'S', 'B' };
+
+    std::string readSource(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("Failed to locate shader file " + path);
+        }
+        std::stringstream stream;
+        stream << file.rdbuf();
+        return stream.str();
+    }
+
+    // The #version directive must come first, so the defines go on the line after it.
+    std::string insertDefines(const std::string& code, const std::string& defines)
+    {
+        if (defines.empty()) {
+            return code;
+        }
+        size_t lineEnd = code.find('\n');
+        if (code.compare(0, 8, "#version") != 0 || lineEnd == std::string::npos) {
+            return defines + code;
+        }
+        return code.substr(0, lineEnd + 1) + defines + code.substr(lineEnd + 1);
+    }
+
+    // 64-bit FNV-1a, which is plenty to tell cached programs apart.
+    uint64_t hashString(const std::string& text, uint64_t hash = 14695981039346656037ull)
+    {
+        for (unsigned char c : text) {
+            hash = (hash ^ c) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    bool binaryCacheEnabled()
+    {
+        if (binaryCacheDirectory.empty() || !GLAD_GL_ARB_get_program_binary) {
+            return false;
+        }
+        // Some drivers support the extension but no binary formats.
+        int32_t formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+    }
+
+    std::string shaderError(uint32_t shader)
+    {
+        char infoLog[512];
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        return infoLog;
+    }
+}
 
 ShaderProgram::ShaderProgram()
-    : m_programId(-1) {
+    : m_programId(-1), m_pending(false), m_fromBinary(false), m_vertexShader(0), m_fragmentShader(0),
+    m_skinnedLocation(-1), m_skinnedValue(-1), m_perDrawBlock(GL_INVALID_INDEX), m_perDrawBinding(-1),
+    m_drawIndexLocation(-1), m_drawIndexValue(-1) {
 
 }
 
+void ShaderProgram::setBinaryCache(const std::filesystem::path& directory)
+{
+    binaryCacheDirectory = directory;
+}
 
+std::filesystem::path ShaderProgram::binaryCachePath() const
+{
+    // A binary only loads into the driver that made it, so the driver is part of the key.
+    uint64_t hash = hashString(m_vertexCode);
+    hash = hashString(std::string(1, '\0') + m_fragmentCode, hash);
+    for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+        hash = hashString(std::string(1, '\0') + reinterpret_cast<const char*>(glGetString(name)), hash);
+    }
+    char fileName[32];
+    std::snprintf(fileName, sizeof(fileName), "%016llx.bin", static_cast<unsigned long long>(hash));
+    return binaryCacheDirectory / fileName;
+}
 
 void ShaderProgram::load(const std::string& vertexShaderPath, const std::string& fragmentShaderPath)
 {
-    std::string vertexCode;
-    std::string fragmentCode;
-    std::ifstream vShaderFile;
-    std::ifstream fShaderFile;
-    // ensure ifstream objects can throw exceptions:
-    vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    try
-    {
-        // open files
-        vShaderFile.open(vertexShaderPath);
-        fShaderFile.open(fragmentShaderPath);
-        std::stringstream vShaderStream, fShaderStream;
-        // read file's buffer contents into streams
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
-        // close file handlers
-        vShaderFile.close();
-        fShaderFile.close();
-        // convert stream into string
-        vertexCode = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
-    }
-    catch (std::ifstream::failure& e)
-    {
-        throw std::runtime_error("Failed to locate vertex or fragment shader files");
-    }
+    compile(vertexShaderPath, fragmentShaderPath);
+    finish();
+}
 
-    const char* vShaderCode = vertexCode.c_str();
-    const char* fShaderCode = fragmentCode.c_str();
+void ShaderProgram::compile(const std::string& vertexShaderPath, const std::string& fragmentShaderPath,
+    const std::string& defines)
+{
+    m_vertexPath = vertexShaderPath;
+    m_fragmentPath = fragmentShaderPath;
+    m_defines = defines;
+    // The cache key is the final source, so each set of defines is cached separately.
+    m_vertexCode = insertDefines(readSource(vertexShaderPath), defines);
+    m_fragmentCode = insertDefines(readSource(fragmentShaderPath), defines);
 
-    unsigned int vertex, fragment;
-    int success;
-    char infoLog[512];
-
-    // vertex Shader
-    vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vShaderCode, NULL);
-    glCompileShader(vertex);
-    // print compile errors if any
-    glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-        glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-        throw std::runtime_error(infoLog);
-    };
-
-    // similiar for Fragment Shader
-    fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fShaderCode, NULL);
-    glCompileShader(fragment);
-    // print compile errors if any
-    glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-        glGetShaderInfoLog(fragment, 512, NULL, infoLog);
-        throw std::runtime_error(infoLog);
-    };
+    static bool parallelCompileEnabled = false;
+    if (!parallelCompileEnabled && GLAD_GL_KHR_parallel_shader_compile) {
+        // Let the driver use as many threads as it likes.
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        parallelCompileEnabled = true;
+    }
 
-    // shader Program
     m_programId = glCreateProgram();
-    glAttachShader(m_programId, vertex);
-    glAttachShader(m_programId, fragment);
+    m_pending = true;
+    m_fromBinary = false;
+    if (binaryCacheEnabled()) {
+        std::ifstream file(binaryCachePath(), std::ios::binary);
+        char magic[4];
+        uint32_t format;
+        if (file.read(magic, sizeof(magic)) && std::equal(magic, magic + 4, BINARY_MAGIC)
+            && file.read(reinterpret_cast<char*>(&format), sizeof(format))) {
+            std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            glProgramBinary(m_programId, format, binary.data(), static_cast<GLsizei>(binary.size()));
+            m_fromBinary = true;
+            return;
+        }
+    }
+    compileSources();
+}
+
+void ShaderProgram::compileSources()
+{
+    const char* vShaderCode = m_vertexCode.c_str();
+    const char* fShaderCode = m_fragmentCode.c_str();
+
+    // Nothing here waits for the compiler; finish() checks the results.
+    m_vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(m_vertexShader, 1, &vShaderCode, NULL);
+    glCompileShader(m_vertexShader);
+    m_fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(m_fragmentShader, 1, &fShaderCode, NULL);
+    glCompileShader(m_fragmentShader);
+
+    glAttachShader(m_programId, m_vertexShader);
+    glAttachShader(m_programId, m_fragmentShader);
+    if (binaryCacheEnabled()) {
+        glProgramParameteri(m_programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
     glLinkProgram(m_programId);
-    // print linking errors if any
+}
+
+void ShaderProgram::finish()
+{
+    if (!m_pending) {
+        return;
+    }
+    int success;
     glGetProgramiv(m_programId, GL_LINK_STATUS, &success);
+    if (!success && m_fromBinary) {
+        // The driver rejected the cached binary, most likely because it has changed since; build
+        // the program from source and replace the binary.
+        m_fromBinary = false;
+        compileSources();
+        glGetProgramiv(m_programId, GL_LINK_STATUS, &success);
+    }
+    m_pending = false;
+    if (!m_fromBinary) {
+        // A shader that failed to compile explains the failure better than the link does.
+        bool compiled = true;
+        std::string error;
+        for (uint32_t shader : { m_vertexShader, m_fragmentShader }) {
+            int status;
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+            if (compiled && !status) {
+                compiled = false;
+                error = shaderError(shader);
+            }
+        }
+        // delete the shaders as they're linked into our program now and no longer necessary
+        glDeleteShader(m_vertexShader);
+        glDeleteShader(m_fragmentShader);
+        m_vertexShader = 0;
+        m_fragmentShader = 0;
+        if (!compiled) {
+            glDeleteProgram(m_programId);
+            m_programId = 0;
+            throw std::runtime_error(error);
+        }
+    }
     if (!success)
     {
+        char infoLog[512];
         glGetProgramInfoLog(m_programId, 512, NULL, infoLog);
+        glDeleteProgram(m_programId);
+        m_programId = 0;
         throw std::runtime_error(infoLog);
     }
 
-    // delete the shaders as they're linked into our program now and no longer necessary
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
+    if (!m_fromBinary && binaryCacheEnabled()) {
+        int32_t length = 0;
+        glGetProgramiv(m_programId, GL_PROGRAM_BINARY_LENGTH, &length);
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(m_programId, length, &length, &format, binary.data());
+        // A cache that cannot be written only costs the next run a compile.
+        std::error_code error;
+        std::filesystem::create_directories(binaryCacheDirectory, error);
+        std::ofstream file(binaryCachePath(), std::ios::binary);
+        uint32_t storedFormat = format;
+        file.write(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+        file.write(reinterpret_cast<const char*>(&storedFormat), sizeof(storedFormat));
+        file.write(binary.data(), length);
+    }
+    m_vertexCode.clear();
+    m_fragmentCode.clear();
+    lookUpLocations();
+}
+
+void ShaderProgram::lookUpLocations()
+{
+    m_skinnedLocation = glGetUniformLocation(m_programId, "skinned");
+    m_skinnedValue = -1;
+    m_perDrawBlock = glGetUniformBlockIndex(m_programId, "PerDraw");
+    m_perDrawBinding = -1;
+    m_drawIndexLocation = glGetUniformLocation(m_programId, "drawIndex");
+    m_drawIndexValue = -1;
+}
+
+void ShaderProgram::reload()
+{
+    finish();
+    ShaderProgram replacement;
+    replacement.compile(m_vertexPath, m_fragmentPath, m_defines);
+    replacement.finish();
+    glDeleteProgram(m_programId);
+    m_programId = replacement.m_programId;
+    lookUpLocations();
 }
 
 void ShaderProgram::activate()
 {
+    finish();
+    RENDER_STATS_ADD(programBinds, 1);
     glUseProgram(m_programId);
 }
 
+bool ShaderProgram::bindUniformBlock(const std::string& blockName, uint32_t binding)
+{
+    finish();
+    uint32_t index = glGetUniformBlockIndex(m_programId, blockName.c_str());
+    if (index == GL_INVALID_INDEX) {
+        return false;
+    }
+    glUniformBlockBinding(m_programId, index, binding);
+    if (index == m_perDrawBlock) {
+        m_perDrawBinding = binding;
+    }
+    return true;
+}
+
+bool ShaderProgram::bindPerDrawBlock(uint32_t binding)
+{
+    finish();
+    if (m_perDrawBlock == GL_INVALID_INDEX) {
+        return false;
+    }
+    if (m_perDrawBinding != binding) {
+        glUniformBlockBinding(m_programId, m_perDrawBlock, binding);
+        m_perDrawBinding = binding;
+    }
+    return true;
+}
+
+void ShaderProgram::setSkinned(bool skinned)
+{
+    if (m_skinnedLocation < 0 || m_skinnedValue == static_cast<int32_t>(skinned)) {
+        return;
+    }
+    RENDER_STATS_ADD(uniformUploads, 1);
+    glUniform1i(m_skinnedLocation, skinned);
+    m_skinnedValue = skinned;
+}
+
+void ShaderProgram::setDrawIndex(int32_t index)
+{
+    if (m_drawIndexLocation < 0 || m_drawIndexValue == index) {
+        return;
+    }
+    RENDER_STATS_ADD(uniformUploads, 1);
+    glUniform1i(m_drawIndexLocation, index);
+    m_drawIndexValue = index;
+}
+
 void ShaderProgram::setUniform(const std::string& uniformName, bool value)
 {
+    RENDER_STATS_ADD(uniformUploads, 1);
     glUniform1i(glGetUniformLocation(m_programId, uniformName.c_str()), (int32_t)value);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, int32_t value)
 {
+    RENDER_STATS_ADD(uniformUploads, 1);
     glUniform1i(glGetUniformLocation(m_programId, uniformName.c_str()), value);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, float_t value)
 {
+    RENDER_STATS_ADD(uniformUploads, 1);
     glUniform1f(glGetUniformLocation(m_programId, uniformName.c_str()), (int)value);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, const glm::vec2& value)
 {
+    RENDER_STATS_ADD(uniformUploads, 1);
     glUniform2fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, &value[0]);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, const glm::vec3& value)
 {
+    RENDER_STATS_ADD(uniformUploads, 1);
     glUniform3fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, &value[0]);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, const glm::vec4& value)
 {
+    RENDER_STATS_ADD(uniformUploads, 1);
     glUniform4fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, &value[0]);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, const glm::mat2& value)
 {
+    RENDER_STATS_ADD(uniformUploads, 1);
     glUniformMatrix2fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, false, &value[0][0]);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, const glm::mat3& value)
 {
+    RENDER_STATS_ADD(uniformUploads, 1);
     glUniformMatrix3fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, false, &value[0][0]);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, const glm::mat4& value)
 {
+    RENDER_STATS_ADD(uniformUploads, 1);
     glUniformMatrix4fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, false, &value[0][0]);
 }
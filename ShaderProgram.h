@@ -1,15 +1,88 @@
 #pragma once
+#include <filesystem>
 #include <glm/ext.hpp>
 #include <string>
 class ShaderProgram {
 	uint32_t m_programId;
+	// What the program was last compiled from, for reload().
+	std::string m_vertexPath;
+	std::string m_fragmentPath;
+	std::string m_defines;
+	// Set from compile() until finish() has checked the program.
+	bool m_pending;
+	bool m_fromBinary;
+	uint32_t m_vertexShader;
+	uint32_t m_fragmentShader;
+	// Kept while pending, to name the program in the binary cache and to compile it if the
+	// cached binary is rejected.
+	std::string m_vertexCode;
+	std::string m_fragmentCode;
+	// The location of the "skinned" uniform, or -1 if the program has none, and the value last
+	// set, or -1 if it has not been set since the program linked.
+	int32_t m_skinnedLocation;
+	int32_t m_skinnedValue;
+	// The index of the "PerDraw" uniform block, or GL_INVALID_INDEX if the program has none, and
+	// the binding point it was last connected to, or -1 if it has not been since the program linked.
+	uint32_t m_perDrawBlock;
+	int64_t m_perDrawBinding;
+	// The location of the "drawIndex" uniform, or -1 if the program has none, and the value last
+	// set, or -1 if it has not been set since the program linked.
+	int32_t m_drawIndexLocation;
+	int32_t m_drawIndexValue;
+
+	// Starts compiling and linking the sources, without waiting for either.
+	void compileSources();
+	std::filesystem::path binaryCachePath() const;
+	// Looks up the locations the program's per-draw setters use, once it has linked.
+	void lookUpLocations();
 
 public:
 	ShaderProgram();
+	// Compiles and links the program, throwing std::runtime_error if either fails.
 	void load(const std::string& vertexShaderPath, const std::string& fragmentShaderPath);
+	// Starts building the program, loading it from the binary cache when a binary of the same
+	// sources from the same driver is there. With GL_KHR_parallel_shader_compile the driver
+	// compiles on its own threads, so several programs can build at once while the caller does
+	// other work. Throws std::runtime_error only if the files cannot be read; compile and link
+	// errors are reported by finish(). The defines, such as "#define SKINNED\n", are inserted
+	// after the #version line of both shaders.
+	void compile(const std::string& vertexShaderPath, const std::string& fragmentShaderPath,
+		const std::string& defines = "");
+	// Waits for the program started by compile() and checks it, and stores it in the binary
+	// cache. If it failed to compile or link, deletes it and its shaders and throws
+	// std::runtime_error. Does nothing if the program is not pending; activate() calls it first.
+	void finish();
+
+	// Compiles the program again from the same files and defines, replacing it only if the new
+	// one links, and throws std::runtime_error otherwise. The new program has none of the old
+	// one's uniform values or block bindings, and must be activated again.
+	void reload();
+	const std::string& vertexPath() const { return m_vertexPath; }
+	const std::string& fragmentPath() const { return m_fragmentPath; }
+
+	// Sets the directory in which linked programs are cached, keyed by their sources and the
+	// driver; an empty path disables the cache. Requires GL_ARB_get_program_binary.
+	static void setBinaryCache(const std::filesystem::path& directory);
 
 	void activate();
 
+	// Connects the named uniform block to a buffer binding point, and returns whether the
+	// program has such a block; does nothing if it does not.
+	bool bindUniformBlock(const std::string& blockName, uint32_t binding);
+
+	// Connects the "PerDraw" uniform block, which Object3D binds for every draw, to a binding
+	// point without a lookup, and returns whether the program has the block.
+	bool bindPerDrawBlock(uint32_t binding);
+
+	// Sets the "skinned" uniform, which Mesh3D sets for every draw, without a location lookup;
+	// nothing is uploaded if the value has not changed or the program has no such uniform.
+	void setSkinned(bool skinned);
+
+	// Sets the "drawIndex" uniform, the draw's matrix in the bound PerDraw block, without a
+	// location lookup; nothing is uploaded if the value has not changed or the program has no
+	// such uniform.
+	void setDrawIndex(int32_t index);
+
 	void setUniform(const std::string& uniformName, bool value);
 	void setUniform(const std::string& uniformName, int32_t value);
 	void setUniform(const std::string& uniformName, float_t value);
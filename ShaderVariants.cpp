@@ -0,0 +1,77 @@
+#include "ShaderVariants.h"
+#include <stdexcept>
+
+ShaderVariants::ShaderVariants(const std::string& vertexPath, const std::string& fragmentPath,
+	const std::string& defines)
+	: m_vertexPath(vertexPath), m_fragmentPath(fragmentPath), m_defines(defines) {}
+
+std::string ShaderVariants::defines(uint32_t features) {
+	std::string lines;
+	if (features & SKINNED) {
+		lines += "#define SKINNED\n";
+	}
+	if (features & NORMAL_MAP) {
+		lines += "#define NORMAL_MAP\n";
+	}
+	if (features & SPEC_MAP) {
+		lines += "#define SPEC_MAP\n";
+	}
+	return lines;
+}
+
+ShaderVariants::Variant& ShaderVariants::variant(uint32_t features) {
+	auto found = m_variants.find(features);
+	if (found != m_variants.end()) {
+		return found->second;
+	}
+	auto program = std::make_unique<ShaderProgram>();
+	program->compile(m_vertexPath, m_fragmentPath, m_defines + defines(features));
+	return m_variants[features] = Variant{ std::move(program), false };
+}
+
+void ShaderVariants::prepare(uint32_t features) {
+	variant(features);
+}
+
+ShaderProgram& ShaderVariants::activate(uint32_t features) {
+	Variant& found = variant(features);
+	ShaderProgram& program = *found.program;
+	program.activate();
+	if (!found.configured) {
+		for (auto& block : m_blocks) {
+			program.bindUniformBlock(block.first, block.second);
+		}
+		for (auto& uniform : m_uniforms) {
+			uniform.second(program);
+		}
+		found.configured = true;
+	}
+	return program;
+}
+
+void ShaderVariants::reload() {
+	std::string error;
+	for (auto& entry : m_variants) {
+		try {
+			entry.second.program->reload();
+			entry.second.configured = false;
+		}
+		catch (std::runtime_error& e) {
+			if (error.empty()) {
+				error = e.what();
+			}
+		}
+	}
+	if (!error.empty()) {
+		throw std::runtime_error(error);
+	}
+}
+
+void ShaderVariants::bindUniformBlock(const std::string& blockName, uint32_t binding) {
+	m_blocks[blockName] = binding;
+	for (auto& entry : m_variants) {
+		if (entry.second.configured) {
+			entry.second.program->bindUniformBlock(blockName, binding);
+		}
+	}
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "ShaderProgram.h"
+
+/**
+ * @brief One vertex and fragment shader pair, compiled into a specialized program for each
+ * combination of material features, so that each draw runs only the code its mesh needs rather
+ * than branching on uniforms. Each feature is a #define inserted after the #version line.
+ *
+ * Variants are compiled the first time they are asked for, or ahead of time with prepare(), and
+ * are kept for the life of the set. Uniforms and uniform blocks set on the set apply to every
+ * variant, including those compiled later.
+ */
+class ShaderVariants {
+public:
+	/**
+	 * @brief The material features a variant may be specialized for; see Mesh3D::shaderFeatures.
+	 */
+	enum Feature : uint32_t {
+		// The mesh is deformed by a joint palette.
+		SKINNED = 1,
+		// The mesh has a "normalMap" texture.
+		NORMAL_MAP = 2,
+		// The mesh has a "specMap" texture.
+		SPEC_MAP = 4
+	};
+
+private:
+	struct Variant {
+		// Programs are held by pointer so references to them survive rehashing.
+		std::unique_ptr<ShaderProgram> program;
+		// Whether the set's uniforms and blocks have been applied to the program.
+		bool configured;
+	};
+
+	std::string m_vertexPath;
+	std::string m_fragmentPath;
+	std::string m_defines;
+	std::unordered_map<uint32_t, Variant> m_variants;
+	std::unordered_map<std::string, uint32_t> m_blocks;
+	// Applies each uniform to a program, by uniform name.
+	std::unordered_map<std::string, std::function<void(ShaderProgram&)>> m_uniforms;
+
+	Variant& variant(uint32_t features);
+
+public:
+	/**
+	 * @brief Creates a set of variants of the given shaders, each also compiled with the given
+	 * defines; nothing is compiled yet.
+	 */
+	ShaderVariants(const std::string& vertexPath, const std::string& fragmentPath,
+		const std::string& defines = "");
+
+	ShaderVariants(const ShaderVariants&) = delete;
+	ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+	/**
+	 * @brief Starts compiling the variant for the given features, if it has not been, so that it
+	 * is ready by the time it is drawn with.
+	 */
+	void prepare(uint32_t features);
+
+	/**
+	 * @brief The variant for the given features, compiled and configured, and active. Throws
+	 * std::runtime_error if it fails to compile.
+	 */
+	ShaderProgram& activate(uint32_t features);
+
+	/**
+	 * @brief Connects the named uniform block of every variant to a buffer binding point.
+	 */
+	void bindUniformBlock(const std::string& blockName, uint32_t binding);
+
+	/**
+	 * @brief Sets a uniform of every variant. Leaves the last configured variant active.
+	 */
+	template <typename T>
+	void setUniform(const std::string& uniformName, const T& value) {
+		m_uniforms[uniformName] = [uniformName, value](ShaderProgram& program) {
+			program.setUniform(uniformName, value);
+		};
+		for (auto& entry : m_variants) {
+			if (entry.second.configured) {
+				entry.second.program->activate();
+				entry.second.program->setUniform(uniformName, value);
+			}
+		}
+	}
+
+	size_t variantCount() const { return m_variants.size(); }
+	const std::string& vertexPath() const { return m_vertexPath; }
+	const std::string& fragmentPath() const { return m_fragmentPath; }
+
+	/**
+	 * @brief Compiles every variant again from the shader files, reapplying the set's uniforms
+	 * and blocks when each is next activated. A variant that fails keeps its old program; the
+	 * first failure is rethrown as std::runtime_error once all have been tried.
+	 */
+	void reload();
+
+	/**
+	 * @brief The #define lines for the given features.
+	 */
+	static std::string defines(uint32_t features);
+};
@@ -0,0 +1,137 @@
+#include "SkinningSystem.h"
+#include <stdexcept>
+#include <unordered_map>
+#include "JobSystem.h"
+
+namespace {
+	void encodeAffine(const glm::mat4& m, glm::vec4* out) {
+		// glm matrices are column-major; the shader wants rows so each one dots with the position.
+		glm::mat4 rows = glm::transpose(m);
+		out[0] = rows[0];
+		out[1] = rows[1];
+		out[2] = rows[2];
+	}
+
+	void encodeDualQuaternion(const glm::mat4& m, glm::vec4* out) {
+		glm::mat3 rotation(glm::normalize(glm::vec3(m[0])), glm::normalize(glm::vec3(m[1])),
+			glm::normalize(glm::vec3(m[2])));
+		glm::quat real = glm::quat_cast(rotation);
+		glm::vec3 t(m[3]);
+		glm::quat dual = glm::quat(0, t.x, t.y, t.z) * real * 0.5f;
+		out[0] = glm::vec4(real.x, real.y, real.z, real.w);
+		out[1] = glm::vec4(dual.x, dual.y, dual.z, dual.w);
+	}
+}
+
+void SkinningSystem::flatten(Object3D& node, int32_t parent, Instance& instance) {
+	uint32_t index = static_cast<uint32_t>(instance.nodes.size());
+	instance.nodes.push_back(&node);
+	instance.parents.push_back(parent);
+	for (size_t i = 0; i < node.numberOfMeshes(); i++) {
+		Mesh3D& mesh = node.getMesh(i);
+		if (mesh.isSkinned()) {
+			instance.meshes.push_back({ &mesh, index, {}, 0 });
+		}
+	}
+	for (size_t i = 0; i < node.numberOfChildren(); i++) {
+		flatten(node.getChild(i), index, instance);
+	}
+}
+
+void SkinningSystem::add(Object3D& model) {
+	Instance instance;
+	flatten(model, -1, instance);
+	if (instance.meshes.empty()) {
+		return;
+	}
+
+	if (m_alignment == 0) {
+		int32_t alignment;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		m_alignment = (alignment + sizeof(glm::vec4) - 1) / sizeof(glm::vec4);
+	}
+
+	std::unordered_map<std::string, uint32_t> nodesByName;
+	for (uint32_t i = 0; i < instance.nodes.size(); i++) {
+		nodesByName.insert(std::make_pair(instance.nodes[i]->getName(), i));
+	}
+
+	for (auto& binding : instance.meshes) {
+		const Skin& skin = *binding.mesh->skin();
+		for (auto& name : skin.jointNames) {
+			auto node = nodesByName.find(name);
+			if (node == nodesByName.end()) {
+				throw std::runtime_error("Skinned mesh joint not found in model: " + name);
+			}
+			binding.jointNodes.push_back(node->second);
+		}
+
+		// Each palette starts on an aligned offset so it can be bound with glBindBufferRange.
+		binding.paletteOffset = (m_paletteSize + m_alignment - 1) / m_alignment * m_alignment;
+		m_paletteSize = binding.paletteOffset + skin.jointNames.size() * jointSize();
+	}
+	m_instances.push_back(std::move(instance));
+}
+
+void SkinningSystem::computePalettes(const Instance& instance, float_t alpha, std::vector<glm::mat4>& globals,
+	glm::vec4* region) const {
+	// Each node's model matrix is relative to its parent; parents come first, so one pass
+	// yields every node's transform relative to the model. The joints are interpolated exactly
+	// as Object3D::render interpolates the mesh nodes.
+	globals.resize(instance.nodes.size());
+	for (size_t i = 0; i < instance.nodes.size(); i++) {
+		int32_t parent = instance.parents[i];
+		glm::mat4 local = instance.nodes[i]->interpolatedModelMatrix(alpha);
+		globals[i] = parent >= 0 ? globals[parent] * local : local;
+	}
+
+	// The mesh is rendered with its own node's matrix as "model", so joint matrices are
+	// expressed relative to the mesh node.
+	for (auto& binding : instance.meshes) {
+		const Skin& skin = *binding.mesh->skin();
+		glm::mat4 meshInverse = glm::inverse(globals[binding.meshNode]);
+		glm::vec4* out = region + binding.paletteOffset;
+		for (size_t j = 0; j < binding.jointNodes.size(); j++) {
+			glm::mat4 joint = meshInverse * globals[binding.jointNodes[j]] * skin.inverseBindMatrices[j];
+			if (m_format == PaletteFormat::AFFINE) {
+				encodeAffine(joint, out + j * 3);
+			}
+			else {
+				encodeDualQuaternion(joint, out + j * 2);
+			}
+		}
+	}
+}
+
+void SkinningSystem::update(float_t alpha) {
+	if (m_instances.empty()) {
+		return;
+	}
+	if (m_stream == nullptr) {
+		m_stream = std::make_unique<StreamBuffer>(GL_UNIFORM_BUFFER, 0, m_alignment * sizeof(glm::vec4));
+	}
+	m_stream->beginFrame();
+
+	// The shader's block always spans MAX_JOINTS joints, so map enough past the last mesh's
+	// palette for its whole block.
+	size_t frameSize = (m_paletteSize + MAX_JOINTS * jointSize()) * sizeof(glm::vec4);
+	size_t frameStart;
+	auto* region = reinterpret_cast<glm::vec4*>(m_stream->map(frameSize, frameStart));
+
+	// The workers write straight into the mapped region, so the palettes are never copied.
+	JobSystem::instance().parallelFor(m_instances.size(), 1, [this, alpha, region](size_t begin, size_t end) {
+		std::vector<glm::mat4> globals;
+		for (size_t i = begin; i < end; i++) {
+			computePalettes(m_instances[i], alpha, globals, region);
+		}
+	});
+	m_stream->unmap();
+
+	size_t blockSize = MAX_JOINTS * jointSize() * sizeof(glm::vec4);
+	for (auto& instance : m_instances) {
+		for (auto& binding : instance.meshes) {
+			binding.mesh->setJointPalette(m_stream->buffer(),
+				frameStart + binding.paletteOffset * sizeof(glm::vec4), blockSize);
+		}
+	}
+}
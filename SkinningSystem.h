@@ -0,0 +1,97 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "Object3D.h"
+#include "StreamBuffer.h"
+
+/**
+ * @brief How joint transforms are encoded in the palette buffer.
+ */
+enum class PaletteFormat : uint8_t {
+	/** @brief The top three rows of each joint matrix; 48 bytes per joint. */
+	AFFINE,
+	/**
+	 * @brief A unit dual quaternion per joint; 32 bytes per joint. Dual quaternions hold only
+	 * rotation and translation, so any scale in the joint matrices is dropped.
+	 */
+	DUAL_QUATERNION
+};
+
+/**
+ * @brief Computes the joint matrices ("palettes") of skinned models for the vertex shader. The
+ * palettes of every registered model are computed in parallel and written into one uniform
+ * buffer per frame; each skinned mesh binds its own range of that buffer when it is rendered,
+ * so no per-vertex work happens on the CPU.
+ *
+ * The buffer is a StreamBuffer, so each frame's palettes are written without synchronizing
+ * with the GPU, and a region is not rewritten until the draws that read it have finished.
+ *
+ * Like Animations, the system keeps pointers to the objects it was given, so models must not be
+ * moved after they are added.
+ */
+class SkinningSystem {
+public:
+	/**
+	 * @brief The most joints a skinned mesh may have; matches MAX_JOINTS in the skinning shaders.
+	 */
+	static const uint32_t MAX_JOINTS = 128;
+
+private:
+	struct SkinnedMeshBinding {
+		Mesh3D* mesh;
+		// Indices into the instance's node list.
+		uint32_t meshNode;
+		std::vector<uint32_t> jointNodes;
+		// Where the mesh's palette begins within a frame's region, in vec4s.
+		size_t paletteOffset;
+	};
+
+	// One registered model, flattened so that every node comes after its parent.
+	struct Instance {
+		std::vector<const Object3D*> nodes;
+		std::vector<int32_t> parents;
+		std::vector<SkinnedMeshBinding> meshes;
+	};
+
+	PaletteFormat m_format;
+	std::vector<Instance> m_instances;
+	// The size of one frame's palettes, in vec4s.
+	size_t m_paletteSize;
+	// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, in vec4s.
+	size_t m_alignment;
+	// Created with the first update, when there is a context to create it in.
+	std::unique_ptr<StreamBuffer> m_stream;
+
+	void flatten(Object3D& node, int32_t parent, Instance& instance);
+	void computePalettes(const Instance& instance, float_t alpha, std::vector<glm::mat4>& globals,
+		glm::vec4* region) const;
+	// The number of vec4s that encode one joint.
+	size_t jointSize() const { return m_format == PaletteFormat::AFFINE ? 3 : 2; }
+
+public:
+	SkinningSystem() : SkinningSystem(PaletteFormat::AFFINE) {}
+	explicit SkinningSystem(PaletteFormat format) : m_format(format),
+		m_paletteSize(0), m_alignment(0) {}
+
+	/**
+	 * @brief Registers every skinned mesh in the model's hierarchy. Models without skinned
+	 * meshes are ignored.
+	 */
+	void add(Object3D& model);
+
+	size_t numberOfInstances() const { return m_instances.size(); }
+	PaletteFormat format() const { return m_format; }
+
+	/**
+	 * @brief The number of bytes of palettes written each frame.
+	 */
+	size_t bytesPerFrame() const { return m_paletteSize * sizeof(glm::vec4); }
+
+	/**
+	 * @brief Recomputes every palette from the transforms of the models' joints the given fraction
+	 * of the way from their previous transforms to their current ones, and writes them into the
+	 * stream buffer. Pass the alpha the models are rendered at, so the pose matches the
+	 * interpolated model. Call once per frame, after animations are applied and before rendering.
+	 */
+	void update(float_t alpha = 1);
+};
@@ -0,0 +1,100 @@
+#include "StreamBuffer.h"
+#include <algorithm>
+#include <stdexcept>
+#include "RenderStats.h"
+
+StreamBuffer::StreamBuffer(uint32_t target, size_t regionSize, size_t alignment)
+	: m_target(target), m_alignment(std::max<size_t>(alignment, 1)), m_buffer(0), m_regionSize(0),
+	m_region(0), m_cursor(0), m_regionsThisFrame(0), m_fences{}, m_mappedSize(0) {
+	glGenBuffers(1, &m_buffer);
+	allocate(regionSize);
+}
+
+StreamBuffer::~StreamBuffer() {
+	for (auto& fence : m_fences) {
+		if (fence != nullptr) {
+			glDeleteSync(fence);
+		}
+	}
+	glDeleteBuffers(1, &m_buffer);
+}
+
+size_t StreamBuffer::uniformAlignment() {
+	int32_t alignment;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	return static_cast<size_t>(alignment);
+}
+
+void StreamBuffer::allocate(size_t regionSize) {
+	// The old storage may still be in use by the GPU; glBufferData orphans it, so the fences on
+	// it no longer matter.
+	for (auto& fence : m_fences) {
+		if (fence != nullptr) {
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+	}
+	m_regionSize = alignUp(regionSize);
+	m_region = 0;
+	m_cursor = 0;
+	glBindBuffer(m_target, m_buffer);
+	glBufferData(m_target, m_regionSize * FRAMES_IN_FLIGHT, nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(m_target, 0);
+}
+
+void StreamBuffer::advance() {
+	// Every draw that reads the current region has been issued by now, so fence it.
+	m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	m_region = (m_region + 1) % FRAMES_IN_FLIGHT;
+	m_cursor = 0;
+	// Then wait for the GPU to finish with the region about to be rewritten, which only blocks
+	// when the CPU is more than FRAMES_IN_FLIGHT - 1 regions ahead.
+	GLsync& fence = m_fences[m_region];
+	if (fence != nullptr) {
+		while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {
+		}
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+}
+
+void StreamBuffer::beginFrame() {
+	if (m_cursor > 0) {
+		advance();
+	}
+	m_regionsThisFrame = 0;
+}
+
+uint8_t* StreamBuffer::map(size_t size, size_t& offset) {
+	size_t start = alignUp(m_cursor);
+	if (start + size > m_regionSize) {
+		if (size > m_regionSize || m_regionsThisFrame + 1 >= FRAMES_IN_FLIGHT) {
+			// Moving on would wait for a region written earlier this frame, so grow instead.
+			allocate(std::max(m_regionSize * 2, size));
+		}
+		else {
+			advance();
+			m_regionsThisFrame++;
+		}
+		start = 0;
+	}
+
+	offset = m_region * m_regionSize + start;
+	glBindBuffer(m_target, m_buffer);
+	auto* data = static_cast<uint8_t*>(glMapBufferRange(m_target, offset, size,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+	if (data == nullptr) {
+		glBindBuffer(m_target, 0);
+		throw std::runtime_error("Could not map a stream buffer");
+	}
+	m_cursor = start + size;
+	m_mappedSize = size;
+	return data;
+}
+
+void StreamBuffer::unmap() {
+	glBindBuffer(m_target, m_buffer);
+	glUnmapBuffer(m_target);
+	glBindBuffer(m_target, 0);
+	RENDER_STATS_ADD(bufferBytesUploaded, m_mappedSize);
+}
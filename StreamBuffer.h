@@ -0,0 +1,77 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "glad.h"
+
+/**
+ * @brief A buffer for data rewritten every frame, such as per-draw uniforms and joint palettes,
+ * that the CPU writes without ever waiting for the GPU to finish reading earlier frames.
+ *
+ * The buffer is a ring of FRAMES_IN_FLIGHT regions. Writes are mapped unsynchronized into the
+ * current region, one after another; when a frame begins, or the region fills, the region is
+ * fenced and writing moves to the next one, first waiting on that region's fence, which has
+ * almost always signaled. A ring that fills every region within one frame grows instead.
+ *
+ * OpenGL 3.3 cannot draw from a buffer while it is mapped, so each write is a short map and
+ * unmap around a batch of data rather than a persistent mapping.
+ */
+class StreamBuffer {
+public:
+	/**
+	 * @brief How many regions the GPU may still be reading while the next is written.
+	 */
+	static const uint32_t FRAMES_IN_FLIGHT = 3;
+
+private:
+	uint32_t m_target;
+	size_t m_alignment;
+	uint32_t m_buffer;
+	size_t m_regionSize;
+	uint32_t m_region;
+	// Where the next write starts within the current region.
+	size_t m_cursor;
+	// How many regions have been filled since the frame began.
+	uint32_t m_regionsThisFrame;
+	std::array<GLsync, FRAMES_IN_FLIGHT> m_fences;
+	size_t m_mappedSize;
+
+	// Replaces the buffer's storage with regions of the given size, orphaning the old storage.
+	void allocate(size_t regionSize);
+	// Fences the current region and waits until the next one is free.
+	void advance();
+	size_t alignUp(size_t offset) const { return (offset + m_alignment - 1) / m_alignment * m_alignment; }
+
+public:
+	/**
+	 * @brief Creates a buffer to be bound to the given target, with regions of at least the given
+	 * size; every write starts at a multiple of alignment. Requires a current OpenGL context.
+	 */
+	StreamBuffer(uint32_t target, size_t regionSize, size_t alignment);
+	~StreamBuffer();
+
+	StreamBuffer(const StreamBuffer&) = delete;
+	StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+	/**
+	 * @brief Moves on to the next region, if the current one has been written to. Call once per
+	 * frame, before the frame's first write.
+	 */
+	void beginFrame();
+
+	/**
+	 * @brief Maps the next size bytes of the current region for writing, and returns them, storing
+	 * their offset in the buffer. The bytes hold garbage until written, and must be unmapped
+	 * before anything draws from the buffer. Throws std::runtime_error if mapping fails.
+	 */
+	uint8_t* map(size_t size, size_t& offset);
+	void unmap();
+
+	uint32_t buffer() const { return m_buffer; }
+	size_t regionSize() const { return m_regionSize; }
+
+	/**
+	 * @brief GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT: the alignment of uniform block ranges.
+	 */
+	static size_t uniformAlignment();
+};
@@ -2,7 +2,9 @@
 #include <string>
 #include <filesystem>
 #include <SFML/Graphics.hpp>
-#include "gl/GL.h"
+#include "glad.h"
+#include "MemoryAccounting.h"
+#include "RenderStats.h"
 
 /**
  * @brief Represents a texture that has been loaded into VRAM, and is expected to be bound
@@ -13,11 +15,26 @@ struct Texture {
 	uint32_t textureId;
 	// The name of the sampler2D uniform in the fragment shader that this texture will bind to.
 	std::string samplerName;
+	// The texture's record in memory reports.
+	uint64_t memoryRecord = 0;
+	// The image file the texture was loaded from, if any, so it can be reloaded when it changes.
+	std::string source;
 
 	/**
-	 * @brief Loads an SFML Image into VRAM and returns a Texture object identifying it.
+	 * @brief Loads an SFML Image into VRAM and returns a Texture object identifying it. The
+	 * texture is recorded in memory reports under the given name, or its sampler name.
 	 */
-	static Texture loadImage(const sf::Image& texture, const std::string& samplerName) {
+	static Texture loadImage(const sf::Image& texture, const std::string& samplerName,
+		const std::string& name = "") {
+		return loadPixels(texture.getPixelsPtr(), texture.getSize().x, texture.getSize().y, samplerName, name);
+	}
+
+	/**
+	 * @brief Loads rows of RGBA8 pixels, top row first, into VRAM directly from the given memory,
+	 * which need not outlive the call.
+	 */
+	static Texture loadPixels(const uint8_t* pixels, uint32_t width, uint32_t height,
+		const std::string& samplerName, const std::string& name = "") {
 		uint32_t texId;
 		glGenTextures(1, &texId);
 		glBindTexture(GL_TEXTURE_2D, texId);
@@ -25,11 +42,42 @@ struct Texture {
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texture.getSize().x, texture.getSize().y, 0, GL_RGBA,
-			GL_UNSIGNED_BYTE, texture.getPixelsPtr());
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		// RGBA8, plus a third for the mipmap chain.
+		size_t bytes = static_cast<size_t>(width) * height * 4;
+		RENDER_STATS_ADD(bufferBytesUploaded, bytes);
+		uint64_t record = MemoryAccounting::instance().add("texture", name.empty() ? samplerName : name,
+			MemoryUsage(0, bytes + bytes / 3));
+
+		return Texture{ texId, samplerName, record };
+	}
+
+	/**
+	 * @brief Replaces the texture's pixels with the image's, keeping its ID, so every mesh that
+	 * uses the texture draws the new image.
+	 */
+	static void reloadImage(const Texture& texture, const sf::Image& image) {
+		uint32_t width = image.getSize().x;
+		uint32_t height = image.getSize().y;
+		glBindTexture(GL_TEXTURE_2D, texture.textureId);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.getPixelsPtr());
 		glGenerateMipmap(GL_TEXTURE_2D);
 		glBindTexture(GL_TEXTURE_2D, 0);
 
-		return Texture{ texId, samplerName };
+		size_t bytes = static_cast<size_t>(width) * height * 4;
+		RENDER_STATS_ADD(bufferBytesUploaded, bytes);
+		MemoryAccounting::instance().update(texture.memoryRecord, MemoryUsage(0, bytes + bytes / 3));
+	}
+
+	/**
+	 * @brief Deletes the texture from VRAM. Textures are copied freely between meshes, so the
+	 * caller must know that no mesh still uses it.
+	 */
+	static void unload(const Texture& texture) {
+		glDeleteTextures(1, &texture.textureId);
+		MemoryAccounting::instance().remove(texture.memoryRecord);
 	}
 };
\ No newline at end of file
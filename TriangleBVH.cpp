@@ -0,0 +1,334 @@
+#include "TriangleBVH.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BVH_SSE 1
+#include <emmintrin.h>
+static_assert(sizeof(float_t) == sizeof(float), "SSE ray casts require float_t to be float");
+#endif
+
+namespace {
+	const size_t LEAF_SIZE = 4;
+	const size_t BIN_COUNT = 12;
+	// Below this depth, nodes are split at the median instead of by SAH, which bounds the depth
+	// of the tree (and so the size of the traversal stack) even for pathological meshes.
+	const size_t MAX_SAH_DEPTH = 32;
+	const size_t STACK_SIZE = 64;
+
+	struct BuildTriangle {
+		AABB bounds;
+		glm::vec3 centroid;
+		uint32_t index;
+	};
+
+	float_t surfaceArea(const AABB& box) {
+		glm::vec3 d = box.max - box.min;
+		return 2 * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+}
+
+TriangleBVH::TriangleBVH(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& faces) {
+	size_t triangleCount = faces.size() / 3;
+	if (triangleCount == 0) {
+		return;
+	}
+	std::vector<BuildTriangle> triangles(triangleCount);
+	for (size_t i = 0; i < triangleCount; i++) {
+		AABB bounds;
+		bounds.expand(positions[faces[i * 3]]);
+		bounds.expand(positions[faces[i * 3 + 1]]);
+		bounds.expand(positions[faces[i * 3 + 2]]);
+		triangles[i] = { bounds, bounds.center(), static_cast<uint32_t>(i) };
+	}
+
+	m_nodes.reserve(triangleCount / LEAF_SIZE * 2 + 1);
+	m_packets.reserve(triangleCount / LEAF_SIZE + 1);
+	m_nodes.push_back({});
+
+	// Nodes still to be built: their index, their range of triangles, and their depth.
+	struct Task {
+		uint32_t node;
+		size_t begin;
+		size_t end;
+		size_t depth;
+	};
+	std::vector<Task> tasks{ { 0, 0, triangleCount, 0 } };
+	while (!tasks.empty()) {
+		Task task = tasks.back();
+		tasks.pop_back();
+
+		AABB bounds, centroidBounds;
+		for (size_t i = task.begin; i < task.end; i++) {
+			bounds.expand(triangles[i].bounds);
+			centroidBounds.expand(triangles[i].centroid);
+		}
+		m_nodes[task.node].min = bounds.min;
+		m_nodes[task.node].max = bounds.max;
+
+		size_t count = task.end - task.begin;
+		if (count <= LEAF_SIZE) {
+			TrianglePacket packet{};
+			for (size_t lane = 0; lane < LEAF_SIZE; lane++) {
+				packet.triangle[lane] = std::numeric_limits<uint32_t>::max();
+				if (lane >= count) {
+					continue;
+				}
+				uint32_t t = triangles[task.begin + lane].index;
+				glm::vec3 v0 = positions[faces[t * 3]];
+				glm::vec3 e1 = positions[faces[t * 3 + 1]] - v0;
+				glm::vec3 e2 = positions[faces[t * 3 + 2]] - v0;
+				packet.v0x[lane] = v0.x; packet.v0y[lane] = v0.y; packet.v0z[lane] = v0.z;
+				packet.e1x[lane] = e1.x; packet.e1y[lane] = e1.y; packet.e1z[lane] = e1.z;
+				packet.e2x[lane] = e2.x; packet.e2y[lane] = e2.y; packet.e2z[lane] = e2.z;
+				packet.triangle[lane] = t;
+			}
+			m_nodes[task.node].first = static_cast<uint32_t>(m_packets.size());
+			m_nodes[task.node].isLeaf = 1;
+			m_packets.push_back(packet);
+			continue;
+		}
+
+		// Choose the split with the surface area heuristic, evaluated at the boundaries of
+		// BIN_COUNT equal bins along each axis of the centroids' bounds.
+		size_t mid = task.begin + count / 2;
+		glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+		int32_t bestAxis = -1;
+		size_t bestBin = 0;
+		if (task.depth < MAX_SAH_DEPTH) {
+			float_t bestCost = std::numeric_limits<float_t>::max();
+			for (int32_t axis = 0; axis < 3; axis++) {
+				if (extent[axis] <= 0) {
+					continue;
+				}
+				AABB binBounds[BIN_COUNT];
+				size_t binCounts[BIN_COUNT] = {};
+				float_t scale = BIN_COUNT / extent[axis];
+				for (size_t i = task.begin; i < task.end; i++) {
+					size_t bin = std::min(BIN_COUNT - 1,
+						static_cast<size_t>((triangles[i].centroid[axis] - centroidBounds.min[axis]) * scale));
+					binBounds[bin].expand(triangles[i].bounds);
+					binCounts[bin]++;
+				}
+				// Sweep from the right to get the cost of each right side, then from the left.
+				float_t rightCosts[BIN_COUNT];
+				AABB right;
+				size_t rightCount = 0;
+				for (size_t b = BIN_COUNT - 1; b > 0; b--) {
+					right.expand(binBounds[b]);
+					rightCount += binCounts[b];
+					rightCosts[b] = rightCount == 0 ? 0 : surfaceArea(right) * rightCount;
+				}
+				AABB left;
+				size_t leftCount = 0;
+				for (size_t b = 0; b < BIN_COUNT - 1; b++) {
+					left.expand(binBounds[b]);
+					leftCount += binCounts[b];
+					if (leftCount == 0 || leftCount == count) {
+						continue;
+					}
+					float_t cost = surfaceArea(left) * leftCount + rightCosts[b + 1];
+					if (cost < bestCost) {
+						bestCost = cost;
+						bestAxis = axis;
+						bestBin = b;
+					}
+				}
+			}
+		}
+
+		if (bestAxis >= 0) {
+			float_t scale = BIN_COUNT / extent[bestAxis];
+			float_t minimum = centroidBounds.min[bestAxis];
+			auto split = std::partition(triangles.begin() + task.begin, triangles.begin() + task.end,
+				[&](const BuildTriangle& t) {
+					return std::min(BIN_COUNT - 1,
+						static_cast<size_t>((t.centroid[bestAxis] - minimum) * scale)) <= bestBin;
+				});
+			mid = split - triangles.begin();
+		}
+		else {
+			// Split at the median of the longest axis.
+			int32_t axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+			std::nth_element(triangles.begin() + task.begin, triangles.begin() + mid,
+				triangles.begin() + task.end, [axis](const BuildTriangle& a, const BuildTriangle& b) {
+					return a.centroid[axis] < b.centroid[axis];
+				});
+		}
+
+		uint32_t left = static_cast<uint32_t>(m_nodes.size());
+		m_nodes.push_back({});
+		m_nodes.push_back({});
+		m_nodes[task.node].first = left;
+		m_nodes[task.node].isLeaf = 0;
+		tasks.push_back({ left, task.begin, mid, task.depth + 1 });
+		tasks.push_back({ left + 1, mid, task.end, task.depth + 1 });
+	}
+}
+
+#ifdef BVH_SSE
+
+bool TriangleBVH::intersectPacket(const TrianglePacket& p, const Ray& ray, RayHit& hit) const {
+	__m128 dx = _mm_set1_ps(ray.direction.x), dy = _mm_set1_ps(ray.direction.y), dz = _mm_set1_ps(ray.direction.z);
+	__m128 e1x = _mm_loadu_ps(p.e1x), e1y = _mm_loadu_ps(p.e1y), e1z = _mm_loadu_ps(p.e1z);
+	__m128 e2x = _mm_loadu_ps(p.e2x), e2y = _mm_loadu_ps(p.e2y), e2z = _mm_loadu_ps(p.e2z);
+
+	// pvec = direction x e2; det = e1 . pvec
+	__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+	__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+	__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+	__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+	__m128 inverseDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+	// tvec = origin - v0; u = (tvec . pvec) / det
+	__m128 tx = _mm_sub_ps(_mm_set1_ps(ray.origin.x), _mm_loadu_ps(p.v0x));
+	__m128 ty = _mm_sub_ps(_mm_set1_ps(ray.origin.y), _mm_loadu_ps(p.v0y));
+	__m128 tz = _mm_sub_ps(_mm_set1_ps(ray.origin.z), _mm_loadu_ps(p.v0z));
+	__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), inverseDet);
+
+	// qvec = tvec x e1; v = (direction . qvec) / det; t = (e2 . qvec) / det
+	__m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+	__m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+	__m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+	__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inverseDet);
+	__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverseDet);
+
+	__m128 zero = _mm_setzero_ps();
+	__m128 absDet = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+	__m128 valid = _mm_and_ps(_mm_cmpgt_ps(absDet, _mm_set1_ps(1e-12f)), _mm_cmpge_ps(u, zero));
+	valid = _mm_and_ps(valid, _mm_cmpge_ps(v, zero));
+	valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+	valid = _mm_and_ps(valid, _mm_cmpgt_ps(t, zero));
+	valid = _mm_and_ps(valid, _mm_cmplt_ps(t, _mm_set1_ps(hit.distance)));
+	int mask = _mm_movemask_ps(valid);
+	if (mask == 0) {
+		return false;
+	}
+
+	float_t ts[4], us[4], vs[4];
+	_mm_storeu_ps(ts, t);
+	_mm_storeu_ps(us, u);
+	_mm_storeu_ps(vs, v);
+	for (int lane = 0; lane < 4; lane++) {
+		if ((mask & (1 << lane)) && ts[lane] < hit.distance) {
+			hit = { ts[lane], p.triangle[lane], us[lane], vs[lane] };
+		}
+	}
+	return true;
+}
+
+#else
+
+bool TriangleBVH::intersectPacket(const TrianglePacket& p, const Ray& ray, RayHit& hit) const {
+	bool found = false;
+	for (int lane = 0; lane < 4; lane++) {
+		glm::vec3 e1(p.e1x[lane], p.e1y[lane], p.e1z[lane]);
+		glm::vec3 e2(p.e2x[lane], p.e2y[lane], p.e2z[lane]);
+		glm::vec3 pvec = glm::cross(ray.direction, e2);
+		float_t det = glm::dot(e1, pvec);
+		if (std::abs(det) <= 1e-12f) {
+			continue;
+		}
+		float_t inverseDet = 1 / det;
+		glm::vec3 tvec = ray.origin - glm::vec3(p.v0x[lane], p.v0y[lane], p.v0z[lane]);
+		float_t u = glm::dot(tvec, pvec) * inverseDet;
+		glm::vec3 qvec = glm::cross(tvec, e1);
+		float_t v = glm::dot(ray.direction, qvec) * inverseDet;
+		float_t t = glm::dot(e2, qvec) * inverseDet;
+		if (u >= 0 && v >= 0 && u + v <= 1 && t > 0 && t < hit.distance) {
+			hit = { t, p.triangle[lane], u, v };
+			found = true;
+		}
+	}
+	return found;
+}
+
+#endif
+
+TriangleBVH TriangleBVH::fromBytes(const void* nodes, size_t nodeByteCount, const void* packets, size_t packetByteCount,
+	size_t triangleCount) {
+	if (nodeByteCount % sizeof(Node) != 0 || packetByteCount % sizeof(TrianglePacket) != 0) {
+		throw std::runtime_error("BVH data is not a whole number of nodes and packets");
+	}
+	TriangleBVH bvh;
+	bvh.m_nodes.resize(nodeByteCount / sizeof(Node));
+	bvh.m_packets.resize(packetByteCount / sizeof(TrianglePacket));
+	if (nodeByteCount > 0) {
+		std::memcpy(bvh.m_nodes.data(), nodes, nodeByteCount);
+	}
+	if (packetByteCount > 0) {
+		std::memcpy(bvh.m_packets.data(), packets, packetByteCount);
+	}
+
+	// Children follow their parents, so the tree has no cycles, and traversal pushes at most one
+	// more node per level than it pops.
+	std::vector<size_t> depths(bvh.m_nodes.size(), 0);
+	for (size_t i = 0; i < bvh.m_nodes.size(); i++) {
+		const Node& node = bvh.m_nodes[i];
+		if (node.isLeaf) {
+			if (node.first >= bvh.m_packets.size()) {
+				throw std::runtime_error("BVH leaf refers to a missing packet");
+			}
+			continue;
+		}
+		if (node.first <= i || static_cast<size_t>(node.first) + 1 >= bvh.m_nodes.size()) {
+			throw std::runtime_error("BVH node has invalid children");
+		}
+		if (depths[i] + 1 >= STACK_SIZE) {
+			throw std::runtime_error("BVH is too deep");
+		}
+		depths[node.first] = std::max(depths[node.first], depths[i] + 1);
+		depths[node.first + 1] = std::max(depths[node.first + 1], depths[i] + 1);
+	}
+	for (const TrianglePacket& packet : bvh.m_packets) {
+		for (uint32_t triangle : packet.triangle) {
+			// Unused slots hold the largest index.
+			if (triangle >= triangleCount && triangle != std::numeric_limits<uint32_t>::max()) {
+				throw std::runtime_error("BVH refers to a missing triangle");
+			}
+		}
+	}
+	return bvh;
+}
+
+bool TriangleBVH::intersect(const Ray& ray, RayHit& hit) const {
+	if (m_nodes.empty()) {
+		return false;
+	}
+	glm::vec3 inverseDirection = 1.0f / ray.direction;
+	const float_t infinity = std::numeric_limits<float_t>::infinity();
+
+	bool found = false;
+	uint32_t stack[STACK_SIZE];
+	size_t stackSize = 0;
+	if (rayEnterDistance(m_nodes[0].min, m_nodes[0].max, ray.origin, inverseDirection, hit.distance) < infinity) {
+		stack[stackSize++] = 0;
+	}
+	while (stackSize > 0) {
+		const Node& node = m_nodes[stack[--stackSize]];
+		if (node.isLeaf) {
+			found |= intersectPacket(m_packets[node.first], ray, hit);
+			continue;
+		}
+		// Visit the nearer child first, so hits there cull the farther child.
+		const Node& left = m_nodes[node.first];
+		const Node& right = m_nodes[node.first + 1];
+		float_t enterLeft = rayEnterDistance(left.min, left.max, ray.origin, inverseDirection, hit.distance);
+		float_t enterRight = rayEnterDistance(right.min, right.max, ray.origin, inverseDirection, hit.distance);
+		uint32_t nearer = node.first, farther = node.first + 1;
+		if (enterRight < enterLeft) {
+			std::swap(nearer, farther);
+			std::swap(enterLeft, enterRight);
+		}
+		if (enterRight < infinity) {
+			stack[stackSize++] = farther;
+		}
+		if (enterLeft < infinity) {
+			stack[stackSize++] = nearer;
+		}
+	}
+	return found;
+}
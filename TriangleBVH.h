@@ -0,0 +1,109 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Bounds.h"
+
+/**
+ * @brief A ray with an origin and a direction. The direction need not be normalized; hit
+ * distances are measured in multiples of it.
+ */
+struct Ray {
+	glm::vec3 origin;
+	glm::vec3 direction;
+};
+
+/**
+ * @brief Where a ray hit a triangle: the distance along the ray, the index of the triangle in
+ * the mesh's face list, and the barycentric coordinates of the hit point.
+ */
+struct RayHit {
+	float_t distance;
+	uint32_t triangle;
+	float_t u;
+	float_t v;
+};
+
+/**
+ * @brief A bounding volume hierarchy over the triangles of a mesh, for fast ray casts. The tree
+ * is built once with the surface area heuristic; each leaf holds up to four triangles stored
+ * as one SoA packet, so a leaf is tested with a single 4-wide Möller–Trumbore intersection.
+ */
+class TriangleBVH {
+private:
+	// 32 bytes. Interior nodes' children are adjacent, starting at first; leaves hold the
+	// packet at index first.
+	struct Node {
+		glm::vec3 min;
+		uint32_t first;
+		glm::vec3 max;
+		uint32_t isLeaf;
+	};
+
+	// Four triangles, each as a vertex and the two edges from it. Unused slots are degenerate
+	// and never hit.
+	struct TrianglePacket {
+		float_t v0x[4], v0y[4], v0z[4];
+		float_t e1x[4], e1y[4], e1z[4];
+		float_t e2x[4], e2y[4], e2z[4];
+		uint32_t triangle[4];
+	};
+
+	std::vector<Node> m_nodes;
+	std::vector<TrianglePacket> m_packets;
+
+	bool intersectPacket(const TrianglePacket& packet, const Ray& ray, RayHit& hit) const;
+
+public:
+	TriangleBVH() = default;
+
+	/**
+	 * @brief Builds a tree over the triangles given by the positions and the face indices, three
+	 * per triangle.
+	 */
+	TriangleBVH(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& faces);
+
+	/**
+	 * @brief Restores a tree over triangleCount triangles from the bytes of another tree's nodes
+	 * and packets, as given by nodeBytes and packetBytes, so a prebuilt tree can be stored in a
+	 * file. Throws std::runtime_error if the sizes are not whole numbers of nodes and packets, or
+	 * if the tree refers to nodes, packets, or triangles it does not have, or is too deep to
+	 * traverse.
+	 */
+	static TriangleBVH fromBytes(const void* nodes, size_t nodeByteCount, const void* packets, size_t packetByteCount,
+		size_t triangleCount);
+
+	/**
+	 * @brief The size of each node in nodeBytes and each packet in packetBytes, which depend on
+	 * the compiler, so stored trees can be checked against them before they are restored.
+	 */
+	static size_t nodeSize() { return sizeof(Node); }
+	static size_t packetSize() { return sizeof(TrianglePacket); }
+
+	const void* nodeBytes() const { return m_nodes.data(); }
+	size_t nodeByteCount() const { return m_nodes.size() * sizeof(Node); }
+	const void* packetBytes() const { return m_packets.data(); }
+	size_t packetByteCount() const { return m_packets.size() * sizeof(TrianglePacket); }
+
+	bool isEmpty() const { return m_nodes.empty(); }
+
+	/**
+	 * @brief The bounds of every triangle in the tree.
+	 */
+	AABB bounds() const {
+		return isEmpty() ? AABB() : AABB(m_nodes[0].min, m_nodes[0].max);
+	}
+
+	/**
+	 * @brief The number of bytes used by the tree.
+	 */
+	size_t byteSize() const {
+		return m_nodes.size() * sizeof(Node) + m_packets.size() * sizeof(TrianglePacket);
+	}
+
+	/**
+	 * @brief Finds the nearest triangle that the ray hits at a distance less than hit.distance,
+	 * updating hit if one is found. Initialize hit.distance to the farthest distance of interest.
+	 */
+	bool intersect(const Ray& ray, RayHit& hit) const;
+};
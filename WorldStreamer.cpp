@@ -0,0 +1,320 @@
+#include "WorldStreamer.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include "MemoryAccounting.h"
+#include "Profiler.h"
+
+WorldStreamer::WorldStreamer(SceneDescription world, StreamingBudgets budgets)
+	: m_description(std::move(world)), m_budgets(budgets),
+	m_loader(budgets.importThreads, budgets.ioBytesPerSecond), m_residentBytes(0),
+	m_memoryHorizon(std::numeric_limits<float_t>::infinity()), m_stats{} {
+	// Cells are found by dividing positions by their size.
+	if (!std::isfinite(m_budgets.cellSize) || m_budgets.cellSize <= 0) {
+		throw std::runtime_error("The cell size must be a positive number");
+	}
+	auto& nodes = m_description.nodes;
+	m_children.resize(nodes.size());
+	std::unordered_map<int64_t, size_t> cellIndex;
+	for (size_t i = 0; i < nodes.size(); i++) {
+		if (nodes[i].parent >= 0) {
+			m_children[nodes[i].parent].push_back(i);
+			continue;
+		}
+		glm::ivec2 coord(static_cast<int32_t>(std::floor(nodes[i].position.x / m_budgets.cellSize)),
+			static_cast<int32_t>(std::floor(nodes[i].position.z / m_budgets.cellSize)));
+		int64_t key = (static_cast<int64_t>(coord.x) << 32) | static_cast<uint32_t>(coord.y);
+		auto cell = cellIndex.find(key);
+		if (cell == cellIndex.end()) {
+			cell = cellIndex.emplace(key, m_cells.size()).first;
+			m_cells.push_back(Cell{ coord, {}, {}, CellState::UNLOADED, 0, {} });
+		}
+		m_cells[cell->second].roots.push_back(i);
+	}
+	// Children are known only once every node has been seen.
+	for (auto& cell : m_cells) {
+		for (size_t root : cell.roots) {
+			collectModels(root, cell.models);
+		}
+	}
+}
+
+WorldStreamer::~WorldStreamer() {
+	for (auto& cell : m_cells) {
+		if (cell.state != CellState::UNLOADED) {
+			evict(cell);
+		}
+	}
+}
+
+std::string WorldStreamer::modelKey(const SceneNodeDescription& node) {
+	return node.model + (node.flipTextureCoords ? "|flip" : "");
+}
+
+void WorldStreamer::collectModels(size_t node, std::vector<size_t>& models) const {
+	auto& nodes = m_description.nodes;
+	if (!nodes[node].model.empty()) {
+		std::string key = modelKey(nodes[node]);
+		bool seen = std::any_of(models.begin(), models.end(), [&](size_t m) { return modelKey(nodes[m]) == key; });
+		if (!seen) {
+			models.push_back(node);
+		}
+	}
+	for (size_t child : m_children[node]) {
+		collectModels(child, models);
+	}
+}
+
+void WorldStreamer::load(Cell& cell) {
+	cell.state = CellState::LOADING;
+	for (size_t node : cell.models) {
+		auto& description = m_description.nodes[node];
+		std::string key = modelKey(description);
+		auto model = m_models.find(key);
+		if (model == m_models.end()) {
+			uint64_t request = m_loader.request(description.model, description.flipTextureCoords, cell.distance);
+			m_requests[request] = key;
+			model = m_models.emplace(key, Model{ description.model, description.flipTextureCoords, ModelState::IMPORTING,
+				request, 0, cell.distance, 0, nullptr, nullptr, {} }).first;
+		}
+		model->second.users++;
+	}
+}
+
+void WorldStreamer::evict(Cell& cell) {
+	cell.objects.clear();
+	cell.state = CellState::UNLOADED;
+	for (size_t node : cell.models) {
+		release(modelKey(m_description.nodes[node]));
+	}
+	m_stats.evictedCells++;
+}
+
+void WorldStreamer::release(const std::string& key) {
+	auto found = m_models.find(key);
+	Model& model = found->second;
+	if (--model.users > 0) {
+		return;
+	}
+	switch (model.state) {
+	case ModelState::IMPORTING:
+		// An import that has already started still delivers its result, which is then ignored.
+		m_loader.cancel(model.request);
+		m_requests.erase(model.request);
+		break;
+	case ModelState::UPLOADING:
+		for (auto& texture : model.upload->textures()) {
+			Texture::unload(texture);
+		}
+		break;
+	case ModelState::RESIDENT:
+		for (auto& texture : model.textures) {
+			Texture::unload(texture);
+		}
+		break;
+	case ModelState::FAILED:
+		break;
+	}
+	// Meshes are deleted along with the last object that shares them.
+	m_residentBytes -= model.bytes;
+	m_models.erase(found);
+}
+
+void WorldStreamer::receiveImports() {
+	for (auto& result : m_loader.collect()) {
+		auto request = m_requests.find(result.id);
+		if (request == m_requests.end()) {
+			continue;
+		}
+		Model& model = m_models.at(request->second);
+		m_requests.erase(request);
+		if (result.model == nullptr) {
+			std::cerr << "Could not stream " << model.path << ": " << result.error << std::endl;
+			model.state = ModelState::FAILED;
+			continue;
+		}
+		// Counted from now on, since the imported data is on its way to the GPU.
+		model.bytes = result.model->gpuBytes();
+		m_residentBytes += model.bytes;
+		model.upload = std::make_unique<ModelUpload>(std::move(*result.model));
+		model.state = ModelState::UPLOADING;
+	}
+}
+
+void WorldStreamer::upload() {
+	PROFILE_SCOPE("WorldStreamer::upload");
+	std::vector<Model*> uploading;
+	for (auto& [key, model] : m_models) {
+		if (model.state == ModelState::UPLOADING) {
+			uploading.push_back(&model);
+		}
+	}
+	std::sort(uploading.begin(), uploading.end(), [](Model* a, Model* b) { return a->priority < b->priority; });
+
+	size_t uploaded = 0;
+	bool first = true;
+	for (Model* model : uploading) {
+		while (!model->upload->done() && (first || uploaded < m_budgets.uploadBytesPerFrame)) {
+			uploaded += model->upload->uploadNext();
+			first = false;
+		}
+		if (model->upload->done()) {
+			model->prototype = std::make_unique<Object3D>(model->upload->finish());
+			model->textures = model->upload->textures();
+			model->upload.reset();
+			model->state = ModelState::RESIDENT;
+		}
+		if (uploaded >= m_budgets.uploadBytesPerFrame) {
+			break;
+		}
+	}
+	m_stats.uploadedBytes = uploaded;
+}
+
+Object3D WorldStreamer::buildNode(size_t index) const {
+	auto& description = m_description.nodes[index];
+	Object3D object(std::vector<Mesh3D>{});
+	object.setName(description.name);
+	object.setTransform(description.position, description.orientation, glm::quat(1, 0, 0, 0), description.scale);
+	if (!description.model.empty()) {
+		auto& model = m_models.at(modelKey(description));
+		if (model.state == ModelState::RESIDENT) {
+			object.addChild(Object3D(*model.prototype));
+		}
+	}
+	for (size_t child : m_children[index]) {
+		object.addChild(buildNode(child));
+	}
+	return object;
+}
+
+void WorldStreamer::update(const glm::vec3& cameraPosition) {
+	PROFILE_SCOPE("WorldStreamer::update");
+	MemoryTag tag("world");
+	m_stats.uploadedBytes = 0;
+	m_stats.evictedCells = 0;
+
+	glm::vec2 camera(cameraPosition.x, cameraPosition.z);
+	for (auto& cell : m_cells) {
+		glm::vec2 low = glm::vec2(cell.coord) * m_budgets.cellSize;
+		glm::vec2 nearest = glm::clamp(camera, low, low + m_budgets.cellSize);
+		cell.distance = glm::length(camera - nearest);
+		if (cell.state != CellState::UNLOADED && cell.distance > m_budgets.evictRadius) {
+			evict(cell);
+		}
+	}
+
+	receiveImports();
+
+	// Over the memory budget, evict the farthest cells, but never the nearest, and load nothing
+	// as far away until memory frees up.
+	std::vector<Cell*> loaded;
+	for (auto& cell : m_cells) {
+		if (cell.state != CellState::UNLOADED) {
+			loaded.push_back(&cell);
+		}
+	}
+	std::sort(loaded.begin(), loaded.end(), [](Cell* a, Cell* b) { return a->distance > b->distance; });
+	for (size_t i = 0; i + 1 < loaded.size() && m_residentBytes > m_budgets.memoryBytes; i++) {
+		m_memoryHorizon = std::min(m_memoryHorizon, loaded[i]->distance);
+		evict(*loaded[i]);
+	}
+	if (m_residentBytes < m_budgets.memoryBytes / 4 * 3) {
+		m_memoryHorizon = std::numeric_limits<float_t>::infinity();
+	}
+
+	std::vector<Cell*> wanted;
+	for (auto& cell : m_cells) {
+		if (cell.state == CellState::UNLOADED && cell.distance <= m_budgets.loadRadius && cell.distance < m_memoryHorizon) {
+			wanted.push_back(&cell);
+		}
+	}
+	std::sort(wanted.begin(), wanted.end(), [](Cell* a, Cell* b) { return a->distance < b->distance; });
+	for (Cell* cell : wanted) {
+		if (m_residentBytes >= m_budgets.memoryBytes) {
+			break;
+		}
+		load(*cell);
+	}
+
+	// Models are imported and uploaded for the nearest cell that needs them first.
+	for (auto& [key, model] : m_models) {
+		model.priority = std::numeric_limits<float_t>::infinity();
+	}
+	for (auto& cell : m_cells) {
+		if (cell.state == CellState::UNLOADED) {
+			continue;
+		}
+		for (size_t node : cell.models) {
+			Model& model = m_models.at(modelKey(m_description.nodes[node]));
+			model.priority = std::min(model.priority, cell.distance);
+		}
+	}
+	for (auto& [key, model] : m_models) {
+		if (model.state == ModelState::IMPORTING) {
+			m_loader.setPriority(model.request, model.priority);
+		}
+	}
+
+	upload();
+
+	// A cell's objects are built once all of its models have arrived, so it appears whole.
+	for (auto& cell : m_cells) {
+		if (cell.state != CellState::LOADING) {
+			continue;
+		}
+		bool arrived = std::all_of(cell.models.begin(), cell.models.end(), [&](size_t node) {
+			auto state = m_models.at(modelKey(m_description.nodes[node])).state;
+			return state == ModelState::RESIDENT || state == ModelState::FAILED;
+		});
+		if (!arrived) {
+			continue;
+		}
+		for (size_t root : cell.roots) {
+			cell.objects.push_back(buildNode(root));
+			cell.objects.back().savePreviousTransform();
+		}
+		cell.state = CellState::RESIDENT;
+	}
+
+	m_stats.residentCells = std::count_if(m_cells.begin(), m_cells.end(), [](auto& c) { return c.state == CellState::RESIDENT; });
+	m_stats.loadingCells = std::count_if(m_cells.begin(), m_cells.end(), [](auto& c) { return c.state == CellState::LOADING; });
+	m_stats.residentModels = std::count_if(m_models.begin(), m_models.end(),
+		[](auto& m) { return m.second.state == ModelState::RESIDENT; });
+	m_stats.residentBytes = m_residentBytes;
+	m_stats.pendingImports = m_loader.pending();
+}
+
+void WorldStreamer::finishLoading(const glm::vec3& cameraPosition) {
+	size_t uploadBudget = m_budgets.uploadBytesPerFrame;
+	m_budgets.uploadBytesPerFrame = std::numeric_limits<size_t>::max();
+	do {
+		update(cameraPosition);
+		if (m_stats.loadingCells > 0 && m_stats.uploadedBytes == 0) {
+			// Waiting on the import threads.
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	} while (m_stats.loadingCells > 0);
+	m_budgets.uploadBytesPerFrame = uploadBudget;
+}
+
+template <typename Program>
+void WorldStreamer::renderWith(Program& program, float_t alpha) const {
+	for (auto& cell : m_cells) {
+		if (cell.state != CellState::RESIDENT) {
+			continue;
+		}
+		Object3D::renderAll(cell.objects, program, alpha);
+	}
+}
+
+void WorldStreamer::render(ShaderProgram& program, float_t alpha) const {
+	renderWith(program, alpha);
+}
+
+void WorldStreamer::render(ShaderVariants& variants, float_t alpha) const {
+	renderWith(variants, alpha);
+}
@@ -0,0 +1,165 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+#include "AssimpImport.h"
+#include "AsyncModelLoader.h"
+#include "Object3D.h"
+#include "SceneFile.h"
+#include "ShaderProgram.h"
+
+/**
+ * @brief The limits a WorldStreamer keeps to. Distances are measured on the ground (x-z) plane,
+ * from the camera to the nearest point of a cell.
+ */
+struct StreamingBudgets {
+	// The width and depth of a grid cell.
+	float_t cellSize = 25;
+	// Cells nearer than this are loaded.
+	float_t loadRadius = 75;
+	// Cells farther than this are evicted. Keeping it above loadRadius stops a camera on the edge
+	// of a cell from loading and evicting it over and over.
+	float_t evictRadius = 100;
+	// The most bytes of meshes and textures resident on the GPU; the farthest cells are evicted
+	// to stay within it.
+	size_t memoryBytes = 512u << 20;
+	// The most bytes read from disk per second by the import threads.
+	double ioBytesPerSecond = 64u << 20;
+	// The most bytes uploaded to the GPU per update, though one texture or mesh is always uploaded.
+	size_t uploadBytesPerFrame = 8u << 20;
+	size_t importThreads = 1;
+};
+
+/**
+ * @brief Streams a world too large to be resident at once. The root nodes of a SceneDescription
+ * are divided into grid cells by position; as the camera approaches a cell, its models are
+ * imported on background threads and uploaded a part at a time, and once they all have arrived
+ * the cell's objects are built. Cells the camera leaves behind are evicted, and a model is
+ * deleted from the GPU when no resident cell uses it.
+ *
+ * Streamed objects are static: their animations are ignored, since the animation, skinning, and
+ * collision systems keep pointers to the objects they drive and evicting would leave those
+ * pointers dangling.
+ */
+class WorldStreamer {
+public:
+	enum class CellState {
+		UNLOADED,
+		// Waiting for its models to import and upload.
+		LOADING,
+		RESIDENT
+	};
+
+	struct Stats {
+		size_t residentCells;
+		size_t loadingCells;
+		size_t residentModels;
+		// Bytes of meshes and textures on the GPU, or imported and waiting to be uploaded.
+		size_t residentBytes;
+		size_t pendingImports;
+		size_t uploadedBytes;
+		size_t evictedCells;
+	};
+
+private:
+	enum class ModelState {
+		IMPORTING,
+		UPLOADING,
+		RESIDENT,
+		FAILED
+	};
+
+	// A model file, shared by every cell that uses it.
+	struct Model {
+		std::string path;
+		bool flipTextureCoords;
+		ModelState state;
+		uint64_t request;
+		// How many loading or resident cells use the model.
+		size_t users;
+		// The distance to the nearest cell that uses it, which orders imports and uploads.
+		float_t priority;
+		size_t bytes;
+		std::unique_ptr<ModelUpload> upload;
+		std::unique_ptr<Object3D> prototype;
+		std::vector<Texture> textures;
+	};
+
+	struct Cell {
+		glm::ivec2 coord;
+		// The root nodes in the cell.
+		std::vector<size_t> roots;
+		// For each model the cell's nodes use, one node that uses it.
+		std::vector<size_t> models;
+		CellState state;
+		float_t distance;
+		std::vector<Object3D> objects;
+	};
+
+	SceneDescription m_description;
+	StreamingBudgets m_budgets;
+	std::vector<std::vector<size_t>> m_children;
+	std::vector<Cell> m_cells;
+	std::unordered_map<std::string, Model> m_models;
+	// Which model each import request is for.
+	std::unordered_map<uint64_t, std::string> m_requests;
+	AsyncModelLoader m_loader;
+	size_t m_residentBytes;
+	// No cell this far away or farther is loaded, after one was evicted to stay within the memory
+	// budget; relaxed again as memory frees up.
+	float_t m_memoryHorizon;
+	Stats m_stats;
+
+	static std::string modelKey(const SceneNodeDescription& node);
+	void collectModels(size_t node, std::vector<size_t>& models) const;
+	template <typename Program>
+	void renderWith(Program& program, float_t alpha) const;
+	void load(Cell& cell);
+	void evict(Cell& cell);
+	void release(const std::string& key);
+	void receiveImports();
+	void upload();
+	Object3D buildNode(size_t index) const;
+
+public:
+	/**
+	 * @brief Divides the world into cells without loading anything. Throws std::runtime_error if
+	 * the budgets' cell size is not a positive number.
+	 */
+	WorldStreamer(SceneDescription world, StreamingBudgets budgets = StreamingBudgets());
+	~WorldStreamer();
+
+	WorldStreamer(const WorldStreamer&) = delete;
+	WorldStreamer& operator=(const WorldStreamer&) = delete;
+
+	const SceneDescription& description() const { return m_description; }
+
+	/**
+	 * @brief Loads the cells near the camera, nearest first, evicts the cells far from it, and
+	 * uploads imported models within the per-frame budget. Call once per frame on the thread that
+	 * owns the OpenGL context.
+	 */
+	void update(const glm::vec3& cameraPosition);
+
+	/**
+	 * @brief Updates until every cell within the load radius is resident, or cannot be within the
+	 * memory budget, regardless of the upload budget.
+	 */
+	void finishLoading(const glm::vec3& cameraPosition);
+
+	/**
+	 * @brief Renders the objects of every resident cell.
+	 */
+	void render(ShaderProgram& program, float_t alpha = 1) const;
+	void render(ShaderVariants& variants, float_t alpha = 1) const;
+
+	CellState state(size_t cell) const { return m_cells[cell].state; }
+	size_t cellCount() const { return m_cells.size(); }
+
+	/**
+	 * @brief Statistics as of the last update; uploadedBytes and evictedCells count that update only.
+	 */
+	const Stats& stats() const { return m_stats; }
+};
@@ -0,0 +1,275 @@
+#include "Benchmark.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <regex>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+namespace {
+	std::vector<std::unique_ptr<BenchmarkDefinition>>& registry() {
+		static std::vector<std::unique_ptr<BenchmarkDefinition>> definitions;
+		return definitions;
+	}
+
+	std::vector<std::pair<std::string, std::string>>& context() {
+		static std::vector<std::pair<std::string, std::string>> entries;
+		return entries;
+	}
+
+	std::string jsonString(const std::string& text) {
+		std::ostringstream out;
+		out << '"';
+		for (char c : text) {
+			if (c == '"' || c == '\\') {
+				out << '\\' << c;
+			}
+			else if (static_cast<unsigned char>(c) < 0x20) {
+				out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c)
+					<< std::dec << std::setfill(' ');
+			}
+			else {
+				out << c;
+			}
+		}
+		out << '"';
+		return out.str();
+	}
+}
+
+BenchmarkState::BenchmarkState(const std::vector<int64_t>& args, uint64_t iterations)
+	: m_args(args), m_iterations(iterations), m_completed(0), m_started(false), m_paused(true),
+	m_cpuStart(0), m_realSeconds(0), m_cpuSeconds(0), m_itemsProcessed(0), m_bytesProcessed(0) {
+}
+
+void BenchmarkState::pauseTiming() {
+	if (m_paused) {
+		return;
+	}
+	m_realSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - m_realStart).count();
+	m_cpuSeconds += static_cast<double>(std::clock() - m_cpuStart) / CLOCKS_PER_SEC;
+	m_paused = true;
+}
+
+void BenchmarkState::resumeTiming() {
+	if (!m_paused) {
+		return;
+	}
+	m_paused = false;
+	m_cpuStart = std::clock();
+	m_realStart = std::chrono::steady_clock::now();
+}
+
+BenchmarkDefinition* registerBenchmark(const char* name, BenchmarkFunction function) {
+	registry().push_back(std::make_unique<BenchmarkDefinition>(name, function));
+	return registry().back().get();
+}
+
+void addBenchmarkContext(const std::string& key, const std::string& value) {
+	context().emplace_back(key, value);
+}
+
+/**
+ * @brief Runs benchmarks and collects their results.
+ */
+class BenchmarkRunner {
+public:
+	struct Result {
+		std::string name;
+		uint64_t iterations;
+		// Per iteration, in nanoseconds, over the repetitions.
+		double realMean;
+		double realMin;
+		double realStddev;
+		double cpuMean;
+		double itemsPerSecond;
+		double bytesPerSecond;
+		std::string label;
+		std::string error;
+	};
+
+	double minTime = 0.5;
+	uint32_t repetitions = 3;
+
+	Result run(BenchmarkDefinition& definition, const std::vector<int64_t>& args, const std::string& name) {
+		Result result{ name, 0, 0, 0, 0, 0, 0, 0, "", "" };
+
+		// Grow the iteration count until one run lasts the minimum time.
+		uint64_t iterations = 1;
+		while (true) {
+			BenchmarkState state(args, iterations);
+			definition.m_function(state);
+			if (!state.m_error.empty()) {
+				result.error = state.m_error;
+				return result;
+			}
+			if (state.m_realSeconds >= minTime || iterations >= 1000000000) {
+				break;
+			}
+			double scale = state.m_realSeconds > 0 ? minTime * 1.4 / state.m_realSeconds : 100;
+			iterations = static_cast<uint64_t>(std::ceil(iterations * std::min(std::max(scale, 2.0), 100.0)));
+		}
+
+		std::vector<double> realTimes;
+		double cpuTotal = 0, items = 0, bytes = 0, seconds = 0;
+		for (uint32_t r = 0; r < repetitions; r++) {
+			BenchmarkState state(args, iterations);
+			definition.m_function(state);
+			realTimes.push_back(state.m_realSeconds / iterations * 1e9);
+			cpuTotal += state.m_cpuSeconds / iterations * 1e9;
+			items += static_cast<double>(state.m_itemsProcessed);
+			bytes += static_cast<double>(state.m_bytesProcessed);
+			seconds += state.m_realSeconds;
+			result.label = state.m_label;
+		}
+		double mean = 0;
+		for (double t : realTimes) {
+			mean += t;
+		}
+		mean /= realTimes.size();
+		double variance = 0;
+		for (double t : realTimes) {
+			variance += (t - mean) * (t - mean);
+		}
+		result.iterations = iterations;
+		result.realMean = mean;
+		result.realMin = *std::min_element(realTimes.begin(), realTimes.end());
+		result.realStddev = realTimes.size() > 1 ? std::sqrt(variance / (realTimes.size() - 1)) : 0;
+		result.cpuMean = cpuTotal / repetitions;
+		result.itemsPerSecond = seconds > 0 ? items / seconds : 0;
+		result.bytesPerSecond = seconds > 0 ? bytes / seconds : 0;
+		return result;
+	}
+
+	static void printResult(std::ostream& out, const Result& result) {
+		out << std::left << std::setw(44) << result.name << std::right;
+		if (!result.error.empty()) {
+			out << " SKIPPED: " << result.error << "\n";
+			return;
+		}
+		out << std::fixed << std::setprecision(0) << std::setw(14) << result.realMean << " ns"
+			<< std::setw(14) << result.cpuMean << " ns" << std::setw(12) << result.iterations;
+		if (result.itemsPerSecond > 0) {
+			out << std::setprecision(3) << "  items/s=" << result.itemsPerSecond;
+		}
+		if (result.bytesPerSecond > 0) {
+			out << std::setprecision(1) << "  MB/s=" << result.bytesPerSecond / (1024 * 1024);
+		}
+		if (!result.label.empty()) {
+			out << "  " << result.label;
+		}
+		out << "\n";
+	}
+
+	static void writeJson(std::ostream& out, const std::vector<Result>& results) {
+		out << "{\n  \"context\": {\n";
+		auto& entries = context();
+		for (size_t i = 0; i < entries.size(); i++) {
+			out << "    " << jsonString(entries[i].first) << ": " << jsonString(entries[i].second)
+				<< (i + 1 < entries.size() ? ",\n" : "\n");
+		}
+		out << "  },\n  \"benchmarks\": [\n";
+		out << std::setprecision(17);
+		for (size_t i = 0; i < results.size(); i++) {
+			const Result& r = results[i];
+			out << "    {\n      \"name\": " << jsonString(r.name) << ",\n";
+			if (!r.error.empty()) {
+				out << "      \"error_occurred\": true,\n      \"error_message\": " << jsonString(r.error) << "\n";
+			}
+			else {
+				out << "      \"iterations\": " << r.iterations << ",\n"
+					<< "      \"real_time\": " << r.realMean << ",\n"
+					<< "      \"real_time_min\": " << r.realMin << ",\n"
+					<< "      \"real_time_stddev\": " << r.realStddev << ",\n"
+					<< "      \"cpu_time\": " << r.cpuMean << ",\n"
+					<< "      \"time_unit\": \"ns\"";
+				if (r.itemsPerSecond > 0) {
+					out << ",\n      \"items_per_second\": " << r.itemsPerSecond;
+				}
+				if (r.bytesPerSecond > 0) {
+					out << ",\n      \"bytes_per_second\": " << r.bytesPerSecond;
+				}
+				if (!r.label.empty()) {
+					out << ",\n      \"label\": " << jsonString(r.label);
+				}
+				out << "\n";
+			}
+			out << "    }" << (i + 1 < results.size() ? ",\n" : "\n");
+		}
+		out << "  ]\n}\n";
+	}
+};
+
+int runBenchmarks(int argc, char* argv[]) {
+	BenchmarkRunner runner;
+	std::string filter = ".*";
+	std::string outputPath;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		auto value = [&](const std::string& flag) {
+			return arg.compare(0, flag.size(), flag) == 0 ? arg.substr(flag.size()) : std::string();
+		};
+		if (!value("--benchmark_filter=").empty()) {
+			filter = value("--benchmark_filter=");
+		}
+		else if (!value("--benchmark_out=").empty()) {
+			outputPath = value("--benchmark_out=");
+		}
+		else if (!value("--benchmark_min_time=").empty()) {
+			runner.minTime = std::stod(value("--benchmark_min_time="));
+		}
+		else if (!value("--benchmark_repetitions=").empty()) {
+			runner.repetitions = std::max(1, std::stoi(value("--benchmark_repetitions=")));
+		}
+		else {
+			std::cerr << "Unknown option " << arg << "\n";
+			return 2;
+		}
+	}
+
+	addBenchmarkContext("executable", argv[0]);
+	addBenchmarkContext("num_cpus", std::to_string(std::thread::hardware_concurrency()));
+#ifdef NDEBUG
+	addBenchmarkContext("library_build_type", "release");
+#else
+	addBenchmarkContext("library_build_type", "debug");
+#endif
+	addBenchmarkContext("min_time", std::to_string(runner.minTime));
+	addBenchmarkContext("repetitions", std::to_string(runner.repetitions));
+
+	std::regex pattern(filter);
+	std::vector<BenchmarkRunner::Result> results;
+	std::cout << std::left << std::setw(44) << "Benchmark" << std::right << std::setw(17) << "Time"
+		<< std::setw(17) << "CPU" << std::setw(12) << "Iterations" << "\n";
+	for (auto& definition : registry()) {
+		auto argLists = definition->argLists();
+		if (argLists.empty()) {
+			argLists.push_back({});
+		}
+		for (auto& args : argLists) {
+			std::string name = definition->name();
+			for (int64_t a : args) {
+				name += "/" + std::to_string(a);
+			}
+			if (!std::regex_search(name, pattern)) {
+				continue;
+			}
+			results.push_back(runner.run(*definition, args, name));
+			BenchmarkRunner::printResult(std::cout, results.back());
+		}
+	}
+
+	if (!outputPath.empty()) {
+		std::ofstream out(outputPath);
+		BenchmarkRunner::writeJson(out, results);
+		if (!out) {
+			std::cerr << "Could not write " << outputPath << "\n";
+			return 1;
+		}
+	}
+	return 0;
+}
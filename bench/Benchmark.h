@@ -0,0 +1,153 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+/**
+ * @brief A small benchmark harness in the style of Google Benchmark. A benchmark is a function
+ * that runs its workload once per iteration of a `while (state.keepRunning())` loop; the
+ * harness picks the iteration count so each run lasts at least the minimum time, repeats the
+ * run, and reports the mean and spread of the time per iteration, on the console and as JSON.
+ *
+ * Command-line flags:
+ *   --benchmark_filter=REGEX       run only benchmarks whose names match
+ *   --benchmark_out=PATH           also write the results as JSON
+ *   --benchmark_min_time=SECONDS   minimum time per run (default 0.5)
+ *   --benchmark_repetitions=N      runs per benchmark (default 3)
+ */
+class BenchmarkState {
+private:
+	std::vector<int64_t> m_args;
+	uint64_t m_iterations;
+	uint64_t m_completed;
+	bool m_started;
+	bool m_paused;
+	std::chrono::steady_clock::time_point m_realStart;
+	std::clock_t m_cpuStart;
+	double m_realSeconds;
+	double m_cpuSeconds;
+	int64_t m_itemsProcessed;
+	int64_t m_bytesProcessed;
+	std::string m_error;
+	std::string m_label;
+
+	friend class BenchmarkRunner;
+
+public:
+	BenchmarkState(const std::vector<int64_t>& args, uint64_t iterations);
+
+	/**
+	 * @brief Starts the timer on the first call, and returns whether to run another iteration.
+	 */
+	bool keepRunning() {
+		if (!m_started) {
+			if (!m_error.empty()) {
+				return false;
+			}
+			m_started = true;
+			resumeTiming();
+		}
+		if (m_completed < m_iterations) {
+			m_completed++;
+			return true;
+		}
+		pauseTiming();
+		return false;
+	}
+
+	/**
+	 * @brief The benchmark's i-th argument.
+	 */
+	int64_t range(size_t i = 0) const { return m_args.at(i); }
+	uint64_t iterations() const { return m_iterations; }
+
+	/**
+	 * @brief Excludes work, such as resetting the workload, from the timing.
+	 */
+	void pauseTiming();
+	void resumeTiming();
+
+	/**
+	 * @brief The number of items, or bytes, processed over all iterations, for throughput.
+	 */
+	void setItemsProcessed(int64_t items) { m_itemsProcessed = items; }
+	void setBytesProcessed(int64_t bytes) { m_bytesProcessed = bytes; }
+	void setLabel(const std::string& label) { m_label = label; }
+
+	/**
+	 * @brief Reports that the benchmark cannot run; call before the first keepRunning().
+	 */
+	void skipWithError(const std::string& message) { m_error = message; }
+};
+
+using BenchmarkFunction = void (*)(BenchmarkState&);
+
+/**
+ * @brief Keeps the compiler from optimizing away the computation of a value that is otherwise
+ * unused.
+ */
+template <typename T>
+inline void doNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : : "m"(value) : "memory");
+#else
+	static volatile const void* sink;
+	sink = &value;
+	_ReadWriteBarrier();
+#endif
+}
+
+/**
+ * @brief A registered benchmark, run once per argument list.
+ */
+class BenchmarkDefinition {
+private:
+	std::string m_name;
+	BenchmarkFunction m_function;
+	std::vector<std::vector<int64_t>> m_argLists;
+
+	friend class BenchmarkRunner;
+
+public:
+	BenchmarkDefinition(const std::string& name, BenchmarkFunction function) : m_name(name), m_function(function) {}
+
+	const std::string& name() const { return m_name; }
+	const std::vector<std::vector<int64_t>>& argLists() const { return m_argLists; }
+
+	BenchmarkDefinition* arg(int64_t value) {
+		m_argLists.push_back({ value });
+		return this;
+	}
+
+	BenchmarkDefinition* args(const std::vector<int64_t>& values) {
+		m_argLists.push_back(values);
+		return this;
+	}
+};
+
+BenchmarkDefinition* registerBenchmark(const char* name, BenchmarkFunction function);
+
+/**
+ * @brief Adds a key/value pair to the "context" section of the JSON output.
+ */
+void addBenchmarkContext(const std::string& key, const std::string& value);
+
+/**
+ * @brief Runs every registered benchmark selected by the command line; returns the process's
+ * exit code.
+ */
+int runBenchmarks(int argc, char* argv[]);
+
+#define BENCHMARK_CONCAT_INNER(a, b) a##b
+#define BENCHMARK_CONCAT(a, b) BENCHMARK_CONCAT_INNER(a, b)
+/**
+ * @brief Registers a benchmark function; chain ->arg(n) to run it with arguments.
+ */
+#define BENCHMARK(function) \
+	static BenchmarkDefinition* BENCHMARK_CONCAT(benchmarkRegistration, __LINE__) = \
+		registerBenchmark(#function, function)
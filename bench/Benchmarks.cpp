@@ -0,0 +1,429 @@
+/**
+Benchmarks of the engine's import, update, animation, uniform, and render paths, on synthetic
+workloads generated the same way on every run. OpenGL benchmarks run in a HeadlessContext and
+are skipped if none can be created.
+*/
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include "Benchmark.h"
+#include "glad.h"
+#include "AnimationEngine.h"
+#include "Animator.h"
+#include "AssetPackage.h"
+#include "AssimpImport.h"
+#include "FrameBuffer.h"
+#include "HeadlessContext.h"
+#include "Mesh3D.h"
+#include "Object3D.h"
+#include "ShaderProgram.h"
+
+namespace {
+	const char* VERTEX_SHADER = R"(#version 330
+layout (location=0) in vec3 vPosition;
+layout (location=1) in vec3 vNormal;
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+out vec3 Normal;
+void main() {
+	mat4 model = models[drawIndex];
+	gl_Position = projection * view * model * vec4(vPosition, 1.0);
+	Normal = mat3(model) * vNormal;
+}
+)";
+
+	// The same transform, with the model matrix read from Object3D's per-draw stream buffer.
+	const char* PER_DRAW_VERTEX_SHADER = R"(#version 330
+layout (location=0) in vec3 vPosition;
+layout (location=1) in vec3 vNormal;
+layout (std140) uniform PerDraw {
+	mat4 models[64];
+};
+uniform int drawIndex;
+uniform mat4 view;
+uniform mat4 projection;
+out vec3 Normal;
+void main() {
+	mat4 model = models[drawIndex];
+	gl_Position = projection * view * model * vec4(vPosition, 1.0);
+	Normal = mat3(model) * vNormal;
+}
+)";
+
+	const char* FRAGMENT_SHADER = R"(#version 330
+in vec3 Normal;
+out vec4 FragColor;
+void main() {
+	FragColor = vec4(normalize(Normal) * 0.5 + 0.5, 1.0);
+}
+)";
+
+	// The OpenGL state shared by the benchmarks, released before the context.
+	struct BenchmarkGL {
+		HeadlessContext context;
+		ShaderProgram program;
+		ShaderProgram perDrawProgram;
+		FrameBuffer frameBuffer;
+
+		BenchmarkGL() : frameBuffer(512, 512) {}
+	};
+	std::unique_ptr<BenchmarkGL> gl;
+
+	std::filesystem::path workspace() {
+		auto path = std::filesystem::temp_directory_path() / "FinalProject449-bench";
+		std::filesystem::create_directories(path);
+		return path;
+	}
+
+	/**
+	 * @brief An n x n grid of quads over a gentle wave, with normals and texture coordinates.
+	 */
+	void makeGrid(int64_t n, std::vector<Vertex3D>& vertices, std::vector<uint32_t>& faces) {
+		vertices.clear();
+		faces.clear();
+		for (int64_t y = 0; y <= n; y++) {
+			for (int64_t x = 0; x <= n; x++) {
+				float_t u = static_cast<float_t>(x) / n;
+				float_t v = static_cast<float_t>(y) / n;
+				float_t px = u * 2 - 1;
+				float_t py = v * 2 - 1;
+				float_t pz = 0.1f * std::sin(px * 6) * std::cos(py * 6);
+				glm::vec3 normal = glm::normalize(glm::vec3(-0.6f * std::cos(px * 6) * std::cos(py * 6),
+					0.6f * std::sin(px * 6) * std::sin(py * 6), 1));
+				vertices.emplace_back(px, py, pz, normal.x, normal.y, normal.z, u, v);
+			}
+		}
+		uint32_t row = static_cast<uint32_t>(n + 1);
+		for (uint32_t y = 0; y < n; y++) {
+			for (uint32_t x = 0; x < n; x++) {
+				uint32_t i = y * row + x;
+				faces.insert(faces.end(), { i, i + 1, i + row + 1, i, i + row + 1, i + row });
+			}
+		}
+	}
+
+	/**
+	 * @brief Writes the n x n grid as an OBJ file, once per size.
+	 */
+	std::filesystem::path gridObj(int64_t n) {
+		auto path = workspace() / ("grid_" + std::to_string(n) + ".obj");
+		if (std::filesystem::exists(path)) {
+			return path;
+		}
+		std::vector<Vertex3D> vertices;
+		std::vector<uint32_t> faces;
+		makeGrid(n, vertices, faces);
+		std::ofstream out(path);
+		for (auto& v : vertices) {
+			out << "v " << v.x << " " << v.y << " " << v.z << "\n";
+		}
+		for (auto& v : vertices) {
+			out << "vt " << v.u << " " << v.v << "\n";
+		}
+		for (auto& v : vertices) {
+			out << "vn " << v.nx << " " << v.ny << " " << v.nz << "\n";
+		}
+		for (size_t i = 0; i < faces.size(); i += 3) {
+			out << "f";
+			for (size_t k = 0; k < 3; k++) {
+				uint32_t index = faces[i + k] + 1;
+				out << " " << index << "/" << index << "/" << index;
+			}
+			out << "\n";
+		}
+		if (!out) {
+			throw std::runtime_error("Could not write " + path.string());
+		}
+		return path;
+	}
+
+	Object3D emptyObject() {
+		return Object3D(std::vector<Mesh3D>{});
+	}
+
+	void collect(Object3D& object, std::vector<Object3D*>& nodes) {
+		nodes.push_back(&object);
+		for (size_t i = 0; i < object.numberOfChildren(); i++) {
+			collect(object.getChild(i), nodes);
+		}
+	}
+
+	// Moves every node, then walks the hierarchy to combine the world matrices.
+	void updateHierarchy(BenchmarkState& state, Object3D& root) {
+		std::vector<Object3D*> nodes;
+		collect(root, nodes);
+		float_t angle = 0;
+		while (state.keepRunning()) {
+			angle += 0.001f;
+			glm::quat rotation = glm::angleAxis(angle, glm::vec3(0, 1, 0));
+			for (auto* node : nodes) {
+				node->setRotation(rotation);
+			}
+			AABB bounds = root.getBounds();
+			doNotOptimize(bounds);
+		}
+		state.setItemsProcessed(static_cast<int64_t>(state.iterations() * nodes.size()));
+	}
+}
+
+/**
+ * @brief Imports an OBJ of n x n quads, including the upload to the GPU.
+ */
+void BM_AssimpLoad(BenchmarkState& state) {
+	if (gl == nullptr) {
+		state.skipWithError("no OpenGL context");
+		return;
+	}
+	std::string path = gridObj(state.range(0)).string();
+	while (state.keepRunning()) {
+		Object3D model = assimpLoad(path, false);
+		doNotOptimize(model);
+	}
+	state.setItemsProcessed(static_cast<int64_t>(state.iterations() * state.range(0) * state.range(0) * 2));
+	state.setLabel("items are triangles");
+}
+BENCHMARK(BM_AssimpLoad)->arg(16)->arg(64)->arg(256);
+
+/**
+ * @brief Opens an asset package holding the same OBJ as BM_AssimpLoad and loads it from the
+ * package, including the upload to the GPU.
+ */
+void BM_PackageLoad(BenchmarkState& state) {
+	if (gl == nullptr) {
+		state.skipWithError("no OpenGL context");
+		return;
+	}
+	std::string path = gridObj(state.range(0)).string();
+	auto packagePath = workspace() / ("grid_" + std::to_string(state.range(0)) + ".fppk");
+	if (!std::filesystem::exists(packagePath)) {
+		std::vector<ImportedModel> models;
+		models.push_back(importModel(path, false));
+		AssetPackage::write(models, packagePath);
+	}
+	while (state.keepRunning()) {
+		AssetPackage package(packagePath);
+		Object3D model = package.load(path, false);
+		doNotOptimize(model);
+	}
+	state.setItemsProcessed(static_cast<int64_t>(state.iterations() * state.range(0) * state.range(0) * 2));
+	state.setLabel("items are triangles");
+}
+BENCHMARK(BM_PackageLoad)->arg(16)->arg(64)->arg(256);
+
+/**
+ * @brief Updates a chain of objects, each the child of the last.
+ */
+void BM_HierarchyUpdateDepth(BenchmarkState& state) {
+	Object3D root = emptyObject();
+	Object3D* node = &root;
+	for (int64_t i = 1; i < state.range(0); i++) {
+		node->addChild(emptyObject());
+		node = &node->getChild(0);
+	}
+	updateHierarchy(state, root);
+}
+BENCHMARK(BM_HierarchyUpdateDepth)->arg(10)->arg(100)->arg(1000);
+
+/**
+ * @brief Updates an object with many children.
+ */
+void BM_HierarchyUpdateBreadth(BenchmarkState& state) {
+	Object3D root = emptyObject();
+	for (int64_t i = 1; i < state.range(0); i++) {
+		root.addChild(emptyObject());
+	}
+	updateHierarchy(state, root);
+}
+BENCHMARK(BM_HierarchyUpdateBreadth)->arg(10)->arg(100)->arg(1000)->arg(10000);
+
+/**
+ * @brief Ticks an AnimationEngine running one Animator per object, each rotating its object.
+ */
+void BM_AnimatorTick(BenchmarkState& state) {
+	size_t count = static_cast<size_t>(state.range(0));
+	// The engine keeps pointers to the objects, so they must not move.
+	std::vector<Object3D> objects;
+	objects.reserve(count);
+	AnimationEngine engine;
+	std::vector<Animator> animators(count);
+	for (size_t i = 0; i < count; i++) {
+		objects.push_back(emptyObject());
+		animators[i].addAnimation(std::make_unique<RotationAnimation>(objects[i], 1e6f, glm::vec3(0, 6.28f, 0)));
+		animators[i].start(engine);
+	}
+	while (state.keepRunning()) {
+		engine.tick(1 / 60.0f);
+		engine.apply();
+	}
+	state.setItemsProcessed(static_cast<int64_t>(state.iterations() * count));
+}
+BENCHMARK(BM_AnimatorTick)->arg(100)->arg(1000)->arg(10000);
+
+/**
+ * @brief Sets a matrix uniform, including the uniform location lookup by name.
+ */
+void BM_SetUniform(BenchmarkState& state) {
+	if (gl == nullptr) {
+		state.skipWithError("no OpenGL context");
+		return;
+	}
+	const int64_t CALLS = 1000;
+	gl->program.activate();
+	glm::mat4 model(1);
+	while (state.keepRunning()) {
+		for (int64_t i = 0; i < CALLS; i++) {
+			model[3][0] = static_cast<float_t>(i);
+			gl->program.setUniform("model", model);
+		}
+	}
+	state.setItemsProcessed(static_cast<int64_t>(state.iterations() * CALLS));
+}
+BENCHMARK(BM_SetUniform);
+
+/**
+ * @brief Renders a scene of objects sharing an 8 x 8 grid mesh into a 512 x 512 framebuffer,
+ * waiting for the GPU to finish each frame. The mesh is small so that, with many objects, the
+ * time goes to submitting draws rather than to rasterizing, which is where setting the model
+ * matrix as a uniform and streaming it differ.
+ */
+void renderScene(BenchmarkState& state, ShaderProgram& program) {
+	if (gl == nullptr) {
+		state.skipWithError("no OpenGL context");
+		return;
+	}
+	std::vector<Vertex3D> vertices;
+	std::vector<uint32_t> faces;
+	makeGrid(8, vertices, faces);
+	size_t triangles = faces.size() / 3;
+	Mesh3D mesh(std::move(vertices), std::move(faces), std::vector<Texture>{});
+
+	// A square of objects in front of the camera.
+	int64_t count = state.range(0);
+	int64_t side = static_cast<int64_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+	std::vector<Object3D> objects;
+	for (int64_t i = 0; i < count; i++) {
+		objects.emplace_back(std::vector<Mesh3D>{ mesh });
+		objects.back().setPosition(glm::vec3((i % side) * 2.0f - side, (i / side) * 2.0f - side, -2.5f * side));
+	}
+
+	program.activate();
+	program.setUniform("view", glm::lookAt(glm::vec3(0), glm::vec3(0, 0, -1), glm::vec3(0, 1, 0)));
+	program.setUniform("projection", glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 1000.0f));
+	gl->frameBuffer.bind();
+	while (state.keepRunning()) {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		Object3D::beginFrame();
+		Object3D::renderAll(objects, program);
+		glFinish();
+	}
+	FrameBuffer::unbind();
+	state.setItemsProcessed(static_cast<int64_t>(state.iterations() * count * triangles));
+	state.setLabel("items are triangles");
+}
+
+/**
+ * @brief The scene with each object's model matrix set as a uniform.
+ */
+void BM_RenderScene(BenchmarkState& state) {
+	renderScene(state, gl->program);
+}
+BENCHMARK(BM_RenderScene)->arg(1)->arg(256)->arg(4096);
+
+/**
+ * @brief The scene with each object's model matrix written to the per-draw stream buffer.
+ */
+void BM_RenderScenePerDraw(BenchmarkState& state) {
+	renderScene(state, gl->perDrawProgram);
+}
+BENCHMARK(BM_RenderScenePerDraw)->arg(1)->arg(256)->arg(4096);
+
+/**
+ * @brief Restores an n x n grid mesh and a copy of it after the context they were created in is
+ * destroyed, into the benchmarks' context, where a mesh created since must survive the restore.
+ * Creating and losing the context is not timed.
+ */
+void BM_MeshReupload(BenchmarkState& state) {
+	if (gl == nullptr) {
+		state.skipWithError("no OpenGL context");
+		return;
+	}
+	std::vector<Vertex3D> gridVertices;
+	std::vector<uint32_t> gridFaces;
+	makeGrid(state.range(0), gridVertices, gridFaces);
+	size_t vertexCount = gridVertices.size();
+
+	gl->program.activate();
+	gl->frameBuffer.bind();
+	while (state.keepRunning()) {
+		state.pauseTiming();
+		std::vector<Mesh3D> meshes;
+		{
+			HeadlessContext lost;
+			auto vertices = gridVertices;
+			auto faces = gridFaces;
+			meshes.emplace_back(std::move(vertices), std::move(faces), std::vector<Texture>{}, MeshRetention::KEEP);
+			meshes.push_back(meshes.back());
+		}
+		gl->context.makeCurrent();
+		Mesh3D::contextLost();
+		// Likely to be given the names the lost meshes had.
+		Mesh3D bystander = Mesh3D::square({});
+		state.resumeTiming();
+
+		for (auto& mesh : meshes) {
+			mesh.reupload();
+		}
+
+		state.pauseTiming();
+		glGetError();
+		for (auto& mesh : meshes) {
+			mesh.render(gl->program);
+		}
+		bystander.render(gl->program);
+		if (glGetError() != GL_NO_ERROR) {
+			state.skipWithError("a restored or bystanding mesh could not be drawn");
+			break;
+		}
+		meshes.clear();
+		state.resumeTiming();
+	}
+	FrameBuffer::unbind();
+	state.setItemsProcessed(static_cast<int64_t>(state.iterations() * vertexCount));
+	state.setLabel("items are vertices");
+}
+BENCHMARK(BM_MeshReupload)->arg(256)->arg(512);
+
+int main(int argc, char* argv[]) {
+	try {
+		gl = std::make_unique<BenchmarkGL>();
+		auto vertexPath = workspace() / "bench.vert";
+		auto fragmentPath = workspace() / "bench.frag";
+		auto perDrawVertexPath = workspace() / "bench_per_draw.vert";
+		std::ofstream(vertexPath) << VERTEX_SHADER;
+		std::ofstream(fragmentPath) << FRAGMENT_SHADER;
+		std::ofstream(perDrawVertexPath) << PER_DRAW_VERTEX_SHADER;
+		// Both compile at once, and are checked here so a broken shader skips the OpenGL
+		// benchmarks instead of failing inside one.
+		gl->program.compile(vertexPath.string(), fragmentPath.string());
+		gl->perDrawProgram.compile(perDrawVertexPath.string(), fragmentPath.string());
+		gl->program.finish();
+		gl->perDrawProgram.finish();
+		glEnable(GL_DEPTH_TEST);
+		addBenchmarkContext("gl_renderer", reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+		addBenchmarkContext("gl_version", reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+	}
+	catch (std::runtime_error& e) {
+		std::cerr << "OpenGL benchmarks will be skipped: " << e.what() << std::endl;
+		gl.reset();
+	}
+
+	int result = runBenchmarks(argc, argv);
+	gl.reset();
+	return result;
+}
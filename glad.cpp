@@ -7,6 +7,8 @@
 	APIs: gl=3.3, gles1=1.0, gles2=2.0, glsc2=2.0
 	Profile: compatibility
 	Extensions:
+		GL_ARB_get_program_binary,
+		GL_KHR_parallel_shader_compile
 
 	Loader: True
 	Local files: False
@@ -14,9 +16,9 @@
 	Reproducible: False
 
 	Commandline:
-		--profile="compatibility" --api="gl=3.3,gles1=1.0,gles2=2.0,glsc2=2.0" --generator="c" --spec="gl" --extensions=""
+		--profile="compatibility" --api="gl=3.3,gles1=1.0,gles2=2.0,glsc2=2.0" --generator="c" --spec="gl" --extensions="GL_ARB_get_program_binary,GL_KHR_parallel_shader_compile"
 	Online:
-		https://glad.dav1d.de/#profile=compatibility&language=c&specification=gl&loader=on&api=gl%3D3.3&api=gles1%3D1.0&api=gles2%3D2.0&api=glsc2%3D2.0
+		https://glad.dav1d.de/#profile=compatibility&language=c&specification=gl&loader=on&api=gl%3D3.3&api=gles1%3D1.0&api=gles2%3D2.0&api=glsc2%3D2.0&extensions=GL_ARB_get_program_binary&extensions=GL_KHR_parallel_shader_compile
 */
 
 #include <stdio.h>
@@ -272,6 +274,8 @@ int GLAD_GL_VERSION_3_3 = 0;
 int GLAD_GL_VERSION_ES_CM_1_0 = 0;
 int GLAD_GL_ES_VERSION_2_0 = 0;
 int GLAD_GL_SC_VERSION_2_0 = 0;
+int GLAD_GL_ARB_get_program_binary = 0;
+int GLAD_GL_KHR_parallel_shader_compile = 0;
 PFNGLACCUMPROC glad_glAccum = NULL;
 PFNGLACTIVETEXTUREPROC glad_glActiveTexture = NULL;
 PFNGLALPHAFUNCPROC glad_glAlphaFunc = NULL;
@@ -890,6 +894,9 @@ PFNGLTEXPARAMETERIVPROC glad_glTexParameteriv = NULL;
 PFNGLTEXPARAMETERXPROC glad_glTexParameterx = NULL;
 PFNGLTEXPARAMETERXVPROC glad_glTexParameterxv = NULL;
 PFNGLTEXSTORAGE2DPROC glad_glTexStorage2D = NULL;
+PFNGLGETPROGRAMBINARYPROC glad_glGetProgramBinary = NULL;
+PFNGLPROGRAMPARAMETERIPROC glad_glProgramParameteri = NULL;
+PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glad_glMaxShaderCompilerThreadsKHR = NULL;
 PFNGLTEXSUBIMAGE1DPROC glad_glTexSubImage1D = NULL;
 PFNGLTEXSUBIMAGE2DPROC glad_glTexSubImage2D = NULL;
 PFNGLTEXSUBIMAGE3DPROC glad_glTexSubImage3D = NULL;
@@ -1813,9 +1820,20 @@ static void load_GL_VERSION_3_3(GLADloadproc load) {
 	glad_glSecondaryColorP3ui = (PFNGLSECONDARYCOLORP3UIPROC)load("glSecondaryColorP3ui");
 	glad_glSecondaryColorP3uiv = (PFNGLSECONDARYCOLORP3UIVPROC)load("glSecondaryColorP3uiv");
 }
+static void load_GL_ARB_get_program_binary(GLADloadproc load) {
+	if (!GLAD_GL_ARB_get_program_binary) return;
+	glad_glGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+	glad_glProgramBinary = (PFNGLPROGRAMBINARYPROC)load("glProgramBinary");
+	glad_glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+}
+static void load_GL_KHR_parallel_shader_compile(GLADloadproc load) {
+	if (!GLAD_GL_KHR_parallel_shader_compile) return;
+	glad_glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsKHR");
+}
 static int find_extensionsGL(void) {
 	if (!get_exts()) return 0;
-	(void)&has_ext;
+	GLAD_GL_ARB_get_program_binary = has_ext("GL_ARB_get_program_binary");
+	GLAD_GL_KHR_parallel_shader_compile = has_ext("GL_KHR_parallel_shader_compile");
 	free_exts();
 	return 1;
 }
@@ -1894,6 +1912,8 @@ int gladLoadGLLoader(GLADloadproc load) {
 	load_GL_VERSION_3_3(load);
 
 	if (!find_extensionsGL()) return 0;
+	load_GL_ARB_get_program_binary(load);
+	load_GL_KHR_parallel_shader_compile(load);
 	return GLVersion.major != 0 || GLVersion.minor != 0;
 }
 
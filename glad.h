@@ -102,7 +102,7 @@ extern "C" {
 
     GLAPI int gladLoadGLSC2Loader(GLADloadproc);
 
-#include <C:\Users\liminal\Downloads\projectBasics (1)\KHR\khrplatform.h>
+#include "khrplatform.h"
     typedef unsigned int GLenum;
     typedef unsigned char GLboolean;
     typedef unsigned int GLbitfield;
@@ -1429,6 +1429,10 @@ extern "C" {
 #define GL_CONTEXT_ROBUST_ACCESS 0x90F3
 #define GL_RESET_NOTIFICATION_STRATEGY 0x8256
 #define GL_LOSE_CONTEXT_ON_RESET 0x8252
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
 #ifndef GL_VERSION_1_0
 #define GL_VERSION_1_0 1
     GLAPI int GLAD_GL_VERSION_1_0;
@@ -3823,6 +3827,23 @@ extern "C" {
     GLAPI PFNGLTEXSTORAGE2DPROC glad_glTexStorage2D;
 #define glTexStorage2D glad_glTexStorage2D
 #endif
+#ifndef GL_ARB_get_program_binary
+#define GL_ARB_get_program_binary 1
+    GLAPI int GLAD_GL_ARB_get_program_binary;
+    typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+    GLAPI PFNGLGETPROGRAMBINARYPROC glad_glGetProgramBinary;
+#define glGetProgramBinary glad_glGetProgramBinary
+    typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+    GLAPI PFNGLPROGRAMPARAMETERIPROC glad_glProgramParameteri;
+#define glProgramParameteri glad_glProgramParameteri
+#endif
+#ifndef GL_KHR_parallel_shader_compile
+#define GL_KHR_parallel_shader_compile 1
+    GLAPI int GLAD_GL_KHR_parallel_shader_compile;
+    typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+    GLAPI PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glad_glMaxShaderCompilerThreadsKHR;
+#define glMaxShaderCompilerThreadsKHR glad_glMaxShaderCompilerThreadsKHR
+#endif
 
 #ifdef __cplusplus
 }
@@ -2,17 +2,40 @@
 This application renders a textured mesh that was loaded with Assimp.
 */
 #define GLM_ENABLE_EXPERIMENTAL
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <set>
+#include <stdexcept>
 #include <SFML/Audio.hpp>
 #include "glad.h"
 
 #include "Mesh3D.h"
 #include "Object3D.h"
+#include "AssetPackage.h"
+#include "AssetReloader.h"
 #include "AssimpImport.h"
+#include "FixedTimestep.h"
+#include "FrameBuffer.h"
+#include "HeadlessContext.h"
+#include "KinematicsSystem.h"
+#include "LazyScene.h"
+#include "MemoryAccounting.h"
+#include "Picking.h"
+#include "Profiler.h"
+#include "RenderStats.h"
+#include "SceneFile.h"
+#include "WorldStreamer.h"
 #include "Animator.h"
 #include "Animation.h"
+#include "AnimationEngine.h"
+#include "AnimationGraph.h"
 #include "ShaderProgram.h"
+#include "ShaderVariants.h"
+#include "SkinningSystem.h"
 
 /**
  * @brief Defines a collection of objects that should be rendered with a specific shader program.
@@ -21,6 +44,10 @@ struct Scene {
 	ShaderProgram defaultShader;
 	std::vector<Object3D> objects;
 	std::vector<Animator> animators;
+	AnimationEngine animationEngine;
+	AnimationGraphSystem animationGraphs;
+	KinematicsSystem kinematics;
+	SkinningSystem skinning;
 };
 
 /**
@@ -31,7 +58,7 @@ struct Scene {
 ShaderProgram phongLighting() {
 	ShaderProgram program;
 	try {
-		program.load("shaders/light_perspective.vert", "shaders/lighting.frag");
+		program.compile("shaders/light_perspective.vert", "shaders/lighting.frag");
 	}
 	catch (std::runtime_error& e) {
 		std::cout << "ERROR: " << e.what() << std::endl;
@@ -46,7 +73,7 @@ ShaderProgram phongLighting() {
 ShaderProgram textureMapping() {
 	ShaderProgram program;
 	try {
-		program.load("shaders/texture_perspective.vert", "shaders/texturing.frag");
+		program.compile("shaders/texture_perspective.vert", "shaders/texturing.frag");
 	}
 	catch (std::runtime_error& e) {
 		std::cout << "ERROR: " << e.what() << std::endl;
@@ -55,13 +82,48 @@ ShaderProgram textureMapping() {
 	return program;
 }
 
+/**
+ * @brief Constructs a shader program that renders textured meshes without lighting, deforming
+ * skinned meshes by the joint palettes of a SkinningSystem with the given palette format.
+ */
+ShaderProgram skinnedTextureMapping(PaletteFormat format = PaletteFormat::AFFINE) {
+	ShaderProgram program;
+	try {
+		program.compile(format == PaletteFormat::AFFINE
+			? "shaders/skinned_texture_perspective.vert"
+			: "shaders/skinned_dq_texture_perspective.vert",
+			"shaders/texturing.frag");
+	}
+	catch (std::runtime_error& e) {
+		std::cout << "ERROR: " << e.what() << std::endl;
+		exit(1);
+	}
+	return program;
+}
+
+/**
+ * @brief Starts compiling the material variants that the meshes of the model will be drawn with.
+ */
+void prepareVariants(ShaderVariants& variants, const Object3D& model) {
+	for (size_t i = 0; i < model.numberOfMeshes(); i++) {
+		const Mesh3D& mesh = model.getMesh(i);
+		// Skinned meshes are drawn skinned once the skinning system has given them a palette.
+		variants.prepare(mesh.shaderFeatures() | (mesh.isSkinned() ? ShaderVariants::SKINNED : 0));
+	}
+	for (size_t i = 0; i < model.numberOfChildren(); i++) {
+		prepareVariants(variants, model.getChild(i));
+	}
+}
+
 /**
  * @brief Loads an image from the given path into an OpenGL texture.
  */
 Texture loadTexture(const std::filesystem::path& path, const std::string& samplerName = "baseTexture") {
 	sf::Image i;
 	i.loadFromFile(path.string());
-	return Texture::loadImage(i, samplerName);
+	Texture texture = Texture::loadImage(i, samplerName);
+	texture.source = path.string();
+	return texture;
 }
 
 /**
@@ -108,7 +170,8 @@ Scene lifeOfPi() {
 	auto boat = assimpLoad("./boat/boat.fbx", true);
 	boat.move(glm::vec3(0, -0.7, 0));
 	boat.grow(glm::vec3(0.01, 0.01, 0.01));
-	auto tiger = assimpLoad("./tiger/scene.gltf", true);
+	std::vector<std::shared_ptr<AnimationClip>> tigerClips;
+	auto tiger = assimpLoad("./tiger/scene.gltf", true, tigerClips);
 	tiger.move(glm::vec3(0, -5, 10));
 	boat.addChild(std::move(tiger));
 	
@@ -125,24 +188,32 @@ Scene lifeOfPi() {
 	animBoat.addAnimation(std::make_unique<RotationAnimation>(objects[0], 10, glm::vec3(0, 6.28, 0)));
 	Animator animTiger;
 	animTiger.addAnimation(std::make_unique<RotationAnimation>(objects[0].getChild(0), 10, glm::vec3(0, 0, 6.28)));
+	// The tiger's own imported animation plays alongside the rotation, looping for the same time.
+	Animator animTigerClip;
+	if (!tigerClips.empty()) {
+		animTigerClip.addAnimation(std::make_unique<ClipAnimation>(objects[0].getChild(0), 10, tigerClips[0]));
+	}
 
 	// The Animators will be destroyed when leaving this function, so we move them into
 	// a list to be returned.
 	std::vector<Animator> animators;
 	animators.push_back(std::move(animBoat));
 	animators.push_back(std::move(animTiger));
+	animators.push_back(std::move(animTigerClip));
 
-	// Transfer ownership of the objects and animators back to the main.
+	// Transfer ownership of the objects and animators back to the main. The tiger's clip may
+	// drive its skinned meshes, so the scene draws with the skinning shader.
 	return Scene{
-		//phongLighting(),
-		//{tiger}
-		//textureMapping(),
-		//std::move(objects),
-		//std::move(animators)
+		skinnedTextureMapping(),
+		std::move(objects),
+		std::move(animators)
 	};
 }
 
 Scene skull() {
+	// The driver compiles the program while the models import.
+	ShaderProgram program = textureMapping();
+
 	//MOUNTAINS?
 	auto mountains = assimpLoad("./mountain_mesh/mountain.obj", true);
 	mountains.move(glm::vec3(0, -12.5, -50));
@@ -207,50 +278,270 @@ Scene skull() {
 
 	return Scene{
 		//phongLighting(),{skull}
-		textureMapping(),
+		program,
 		std::move(objects),
 		std::move(animators),
 	};
 }
 
-int main() {
-	// Initialize the window and OpenGL.
-	sf::ContextSettings Settings;
-	Settings.depthBits = 24; // Request a 24 bits depth buffer
-	Settings.stencilBits = 8;  // Request a 8 bits stencil buffer
-	Settings.antialiasingLevel = 2;  // Request 2 levels of antialiasing
-	sf::RenderWindow window(sf::VideoMode{ 1600, 1600 }, "SFML Demo", sf::Style::Resize | sf::Style::Close, Settings);
-	gladLoadGL();
-	glEnable(GL_DEPTH_TEST);
-	//"C:\Users\liminal\Desktop\FinalProject449\Lone - Pulsar.mp3"
-	//adding music
-	sf::Music music;
+/**
+ * @brief Command-line options. With --headless, the demo renders a fixed number of frames
+ * offscreen, without a window or music, advancing the simulation by exactly one step per frame
+ * so that runs are reproducible; with --out, each frame is saved there as a PNG. With --scene,
+ * the demo shows a scene file instead of the skull, loading its models nearest first; with
+ * --compile-scene, it only converts the scene file to the binary form. With --world, the scene
+ * file is streamed in grid cells of --cell-size while the camera travels through it. Models in
+ * the asset packages given with --package load from them; with --pack, the demo only writes the
+ * models of the --scene to a package. Linked shader programs are cached in --shader-cache, by
+ * default in the temporary directory; an empty path disables the cache. With --material-shaders,
+ * each mesh is drawn with the variant of shaders/material.vert and material.frag specialized for
+ * its material, instead of the scene's shader. With --boat, the demo shows the tiger in the boat,
+ * playing the tiger's imported animation, instead of the skull. With --hot-reload, shaders, textures, and the
+ * models of the scene's objects are reloaded whenever their files are saved.
+ */
+struct Options {
+	bool headless = false;
+	uint32_t frames = 600;
+	std::string outputDirectory;
+	std::string scenePath;
+	std::string compiledScenePath;
+	std::string worldPath;
+	std::vector<std::string> packagePaths;
+	std::string packOutput;
+	bool materialShaders = false;
+	bool boat = false;
+	bool hotReload = false;
+	std::string shaderCache = (std::filesystem::temp_directory_path() / "FinalProject449-shaders").string();
+	float_t cellSize = StreamingBudgets().cellSize;
+	uint32_t width = 1600;
+	uint32_t height = 1600;
+};
 
-	if (!music.openFromFile("./Lone - Pulsar.mp3")) {
-		return -1;
+const char* USAGE = "usage: [--headless] [--frames N] [--out DIRECTORY] [--size WIDTHxHEIGHT] [--scene PATH]"
+	" [--compile-scene OUTPUT] [--world PATH] [--cell-size SIZE] [--package PATH]... [--pack OUTPUT]"
+	" [--shader-cache DIRECTORY] [--material-shaders] [--boat] [--hot-reload]";
+
+// Throws std::runtime_error for unknown options, malformed sizes, and cell sizes that are not
+// positive numbers, and std::invalid_argument or std::out_of_range for malformed numbers.
+Options parseOptions(int argc, char* argv[]) {
+	Options options;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--headless") {
+			options.headless = true;
+		}
+		else if (arg == "--frames" && hasValue) {
+			options.frames = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (arg == "--out" && hasValue) {
+			options.outputDirectory = argv[++i];
+		}
+		else if (arg == "--scene" && hasValue) {
+			options.scenePath = argv[++i];
+		}
+		else if (arg == "--compile-scene" && hasValue) {
+			options.compiledScenePath = argv[++i];
+		}
+		else if (arg == "--world" && hasValue) {
+			options.worldPath = argv[++i];
+		}
+		else if (arg == "--cell-size" && hasValue) {
+			options.cellSize = std::stof(argv[++i]);
+			if (!std::isfinite(options.cellSize) || options.cellSize <= 0) {
+				throw std::runtime_error("--cell-size must be a positive number");
+			}
+		}
+		else if (arg == "--package" && hasValue) {
+			options.packagePaths.push_back(argv[++i]);
+		}
+		else if (arg == "--pack" && hasValue) {
+			options.packOutput = argv[++i];
+		}
+		else if (arg == "--material-shaders") {
+			options.materialShaders = true;
+		}
+		else if (arg == "--boat") {
+			options.boat = true;
+		}
+		else if (arg == "--hot-reload") {
+			options.hotReload = true;
+		}
+		else if (arg == "--shader-cache" && hasValue) {
+			options.shaderCache = argv[++i];
+		}
+		else if (arg == "--size" && hasValue) {
+			if (std::sscanf(argv[++i], "%ux%u", &options.width, &options.height) != 2) {
+				throw std::runtime_error("--size must be WIDTHxHEIGHT");
+			}
+		}
+		else {
+			throw std::runtime_error("Unknown option " + arg);
+		}
 	}
+	return options;
+}
 
-	music.play();
-
-	// Initialize scene objects.
-	//auto scene = lifeOfPi();
-	auto scene2 = skull();
-	auto& skull = scene2.objects[0];
-	auto& jaw = skull.getChild(0);
-	auto& topTeeth = skull.getChild(1);
-	auto& botTeeth = skull.getChild(2);
-	auto& calvaria = skull.getChild(3);
-	auto& eye1 = skull.getChild(4);
-	auto& eye2 = skull.getChild(5);
-	
+/**
+ * @brief Writes each model used by the scene to an asset package, except those with animations,
+ * which packages cannot store.
+ */
+void packScene(const SceneDescription& scene, const std::filesystem::path& output) {
+	std::vector<ImportedModel> models;
+	std::set<std::pair<std::string, bool>> packed;
+	for (auto& node : scene.nodes) {
+		if (node.model.empty() || !packed.insert({ node.model, node.flipTextureCoords }).second) {
+			continue;
+		}
+		ImportedModel model = importModel(node.model, node.flipTextureCoords);
+		if (!model.animations.empty()) {
+			std::cout << "Skipping " << node.model << ", which has animations" << std::endl;
+			continue;
+		}
+		models.push_back(std::move(model));
+	}
+	AssetPackage::write(models, output);
+	std::cout << "Packed " << models.size() << " models into " << output.string() << std::endl;
+}
 
+int main(int argc, char* argv[]) {
+	Options options;
+	try {
+		options = parseOptions(argc, argv);
+	}
+	catch (std::exception& e) {
+		std::cerr << e.what() << "\n" << USAGE << std::endl;
+		return 1;
+	}
+	if (!options.compiledScenePath.empty()) {
+		if (options.scenePath.empty()) {
+			std::cerr << "--compile-scene needs a --scene to compile\n" << USAGE << std::endl;
+			return 1;
+		}
+		std::ofstream out(options.compiledScenePath, std::ios::binary);
+		writeSceneBinary(loadSceneDescription(options.scenePath), out);
+		return out ? 0 : 1;
+	}
+	if (!options.packOutput.empty()) {
+		if (options.scenePath.empty()) {
+			std::cerr << "--pack needs a --scene whose models to pack\n" << USAGE << std::endl;
+			return 1;
+		}
+		packScene(loadSceneDescription(options.scenePath), options.packOutput);
+		return 0;
+	}
+	for (auto& path : options.packagePaths) {
+		mountAssetPackage(path);
+	}
+	ShaderProgram::setBinaryCache(options.shaderCache);
+
+	// Initialize the window, or an offscreen framebuffer, and OpenGL.
+	std::unique_ptr<sf::RenderWindow> window;
+	std::unique_ptr<HeadlessContext> headlessContext;
+	std::unique_ptr<FrameBuffer> frameBuffer;
+	// Created only with a window, since opening the audio device fails on headless machines.
+	std::unique_ptr<sf::Music> music;
+	if (options.headless) {
+		headlessContext = std::make_unique<HeadlessContext>();
+		frameBuffer = std::make_unique<FrameBuffer>(options.width, options.height);
+		frameBuffer->bind();
+		if (!options.outputDirectory.empty()) {
+			std::filesystem::create_directories(options.outputDirectory);
+		}
+	}
+	else {
+		sf::ContextSettings Settings;
+		Settings.depthBits = 24; // Request a 24 bits depth buffer
+		Settings.stencilBits = 8;  // Request a 8 bits stencil buffer
+		Settings.antialiasingLevel = 2;  // Request 2 levels of antialiasing
+		window = std::make_unique<sf::RenderWindow>(sf::VideoMode{ options.width, options.height }, "SFML Demo",
+			sf::Style::Resize | sf::Style::Close, Settings);
+		gladLoadGL();
+		//"C:\Users\liminal\Desktop\FinalProject449\Lone - Pulsar.mp3"
+		//adding music
+		music = std::make_unique<sf::Music>();
+		if (!music->openFromFile("./Lone - Pulsar.mp3")) {
+			return -1;
+		}
 
-	//auto& jaw_botTeeth = scene2.objects[2];
-	jaw.addChild(std::move(botTeeth));
+		music->play();
+	}
+	glEnable(GL_DEPTH_TEST);
 
-	//OBJECT VELOCITY:
-	//skull.setVelocity(glm::vec3(0.0, -0.0075, -1.0));
-	jaw.setVelocity(glm::vec3(0.0, -2.0, -0.5));
+	// Initialize scene objects.
+	Scene scene2 = [&] {
+		if (!options.scenePath.empty() || !options.worldPath.empty()) {
+			return Scene{};
+		}
+		if (options.boat) {
+			MemoryTag tag("lifeOfPi");
+			return lifeOfPi();
+		}
+		MemoryTag tag("skull");
+		return skull();
+	}();
+	// A scene file's objects are created at once, and its models load while it renders.
+	std::unique_ptr<LazyScene> lazyScene;
+	// Created once the shaders are set up, but models may load before then.
+	std::unique_ptr<AssetReloader> reloader;
+	if (!options.scenePath.empty()) {
+		try {
+			lazyScene = std::make_unique<LazyScene>(loadSceneDescription(options.scenePath));
+			scene2.defaultShader.compile(lazyScene->description().vertexShader, lazyScene->description().fragmentShader);
+		}
+		catch (std::runtime_error& e) {
+			std::cout << "ERROR: " << e.what() << std::endl;
+			return 1;
+		}
+		lazyScene->setOnLoaded([&](Object3D& model) {
+			scene2.skinning.add(model);
+			if (reloader != nullptr) {
+				reloader->watch(model);
+			}
+		});
+		if (options.headless) {
+			// Headless runs must render the same frames every time, whatever loading takes.
+			lazyScene->loadAll();
+		}
+	}
+	// A world's cells load and unload as the camera moves; its objects are static.
+	std::unique_ptr<WorldStreamer> world;
+	if (!options.worldPath.empty()) {
+		try {
+			StreamingBudgets budgets;
+			budgets.cellSize = options.cellSize;
+			world = std::make_unique<WorldStreamer>(loadSceneDescription(options.worldPath), budgets);
+			scene2.defaultShader.compile(world->description().vertexShader, world->description().fragmentShader);
+		}
+		catch (std::runtime_error& e) {
+			std::cout << "ERROR: " << e.what() << std::endl;
+			return 1;
+		}
+	}
+	std::vector<Object3D>& objects = lazyScene != nullptr ? lazyScene->objects() : scene2.objects;
+
+	MemoryAccounting::instance().report(std::cout);
+
+	// The skull's jaw bounces; the boat and scene files have no such behavior.
+	bool bounceJaw = lazyScene == nullptr && world == nullptr && !options.boat;
+	size_t jawBody = 0;
+	if (bounceJaw) {
+		auto& skull = scene2.objects[0];
+		auto& jaw = skull.getChild(0);
+		auto& topTeeth = skull.getChild(1);
+		auto& botTeeth = skull.getChild(2);
+		auto& calvaria = skull.getChild(3);
+		auto& eye1 = skull.getChild(4);
+		auto& eye2 = skull.getChild(5);
+
+		//auto& jaw_botTeeth = scene2.objects[2];
+		jaw.addChild(std::move(botTeeth));
+
+		//OBJECT VELOCITY:
+		//skull.setVelocity(glm::vec3(0.0, -0.0075, -1.0));
+		jaw.setVelocity(glm::vec3(0.0, -2.0, -0.5));
+		jawBody = scene2.kinematics.add(jaw);
+	}
 	//calvaria.setVelocity(glm::vec3(0.0, 0.5, 0));
 	//eye1.setVelocity(glm::vec3(-1.0, 1, 0));
 	//eye2.setVelocity(glm::vec3(1.0, 1, 0));
@@ -272,34 +563,131 @@ int main() {
 
 	auto cameraPosition = glm::vec3(0, 0, 0); 
 	auto camera = glm::lookAt(cameraPosition, glm::vec3(0, 0, -1), glm::vec3(0, 1, 0));
-	auto perspective = glm::perspective(glm::radians(45.0), static_cast<double>(window.getSize().x) / window.getSize().y, 0.1, 100.0);
+	auto perspective = glm::perspective(glm::radians(45.0), static_cast<double>(options.width) / options.height, 0.1, 100.0);
 
 	ShaderProgram& mainShader = scene2.defaultShader;
 	//ShaderProgram& subShader = scene2.defaultShader;
+	try {
+		mainShader.finish();
+	}
+	catch (std::runtime_error& e) {
+		std::cout << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
 
-	mainShader.activate();
+	// Also run whenever the program is reloaded, which resets its uniforms.
+	auto configureMainShader = [&](ShaderProgram& program) {
+		program.activate();
+		program.bindUniformBlock("JointPalette", Mesh3D::JOINT_PALETTE_BINDING);
+		program.setUniform("view", camera);
+		program.setUniform("projection", perspective);
+	};
+	configureMainShader(mainShader);
 	//subShader.activate();
-	mainShader.setUniform("view", camera);
 	//subShader.setUniform("view", camera);
-	mainShader.setUniform("projection", perspective);
 	//subShader.setUniform("projection", perspective);
 
+	// Each material's variant compiles while the first frames are prepared.
+	std::unique_ptr<ShaderVariants> materials;
+	if (options.materialShaders) {
+		materials = std::make_unique<ShaderVariants>("shaders/material.vert", "shaders/material.frag",
+			scene2.skinning.format() == PaletteFormat::DUAL_QUATERNION ? "#define DUAL_QUATERNION\n" : "");
+		materials->bindUniformBlock("JointPalette", Mesh3D::JOINT_PALETTE_BINDING);
+		materials->bindUniformBlock("PerDraw", Object3D::PER_DRAW_BINDING);
+		materials->setUniform("view", camera);
+		materials->setUniform("projection", perspective);
+		materials->setUniform("viewPosition", cameraPosition);
+		for (auto& o : objects) {
+			prepareVariants(*materials, o);
+		}
+	}
+	if (options.hotReload) {
+		reloader = std::make_unique<AssetReloader>();
+		reloader->addShader(mainShader, configureMainShader);
+		if (materials != nullptr) {
+			reloader->addShaders(*materials);
+		}
+		reloader->addObjects(objects);
+	}
+
 	//std::cout << scene2.objects[0].getCenter() << std::endl;
 	//std::cout << scene2.objects[0].getChild(1).getCenter() << std::endl;
 	// Ready, set, go!
 	for (auto& animator : scene2.animators) {
-		animator.start();
+		animator.start(scene2.animationEngine);
+	}
+	if (lazyScene != nullptr) {
+		lazyScene->start(scene2.animationEngine);
+	}
+	for (auto& o : scene2.objects) {
+		scene2.skinning.add(o);
 	}
+	// The simulation advances in fixed steps, independent of the display's frame rate.
+	const float_t SIMULATION_HZ = 60;
+	const uint32_t MAX_STEPS_PER_FRAME = 5;
+	FixedTimestep timestep(SIMULATION_HZ, MAX_STEPS_PER_FRAME);
+	for (auto& o : objects) {
+		o.savePreviousTransform();
+	}
+
 	bool running = true;
+	// F3 shows the last frame's rendering statistics in the window title, after the name of the
+	// object last clicked.
+	bool showStats = false;
+	float_t statsRefresh = 0;
+	std::string pickedName;
+	auto windowTitle = [&] {
+		std::string title = "SFML Demo";
+		if (!pickedName.empty()) {
+			title += " - " + pickedName;
+		}
+		if (showStats) {
+			title += " - " + RenderStats::lastFrame().summary();
+		}
+		return title;
+	};
 	sf::Clock c;
 
 	auto last = c.getElapsedTime();
+	uint32_t frame = 0;
 	while (running) {
 		sf::Event ev;
-		while (window.pollEvent(ev)) {
+		while (window != nullptr && window->pollEvent(ev)) {
 			if (ev.type == sf::Event::Closed) {
 				running = false;
 			}
+			else if (ev.type == sf::Event::KeyPressed && ev.key.code == sf::Keyboard::F3) {
+				showStats = !showStats;
+				window->setTitle(windowTitle());
+			}
+			else if (ev.type == sf::Event::KeyPressed && ev.key.code == sf::Keyboard::P) {
+				// Print where the recent frames' time went.
+				Profiler::instance().report(std::cout);
+			}
+			else if (ev.type == sf::Event::KeyPressed && ev.key.code == sf::Keyboard::T) {
+				// Start capturing a trace, or stop and save it.
+				auto& profiler = Profiler::instance();
+				if (!profiler.isCapturing()) {
+					profiler.startCapture();
+					std::cout << "Capturing trace..." << std::endl;
+				}
+				else {
+					profiler.stopCapture();
+					std::ofstream trace("trace.json");
+					profiler.writeChromeTrace(trace);
+					std::cout << "Wrote trace.json" << std::endl;
+				}
+			}
+			else if (ev.type == sf::Event::MouseButtonPressed && ev.mouseButton.button == sf::Mouse::Left) {
+				// Show which object was clicked in the title.
+				SceneBVH picker;
+				picker.build(objects);
+				Ray ray = rayFromScreen(glm::vec2(ev.mouseButton.x, ev.mouseButton.y),
+					glm::vec2(window->getSize().x, window->getSize().y), camera, glm::mat4(perspective));
+				PickResult pick;
+				pickedName = picker.pick(ray, pick) ? pick.object->getName() : "";
+				window->setTitle(windowTitle());
+			}
 		}
 		//std::cout << skull.getCenter() << std::endl;
 		//std::cout << eye1.getCenter() << std::endl;
@@ -307,39 +695,132 @@ int main() {
 		auto diff = now - last;
 		auto diffSeconds = diff.asSeconds();
 		last = now;
+		if (options.headless) {
+			// Headless runs advance exactly one step per frame, whatever the frame took.
+			diffSeconds = 1 / SIMULATION_HZ;
+		}
 
-		//eye1.render(window, mainShader);
-		//eye1.tick(diffSeconds);
-		//eye2.tick(diffSeconds);
-		//topTeeth.tick(diffSeconds);
-		//botTeeth.tick(diffSeconds);
-		
-		jaw.tick(diffSeconds);
+		uint32_t steps = timestep.advance(diffSeconds);
+		for (uint32_t step = 0; step < steps; step++) {
+			PROFILE_SCOPE("simulation step");
+			for (auto& o : objects) {
+				o.savePreviousTransform();
+			}
+			float_t dt = timestep.step();
+
+			//eye1.tick(dt);
+			//eye2.tick(dt);
+			//topTeeth.tick(dt);
+			//botTeeth.tick(dt);
+
+			auto& kinematics = scene2.kinematics;
+			kinematics.integrate(dt);
+
+			// Bounce the jaw between y = -4 and y = 0. Clamping to the boundary keeps it from
+			// overshooting, and reversing only when moving outward keeps it from getting stuck.
+			if (bounceJaw) {
+				glm::vec3 jawPosition = kinematics.position(jawBody);
+				glm::vec3 jawVelocity = kinematics.velocity(jawBody);
+				if (jawPosition.y >= 0 && jawVelocity.y > 0) {
+					kinematics.setPosition(jawBody, glm::vec3(jawPosition.x, 0, jawPosition.z));
+					kinematics.setVelocity(jawBody, -jawVelocity);
+				}
+				else if (jawPosition.y < -4.0 && jawVelocity.y < 0) {
+					kinematics.setPosition(jawBody, glm::vec3(jawPosition.x, -4.0, jawPosition.z));
+					kinematics.setVelocity(jawBody, -jawVelocity);
+				}
+			}
+			kinematics.apply();
 
-		if (jaw.getPosition().y >= 0) {
-			jaw.setVelocity(-jaw.getVelocity());
+			//calvaria.tick(dt);
+			//skull.tick(dt);
+			scene2.animationEngine.tick(dt);
+			scene2.animationEngine.apply();
+			scene2.animationGraphs.update(dt);
 		}
-
-		if (jaw.getPosition().y < -4.0) {
-			jaw.setVelocity(-jaw.getVelocity());
+		if (lazyScene != nullptr) {
+			// Load what the camera is nearest to, a few milliseconds' worth per frame.
+			lazyScene->update(cameraPosition, 0.004f);
 		}
-
-		
-		
-		//calvaria.tick(diffSeconds);
-		//skull.tick(diffSeconds);
-		for (auto& animator : scene2.animators) {
-			animator.tick(diffSeconds);
+		if (world != nullptr) {
+			// Travel forward through the world.
+			const float_t WORLD_CAMERA_SPEED = 5;
+			cameraPosition.z -= WORLD_CAMERA_SPEED * diffSeconds;
+			camera = glm::lookAt(cameraPosition, cameraPosition + glm::vec3(0, 0, -1), glm::vec3(0, 1, 0));
+			mainShader.setUniform("view", camera);
+			if (materials != nullptr) {
+				materials->setUniform("view", camera);
+				materials->setUniform("viewPosition", cameraPosition);
+			}
+			if (options.headless) {
+				// Headless runs must render the same frames every time, whatever loading takes.
+				world->finishLoading(cameraPosition);
+			}
+			else {
+				world->update(cameraPosition);
+			}
+		}
+		if (reloader != nullptr) {
+			reloader->update();
+		}
+		{
+			PROFILE_SCOPE("SkinningSystem::update");
+			scene2.skinning.update(timestep.alpha());
 		}
 
-		// Clear the OpenGL "context".
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		// Render each object in the scene.
-		for (auto& o : scene2.objects) {
-			o.render(window, mainShader);
-			//o.render(window, subShader);
+		{
+			PROFILE_SCOPE("draw");
+			PROFILE_GPU_SCOPE("scene");
+			// Clear the OpenGL "context".
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			Object3D::beginFrame();
+			// Render each object in the scene.
+			if (materials != nullptr) {
+				Object3D::renderAll(objects, *materials, timestep.alpha());
+			}
+			else {
+				Object3D::renderAll(objects, mainShader, timestep.alpha());
+			}
+			if (world != nullptr && materials != nullptr) {
+				world->render(*materials, timestep.alpha());
+			}
+			else if (world != nullptr) {
+				world->render(mainShader, timestep.alpha());
+			}
+		}
+		if (window != nullptr) {
+			PROFILE_SCOPE("window.display");
+			window->display();
+		}
+		else if (!options.outputDirectory.empty()) {
+			PROFILE_SCOPE("save frame");
+			char name[32];
+			std::snprintf(name, sizeof(name), "frame_%05u.png", frame);
+			frameBuffer->save((std::filesystem::path(options.outputDirectory) / name).string());
+		}
+		Profiler::instance().endFrame();
+		RenderStats::endFrame();
+
+		statsRefresh += diffSeconds;
+		if (showStats && statsRefresh >= 0.5f) {
+			// Twice a second is often enough to read, and keeps the title from flickering.
+			statsRefresh = 0;
+			window->setTitle(windowTitle());
+		}
+		if (options.headless && ++frame >= options.frames) {
+			running = false;
+		}
+	}
+	if (options.headless) {
+		glFinish();
+		std::cout << "Rendered " << frame << " frames in " << c.getElapsedTime().asSeconds() << " s" << std::endl;
+		std::cout << "Last frame: " << RenderStats::lastFrame().summary() << std::endl;
+		if (world != nullptr) {
+			auto& stats = world->stats();
+			std::cout << "World: " << stats.residentCells << " of " << world->cellCount() << " cells resident, "
+				<< stats.residentModels << " models, " << stats.residentBytes / 1024 << " KiB" << std::endl;
 		}
-		window.display();
+		Profiler::instance().report(std::cout);
 	}
 
 	return 0;
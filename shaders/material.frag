@@ -0,0 +1,58 @@
+#version 330
+// The fragment shader of ShaderVariants' material programs: the base texture lit by one
+// directional light. NORMAL_MAP perturbs the normal by the mesh's normal map, and SPEC_MAP
+// scales the highlight by its specular map; without them, neither sampler is read.
+in vec2 TexCoord;
+in vec3 WorldPosition;
+in vec3 Normal;
+
+uniform sampler2D baseTexture;
+#ifdef NORMAL_MAP
+uniform sampler2D normalMap;
+#endif
+#ifdef SPEC_MAP
+uniform sampler2D specMap;
+#endif
+
+uniform vec3 lightDirection = vec3(-0.4, -1.0, -0.6);
+uniform vec3 viewPosition = vec3(0.0);
+uniform float ambient = 0.3;
+uniform float shininess = 32.0;
+
+out vec4 FragColor;
+
+#ifdef NORMAL_MAP
+// Meshes carry no tangents, so the tangent frame comes from the screen-space derivatives of the
+// position and texture coordinates.
+vec3 perturbNormal(vec3 normal) {
+    vec3 dp1 = dFdx(WorldPosition);
+    vec3 dp2 = dFdy(WorldPosition);
+    vec2 duv1 = dFdx(TexCoord);
+    vec2 duv2 = dFdy(TexCoord);
+    vec3 dp2perp = cross(dp2, normal);
+    vec3 dp1perp = cross(normal, dp1);
+    vec3 tangent = dp2perp * duv1.x + dp1perp * duv2.x;
+    vec3 bitangent = dp2perp * duv1.y + dp1perp * duv2.y;
+    float scale = inversesqrt(max(dot(tangent, tangent), dot(bitangent, bitangent)));
+    vec3 mapped = texture(normalMap, TexCoord).xyz * 2.0 - 1.0;
+    return normalize(mat3(tangent * scale, bitangent * scale, normal) * mapped);
+}
+#endif
+
+void main() {
+    vec4 base = texture(baseTexture, TexCoord);
+    vec3 normal = normalize(Normal);
+#ifdef NORMAL_MAP
+    normal = perturbNormal(normal);
+#endif
+    vec3 toLight = normalize(-lightDirection);
+    float diffuse = max(dot(normal, toLight), 0.0);
+    vec3 toViewer = normalize(viewPosition - WorldPosition);
+    float specular = pow(max(dot(reflect(-toLight, normal), toViewer), 0.0), shininess);
+#ifdef SPEC_MAP
+    specular *= texture(specMap, TexCoord).r;
+#else
+    specular *= 0.2;
+#endif
+    FragColor = vec4(base.rgb * (ambient + diffuse) + vec3(specular), base.a);
+}
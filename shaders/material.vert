@@ -0,0 +1,82 @@
+#version 330
+// The vertex shader of ShaderVariants' material programs. Each program is compiled with a define
+// for each feature of the meshes it draws: SKINNED deforms the mesh by its joint palette, read
+// as PaletteFormat::DUAL_QUATERNION if DUAL_QUATERNION is defined and as AFFINE otherwise.
+layout (location=0) in vec3 vPosition;
+layout (location=1) in vec3 vNormal;
+layout (location=2) in vec2 vTexCoord;
+
+#ifdef SKINNED
+layout (location=3) in uvec4 vJoints;
+layout (location=4) in vec4 vWeights;
+
+// Must match SkinningSystem::MAX_JOINTS.
+const int MAX_JOINTS = 128;
+
+#ifdef DUAL_QUATERNION
+layout (std140) uniform JointPalette {
+    vec4 joints[MAX_JOINTS * 2];
+};
+#else
+layout (std140) uniform JointPalette {
+    vec4 joints[MAX_JOINTS * 3];
+};
+#endif
+#endif
+
+// Must match Object3D::PER_DRAW_CAPACITY.
+const int PER_DRAW_CAPACITY = 64;
+
+// Object3D::PER_DRAW_BINDING: the model matrices of a batch of draws, of which drawIndex is the
+// mesh being drawn.
+layout (std140) uniform PerDraw {
+    mat4 models[PER_DRAW_CAPACITY];
+};
+uniform int drawIndex;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+out vec2 TexCoord;
+out vec3 WorldPosition;
+out vec3 Normal;
+
+void main() {
+    mat4 model = models[drawIndex];
+    vec3 position = vPosition;
+    vec3 normal = vNormal;
+#if defined(SKINNED) && defined(DUAL_QUATERNION)
+    vec4 first = joints[int(vJoints[0]) * 2];
+    vec4 real = vec4(0.0), dual = vec4(0.0);
+    for (int i = 0; i < 4; i++) {
+        int base = int(vJoints[i]) * 2;
+        // q and -q are the same rotation; blend every joint in the first one's hemisphere.
+        float weight = dot(joints[base], first) < 0.0 ? -vWeights[i] : vWeights[i];
+        real += weight * joints[base];
+        dual += weight * joints[base + 1];
+    }
+    float len = length(real);
+    real /= len;
+    dual /= len;
+    position += 2.0 * cross(real.xyz, cross(real.xyz, position) + real.w * position);
+    position += 2.0 * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+    normal += 2.0 * cross(real.xyz, cross(real.xyz, normal) + real.w * normal);
+#elif defined(SKINNED)
+    // Blend the rows, then transform once.
+    vec4 row0 = vec4(0.0), row1 = vec4(0.0), row2 = vec4(0.0);
+    for (int i = 0; i < 4; i++) {
+        int base = int(vJoints[i]) * 3;
+        row0 += vWeights[i] * joints[base];
+        row1 += vWeights[i] * joints[base + 1];
+        row2 += vWeights[i] * joints[base + 2];
+    }
+    vec4 p = vec4(position, 1.0);
+    position = vec3(dot(row0, p), dot(row1, p), dot(row2, p));
+    normal = vec3(dot(row0.xyz, normal), dot(row1.xyz, normal), dot(row2.xyz, normal));
+#endif
+    vec4 world = model * vec4(position, 1.0);
+    gl_Position = projection * view * world;
+    WorldPosition = world.xyz;
+    Normal = mat3(model) * normal;
+    TexCoord = vTexCoord;
+}
@@ -0,0 +1,55 @@
+#version 330
+// The dual-quaternion counterpart of skinned_texture_perspective.vert. Blending dual quaternions
+// keeps twisting joints from collapsing the way blended matrices do, but ignores joint scale.
+layout (location=0) in vec3 vPosition;
+layout (location=1) in vec3 vNormal;
+layout (location=2) in vec2 vTexCoord;
+layout (location=3) in uvec4 vJoints;
+layout (location=4) in vec4 vWeights;
+
+// Must match SkinningSystem::MAX_JOINTS.
+const int MAX_JOINTS = 128;
+
+// PaletteFormat::DUAL_QUATERNION: the real part (x, y, z, w) of each joint, then the dual part.
+layout (std140) uniform JointPalette {
+    vec4 joints[MAX_JOINTS * 2];
+};
+
+// Must match Object3D::PER_DRAW_CAPACITY.
+const int PER_DRAW_CAPACITY = 64;
+
+// Object3D::PER_DRAW_BINDING: the model matrices of a batch of draws, of which drawIndex is the
+// mesh being drawn.
+layout (std140) uniform PerDraw {
+    mat4 models[PER_DRAW_CAPACITY];
+};
+uniform int drawIndex;
+
+uniform bool skinned;
+uniform mat4 view;
+uniform mat4 projection;
+
+out vec2 TexCoord;
+
+void main() {
+    mat4 model = models[drawIndex];
+    vec3 position = vPosition;
+    if (skinned) {
+        vec4 first = joints[int(vJoints[0]) * 2];
+        vec4 real = vec4(0.0), dual = vec4(0.0);
+        for (int i = 0; i < 4; i++) {
+            int base = int(vJoints[i]) * 2;
+            // q and -q are the same rotation; blend every joint in the first one's hemisphere.
+            float weight = dot(joints[base], first) < 0.0 ? -vWeights[i] : vWeights[i];
+            real += weight * joints[base];
+            dual += weight * joints[base + 1];
+        }
+        float len = length(real);
+        real /= len;
+        dual /= len;
+        position += 2.0 * cross(real.xyz, cross(real.xyz, position) + real.w * position);
+        position += 2.0 * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+    }
+    gl_Position = projection * view * model * vec4(position, 1.0);
+    TexCoord = vTexCoord;
+}
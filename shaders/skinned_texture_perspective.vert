@@ -0,0 +1,51 @@
+#version 330
+// A vertex shader that deforms skinned meshes by their joint matrices before applying the
+// model-view-projection transform. Meshes without skins pass through unchanged, so one program
+// can draw a whole model. Outputs match texture_perspective.vert.
+layout (location=0) in vec3 vPosition;
+layout (location=1) in vec3 vNormal;
+layout (location=2) in vec2 vTexCoord;
+layout (location=3) in uvec4 vJoints;
+layout (location=4) in vec4 vWeights;
+
+// Must match SkinningSystem::MAX_JOINTS.
+const int MAX_JOINTS = 128;
+
+// PaletteFormat::AFFINE: the top three rows of each joint's matrix.
+layout (std140) uniform JointPalette {
+    vec4 joints[MAX_JOINTS * 3];
+};
+
+// Must match Object3D::PER_DRAW_CAPACITY.
+const int PER_DRAW_CAPACITY = 64;
+
+// Object3D::PER_DRAW_BINDING: the model matrices of a batch of draws, of which drawIndex is the
+// mesh being drawn.
+layout (std140) uniform PerDraw {
+    mat4 models[PER_DRAW_CAPACITY];
+};
+uniform int drawIndex;
+
+uniform bool skinned;
+uniform mat4 view;
+uniform mat4 projection;
+
+out vec2 TexCoord;
+
+void main() {
+    mat4 model = models[drawIndex];
+    vec4 position = vec4(vPosition, 1.0);
+    if (skinned) {
+        // Blend the rows, then transform once.
+        vec4 row0 = vec4(0.0), row1 = vec4(0.0), row2 = vec4(0.0);
+        for (int i = 0; i < 4; i++) {
+            int base = int(vJoints[i]) * 3;
+            row0 += vWeights[i] * joints[base];
+            row1 += vWeights[i] * joints[base + 1];
+            row2 += vWeights[i] * joints[base + 2];
+        }
+        position = vec4(dot(row0, position), dot(row1, position), dot(row2, position), 1.0);
+    }
+    gl_Position = projection * view * model * position;
+    TexCoord = vTexCoord;
+}
@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+"""Compares two runs of fp449_bench, and optionally two headless runs of fp449_demo.
+
+    tools/compare_benchmarks.py BASELINE.json CONTENDER.json [--demo BASELINE.txt CONTENDER.txt]
+
+Benchmark files are the --benchmark_out output of fp449_bench; demo files are the standard
+output of fp449_demo --headless. A change counts as significant when the means differ by more
+than twice their combined standard deviation. Exits with status 1 if any benchmark got
+significantly slower.
+"""
+import argparse
+import json
+import math
+import re
+import sys
+
+
+def load_benchmarks(path):
+    with open(path) as f:
+        return {b["name"]: b for b in json.load(f)["benchmarks"]}
+
+
+def load_demo(path):
+    """The total run time, and the profiler's average frame time in ms, of a headless run."""
+    result = {}
+    with open(path) as f:
+        for line in f:
+            rendered = re.match(r"Rendered (\d+) frames in ([\d.eE+-]+) s", line)
+            if rendered:
+                result["frames"] = int(rendered.group(1))
+                result["seconds"] = float(rendered.group(2))
+            # The CPU "frame" row of the profiler report: name, calls, min, avg, p99.
+            frame = re.match(r"\s+frame\s+([\d.]+)\s+([\d.]+)\s+([\d.]+)\s+([\d.]+)", line)
+            if frame and "frame_avg_ms" not in result:
+                result["frame_min_ms"] = float(frame.group(2))
+                result["frame_avg_ms"] = float(frame.group(3))
+                result["frame_p99_ms"] = float(frame.group(4))
+    return result
+
+
+def compare_benchmarks(baseline, contender):
+    regressions = 0
+    print(f"{'Benchmark':<40}{'Baseline':>14}{'Contender':>14}{'Change':>10}  ")
+    for name, base in baseline.items():
+        other = contender.get(name)
+        if other is None or "error_message" in base or "error_message" in other:
+            reason = "missing" if other is None else "skipped"
+            print(f"{name:<40}{reason:>38}")
+            continue
+        before, after = base["real_time"], other["real_time"]
+        change = (after - before) / before * 100
+        noise = 2 * math.hypot(base.get("real_time_stddev", 0), other.get("real_time_stddev", 0))
+        verdict = ""
+        if abs(after - before) > noise:
+            verdict = "faster" if after < before else "SLOWER"
+            regressions += after > before
+        unit = base.get("time_unit", "ns")
+        print(f"{name:<40}{before:>11.0f} {unit}{after:>11.0f} {unit}{change:>+9.1f}%  {verdict}")
+    return regressions
+
+
+def compare_demo(baseline, contender):
+    print()
+    print(f"{'Demo (headless)':<40}{'Baseline':>14}{'Contender':>14}{'Change':>10}")
+    for key, label in [("seconds", "total s"), ("frame_min_ms", "frame min ms"),
+                       ("frame_avg_ms", "frame avg ms"), ("frame_p99_ms", "frame p99 ms")]:
+        if key in baseline and key in contender:
+            before, after = baseline[key], contender[key]
+            change = (after - before) / before * 100 if before else 0
+            print(f"{label:<40}{before:>14.3f}{after:>14.3f}{change:>+9.1f}%")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("baseline")
+    parser.add_argument("contender")
+    parser.add_argument("--demo", nargs=2, metavar=("BASELINE", "CONTENDER"))
+    args = parser.parse_args()
+
+    regressions = compare_benchmarks(load_benchmarks(args.baseline), load_benchmarks(args.contender))
+    if args.demo:
+        compare_demo(load_demo(args.demo[0]), load_demo(args.demo[1]))
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,87 @@
+#!/usr/bin/env bash
+# Builds the engine with profile-guided optimization and compares it against a build without.
+#
+#   tools/pgo.sh [--frames N] [--repetitions N] [--build-root DIR] [-- extra CMake arguments]
+#
+# 1. Builds a baseline (FP449_PGO=OFF) and an instrumented build (FP449_PGO=GENERATE), both with
+#    any extra CMake arguments, e.g. -DFP449_LTO=ON -DFP449_MARCH=native.
+# 2. Trains the instrumented build on the canonical workload: the skull scene rendered headless
+#    for N frames, and the import benchmarks.
+# 3. Rebuilds the instrumented build directory with FP449_PGO=USE. GCC finds its profiles by
+#    object file path, so the optimized build must reuse the instrumented build's directory.
+# 4. Runs the same workload on the baseline and the optimized build, and compares them with
+#    tools/compare_benchmarks.py.
+#
+# Run from anywhere; the demo runs from the source directory, where its assets are.
+set -euo pipefail
+
+SOURCE_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+BUILD_ROOT="$SOURCE_DIR/build"
+FRAMES=600
+REPETITIONS=5
+CMAKE_ARGS=()
+
+while [[ $# -gt 0 ]]; do
+	case "$1" in
+		--frames) FRAMES="$2"; shift 2 ;;
+		--repetitions) REPETITIONS="$2"; shift 2 ;;
+		--build-root) BUILD_ROOT="$2"; shift 2 ;;
+		--) shift; CMAKE_ARGS=("$@"); break ;;
+		*) echo "usage: $0 [--frames N] [--repetitions N] [--build-root DIR] [-- CMake arguments]" >&2; exit 2 ;;
+	esac
+done
+
+BASELINE_DIR="$BUILD_ROOT/pgo-baseline"
+PGO_DIR="$BUILD_ROOT/pgo"
+PROFILE_DIR="$PGO_DIR/pgo-profiles"
+RESULTS_DIR="$BUILD_ROOT/pgo-results"
+JOBS="$(nproc 2>/dev/null || echo 4)"
+# Training runs only the benchmarks the workload is meant to represent.
+TRAINING_FILTER="BM_AssimpLoad"
+
+configure() {
+	local dir="$1" pgo="$2"
+	cmake -S "$SOURCE_DIR" -B "$dir" -DCMAKE_BUILD_TYPE=Release -DFP449_PGO="$pgo" \
+		-DFP449_PGO_DIR="$PROFILE_DIR" ${CMAKE_ARGS[@]+"${CMAKE_ARGS[@]}"} > /dev/null
+}
+
+# Runs the workload on one build, writing the demo's output and the benchmark JSON to $2.
+run_workload() {
+	local dir="$1" prefix="$2" filter="$3" repetitions="$4"
+	(cd "$SOURCE_DIR" && "$dir/fp449_demo" --headless --frames "$FRAMES") > "$prefix-demo.txt"
+	"$dir/fp449_bench" --benchmark_filter="$filter" --benchmark_repetitions="$repetitions" \
+		--benchmark_out="$prefix-bench.json" > /dev/null
+}
+
+mkdir -p "$RESULTS_DIR"
+
+echo "== Building the baseline"
+configure "$BASELINE_DIR" OFF
+cmake --build "$BASELINE_DIR" -j "$JOBS"
+
+echo "== Building the instrumented engine"
+rm -rf "$PROFILE_DIR"
+configure "$PGO_DIR" GENERATE
+cmake --build "$PGO_DIR" -j "$JOBS" --clean-first
+
+echo "== Training: skull scene for $FRAMES frames, then $TRAINING_FILTER"
+run_workload "$PGO_DIR" "$RESULTS_DIR/training" "$TRAINING_FILTER" 1
+
+COMPILER_ID="$(sed -n 's/^set(CMAKE_CXX_COMPILER_ID "\(.*\)")$/\1/p' "$PGO_DIR"/CMakeFiles/*/CMakeCXXCompiler.cmake)"
+if [[ "$COMPILER_ID" == *Clang* ]]; then
+	# Clang writes one raw profile per process; the optimized build reads them merged.
+	PROFDATA="$(command -v llvm-profdata || ls /usr/bin/llvm-profdata-* 2>/dev/null | sort -V | tail -n 1)"
+	"$PROFDATA" merge -o "$PROFILE_DIR/merged.profdata" "$PROFILE_DIR"/*.profraw
+fi
+
+echo "== Building with the collected profile"
+configure "$PGO_DIR" USE
+cmake --build "$PGO_DIR" -j "$JOBS" --clean-first
+
+echo "== Measuring"
+run_workload "$BASELINE_DIR" "$RESULTS_DIR/baseline" ".*" "$REPETITIONS"
+run_workload "$PGO_DIR" "$RESULTS_DIR/pgo" ".*" "$REPETITIONS"
+
+python3 "$SOURCE_DIR/tools/compare_benchmarks.py" \
+	"$RESULTS_DIR/baseline-bench.json" "$RESULTS_DIR/pgo-bench.json" \
+	--demo "$RESULTS_DIR/baseline-demo.txt" "$RESULTS_DIR/pgo-demo.txt"